@@ -190,8 +190,19 @@ free_unit_times(struct unit_times *t, unsigned n)
 	free(t);
 }
 
+static void
+unit_times_finish(struct unit_times *t)
+{
+	if (t->activated >= t->activating)
+		t->time = t->activated - t->activating;
+	else if (t->deactivated >= t->activating)
+		t->time = t->deactivated - t->activating;
+	else
+		t->time = 0;
+}
+
 static int
-acquire_time_data(sd_bus *bus, struct unit_times **out)
+acquire_time_data_per_unit(sd_bus *bus, struct unit_times **out)
 {
 	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
 	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
@@ -249,12 +260,7 @@ acquire_time_data(sd_bus *bus, struct unit_times **out)
 			goto fail;
 		}
 
-		if (t->activated >= t->activating)
-			t->time = t->activated - t->activating;
-		else if (t->deactivated >= t->activating)
-			t->time = t->deactivated - t->activating;
-		else
-			t->time = 0;
+		unit_times_finish(t);
 
 		if (t->activating == 0)
 			continue;
@@ -280,6 +286,185 @@ fail:
 	return r;
 }
 
+/* Asks the manager for the timestamps of all units and the edges of the
+ * given dependency types between them in a single call. Returns 0 if the
+ * manager does not know about that call yet. */
+static int
+list_unit_times(sd_bus *bus, char **types, sd_bus_message **reply)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	int r;
+
+	r = sd_bus_message_new_method_call(bus, &m, SVC_DBUS_BUSNAME,
+		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
+		"ListUnitTimes");
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append_strv(m, types);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_call(bus, m, 0, &error, reply);
+	if (r < 0) {
+		if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+			return 0;
+
+		log_error("Failed to list unit times: %s",
+			bus_error_message(&error, -r));
+		return r;
+	}
+
+	return 1;
+}
+
+static void
+free_unit_deps(Hashmap *h)
+{
+	char *k;
+
+	while ((k = hashmap_first_key(h))) {
+		strv_free(hashmap_remove(h, k));
+		free(k);
+	}
+
+	hashmap_free(h);
+}
+
+static int
+parse_unit_deps(sd_bus_message *reply, const char *type, Hashmap **out)
+{
+	const char *from, *t, *to;
+	Hashmap *h;
+	int r;
+
+	h = hashmap_new(&string_hash_ops);
+	if (!h)
+		return log_oom();
+
+	r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sss)");
+	if (r < 0)
+		goto parse_fail;
+
+	while ((r = sd_bus_message_read(reply, "(sss)", &from, &t, &to)) > 0) {
+		char **l, *k = NULL;
+
+		if (!streq(t, type))
+			continue;
+
+		l = hashmap_get2(h, from, (void **)&k);
+		if (!l) {
+			k = strdup(from);
+			if (!k)
+				goto oom;
+		}
+
+		if (strv_extend(&l, to) < 0 || hashmap_replace(h, k, l) < 0) {
+			if (!hashmap_get(h, k)) {
+				strv_free(l);
+				free(k);
+			}
+			goto oom;
+		}
+	}
+	if (r < 0)
+		goto parse_fail;
+
+	r = sd_bus_message_exit_container(reply);
+	if (r < 0)
+		goto parse_fail;
+
+	*out = h;
+	return 0;
+
+parse_fail:
+	free_unit_deps(h);
+	return bus_log_parse_error(r);
+
+oom:
+	free_unit_deps(h);
+	return log_oom();
+}
+
+/* Collects the timestamps of all units that have been started. If deps
+ * is not NULL, also returns the units each unit is ordered after, or
+ * NULL if these have to be asked for unit by unit. */
+static int
+acquire_time_data(sd_bus *bus, Hashmap **deps, struct unit_times **out)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	struct unit_times *unit_times = NULL;
+	size_t size = 0;
+	int r, c = 0;
+
+	r = list_unit_times(bus, deps ? STRV_MAKE("After") : NULL, &reply);
+	if (r < 0)
+		return r;
+	if (r == 0) {
+		if (deps)
+			*deps = NULL;
+		return acquire_time_data_per_unit(bus, out);
+	}
+
+	r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY,
+		"(stttt)");
+	if (r < 0)
+		goto parse_fail;
+
+	for (;;) {
+		struct unit_times *t;
+		const char *id;
+
+		if (!GREEDY_REALLOC(unit_times, size, c + 1)) {
+			r = log_oom();
+			goto fail;
+		}
+
+		t = unit_times + c;
+		t->name = NULL;
+
+		r = sd_bus_message_read(reply, "(stttt)", &id, &t->activating,
+			&t->activated, &t->deactivating, &t->deactivated);
+		if (r < 0)
+			goto parse_fail;
+		if (r == 0)
+			break;
+
+		unit_times_finish(t);
+
+		if (t->activating == 0)
+			continue;
+
+		t->name = strdup(id);
+		if (t->name == NULL) {
+			r = log_oom();
+			goto fail;
+		}
+		c++;
+	}
+
+	r = sd_bus_message_exit_container(reply);
+	if (r < 0)
+		goto parse_fail;
+
+	if (deps) {
+		r = parse_unit_deps(reply, "After", deps);
+		if (r < 0)
+			goto fail;
+	}
+
+	*out = unit_times;
+	return c;
+
+parse_fail:
+	bus_log_parse_error(r);
+fail:
+	if (unit_times)
+		free_unit_times(unit_times, (unsigned)c);
+	return r;
+}
+
 static int
 acquire_boot_times(sd_bus *bus, struct boot_times **bt)
 {
@@ -525,7 +710,7 @@ analyze_plot(sd_bus *bus)
 	if (n < 0)
 		return n;
 
-	n = acquire_time_data(bus, &times);
+	n = acquire_time_data(bus, NULL, &times);
 	if (n <= 0)
 		goto out;
 
@@ -770,6 +955,9 @@ list_dependencies_print(const char *name, unsigned int level,
 	return 0;
 }
 
+static Hashmap *unit_times_hashmap;
+static Hashmap *unit_deps_hashmap;
+
 static int
 list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps)
 {
@@ -779,6 +967,11 @@ list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps)
 	assert(name);
 	assert(deps);
 
+	if (unit_deps_hashmap) {
+		*deps = strv_copy(hashmap_get(unit_deps_hashmap, name));
+		return *deps ? 0 : -ENOMEM;
+	}
+
 	path = unit_dbus_path_from_name(name);
 	if (path == NULL)
 		return -ENOMEM;
@@ -786,8 +979,6 @@ list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps)
 	return bus_get_unit_property_strv(bus, path, "After", deps);
 }
 
-static Hashmap *unit_times_hashmap;
-
 static int
 list_dependencies_compare(const void *_a, const void *_b)
 {
@@ -940,7 +1131,10 @@ list_dependencies(sd_bus *bus, const char *name)
 			printf("%s\n", id);
 	}
 
-	return list_dependencies_one(bus, name, 0, &units, 0);
+	/* Walk from the ID rather than from the name we were given,
+         * which might be an alias: the edges that came with
+         * ListUnitTimes() are keyed by ID only */
+	return list_dependencies_one(bus, id, 0, &units, 0);
 }
 
 static int
@@ -951,7 +1145,7 @@ analyze_critical_chain(sd_bus *bus, char *names[])
 	Hashmap *h;
 	int n, r;
 
-	n = acquire_time_data(bus, &times);
+	n = acquire_time_data(bus, &unit_deps_hashmap, &times);
 	if (n <= 0)
 		return n;
 
@@ -979,6 +1173,7 @@ analyze_critical_chain(sd_bus *bus, char *names[])
 		list_dependencies(bus, SPECIAL_DEFAULT_TARGET);
 
 	hashmap_free(h);
+	free_unit_deps(unit_deps_hashmap);
 	free_unit_times(times, (unsigned)n);
 	return 0;
 }
@@ -990,7 +1185,7 @@ analyze_blame(sd_bus *bus)
 	unsigned i;
 	int n;
 
-	n = acquire_time_data(bus, &times);
+	n = acquire_time_data(bus, NULL, &times);
 	if (n <= 0)
 		return n;
 
@@ -1026,87 +1221,136 @@ analyze_time(sd_bus *bus)
 	return 0;
 }
 
+static const struct {
+	const char *type;
+	const char *color;
+	enum dot dot;
+} graph_types[] = {
+	{ "After", "green", DEP_ORDER },
+	{ "Requires", "black", DEP_REQUIRE },
+	{ "RequiresOverridable", "black", DEP_REQUIRE },
+	{ "RequisiteOverridable", "darkblue", DEP_REQUIRE },
+	{ "Wants", "grey66", DEP_REQUIRE },
+	{ "Conflicts", "red", DEP_REQUIRE },
+	{ "ConflictedBy", "red", DEP_REQUIRE },
+};
+
+static bool
+graph_type_wanted(unsigned i)
+{
+	return arg_dot == DEP_ALL || arg_dot == graph_types[i].dot;
+}
+
+static bool
+graph_from_wanted(const char *id, char *patterns[])
+{
+	return strv_isempty(arg_dot_from_patterns) ||
+		strv_fnmatch(patterns, id, 0) ||
+		strv_fnmatch(arg_dot_from_patterns, id, 0);
+}
+
+static void
+graph_edge(const char *from, const char *to, const char *color,
+	char *patterns[])
+{
+	bool match_patterns, match_patterns2;
+
+	match_patterns = strv_fnmatch(patterns, from, 0);
+	match_patterns2 = strv_fnmatch(patterns, to, 0);
+
+	if (!strv_isempty(arg_dot_to_patterns) && !match_patterns2 &&
+		!strv_fnmatch(arg_dot_to_patterns, to, 0))
+		return;
+
+	if (!strv_isempty(patterns) && !match_patterns && !match_patterns2)
+		return;
+
+	printf("\t\"%s\"->\"%s\" [color=\"%s\"];\n", from, to, color);
+}
+
 static int
-graph_one_property(sd_bus *bus, const UnitInfo *u, const char *prop,
-	const char *color, char *patterns[])
+graph_one(sd_bus *bus, const UnitInfo *u, char *patterns[])
 {
-	_cleanup_strv_free_ char **units = NULL;
-	char **unit;
+	unsigned i;
 	int r;
-	bool match_patterns;
 
+	assert(bus);
 	assert(u);
-	assert(prop);
-	assert(color);
 
-	match_patterns = strv_fnmatch(patterns, u->id, 0);
-
-	if (!strv_isempty(arg_dot_from_patterns) && !match_patterns &&
-		!strv_fnmatch(arg_dot_from_patterns, u->id, 0))
+	if (!graph_from_wanted(u->id, patterns))
 		return 0;
 
-	r = bus_get_unit_property_strv(bus, u->unit_path, prop, &units);
-	if (r < 0)
-		return r;
-
-	STRV_FOREACH (unit, units) {
-		bool match_patterns2;
-
-		match_patterns2 = strv_fnmatch(patterns, *unit, 0);
+	for (i = 0; i < ELEMENTSOF(graph_types); i++) {
+		_cleanup_strv_free_ char **units = NULL;
+		char **unit;
 
-		if (!strv_isempty(arg_dot_to_patterns) && !match_patterns2 &&
-			!strv_fnmatch(arg_dot_to_patterns, *unit, 0))
+		if (!graph_type_wanted(i))
 			continue;
 
-		if (!strv_isempty(patterns) && !match_patterns &&
-			!match_patterns2)
-			continue;
+		r = bus_get_unit_property_strv(bus, u->unit_path,
+			graph_types[i].type, &units);
+		if (r < 0)
+			return r;
 
-		printf("\t\"%s\"->\"%s\" [color=\"%s\"];\n", u->id, *unit,
-			color);
+		STRV_FOREACH (unit, units)
+			graph_edge(u->id, *unit, graph_types[i].color,
+				patterns);
 	}
 
 	return 0;
 }
 
+/* Prints the whole graph from the edges returned by ListUnitTimes, in
+ * the same order as graph_one() would. Returns 0 if the manager is too
+ * old for that. */
 static int
-graph_one(sd_bus *bus, const UnitInfo *u, char *patterns[])
+graph_all(sd_bus *bus, char *patterns[])
 {
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	const char *types[ELEMENTSOF(graph_types) + 1] = {};
+	const char *from, *type, *to;
+	unsigned i, n = 0;
 	int r;
 
-	assert(bus);
-	assert(u);
+	for (i = 0; i < ELEMENTSOF(graph_types); i++)
+		if (graph_type_wanted(i))
+			types[n++] = graph_types[i].type;
 
-	if (arg_dot == DEP_ORDER || arg_dot == DEP_ALL) {
-		r = graph_one_property(bus, u, "After", "green", patterns);
-		if (r < 0)
-			return r;
-	}
+	r = list_unit_times(bus, (char **)types, &reply);
+	if (r <= 0)
+		return r;
 
-	if (arg_dot == DEP_REQUIRE || arg_dot == DEP_ALL) {
-		r = graph_one_property(bus, u, "Requires", "black", patterns);
-		if (r < 0)
-			return r;
-		r = graph_one_property(bus, u, "RequiresOverridable", "black",
-			patterns);
-		if (r < 0)
-			return r;
-		r = graph_one_property(bus, u, "RequisiteOverridable",
-			"darkblue", patterns);
-		if (r < 0)
-			return r;
-		r = graph_one_property(bus, u, "Wants", "grey66", patterns);
-		if (r < 0)
-			return r;
-		r = graph_one_property(bus, u, "Conflicts", "red", patterns);
-		if (r < 0)
-			return r;
-		r = graph_one_property(bus, u, "ConflictedBy", "red", patterns);
+	r = sd_bus_message_skip(reply, "a(stttt)");
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sss)");
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	printf("digraph systemd {\n");
+
+	for (;;) {
+		r = sd_bus_message_read(reply, "(sss)", &from, &type, &to);
 		if (r < 0)
-			return r;
+			return bus_log_parse_error(r);
+		if (r == 0)
+			break;
+
+		if (!graph_from_wanted(from, patterns))
+			continue;
+
+		for (i = 0; i < ELEMENTSOF(graph_types); i++)
+			if (streq(graph_types[i].type, type)) {
+				graph_edge(from, to, graph_types[i].color,
+					patterns);
+				break;
+			}
 	}
 
-	return 0;
+	printf("}\n");
+
+	return 1;
 }
 
 static int
@@ -1117,6 +1361,12 @@ dot(sd_bus *bus, char *patterns[])
 	int r;
 	UnitInfo u;
 
+	r = graph_all(bus, patterns);
+	if (r < 0)
+		return r;
+	if (r > 0)
+		goto legend;
+
 	r = sd_bus_call_method(bus, SVC_DBUS_BUSNAME,
 		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
 		"ListUnits", &error, &reply, "");
@@ -1143,6 +1393,7 @@ dot(sd_bus *bus, char *patterns[])
 
 	printf("}\n");
 
+legend:
 	log_info("   Color legend: black     = Requires\n"
 		 "                 dark blue = Requisite\n"
 		 "                 dark grey = Wants\n"
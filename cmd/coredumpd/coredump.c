@@ -18,7 +18,9 @@
 ***/
 
 #include <sys/types.h>
+#include <sys/file.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -44,6 +46,7 @@
 #include "path-util.h"
 #include "sd-journal.h"
 #include "sd-login.h"
+#include "sd-messages.h"
 #include "special.h"
 #include "stacktrace.h"
 #include "strv.h"
@@ -60,6 +63,16 @@
  * journal */
 #define JOURNAL_SIZE_MAX ((size_t)(767LU * 1024LU * 1024LU))
 
+/* The number of threads used to compress a coredump, unless configured
+ * explicitly */
+#define COMPRESS_THREADS_MAX 8U
+
+/* The number of stack traces generated at the same time, unless
+ * configured explicitly */
+#define STACK_TRACE_JOBS_MAX 4U
+
+#define STACK_TRACE_SLOT_DIR SVC_PKGRUNSTATEDIR "/coredump"
+
 /* Make sure to not make this larger than the maximum journal entry
  * size. See DATA_SIZE_MAX in journald-native.c. */
 assert_cc(JOURNAL_SIZE_MAX <= DATA_SIZE_MAX);
@@ -97,11 +110,13 @@ static DEFINE_CONFIG_PARSE_ENUM(config_parse_coredump_storage, coredump_storage,
 
 static CoredumpStorage arg_storage = COREDUMP_STORAGE_EXTERNAL;
 static bool arg_compress = true;
+static unsigned arg_compress_threads = 0;
 static off_t arg_process_size_max = PROCESS_SIZE_MAX;
 static off_t arg_external_size_max = EXTERNAL_SIZE_MAX;
 static size_t arg_journal_size_max = JOURNAL_SIZE_MAX;
 static off_t arg_keep_free = (off_t)-1;
 static off_t arg_max_use = (off_t)-1;
+static unsigned arg_stack_trace_jobs_max = STACK_TRACE_JOBS_MAX;
 
 static int
 parse_config(void)
@@ -110,6 +125,8 @@ parse_config(void)
 		{ "Coredump", "Storage", config_parse_coredump_storage, 0,
 			&arg_storage },
 		{ "Coredump", "Compress", config_parse_bool, 0, &arg_compress },
+		{ "Coredump", "CompressThreads", config_parse_unsigned, 0,
+			&arg_compress_threads },
 		{ "Coredump", "ProcessSizeMax", config_parse_iec_off, 0,
 			&arg_process_size_max },
 		{ "Coredump", "ExternalSizeMax", config_parse_iec_off, 0,
@@ -119,6 +136,8 @@ parse_config(void)
 		{ "Coredump", "KeepFree", config_parse_iec_off, 0,
 			&arg_keep_free },
 		{ "Coredump", "MaxUse", config_parse_iec_off, 0, &arg_max_use },
+		{ "Coredump", "StackTraceJobsMax", config_parse_unsigned, 0,
+			&arg_stack_trace_jobs_max },
 		{}
 	};
 
@@ -290,6 +309,23 @@ make_filename(const char *info[_INFO_LEN], char **ret)
 	return 0;
 }
 
+static unsigned
+compress_threads(void)
+{
+	long n;
+
+	if (arg_compress_threads > 0)
+		return arg_compress_threads;
+
+	/* Each thread needs some 50M for the encoder, so don't go
+         * overboard on large machines */
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n <= 0)
+		return 1;
+
+	return MIN((unsigned)n, COMPRESS_THREADS_MAX);
+}
+
 static int
 save_external_coredump(const char *info[_INFO_LEN], uid_t uid,
 	char **ret_filename, int *ret_fd, off_t *ret_size)
@@ -323,7 +359,8 @@ save_external_coredump(const char *info[_INFO_LEN], uid_t uid,
 		return log_error_errno(errno,
 			"Failed to create coredump file %s: %m", tmp);
 
-	r = copy_bytes(STDIN_FILENO, fd, arg_process_size_max, false);
+	/* Large parts of most cores are zero pages, keep them as holes */
+	r = copy_bytes_sparse(STDIN_FILENO, fd, arg_process_size_max);
 	if (r == -EFBIG) {
 		log_error(
 			"Coredump of %s (%s) is larger than configured processing limit, refusing.",
@@ -381,7 +418,8 @@ save_external_coredump(const char *info[_INFO_LEN], uid_t uid,
 			goto uncompressed;
 		}
 
-		r = compress_stream(fd, fd_compressed, -1);
+		r = compress_stream_parallel(fd, fd_compressed, -1,
+			compress_threads());
 		if (r < 0) {
 			log_error_errno(r, "Failed to compress %s: %m",
 				tmp_compressed);
@@ -557,6 +595,108 @@ compose_open_fds(pid_t pid, char **open_fds)
 	return 0;
 }
 
+#ifdef HAVE_ELFUTILS
+static int
+acquire_stack_trace_slot(void)
+{
+	unsigned i;
+	int r;
+
+	/* Every stack trace job holds a lock on one of a fixed number of
+         * slot files while it runs, so that a storm of crashes cannot
+         * start an unbounded number of them. Returns the locked fd, or
+         * -EBUSY if all slots are taken. */
+
+	r = mkdir_p_label(STACK_TRACE_SLOT_DIR, 0755);
+	if (r < 0)
+		return r;
+
+	for (i = 0; i < arg_stack_trace_jobs_max; i++) {
+		_cleanup_free_ char *path = NULL;
+		_cleanup_close_ int fd = -1;
+
+		if (asprintf(&path, STACK_TRACE_SLOT_DIR "/stacktrace.%u", i) <
+			0)
+			return -ENOMEM;
+
+		fd = open(path,
+			O_RDWR | O_CREAT | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW,
+			0600);
+		if (fd < 0)
+			return -errno;
+
+		if (flock(fd, LOCK_EX | LOCK_NB) >= 0) {
+			r = fd;
+			fd = -1;
+			return r;
+		}
+
+		if (errno != EWOULDBLOCK)
+			return -errno;
+	}
+
+	return -EBUSY;
+}
+
+static void
+submit_stack_trace(int fd, const char *coredump_id,
+	const char *info[_INFO_LEN])
+{
+	_cleanup_free_ char *stacktrace = NULL;
+	int r;
+
+	r = coredump_make_stack_trace(fd, info[INFO_EXE], &stacktrace);
+	if (r == -EINVAL) {
+		log_warning("Failed to generate stack trace: %s",
+			dwfl_errmsg(dwfl_errno()));
+		return;
+	} else if (r < 0) {
+		log_warning_errno(r, "Failed to generate stack trace: %m");
+		return;
+	}
+
+	r = sd_journal_send("MESSAGE_ID=" SD_ID128_FORMAT_STR,
+		SD_ID128_FORMAT_VAL(SD_MESSAGE_COREDUMP_STACKTRACE),
+		"PRIORITY=%i", LOG_INFO, "COREDUMP_ID=%s", coredump_id,
+		"COREDUMP_PID=%s", info[INFO_PID], "COREDUMP_COMM=%s",
+		strempty(info[INFO_COMM]),
+		"MESSAGE=Stack trace of process %s (%s) of user %s:\n\n%s",
+		info[INFO_PID], strna(info[INFO_COMM]), info[INFO_UID],
+		stacktrace, NULL);
+	if (r < 0)
+		log_error_errno(r, "Failed to log stack trace: %m");
+}
+
+static void
+fork_stack_trace(int fd, const char *coredump_id, const char *info[_INFO_LEN])
+{
+	pid_t pid;
+
+	/* Unwinding a large multithreaded process can take a long time,
+         * hence do it in the background, after the coredump has been
+         * logged, and report the result as a separate entry. */
+
+	pid = fork();
+	if (pid < 0) {
+		log_warning_errno(errno,
+			"Failed to fork off stack trace generation: %m");
+		return;
+	}
+	if (pid > 0)
+		return;
+
+	/* The kernel might wait for the last reader of the core pipe to
+         * go away before it cleans up the crashed process. We inherited
+         * the lock on our slot, which goes away when we exit. */
+	make_null_stdio();
+	(void)setpriority(PRIO_PROCESS, 0, 19);
+
+	submit_stack_trace(fd, coredump_id, info);
+
+	_exit(EXIT_SUCCESS);
+}
+#endif
+
 int
 main(int argc, char *argv[])
 {
@@ -570,9 +710,11 @@ main(int argc, char *argv[])
 	_cleanup_free_ char *exe = NULL, *comm = NULL, *filename = NULL;
 	const char *info[_INFO_LEN];
 
-	_cleanup_close_ int coredump_fd = -1;
+	_cleanup_close_ int coredump_fd = -1, slot_fd = -1;
 
-	struct iovec iovec[26];
+	char core_id[sizeof("COREDUMP_ID=") + 32] = "";
+	struct iovec iovec[28];
+	sd_id128_t id;
 	off_t coredump_size;
 	int r;
 	unsigned int n_iovec = 0;
@@ -785,6 +927,13 @@ main(int argc, char *argv[])
 		"MESSAGE_ID=fc2e22bc6ee647b6b90729ab34a250b1");
 	IOVEC_SET_STRING(iovec[n_iovec++], "PRIORITY=2");
 
+	/* Links this entry to the one carrying the stack trace */
+	if (sd_id128_randomize(&id) >= 0) {
+		strcpy(core_id, "COREDUMP_ID=");
+		sd_id128_to_string(id, core_id + strlen("COREDUMP_ID="));
+		IOVEC_SET_STRING(iovec[n_iovec++], core_id);
+	}
+
 	/* Vacuum before we write anything again */
 	coredump_vacuum(-1, arg_keep_free, arg_max_use);
 
@@ -812,6 +961,21 @@ main(int argc, char *argv[])
 	/* Vacuum again, but exclude the coredump we just created */
 	coredump_vacuum(coredump_fd, arg_keep_free, arg_max_use);
 
+#ifdef HAVE_ELFUTILS
+	/* Take the stack trace slot while we may still create its lock */
+	if (arg_stack_trace_jobs_max > 0 && !isempty(core_id) &&
+		coredump_size <= arg_process_size_max) {
+		slot_fd = acquire_stack_trace_slot();
+		if (slot_fd == -EBUSY)
+			log_notice(
+				"Too many stack traces in progress, not generating one for %s (%s).",
+				info[INFO_PID], strna(info[INFO_COMM]));
+		else if (slot_fd < 0)
+			log_warning_errno(slot_fd,
+				"Failed to acquire stack trace slot: %m");
+	}
+#endif
+
 	/* Now, let's drop privileges to become the user who owns the
          * segfaulted process and allocate the coredump memory under
          * the user's uid. This also ensures that the credentials
@@ -825,31 +989,9 @@ main(int argc, char *argv[])
 		goto finish;
 	}
 
-#ifdef HAVE_ELFUTILS
-	/* Try to get a strack trace if we can */
-	if (coredump_size <= arg_process_size_max) {
-		_cleanup_free_ char *stacktrace = NULL;
-
-		r = coredump_make_stack_trace(coredump_fd, exe, &stacktrace);
-		if (r >= 0)
-			core_message = strjoin("MESSAGE=Process ",
-				info[INFO_PID], " (", comm, ") of user ",
-				info[INFO_UID], " dumped core.\n\n", stacktrace,
-				NULL);
-		else if (r == -EINVAL)
-			log_warning("Failed to generate stack trace: %s",
-				dwfl_errmsg(dwfl_errno()));
-		else
-			log_warning_errno(r,
-				"Failed to generate stack trace: %m");
-	}
-
-	if (!core_message)
-#endif
-	log:
-		core_message = strjoin("MESSAGE=Process ", info[INFO_PID], " (",
-			comm, ") of user ", info[INFO_UID], " dumped core.",
-			NULL);
+log:
+	core_message = strjoin("MESSAGE=Process ", info[INFO_PID], " (", comm,
+		") of user ", info[INFO_UID], " dumped core.", NULL);
 	if (core_message)
 		IOVEC_SET_STRING(iovec[n_iovec++], core_message);
 
@@ -874,6 +1016,12 @@ main(int argc, char *argv[])
 	if (r < 0)
 		log_error_errno(r, "Failed to log coredump: %m");
 
+#ifdef HAVE_ELFUTILS
+	if (slot_fd >= 0)
+		fork_stack_trace(coredump_fd,
+			core_id + strlen("COREDUMP_ID="), info);
+#endif
+
 finish:
 	return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -33,10 +33,14 @@
 #include "pager.h"
 #include "path-util.h"
 #include "sd-journal.h"
+#include "sd-messages.h"
 #include "set.h"
 #include "sigbus.h"
 #include "util.h"
 
+/* Each decoding thread holds two chunks of input and output */
+#define DECOMPRESS_THREADS_MAX 8U
+
 static enum {
 	ACTION_NONE,
 	ACTION_INFO,
@@ -349,6 +353,54 @@ print_list(FILE *file, sd_journal *j, int had_legend)
 	return 0;
 }
 
+static int
+retrieve_stack_trace(const char *coredump_id, char **ret)
+{
+	_cleanup_journal_close_ sd_journal *j = NULL;
+	char match[STRLEN("MESSAGE_ID=") + SD_ID128_STRING_MAX];
+	const void *d;
+	const char *m;
+	size_t l;
+	int r;
+
+	assert(coredump_id);
+	assert(ret);
+
+	/* Stack traces are generated in the background and logged as an
+         * entry of their own, which refers to the coredump by its ID. */
+
+	r = sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY);
+	if (r < 0)
+		return r;
+
+	sd_journal_set_data_threshold(j, 0);
+
+	m = strjoina("COREDUMP_ID=", coredump_id);
+	r = sd_journal_add_match(j, m, 0);
+	if (r < 0)
+		return r;
+
+	snprintf(match, sizeof(match),
+		LOG_MESSAGE_ID(SD_MESSAGE_COREDUMP_STACKTRACE));
+	r = sd_journal_add_match(j, match, 0);
+	if (r < 0)
+		return r;
+
+	r = sd_journal_next(j);
+	if (r <= 0)
+		return r;
+
+	r = sd_journal_get_data(j, "MESSAGE", &d, &l);
+	if (r < 0)
+		return r;
+
+	r = retrieve(d, l, "MESSAGE", ret);
+	if (r < 0)
+		return r;
+
+	return 1;
+}
+
 static int
 print_info(FILE *file, sd_journal *j, bool need_space)
 {
@@ -358,7 +410,8 @@ print_info(FILE *file, sd_journal *j, bool need_space)
 			    *boot_id = NULL, *machine_id = NULL,
 			    *hostname = NULL, *slice = NULL, *cgroup = NULL,
 			    *owner_uid = NULL, *message = NULL,
-			    *timestamp = NULL, *filename = NULL;
+			    *timestamp = NULL, *filename = NULL,
+			    *coredump_id = NULL, *stacktrace = NULL;
 	const void *d;
 	size_t l;
 	int r;
@@ -383,6 +436,7 @@ print_info(FILE *file, sd_journal *j, bool need_space)
 		retrieve(d, l, "COREDUMP_CGROUP", &cgroup);
 		retrieve(d, l, "COREDUMP_TIMESTAMP", &timestamp);
 		retrieve(d, l, "COREDUMP_FILENAME", &filename);
+		retrieve(d, l, "COREDUMP_ID", &coredump_id);
 		retrieve(d, l, "_BOOT_ID", &boot_id);
 		retrieve(d, l, "_MACHINE_ID", &machine_id);
 		retrieve(d, l, "_HOSTNAME", &hostname);
@@ -498,6 +552,15 @@ print_info(FILE *file, sd_journal *j, bool need_space)
 		fprintf(file, "       Message: %s\n", strstrip(m ?: message));
 	}
 
+	if (coredump_id && retrieve_stack_trace(coredump_id, &stacktrace) > 0) {
+		_cleanup_free_ char *m = NULL;
+
+		m = strreplace(stacktrace, "\n", "\n                ");
+
+		fprintf(file, "   Stack Trace: %s\n",
+			strstrip(m ?: stacktrace));
+	}
+
 	return 0;
 }
 
@@ -563,6 +626,20 @@ dump_list(sd_journal *j)
 	return 0;
 }
 
+#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+static unsigned
+decompress_threads(void)
+{
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n <= 0)
+		return 1;
+
+	return MIN((unsigned)n, DECOMPRESS_THREADS_MAX);
+}
+#endif
+
 static int
 save_core(sd_journal *j, int fd, char **path, bool *unlink_temp)
 {
@@ -650,7 +727,8 @@ save_core(sd_journal *j, int fd, char **path, bool *unlink_temp)
 				goto error;
 			}
 
-			r = decompress_stream(filename, fdf, fd, -1);
+			r = decompress_stream_parallel(filename, fdf, fd, -1,
+				decompress_threads());
 			if (r < 0) {
 				log_error_errno(r,
 					"Failed to decompress %s: %m",
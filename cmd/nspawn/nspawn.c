@@ -179,6 +179,22 @@ static unsigned long arg_personality = 0xffffffffLU;
 static char *arg_image = NULL;
 static Volatile arg_volatile = VOLATILE_NO;
 static ExposePort *arg_expose_ports = NULL;
+static bool arg_timing = false;
+
+#define TIMING_PHASES_MAX 32
+
+/* How long one step of the container setup took. The child reports
+ * these to the parent, which shows all of them once the container is
+ * up. */
+typedef struct TimingPhase {
+	char name[24];
+	bool child;
+	usec_t begin;
+	usec_t end;
+} TimingPhase;
+
+static TimingPhase timing_phases[TIMING_PHASES_MAX];
+static unsigned n_timing_phases = 0;
 
 static void
 help(void)
@@ -240,7 +256,9 @@ help(void)
 	       "     --register=BOOLEAN     Register container as machine\n"
 	       "     --keep-unit            Do not register a scope for the machine, reuse\n"
 	       "                            the service unit nspawn is running in\n"
-	       "     --volatile[=MODE]      Run the system in volatile mode\n",
+	       "     --volatile[=MODE]      Run the system in volatile mode\n"
+	       "     --timing               Show how long each step of the container setup\n"
+	       "                            took\n",
 		program_invocation_short_name);
 }
 
@@ -292,6 +310,7 @@ parse_argv(int argc, char *argv[])
 		ARG_PERSONALITY,
 		ARG_VOLATILE,
 		ARG_TEMPLATE,
+		ARG_TIMING,
 	};
 
 	static const struct option options[] = { { "help", no_argument, NULL,
@@ -334,7 +353,8 @@ parse_argv(int argc, char *argv[])
 		{ "personality", required_argument, NULL, ARG_PERSONALITY },
 		{ "image", required_argument, NULL, 'i' },
 		{ "volatile", optional_argument, NULL, ARG_VOLATILE },
-		{ "port", required_argument, NULL, 'p' }, {} };
+		{ "port", required_argument, NULL, 'p' },
+		{ "timing", no_argument, NULL, ARG_TIMING }, {} };
 
 	int c, r;
 	uint64_t plus = 0, minus = 0;
@@ -677,6 +697,10 @@ parse_argv(int argc, char *argv[])
 			arg_keep_unit = true;
 			break;
 
+		case ARG_TIMING:
+			arg_timing = true;
+			break;
+
 		case ARG_PERSONALITY:
 
 			arg_personality = personality_from_string(optarg);
@@ -2065,18 +2089,15 @@ drop_capabilities(void)
 }
 
 static int
-register_machine(pid_t pid, int local_ifindex)
+register_machine(sd_bus *bus, pid_t pid, int local_ifindex)
 {
 	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-	_cleanup_bus_close_unref_ sd_bus *bus = NULL;
 	int r;
 
 	if (!arg_register)
 		return 0;
 
-	r = sd_bus_default_system(&bus);
-	if (r < 0)
-		return log_error_errno(r, "Failed to open system bus: %m");
+	assert(bus);
 
 	if (arg_keep_unit) {
 		r = sd_bus_call_method(bus, SVC_MACHINED_DBUS_BUSNAME,
@@ -2296,17 +2317,101 @@ generate_mac(struct ether_addr *mac, sd_id128_t hash_key, uint64_t idx)
 	return 0;
 }
 
+/* Network interface changes for the container, sent to the kernel in
+ * one go. The kernel goes on with the next request when one fails, so
+ * a request must not depend on an earlier one in the same batch. */
+typedef struct LinkBatch {
+	sd_rtnl *rtnl;
+	sd_rtnl_message **messages;
+	size_t n_messages;
+	size_t n_allocated;
+	char **errors;
+} LinkBatch;
+
+static void
+link_batch_clear(LinkBatch *b)
+{
+	size_t i;
+
+	for (i = 0; i < b->n_messages; i++)
+		sd_rtnl_message_unref(b->messages[i]);
+	b->n_messages = 0;
+
+	strv_free(b->errors);
+	b->errors = NULL;
+}
+
+static void
+link_batch_done(LinkBatch *b)
+{
+	link_batch_clear(b);
+	free(b->messages);
+	sd_rtnl_unref(b->rtnl);
+}
+
 static int
-setup_veth(pid_t pid, char iface_name[IFNAMSIZ], int *ifi)
+link_batch_add(LinkBatch *b, sd_rtnl_message *m, const char *error)
 {
-	_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
-	struct ether_addr mac_host, mac_container;
-	int r, i;
+	if (!GREEDY_REALLOC(b->messages, b->n_allocated, b->n_messages + 1))
+		return log_oom();
 
-	if (!arg_private_network)
+	/* What to complain about if the kernel refuses the request */
+	if (strv_extend(&b->errors, error) < 0)
+		return log_oom();
+
+	b->messages[b->n_messages++] = sd_rtnl_message_ref(m);
+
+	return 0;
+}
+
+static int
+link_batch_run(LinkBatch *b)
+{
+	_cleanup_free_ sd_rtnl_message **replies = NULL;
+	bool logged = false;
+	size_t i;
+	int r;
+
+	if (b->n_messages <= 0)
 		return 0;
 
+	replies = new0(sd_rtnl_message *, b->n_messages);
+	if (!replies)
+		return log_oom();
+
+	r = sd_rtnl_call_many(b->rtnl, b->messages, b->n_messages, 0, replies);
+
+	for (i = 0; i < b->n_messages; i++) {
+		int k;
+
+		if (!replies[i])
+			continue;
+
+		k = sd_rtnl_message_get_errno(replies[i]);
+		if (k < 0) {
+			log_error_errno(k, "%s: %m", b->errors[i]);
+			logged = true;
+		}
+
+		sd_rtnl_message_unref(replies[i]);
+	}
+
+	link_batch_clear(b);
+
+	if (r < 0 && !logged)
+		return log_error_errno(r,
+			"Failed to configure network interfaces: %m");
+
+	return r < 0 ? r : 0;
+}
+
+static int
+setup_veth(LinkBatch *b, pid_t pid, char iface_name[IFNAMSIZ])
+{
+	_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
+	struct ether_addr mac_host, mac_container;
+	int r;
+
 	if (!arg_network_veth)
 		return 0;
 
@@ -2325,11 +2430,7 @@ setup_veth(pid_t pid, char iface_name[IFNAMSIZ], int *ifi)
 		return log_error_errno(r,
 			"Failed to generate predictable MAC address for host side: %m");
 
-	r = sd_rtnl_open(&rtnl, 0);
-	if (r < 0)
-		return log_error_errno(r, "Failed to connect to netlink: %m");
-
-	r = sd_rtnl_message_new_link(rtnl, &m, RTM_NEWLINK, 0);
+	r = sd_rtnl_message_new_link(b->rtnl, &m, RTM_NEWLINK, 0);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to allocate netlink message: %m");
@@ -2389,31 +2490,15 @@ setup_veth(pid_t pid, char iface_name[IFNAMSIZ], int *ifi)
 		return log_error_errno(r,
 			"Failed to close netlink container: %m");
 
-	r = sd_rtnl_call(rtnl, m, 0, NULL);
-	if (r < 0)
-		return log_error_errno(r,
-			"Failed to add new veth interfaces: %m");
-
-	i = (int)if_nametoindex(iface_name);
-	if (i <= 0)
-		return log_error_errno(errno,
-			"Failed to resolve interface %s: %m", iface_name);
-
-	*ifi = i;
-
-	return 0;
+	return link_batch_add(b, m, "Failed to add new veth interfaces");
 }
 
 static int
-setup_bridge(const char veth_name[], int *ifi)
+setup_bridge(LinkBatch *b, int veth, int *ifi)
 {
 	_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
 	int r, bridge;
 
-	if (!arg_private_network)
-		return 0;
-
 	if (!arg_network_veth)
 		return 0;
 
@@ -2428,11 +2513,10 @@ setup_bridge(const char veth_name[], int *ifi)
 
 	*ifi = bridge;
 
-	r = sd_rtnl_open(&rtnl, 0);
-	if (r < 0)
-		return log_error_errno(r, "Failed to connect to netlink: %m");
-
-	r = sd_rtnl_message_new_link(rtnl, &m, RTM_SETLINK, 0);
+	/* Refer to the veth interface by the index it got when we
+         * created it, never by name, which might be taken by some
+         * other interface */
+	r = sd_rtnl_message_new_link(b->rtnl, &m, RTM_SETLINK, veth);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to allocate netlink message: %m");
@@ -2441,22 +2525,12 @@ setup_bridge(const char veth_name[], int *ifi)
 	if (r < 0)
 		return log_error_errno(r, "Failed to set IFF_UP flag: %m");
 
-	r = sd_rtnl_message_append_string(m, IFLA_IFNAME, veth_name);
-	if (r < 0)
-		return log_error_errno(r,
-			"Failed to add netlink interface name field: %m");
-
 	r = sd_rtnl_message_append_u32(m, IFLA_MASTER, bridge);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to add netlink master field: %m");
 
-	r = sd_rtnl_call(rtnl, m, 0, NULL);
-	if (r < 0)
-		return log_error_errno(r,
-			"Failed to add veth interface to bridge: %m");
-
-	return 0;
+	return link_batch_add(b, m, "Failed to add veth interface to bridge");
 }
 
 static int
@@ -2486,38 +2560,21 @@ parse_interface(struct udev *udev, const char *name)
 }
 
 static int
-move_network_interfaces(pid_t pid)
+move_network_interfaces(LinkBatch *b, struct udev *udev, pid_t pid)
 {
-	_cleanup_udev_unref_ struct udev *udev = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
 	char **i;
 	int r;
 
-	if (!arg_private_network)
-		return 0;
-
-	if (strv_isempty(arg_network_interfaces))
-		return 0;
-
-	r = sd_rtnl_open(&rtnl, 0);
-	if (r < 0)
-		return log_error_errno(r, "Failed to connect to netlink: %m");
-
-	udev = udev_new();
-	if (!udev) {
-		log_error("Failed to connect to udev.");
-		return -ENOMEM;
-	}
-
 	STRV_FOREACH (i, arg_network_interfaces) {
 		_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
+		_cleanup_free_ char *e = NULL;
 		int ifi;
 
 		ifi = parse_interface(udev, *i);
 		if (ifi < 0)
 			return ifi;
 
-		r = sd_rtnl_message_new_link(rtnl, &m, RTM_SETLINK, ifi);
+		r = sd_rtnl_message_new_link(b->rtnl, &m, RTM_SETLINK, ifi);
 		if (r < 0)
 			return log_error_errno(r,
 				"Failed to allocate netlink message: %m");
@@ -2527,41 +2584,26 @@ move_network_interfaces(pid_t pid)
 			return log_error_errno(r,
 				"Failed to append namespace PID to netlink message: %m");
 
-		r = sd_rtnl_call(rtnl, m, 0, NULL);
+		e = strjoin("Failed to move interface ", *i, " to namespace",
+			NULL);
+		if (!e)
+			return log_oom();
+
+		r = link_batch_add(b, m, e);
 		if (r < 0)
-			return log_error_errno(r,
-				"Failed to move interface %s to namespace: %m",
-				*i);
+			return r;
 	}
 
 	return 0;
 }
 
 static int
-setup_macvlan(pid_t pid)
+setup_macvlan(LinkBatch *b, struct udev *udev, pid_t pid)
 {
-	_cleanup_udev_unref_ struct udev *udev = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
 	unsigned idx = 0;
 	char **i;
 	int r;
 
-	if (!arg_private_network)
-		return 0;
-
-	if (strv_isempty(arg_network_macvlan))
-		return 0;
-
-	r = sd_rtnl_open(&rtnl, 0);
-	if (r < 0)
-		return log_error_errno(r, "Failed to connect to netlink: %m");
-
-	udev = udev_new();
-	if (!udev) {
-		log_error("Failed to connect to udev.");
-		return -ENOMEM;
-	}
-
 	STRV_FOREACH (i, arg_network_macvlan) {
 		_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
 		_cleanup_free_ char *n = NULL;
@@ -2577,7 +2619,7 @@ setup_macvlan(pid_t pid)
 			return log_error_errno(r,
 				"Failed to create MACVLAN MAC address: %m");
 
-		r = sd_rtnl_message_new_link(rtnl, &m, RTM_NEWLINK, 0);
+		r = sd_rtnl_message_new_link(b->rtnl, &m, RTM_NEWLINK, 0);
 		if (r < 0)
 			return log_error_errno(r,
 				"Failed to allocate netlink message: %m");
@@ -2635,39 +2677,21 @@ setup_macvlan(pid_t pid)
 			return log_error_errno(r,
 				"Failed to close netlink container: %m");
 
-		r = sd_rtnl_call(rtnl, m, 0, NULL);
+		r = link_batch_add(b, m,
+			"Failed to add new macvlan interfaces");
 		if (r < 0)
-			return log_error_errno(r,
-				"Failed to add new macvlan interfaces: %m");
+			return r;
 	}
 
 	return 0;
 }
 
 static int
-setup_ipvlan(pid_t pid)
+setup_ipvlan(LinkBatch *b, struct udev *udev, pid_t pid)
 {
-	_cleanup_udev_unref_ struct udev *udev = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
 	char **i;
 	int r;
 
-	if (!arg_private_network)
-		return 0;
-
-	if (strv_isempty(arg_network_ipvlan))
-		return 0;
-
-	r = sd_rtnl_open(&rtnl, 0);
-	if (r < 0)
-		return log_error_errno(r, "Failed to connect to netlink: %m");
-
-	udev = udev_new();
-	if (!udev) {
-		log_error("Failed to connect to udev.");
-		return -ENOMEM;
-	}
-
 	STRV_FOREACH (i, arg_network_ipvlan) {
 		_cleanup_rtnl_message_unref_ sd_rtnl_message *m = NULL;
 		_cleanup_free_ char *n = NULL;
@@ -2677,7 +2701,7 @@ setup_ipvlan(pid_t pid)
 		if (ifi < 0)
 			return ifi;
 
-		r = sd_rtnl_message_new_link(rtnl, &m, RTM_NEWLINK, 0);
+		r = sd_rtnl_message_new_link(b->rtnl, &m, RTM_NEWLINK, 0);
 		if (r < 0)
 			return log_error_errno(r,
 				"Failed to allocate netlink message: %m");
@@ -2730,15 +2754,90 @@ setup_ipvlan(pid_t pid)
 			return log_error_errno(r,
 				"Failed to close netlink container: %m");
 
-		r = sd_rtnl_call(rtnl, m, 0, NULL);
+		r = link_batch_add(b, m, "Failed to add new ipvlan interfaces");
 		if (r < 0)
-			return log_error_errno(r,
-				"Failed to add new ipvlan interfaces: %m");
+			return r;
 	}
 
 	return 0;
 }
 
+static int
+setup_network(pid_t pid, char veth_name[IFNAMSIZ], int *ifi)
+{
+	_cleanup_udev_unref_ struct udev *udev = NULL;
+	LinkBatch b = {};
+	int r;
+
+	if (!arg_private_network)
+		return 0;
+
+	r = sd_rtnl_open(&b.rtnl, 0);
+	if (r < 0)
+		return log_error_errno(r, "Failed to connect to netlink: %m");
+
+	if (!strv_isempty(arg_network_interfaces) ||
+		!strv_isempty(arg_network_macvlan) ||
+		!strv_isempty(arg_network_ipvlan)) {
+		udev = udev_new();
+		if (!udev) {
+			log_error("Failed to connect to udev.");
+			r = -ENOMEM;
+			goto finish;
+		}
+	}
+
+	r = move_network_interfaces(&b, udev, pid);
+	if (r < 0)
+		goto finish;
+
+	r = setup_veth(&b, pid, veth_name);
+	if (r < 0)
+		goto finish;
+
+	r = setup_macvlan(&b, udev, pid);
+	if (r < 0)
+		goto finish;
+
+	r = setup_ipvlan(&b, udev, pid);
+	if (r < 0)
+		goto finish;
+
+	r = link_batch_run(&b);
+	if (r < 0)
+		goto finish;
+
+	if (arg_network_veth) {
+		int i;
+
+		/* The veth interface was created by us just now, so
+                 * this is the index of ours */
+		i = (int)if_nametoindex(veth_name);
+		if (i <= 0) {
+			r = log_error_errno(errno,
+				"Failed to resolve interface %s: %m",
+				veth_name);
+			goto finish;
+		}
+
+		*ifi = i;
+
+		/* Only now that it exists the veth interface can be
+                 * added to the bridge */
+		r = setup_bridge(&b, i, ifi);
+		if (r < 0)
+			goto finish;
+
+		r = link_batch_run(&b);
+		if (r < 0)
+			goto finish;
+	}
+
+finish:
+	link_batch_done(&b);
+	return r;
+}
+
 static int
 setup_seccomp(void)
 {
@@ -3806,6 +3905,74 @@ wait_for_container(pid_t pid, ContainerStatus *container)
 	return r;
 }
 
+static void
+timing_phase(int fd, const char *name, usec_t *begin)
+{
+	TimingPhase t = {};
+
+	if (!arg_timing)
+		return;
+
+	strncpy(t.name, name, sizeof(t.name) - 1);
+	t.child = fd >= 0;
+	t.begin = *begin;
+	t.end = *begin = now(CLOCK_MONOTONIC);
+
+	/* The child cannot show anything outside of the container, hence
+         * it sends its phases to the parent */
+	if (fd >= 0)
+		(void)send(fd, &t, sizeof(t), MSG_DONTWAIT | MSG_NOSIGNAL);
+	else if (n_timing_phases < TIMING_PHASES_MAX)
+		timing_phases[n_timing_phases++] = t;
+}
+
+static int
+timing_phase_compare(const void *a, const void *b)
+{
+	const TimingPhase *x = a, *y = b;
+
+	if (x->begin < y->begin)
+		return -1;
+	if (x->begin > y->begin)
+		return 1;
+
+	return x->child - y->child;
+}
+
+static void
+timing_show(int fd, usec_t start)
+{
+	TimingPhase t;
+	unsigned i;
+
+	if (!arg_timing)
+		return;
+
+	while (n_timing_phases < TIMING_PHASES_MAX &&
+		recv(fd, &t, sizeof(t), MSG_DONTWAIT) == sizeof(t))
+		timing_phases[n_timing_phases++] = t;
+
+	qsort_safe(timing_phases, n_timing_phases, sizeof(TimingPhase),
+		timing_phase_compare);
+
+	fprintf(stderr, "%10s %10s %-6s %s\n", "START", "TIME", "SIDE",
+		"PHASE");
+
+	for (i = 0; i < n_timing_phases; i++) {
+		TimingPhase *p = timing_phases + i;
+
+		fprintf(stderr, "%8.1fms %8.1fms %-6s %s\n",
+			(double)(p->begin - start) / USEC_PER_MSEC,
+			(double)(p->end - p->begin) / USEC_PER_MSEC,
+			p->child ? "child" : "parent", p->name);
+	}
+
+	fprintf(stderr, "Container ready after %.1fms.\n",
+		(double)(now(CLOCK_MONOTONIC) - start) / USEC_PER_MSEC);
+
+	n_timing_phases = 0;
+}
+
 static void
 nop_handler(int sig)
 {
@@ -4170,13 +4337,17 @@ main(int argc, char *argv[])
 
 	for (;;) {
 		_cleanup_close_pair_ int kmsg_socket_pair[2] = { -1, -1 },
-					 rtnl_socket_pair[2] = { -1, -1 };
+					 rtnl_socket_pair[2] = { -1, -1 },
+					 timing_socket_pair[2] = { -1, -1 };
+		_cleanup_bus_close_unref_ sd_bus *bus = NULL;
 		ContainerStatus container_status;
 		_cleanup_(barrier_destroy) Barrier barrier = BARRIER_NULL;
 		struct sigaction sa = {
 			.sa_handler = nop_handler,
 			.sa_flags = SA_NOCLDSTOP,
 		};
+		usec_t start, phase;
+		int ifi = 0, network_r;
 
 		r = barrier_create(&barrier);
 		if (r < 0) {
@@ -4198,6 +4369,14 @@ main(int argc, char *argv[])
 			goto finish;
 		}
 
+		if (arg_timing &&
+			socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0,
+				timing_socket_pair) < 0) {
+			r = log_error_errno(errno,
+				"Failed to create timing socket pair: %m");
+			goto finish;
+		}
+
 		/* Child can be killed before execv(), so handle SIGCHLD
                  * in order to interrupt parent's blocking calls and
                  * give it a chance to call wait() and terminate. */
@@ -4215,6 +4394,8 @@ main(int argc, char *argv[])
 			goto finish;
 		}
 
+		start = phase = now(CLOCK_MONOTONIC);
+
 		pid = raw_clone(SIGCHLD | CLONE_NEWNS |
 				(arg_share_system ?
 						      0 :
@@ -4259,6 +4440,8 @@ main(int argc, char *argv[])
 
 			kmsg_socket_pair[0] = safe_close(kmsg_socket_pair[0]);
 			rtnl_socket_pair[0] = safe_close(rtnl_socket_pair[0]);
+			timing_socket_pair[0] =
+				safe_close(timing_socket_pair[0]);
 
 			reset_all_signal_handlers();
 			reset_signal_mask();
@@ -4307,6 +4490,8 @@ main(int argc, char *argv[])
 			/* Mark everything as slave, so that we still
                          * receive mounts from the real root, but don't
                          * propagate mounts to the real root. */
+			timing_phase(timing_socket_pair[1], "spawn", &phase);
+
 			if (mount(NULL, "/", NULL, MS_SLAVE | MS_REC, NULL) <
 				0) {
 				log_error_errno(errno,
@@ -4347,9 +4532,15 @@ main(int argc, char *argv[])
 				}
 			}
 
+			timing_phase(timing_socket_pair[1], "mount-root",
+				&phase);
+
 			if (mount_all(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
+			timing_phase(timing_socket_pair[1], "mount-api",
+				&phase);
+
 			if (copy_devnodes(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
@@ -4361,9 +4552,13 @@ main(int argc, char *argv[])
 			if (setup_propagate(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
+			timing_phase(timing_socket_pair[1], "dev", &phase);
+
 			if (setup_seccomp() < 0)
 				_exit(EXIT_FAILURE);
 
+			timing_phase(timing_socket_pair[1], "seccomp", &phase);
+
 			if (setup_dev_console(arg_directory, console) < 0)
 				_exit(EXIT_FAILURE);
 
@@ -4375,6 +4570,8 @@ main(int argc, char *argv[])
 				_exit(EXIT_FAILURE);
 			rtnl_socket_pair[1] = safe_close(rtnl_socket_pair[1]);
 
+			timing_phase(timing_socket_pair[1], "console", &phase);
+
 			/* Tell the parent that we are ready, and that
                          * it can cgroupify us to that we lack access
                          * to certain devices and resources. */
@@ -4392,6 +4589,8 @@ main(int argc, char *argv[])
 			if (setup_journal(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
+			timing_phase(timing_socket_pair[1], "etc", &phase);
+
 			if (mount_binds(arg_directory, arg_bind, false) < 0)
 				_exit(EXIT_FAILURE);
 
@@ -4401,10 +4600,15 @@ main(int argc, char *argv[])
 			if (mount_tmpfs(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
+			timing_phase(timing_socket_pair[1], "binds", &phase);
+
 			/* Wait until we are cgroup-ified, so that we
                          * can mount the right cgroup path writable */
 			(void)barrier_sync_next(&barrier);
 
+			timing_phase(timing_socket_pair[1], "wait-register",
+				&phase);
+
 			if (mount_cgroup(arg_directory) < 0)
 				_exit(EXIT_FAILURE);
 
@@ -4433,6 +4637,8 @@ main(int argc, char *argv[])
 
 			umask(0022);
 
+			timing_phase(timing_socket_pair[1], "chroot", &phase);
+
 			if (arg_private_network)
 				loopback_setup();
 
@@ -4527,6 +4733,11 @@ main(int argc, char *argv[])
 			} else
 				env_use = (char **)envp;
 
+			timing_phase(timing_socket_pair[1], "credentials",
+				&phase);
+			timing_socket_pair[1] =
+				safe_close(timing_socket_pair[1]);
+
 			/* Wait until the parent is ready with the setup, too... */
 			if (!barrier_place_and_sync(&barrier))
 				_exit(EXIT_FAILURE);
@@ -4581,37 +4792,49 @@ main(int argc, char *argv[])
 
 		kmsg_socket_pair[1] = safe_close(kmsg_socket_pair[1]);
 		rtnl_socket_pair[1] = safe_close(rtnl_socket_pair[1]);
+		timing_socket_pair[1] = safe_close(timing_socket_pair[1]);
 
-		/* Wait for the most basic Child-setup to be done,
-                 * before we add hardware to it, and place it in a
-                 * cgroup. */
-		if (barrier_sync_next(&barrier)) {
-			int ifi = 0;
+		timing_phase(-1, "clone", &phase);
 
-			r = move_network_interfaces(pid);
-			if (r < 0)
-				goto finish;
+		/* Network interfaces only need the network namespace of
+                 * the child, and the bus connection nothing at all,
+                 * hence set them up while the child is still busy
+                 * with its mounts. A child that dies in the meantime
+                 * makes this fail too, so a failure is only acted on
+                 * once we know the child is still there. */
+		network_r = setup_network(pid, veth_name, &ifi);
 
-			r = setup_veth(pid, veth_name, &ifi);
-			if (r < 0)
-				goto finish;
+		timing_phase(-1, "network", &phase);
 
-			r = setup_bridge(veth_name, &ifi);
-			if (r < 0)
+		if (arg_register && network_r >= 0) {
+			r = sd_bus_open_system(&bus);
+			if (r < 0) {
+				log_error_errno(r,
+					"Failed to open system bus: %m");
 				goto finish;
+			}
 
-			r = setup_macvlan(pid);
-			if (r < 0)
-				goto finish;
+			timing_phase(-1, "bus", &phase);
+		}
+
+		/* Wait for the most basic Child-setup to be done,
+                 * before we place it in a cgroup. */
+		if (barrier_sync_next(&barrier)) {
+			timing_phase(-1, "wait-child", &phase);
 
-			r = setup_ipvlan(pid);
+			r = network_r;
 			if (r < 0)
 				goto finish;
 
-			r = register_machine(pid, ifi);
+			r = register_machine(bus, pid, ifi);
 			if (r < 0)
 				goto finish;
 
+			sd_bus_close_unrefp(&bus);
+			bus = NULL;
+
+			timing_phase(-1, "register", &phase);
+
 			/* Block SIGCHLD here, before notifying child.
                          * process_pty() will handle it with the other signals. */
 			r = sigprocmask(SIG_BLOCK, &mask_chld, NULL);
@@ -4636,6 +4859,9 @@ main(int argc, char *argv[])
 				_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
 				char last_char = 0;
 
+				timing_phase(-1, "wait-ready", &phase);
+				timing_show(timing_socket_pair[0], start);
+
 				sd_notifyf(false,
 					"READY=1\n"
 					"STATUS=Container running.\n"
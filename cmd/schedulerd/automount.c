@@ -143,6 +143,8 @@ automount_done(Unit *u)
 	set_free(a->expire_tokens);
 	a->expire_tokens = NULL;
 
+	set_remove(u->manager->automounts_pending, a);
+
 	a->expire_event_source = sd_event_source_unref(a->expire_event_source);
 }
 
@@ -789,21 +791,23 @@ automount_start_expire(Automount *a)
 		automount_dispatch_expire, a);
 }
 
-static void
-automount_enter_running(Automount *a)
+static int
+automount_check_running(Automount *a)
 {
-	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
 	struct stat st;
-	Unit *trigger;
-	int r;
 
 	assert(a);
 
+	/* Checks whether a mount request for this automount should be
+         * turned into a start job for the mount unit. Returns > 0 if
+         * so, 0 if the request was already dealt with, and < 0 if the
+         * automount should fail. */
+
 	/* If the user masked our unit in the meantime, fail */
 	if (UNIT(a)->load_state != UNIT_LOADED) {
 		log_unit_error(UNIT(a)->id,
 			"Suppressing automount event since unit is no longer loaded.");
-		goto fail;
+		return -ENOENT;
 	}
 
 	/* We don't take mount requests anymore if we are supposed to
@@ -814,7 +818,7 @@ automount_enter_running(Automount *a)
 			UNIT(a)->id);
 		automount_send_ready(a, a->tokens, -EHOSTDOWN);
 		automount_send_ready(a, a->expire_tokens, -EHOSTDOWN);
-		return;
+		return 0;
 	}
 
 	mkdir_p_label(a->where, a->directory_mode);
@@ -823,7 +827,7 @@ automount_enter_running(Automount *a)
 	if (lstat(a->where, &st) < 0) {
 		log_unit_warning(UNIT(a)->id,
 			"%s failed to stat automount point: %m", UNIT(a)->id);
-		goto fail;
+		return -errno;
 	}
 
 	/* The mount unit may have been explicitly started before we got the
@@ -832,29 +836,136 @@ automount_enter_running(Automount *a)
 		log_unit_info(UNIT(a)->id,
 			"%s's automount point already active?", UNIT(a)->id);
 		automount_send_ready(a, a->tokens, 0);
-		return;
+		return 0;
 	}
 
-	trigger = UNIT_TRIGGER(UNIT(a));
-	if (!trigger) {
+	if (!UNIT_TRIGGER(UNIT(a))) {
 		log_unit_error(UNIT(a)->id, "Unit to trigger vanished.");
-		goto fail;
+		return -ENOENT;
 	}
 
-	r = manager_add_job(UNIT(a)->manager, JOB_START, trigger, JOB_REPLACE,
-		true, &error, NULL);
-	if (r < 0) {
-		log_unit_warning(UNIT(a)->id,
-			"%s failed to queue mount startup job: %s", UNIT(a)->id,
+	return 1;
+}
+
+static int
+automount_dispatch_batch(sd_event_source *source, void *userdata)
+{
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	_cleanup_free_ Automount **batch = NULL;
+	_cleanup_free_ Unit **triggers = NULL;
+	Manager *m = userdata;
+	unsigned n = 0, k;
+	Automount *a;
+	int r;
+
+	assert(m);
+
+	/* All automount points that got mount requests since the last
+         * time we were called are collected here, so that the mount
+         * jobs for them are submitted in one transaction rather than
+         * one after the other. */
+
+	batch = new(Automount *, set_size(m->automounts_pending));
+	triggers = new(Unit *, set_size(m->automounts_pending));
+	if (!batch || !triggers)
+		return log_oom();
+
+	while ((a = set_steal_first(m->automounts_pending))) {
+		if (!IN_SET(a->state, AUTOMOUNT_WAITING, AUTOMOUNT_RUNNING))
+			continue;
+
+		r = automount_check_running(a);
+		if (r < 0) {
+			automount_enter_dead(a, AUTOMOUNT_FAILURE_RESOURCES);
+			continue;
+		}
+		if (r == 0)
+			continue;
+
+		batch[n] = a;
+		triggers[n] = UNIT_TRIGGER(UNIT(a));
+		n++;
+	}
+
+	if (n == 0)
+		return 0;
+
+	r = manager_add_jobs(m, JOB_START, triggers, n, JOB_REPLACE, true,
+		NULL, &error);
+	if (r < 0)
+		log_warning("Failed to queue %u mount jobs: %s", n,
 			bus_error_message(&error, r));
-		goto fail;
+	else
+		log_debug("Queued mount jobs for %u automount points.", n);
+
+	for (k = 0; k < n; k++) {
+		Unit *trigger = triggers[k];
+
+		a = batch[k];
+
+		/* Jobs that didn't make it into the common transaction,
+                 * e.g. since they were found redundant, are retried on
+                 * their own, so that the tokens are answered either
+                 * way. */
+		if (!trigger->job || trigger->job->type != JOB_START) {
+			sd_bus_error_free(&error);
+
+			r = manager_add_job(m, JOB_START, trigger, JOB_REPLACE,
+				true, &error, NULL);
+			if (r < 0) {
+				log_unit_warning(UNIT(a)->id,
+					"%s failed to queue mount startup job: %s",
+					UNIT(a)->id,
+					bus_error_message(&error, r));
+				automount_enter_dead(a,
+					AUTOMOUNT_FAILURE_RESOURCES);
+				continue;
+			}
+		}
+
+		automount_set_state(a, AUTOMOUNT_RUNNING);
 	}
 
-	automount_set_state(a, AUTOMOUNT_RUNNING);
-	return;
+	return 0;
+}
 
-fail:
-	automount_enter_dead(a, AUTOMOUNT_FAILURE_RESOURCES);
+static int
+automount_queue_running(Automount *a)
+{
+	Manager *m;
+	int r;
+
+	assert(a);
+
+	m = UNIT(a)->manager;
+
+	r = set_ensure_allocated(&m->automounts_pending, NULL);
+	if (r < 0)
+		return r;
+
+	r = set_put(m->automounts_pending, a);
+	if (r < 0)
+		return r;
+
+	if (!m->automount_batch_event_source) {
+		r = sd_event_add_defer(m->event,
+			&m->automount_batch_event_source,
+			automount_dispatch_batch, m);
+		if (r < 0)
+			return r;
+
+		/* Run after the pipes of all other automount points
+                 * that are ready have been read, but before the run
+                 * queue, so that the jobs start right away. */
+		r = sd_event_source_set_priority(
+			m->automount_batch_event_source,
+			SD_EVENT_PRIORITY_IDLE - 1);
+		if (r < 0)
+			return r;
+	}
+
+	return sd_event_source_set_enabled(m->automount_batch_event_source,
+		SD_EVENT_ONESHOT);
 }
 
 static int
@@ -1049,15 +1160,89 @@ automount_may_gc(Unit *u)
 	return UNIT_VTABLE(t)->may_gc(t);
 }
 
+int
+automount_read_requests(int fd, Set **tokens, Set **expire_tokens,
+	unsigned *ret_missing, unsigned *ret_expire, pid_t *ret_pid)
+{
+	unsigned n_missing = 0, n_expire = 0;
+	pid_t pid = 0;
+	int r;
+
+	assert(fd >= 0);
+	assert(tokens);
+	assert(expire_tokens);
+
+	/* Drains all autofs packets currently queued on the pipe and
+         * collects the wait queue tokens of mount and umount requests
+         * in the two sets. However many processes hit the mount point
+         * at the same time, this results in a single request. */
+
+	for (;;) {
+		union autofs_v5_packet_union packet;
+		Set **set;
+		ssize_t l;
+
+		l = read(fd, &packet, sizeof(packet));
+		if (l < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+
+			return -errno;
+		}
+
+		/* The kernel writes packets atomically */
+		if (l != sizeof(packet))
+			return -EIO;
+
+		switch (packet.hdr.type) {
+		case autofs_ptype_missing_direct:
+			set = tokens;
+			n_missing++;
+			if (pid <= 0)
+				pid = packet.v5_packet.pid;
+			break;
+
+		case autofs_ptype_expire_direct:
+			set = expire_tokens;
+			n_expire++;
+			break;
+
+		default:
+			log_debug("Received unknown automount request %i, ignoring.",
+				packet.hdr.type);
+			continue;
+		}
+
+		r = set_ensure_allocated(set, NULL);
+		if (r < 0)
+			return r;
+
+		r = set_put(*set, UINT_TO_PTR(packet.v5_packet.wait_queue_token));
+		if (r < 0)
+			return r;
+	}
+
+	if (ret_missing)
+		*ret_missing = n_missing;
+	if (ret_expire)
+		*ret_expire = n_expire;
+	if (ret_pid)
+		*ret_pid = pid;
+
+	return n_missing + n_expire;
+}
+
 static int
 automount_dispatch_io(sd_event_source *s, int fd, uint32_t events,
 	void *userdata)
 {
 	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-	union autofs_v5_packet_union packet;
 	Automount *a = AUTOMOUNT(userdata);
+	unsigned n_missing, n_expire;
 	Unit *trigger;
-	ssize_t l;
+	pid_t pid;
 	int r;
 
 	assert(a);
@@ -1071,72 +1256,22 @@ automount_dispatch_io(sd_event_source *s, int fd, uint32_t events,
 		goto fail;
 	}
 
-	l = loop_read(a->pipe_fd, &packet, sizeof(packet), true);
-	if (l != sizeof(packet)) {
-		if (l < 0)
-			log_unit_error_errno(UNIT(a)->id, l,
-				"Invalid read from pipe: %m");
-		else
-			log_unit_error(UNIT(a)->id,
-				"Invalid read from pipe: short read");
+	r = automount_read_requests(a->pipe_fd, &a->tokens, &a->expire_tokens,
+		&n_missing, &n_expire, &pid);
+	if (r < 0) {
+		log_unit_error_errno(UNIT(a)->id, r,
+			"Invalid read from pipe: %m");
 		goto fail;
 	}
 
-	switch (packet.hdr.type) {
-	case autofs_ptype_missing_direct:
-
-		if (packet.v5_packet.pid > 0) {
-			_cleanup_free_ char *p = NULL;
-
-			get_process_comm(packet.v5_packet.pid, &p);
-			log_unit_info(UNIT(a)->id,
-				"Got automount request for %s, triggered by %" PRIu32
-				" (%s)",
-				a->where, packet.v5_packet.pid, strna(p));
-		} else
-			log_unit_debug(UNIT(a)->id,
-				"Got direct mount request on %s", a->where);
-
-		r = set_ensure_allocated(&a->tokens, NULL);
-		if (r < 0) {
-			log_unit_error(UNIT(a)->id,
-				"Failed to allocate token set.");
-			goto fail;
-		}
-
-		r = set_put(a->tokens,
-			UINT_TO_PTR(packet.v5_packet.wait_queue_token));
-		if (r < 0) {
-			log_unit_error_errno(UNIT(a)->id, r,
-				"Failed to remember token: %m");
-			goto fail;
-		}
-
-		automount_enter_running(a);
-		break;
-
-	case autofs_ptype_expire_direct:
-		log_unit_debug(UNIT(a)->id, "Got direct umount request on %s",
+	if (n_expire > 0) {
+		log_unit_debug(UNIT(a)->id,
+			"Got %u direct umount request(s) on %s", n_expire,
 			a->where);
 
 		(void)sd_event_source_set_enabled(a->expire_event_source,
 			SD_EVENT_OFF);
 
-		r = set_ensure_allocated(&a->expire_tokens, NULL);
-		if (r < 0) {
-			log_unit_error(UNIT(a)->id,
-				"Failed to allocate token set.");
-			goto fail;
-		}
-
-		r = set_put(a->expire_tokens,
-			UINT_TO_PTR(packet.v5_packet.wait_queue_token));
-		if (r < 0) {
-			log_unit_error_errno(UNIT(a)->id, r,
-				"Failed to remember token: %m");
-			goto fail;
-		}
-
 		trigger = UNIT_TRIGGER(UNIT(a));
 		if (!trigger) {
 			log_unit_error(UNIT(a)->id,
@@ -1151,13 +1286,30 @@ automount_dispatch_io(sd_event_source *s, int fd, uint32_t events,
 				UNIT(a)->id, bus_error_message(&error, r));
 			goto fail;
 		}
-		break;
+	}
 
-	default:
-		log_unit_error(UNIT(a)->id,
-			"Received unknown automount request %i",
-			packet.hdr.type);
-		break;
+	if (n_missing > 0) {
+		if (pid > 0) {
+			_cleanup_free_ char *p = NULL;
+
+			get_process_comm(pid, &p);
+			log_unit_info(UNIT(a)->id,
+				"Got %u automount request(s) for %s, first triggered by " PID_FMT
+				" (%s)",
+				n_missing, a->where, pid, strna(p));
+		} else
+			log_unit_debug(UNIT(a)->id,
+				"Got %u direct mount request(s) on %s",
+				n_missing, a->where);
+
+		/* The mount job is submitted together with those of
+                 * all other automount points with pending requests */
+		r = automount_queue_running(a);
+		if (r < 0) {
+			log_unit_error_errno(UNIT(a)->id, r,
+				"Failed to queue mount request: %m");
+			goto fail;
+		}
 	}
 
 	return 0;
@@ -1173,6 +1325,11 @@ automount_shutdown(Manager *m)
 	assert(m);
 
 	m->dev_autofs_fd = safe_close(m->dev_autofs_fd);
+
+	m->automount_batch_event_source =
+		sd_event_source_unref(m->automount_batch_event_source);
+	set_free(m->automounts_pending);
+	m->automounts_pending = NULL;
 }
 
 static void
@@ -66,6 +66,9 @@ extern const UnitVTable automount_vtable;
 int automount_update_mount(Automount *a, MountState old_state,
 	MountState state);
 
+int automount_read_requests(int fd, Set **tokens, Set **expire_tokens,
+	unsigned *ret_missing, unsigned *ret_expire, pid_t *ret_pid);
+
 const char *automount_state_to_string(AutomountState i) _const_;
 AutomountState automount_state_from_string(const char *s) _pure_;
 
@@ -18,6 +18,7 @@
 ***/
 
 #include <errno.h>
+#include <fnmatch.h>
 #include <unistd.h>
 
 #include "architecture.h"
@@ -322,6 +323,15 @@ method_get_unit(sd_bus *bus, sd_bus_message *message, void *userdata,
 		return r;
 
 	u = manager_get_unit(m, name);
+	if (!u) {
+		/* Lazily tracked devices and mounts are nonetheless
+                 * around, hence create their units now */
+		r = manager_materialize_unit(m, name, &u);
+		if (r < 0)
+			return r;
+		if (r > 0)
+			manager_dispatch_load_queue(m);
+	}
 	if (!u)
 		return sd_bus_error_setf(error, BUS_ERROR_NO_SUCH_UNIT,
 			"Unit %s not loaded.", name);
@@ -542,6 +552,226 @@ method_start_unit_replace(sd_bus *bus, sd_bus_message *message, void *userdata,
 		error);
 }
 
+static int
+append_unit_job_error(sd_bus_message *reply, const char *name,
+	const sd_bus_error *e)
+{
+	return sd_bus_message_append(reply, "(sobss)", name, "/", false,
+		e->name, e->message ?: "");
+}
+
+static int
+add_unit_job_candidate(sd_bus_message *message, sd_bus_message *reply,
+	Unit *u, JobType type, Set *seen, Unit ***units, unsigned *n_units,
+	size_t *n_allocated)
+{
+	_cleanup_bus_error_free_ sd_bus_error e = SD_BUS_ERROR_NULL;
+	int r;
+
+	r = set_put(seen, u);
+	if (r <= 0)
+		return r;
+
+	r = bus_unit_check_job(message, u, &type, false, &e);
+	if (r < 0) {
+		if (!sd_bus_error_is_set(&e))
+			sd_bus_error_set_errno(&e, r);
+
+		return append_unit_job_error(reply, u->id, &e);
+	}
+
+	if (!GREEDY_REALLOC(*units, *n_allocated, *n_units + 1))
+		return -ENOMEM;
+
+	(*units)[(*n_units)++] = u;
+	return 0;
+}
+
+/* Queues jobs for a number of units in a single transaction. Names may
+ * be globs, which are matched against the loaded units. Every unit is
+ * reported with the job it has afterwards, or "/" if it needs none,
+ * and if it could not be added, with the error why. */
+static int
+method_start_units_generic(sd_bus *bus, sd_bus_message *message, Manager *m,
+	JobType job_type, sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	_cleanup_strv_free_ char **names = NULL;
+	_cleanup_set_free_ Set *seen = NULL;
+	_cleanup_free_ sd_bus_error *unit_errors = NULL;
+	_cleanup_free_ Unit **units = NULL;
+	unsigned n_units = 0, n_failed = 0, k;
+	size_t n_allocated = 0;
+	const char *smode;
+	JobMode mode;
+	char **name;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	r = bus_verify_manage_unit_async(m, message, error);
+	if (r < 0)
+		return r;
+	if (r == 0)
+		return 1; /* No authorization for now, but the async polkit stuff will call us again when it has it */
+
+	r = sd_bus_message_read_strv(message, &names);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_read(message, "s", &smode);
+	if (r < 0)
+		return r;
+
+	mode = job_mode_from_string(smode);
+	if (mode < 0 || mode == JOB_ISOLATE)
+		return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS,
+			"Job mode %s invalid", smode);
+
+	seen = set_new(NULL);
+	if (!seen)
+		return -ENOMEM;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(sobss)");
+	if (r < 0)
+		return r;
+
+	STRV_FOREACH (name, names) {
+		_cleanup_bus_error_free_ sd_bus_error e = SD_BUS_ERROR_NULL;
+		const char *id;
+		Iterator i;
+		Unit *u;
+
+		if (string_is_glob(*name)) {
+			HASHMAP_FOREACH_KEY (u, id, m->units, i) {
+				if (id != u->id ||
+					fnmatch(*name, id, FNM_NOESCAPE) != 0)
+					continue;
+
+				r = add_unit_job_candidate(message, reply, u,
+					job_type, seen, &units, &n_units,
+					&n_allocated);
+				if (r < 0)
+					return r;
+			}
+
+			continue;
+		}
+
+		r = manager_load_unit(m, *name, NULL, &e, &u);
+		if (r < 0) {
+			if (!sd_bus_error_is_set(&e))
+				sd_bus_error_set_errno(&e, r);
+
+			r = append_unit_job_error(reply, *name, &e);
+		} else
+			r = add_unit_job_candidate(message, reply, u, job_type,
+				seen, &units, &n_units, &n_allocated);
+		if (r < 0)
+			return r;
+	}
+
+	unit_errors = new0(sd_bus_error, n_units);
+	if (!unit_errors && n_units > 0)
+		return -ENOMEM;
+
+	r = manager_add_jobs(m, job_type, units, n_units, mode, true,
+		unit_errors, error);
+
+	for (k = 0; k < n_units; k++)
+		if (sd_bus_error_is_set(&unit_errors[k]))
+			n_failed++;
+
+	/* If no unit could be added at all, that is reported per unit,
+         * otherwise the transaction as a whole failed */
+	if (r < 0 && n_failed == n_units) {
+		sd_bus_error_free(error);
+		r = 0;
+	}
+
+	for (k = 0; k < n_units && r >= 0; k++) {
+		_cleanup_free_ char *path = NULL;
+		Job *j;
+
+		/* A unit without a job only got what it asked for if
+                 * the unit already is in the requested state. Otherwise
+                 * the transaction dropped its job, for example when it
+                 * collided with another one, which is not a success. */
+		j = units[k]->job;
+		if (!j && !sd_bus_error_is_set(&unit_errors[k]) &&
+			!job_type_is_redundant(
+				job_type_collapse(job_type, units[k]),
+				unit_active_state(units[k])))
+			sd_bus_error_setf(&unit_errors[k],
+				BUS_ERROR_TRANSACTION_JOBS_CONFLICTING,
+				"Job for %s was dropped from the transaction.",
+				units[k]->id);
+
+		if (sd_bus_error_is_set(&unit_errors[k])) {
+			r = append_unit_job_error(reply, units[k]->id,
+				&unit_errors[k]);
+			continue;
+		}
+
+		if (j) {
+			r = bus_unit_track_job(bus, message, j);
+			if (r < 0)
+				break;
+
+			path = job_dbus_path(j);
+			if (!path) {
+				r = -ENOMEM;
+				break;
+			}
+		}
+
+		r = sd_bus_message_append(reply, "(sobss)", units[k]->id,
+			path ?: "/", unit_need_daemon_reload(units[k]), "", "");
+	}
+
+	for (k = 0; k < n_units; k++)
+		sd_bus_error_free(&unit_errors[k]);
+
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
+static int
+method_start_units(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	return method_start_units_generic(bus, message, userdata, JOB_START,
+		error);
+}
+
+static int
+method_stop_units(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	return method_start_units_generic(bus, message, userdata, JOB_STOP,
+		error);
+}
+
+static int
+method_restart_units(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	return method_start_units_generic(bus, message, userdata,
+		JOB_RESTART, error);
+}
+
 static int
 method_kill_unit(sd_bus *bus, sd_bus_message *message, void *userdata,
 	sd_bus_error *error)
@@ -992,6 +1222,262 @@ method_list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userdata,
 	return list_units_filtered(bus, message, userdata, error, states);
 }
 
+/* Reads a list of dependency types, each of which is returned once */
+static int
+read_dependency_types(sd_bus_message *message,
+	UnitDependency deps[_UNIT_DEPENDENCY_MAX], unsigned *n_deps,
+	sd_bus_error *error)
+{
+	_cleanup_strv_free_ char **types = NULL;
+	unsigned d;
+	char **t;
+	int r;
+
+	r = sd_bus_message_read_strv(message, &types);
+	if (r < 0)
+		return r;
+
+	*n_deps = 0;
+
+	STRV_FOREACH (t, types) {
+		UnitDependency e;
+
+		e = unit_dependency_from_string(*t);
+		if (e < 0)
+			return sd_bus_error_setf(error,
+				SD_BUS_ERROR_INVALID_ARGS,
+				"Invalid dependency type %s", *t);
+
+		for (d = 0; d < *n_deps; d++)
+			if (deps[d] == e)
+				break;
+		if (d == *n_deps)
+			deps[(*n_deps)++] = e;
+	}
+
+	return 0;
+}
+
+/* Returns the timestamps of all units, and all edges of the requested
+ * dependency types between them, so that tools like analyze don't have
+ * to ask for each unit separately */
+static int
+method_list_unit_times(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	UnitDependency deps[_UNIT_DEPENDENCY_MAX];
+	unsigned n_deps, d;
+	Manager *m = userdata;
+	const char *k;
+	Iterator i;
+	Unit *u;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	/* Anyone can call this method */
+
+	r = mac_selinux_access_check(message, "status", error);
+	if (r < 0)
+		return r;
+
+	r = read_dependency_types(message, deps, &n_deps, error);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(stttt)");
+	if (r < 0)
+		return r;
+
+	HASHMAP_FOREACH_KEY (u, k, m->units, i) {
+		if (k != u->id)
+			continue;
+
+		r = sd_bus_message_append(reply, "(stttt)", u->id,
+			u->inactive_exit_timestamp.monotonic,
+			u->active_enter_timestamp.monotonic,
+			u->active_exit_timestamp.monotonic,
+			u->inactive_enter_timestamp.monotonic);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(sss)");
+	if (r < 0)
+		return r;
+
+	HASHMAP_FOREACH_KEY (u, k, m->units, i) {
+		if (k != u->id)
+			continue;
+
+		for (d = 0; d < n_deps; d++) {
+			const char *type = unit_dependency_to_string(deps[d]);
+			Iterator j;
+			Unit *other;
+
+			SET_FOREACH (other, u->dependencies[deps[d]], j) {
+				r = sd_bus_message_append(reply, "(sss)", u->id,
+					type, other->id);
+				if (r < 0)
+					return r;
+			}
+		}
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
+/* Returns every unit reachable from a unit through dependencies of the
+ * requested types, with its state and its dependencies, so that the
+ * tree can be shown without asking for each unit separately. Units
+ * further away than depth (unless it is 0), and unless all is set,
+ * units that are not targets, are listed with the unit depending on
+ * them, but their own dependencies are not followed. */
+static int
+method_list_unit_dependencies(sd_bus *bus, sd_bus_message *message,
+	void *userdata, sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	_cleanup_set_free_ Set *seen = NULL;
+	_cleanup_free_ Unit **queue = NULL;
+	_cleanup_free_ unsigned *levels = NULL;
+	size_t n_queue = 0, n_queue_allocated = 0, n_levels_allocated = 0, k;
+	UnitDependency deps[_UNIT_DEPENDENCY_MAX];
+	unsigned n_deps, depth, d;
+	Manager *m = userdata;
+	const char *name;
+	int all, r;
+	Unit *u;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	/* Anyone can call this method */
+
+	r = sd_bus_message_read(message, "s", &name);
+	if (r < 0)
+		return r;
+
+	r = read_dependency_types(message, deps, &n_deps, error);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_read(message, "ub", &depth, &all);
+	if (r < 0)
+		return r;
+
+	r = manager_load_unit(m, name, NULL, error, &u);
+	if (r < 0)
+		return r;
+
+	r = mac_selinux_unit_access_check(u, message, "status", error);
+	if (r < 0)
+		return r;
+
+	seen = set_new(NULL);
+	if (!seen)
+		return -ENOMEM;
+
+	if (set_put(seen, u) < 0 ||
+		!GREEDY_REALLOC(queue, n_queue_allocated, 1) ||
+		!GREEDY_REALLOC(levels, n_levels_allocated, 1))
+		return -ENOMEM;
+
+	queue[n_queue] = u;
+	levels[n_queue++] = 0;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(ssas)");
+	if (r < 0)
+		return r;
+
+	/* Breadth first, so that every unit is followed at the smallest
+         * depth it is found at */
+	for (k = 0; k < n_queue; k++) {
+		unsigned level = levels[k];
+
+		u = queue[k];
+
+		r = sd_bus_message_open_container(reply, 'r', "ssas");
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_append(reply, "ss", u->id,
+			unit_active_state_to_string(unit_active_state(u)));
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_open_container(reply, 'a', "s");
+		if (r < 0)
+			return r;
+
+		if ((level == 0 || all || u->type == UNIT_TARGET) &&
+			(depth == 0 || level < depth))
+			for (d = 0; d < n_deps; d++) {
+				Iterator i;
+				Unit *other;
+
+				SET_FOREACH (other, u->dependencies[deps[d]],
+					i) {
+					r = sd_bus_message_append(reply, "s",
+						other->id);
+					if (r < 0)
+						return r;
+
+					r = set_put(seen, other);
+					if (r < 0)
+						return r;
+					if (r == 0)
+						continue;
+
+					if (!GREEDY_REALLOC(queue,
+						    n_queue_allocated,
+						    n_queue + 1) ||
+						!GREEDY_REALLOC(levels,
+							n_levels_allocated,
+							n_queue + 1))
+						return -ENOMEM;
+
+					queue[n_queue] = other;
+					levels[n_queue++] = level + 1;
+				}
+			}
+
+		r = sd_bus_message_close_container(reply);
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_close_container(reply);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
 static int
 method_list_jobs(sd_bus *bus, sd_bus_message *message, void *userdata,
 	sd_bus_error *error)
@@ -2417,6 +2903,12 @@ const sd_bus_vtable bus_manager_vtable[] = { SD_BUS_VTABLE_START(0),
 		method_reload_or_restart_unit, SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ReloadOrTryRestartUnit", "ss", "o",
 		method_reload_or_try_restart_unit, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("StartUnits", "ass", "a(sobss)", method_start_units,
+		SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("StopUnits", "ass", "a(sobss)", method_stop_units,
+		SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("RestartUnits", "ass", "a(sobss)", method_restart_units,
+		SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("KillUnit", "ssi", NULL, method_kill_unit,
 		SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ResetFailedUnit", "s", NULL, method_reset_failed_unit,
@@ -2435,6 +2927,10 @@ const sd_bus_vtable bus_manager_vtable[] = { SD_BUS_VTABLE_START(0),
 		SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ListUnitsFiltered", "as", "a(ssssssouso)",
 		method_list_units_filtered, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ListUnitTimes", "as", "a(stttt)a(sss)",
+		method_list_unit_times, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ListUnitDependencies", "sasub", "a(ssas)",
+		method_list_unit_dependencies, SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ListJobs", NULL, "a(usssoo)", method_list_jobs,
 		SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("Subscribe", NULL, NULL, method_subscribe,
@@ -918,68 +918,103 @@ bus_unit_send_removed_signal(Unit *u)
 			"Failed to send unit remove signal for %s: %m", u->id);
 }
 
+/* Checks whether the sender of message may have a job of the given type
+ * queued for the unit, adjusting the type if reloading is preferred */
 int
-bus_unit_queue_job(sd_bus *bus, sd_bus_message *message, Unit *u, JobType type,
-	JobMode mode, bool reload_if_possible, sd_bus_error *error)
+bus_unit_check_job(sd_bus_message *message, Unit *u, JobType *type,
+	bool reload_if_possible, sd_bus_error *error)
 {
-	_cleanup_free_ char *path = NULL;
-	Job *j;
 	int r;
 
-	assert(bus);
 	assert(message);
 	assert(u);
-	assert(type >= 0 && type < _JOB_TYPE_MAX);
-	assert(mode >= 0 && mode < _JOB_MODE_MAX);
+	assert(type);
+	assert(*type >= 0 && *type < _JOB_TYPE_MAX);
 
 	if (reload_if_possible && unit_can_reload(u)) {
-		if (type == JOB_RESTART)
-			type = JOB_RELOAD_OR_START;
-		else if (type == JOB_TRY_RESTART)
-			type = JOB_TRY_RELOAD;
+		if (*type == JOB_RESTART)
+			*type = JOB_RELOAD_OR_START;
+		else if (*type == JOB_TRY_RESTART)
+			*type = JOB_TRY_RELOAD;
 	}
 
 	r = mac_selinux_unit_access_check(u, message,
-		(type == JOB_START || type == JOB_RESTART ||
-			type == JOB_TRY_RESTART) ?
-						 "start" :
-			type == JOB_STOP ? "stop" :
-						 "reload",
+		(*type == JOB_START || *type == JOB_RESTART ||
+			*type == JOB_TRY_RESTART) ?
+						  "start" :
+			*type == JOB_STOP ? "stop" :
+						  "reload",
 		error);
 	if (r < 0)
 		return r;
 
-	if (type == JOB_STOP &&
+	if (*type == JOB_STOP &&
 		(u->load_state == UNIT_NOT_FOUND ||
 			u->load_state == UNIT_ERROR) &&
 		unit_active_state(u) == UNIT_INACTIVE)
 		return sd_bus_error_setf(error, BUS_ERROR_NO_SUCH_UNIT,
 			"Unit %s not loaded.", u->id);
 
-	if ((type == JOB_START && u->refuse_manual_start) ||
-		(type == JOB_STOP && u->refuse_manual_stop) ||
-		((type == JOB_RESTART || type == JOB_TRY_RESTART) &&
+	if ((*type == JOB_START && u->refuse_manual_start) ||
+		(*type == JOB_STOP && u->refuse_manual_stop) ||
+		((*type == JOB_RESTART || *type == JOB_TRY_RESTART) &&
 			(u->refuse_manual_start || u->refuse_manual_stop)))
 		return sd_bus_error_setf(error, BUS_ERROR_ONLY_BY_DEPENDENCY,
 			"Operation refused, unit %s may be requested by dependency only (it is configured to refuse manual start/stop).",
 			u->id);
 
-	r = manager_add_job(u->manager, type, u, mode, true, error, &j);
-	if (r < 0)
-		return r;
+	return 0;
+}
 
-	if (bus == u->manager->api_bus) {
-		if (!j->clients) {
-			r = sd_bus_track_new(bus, &j->clients, NULL, NULL);
-			if (r < 0)
-				return r;
-		}
+/* Remembers the sender of message as a client of the job, so that it
+ * is told when the job is removed */
+int
+bus_unit_track_job(sd_bus *bus, sd_bus_message *message, Job *j)
+{
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(j);
+
+	if (bus != j->manager->api_bus)
+		return 0;
 
-		r = sd_bus_track_add_sender(j->clients, message);
+	if (!j->clients) {
+		r = sd_bus_track_new(bus, &j->clients, NULL, NULL);
 		if (r < 0)
 			return r;
 	}
 
+	return sd_bus_track_add_sender(j->clients, message);
+}
+
+int
+bus_unit_queue_job(sd_bus *bus, sd_bus_message *message, Unit *u, JobType type,
+	JobMode mode, bool reload_if_possible, sd_bus_error *error)
+{
+	_cleanup_free_ char *path = NULL;
+	Job *j;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(u);
+	assert(type >= 0 && type < _JOB_TYPE_MAX);
+	assert(mode >= 0 && mode < _JOB_MODE_MAX);
+
+	r = bus_unit_check_job(message, u, &type, reload_if_possible, error);
+	if (r < 0)
+		return r;
+
+	r = manager_add_job(u->manager, type, u, mode, true, error, &j);
+	if (r < 0)
+		return r;
+
+	r = bus_unit_track_job(bus, message, j);
+	if (r < 0)
+		return r;
+
 	path = job_dbus_path(j);
 	if (!path)
 		return -ENOMEM;
@@ -35,6 +35,9 @@ int bus_unit_method_kill(sd_bus *bus, sd_bus_message *message, void *userdata,
 int bus_unit_method_reset_failed(sd_bus *bus, sd_bus_message *message,
 	void *userdata, sd_bus_error *error);
 
+int bus_unit_check_job(sd_bus_message *message, Unit *u, JobType *type,
+	bool reload_if_possible, sd_bus_error *error);
+int bus_unit_track_job(sd_bus *bus, sd_bus_message *message, Job *j);
 int bus_unit_queue_job(sd_bus *bus, sd_bus_message *message, Unit *u,
 	JobType type, JobMode mode, bool reload_if_possible,
 	sd_bus_error *error);
@@ -31,6 +31,19 @@
 #include "unit-name.h"
 #include "unit.h"
 
+typedef struct DeviceStub DeviceStub;
+
+/* A device announced by udev that nothing references yet. If lazy
+ * units are enabled we keep only this around instead of a full
+ * unit. Name and sysfs path are stored right after the structure. */
+struct DeviceStub {
+	const char *name;
+	const char *sysfs;
+	DeviceFound found;
+
+	IWLIST_FIELDS(DeviceStub, same_sysfs);
+};
+
 static const UnitActiveState state_translation_table[_DEVICE_STATE_MAX] = {
 	[DEVICE_DEAD] = UNIT_INACTIVE,
 	[DEVICE_TENTATIVE] = UNIT_ACTIVATING,
@@ -106,6 +119,124 @@ device_set_sysfs(Device *d, const char *sysfs)
 	return 0;
 }
 
+static void
+device_stub_free(Manager *m, DeviceStub *s)
+{
+	DeviceStub *first;
+
+	assert(m);
+	assert(s);
+
+	hashmap_remove(m->device_stubs, s->name);
+
+	first = hashmap_get(m->device_stubs_by_sysfs, s->sysfs);
+	IWLIST_REMOVE(same_sysfs, first, s);
+
+	if (first)
+		hashmap_remove_and_replace(m->device_stubs_by_sysfs, s->sysfs,
+			first->sysfs, first);
+	else
+		hashmap_remove(m->device_stubs_by_sysfs, s->sysfs);
+
+	free(s);
+}
+
+static void
+device_stub_remove(Manager *m, const char *name)
+{
+	DeviceStub *s;
+
+	assert(m);
+	assert(name);
+
+	s = hashmap_get(m->device_stubs, name);
+	if (s)
+		device_stub_free(m, s);
+}
+
+static int
+device_stub_add(Manager *m, const char *name, const char *sysfs)
+{
+	DeviceStub *s, *first;
+	size_t ln, ls;
+	char *p;
+	int r;
+
+	assert(m);
+	assert(name);
+	assert(sysfs);
+
+	s = hashmap_get(m->device_stubs, name);
+	if (s) {
+		if (streq(s->sysfs, sysfs))
+			return 0;
+
+		device_stub_free(m, s);
+	}
+
+	r = hashmap_ensure_allocated(&m->device_stubs, &string_hash_ops);
+	if (r < 0)
+		return r;
+
+	r = hashmap_ensure_allocated(&m->device_stubs_by_sysfs,
+		&string_hash_ops);
+	if (r < 0)
+		return r;
+
+	ln = strlen(name) + 1;
+	ls = strlen(sysfs) + 1;
+
+	s = malloc0(sizeof(DeviceStub) + ln + ls);
+	if (!s)
+		return -ENOMEM;
+
+	p = (char *)(s + 1);
+	s->name = memcpy(p, name, ln);
+	s->sysfs = memcpy(p + ln, sysfs, ls);
+
+	r = hashmap_put(m->device_stubs, s->name, s);
+	if (r < 0) {
+		free(s);
+		return r;
+	}
+
+	first = hashmap_get(m->device_stubs_by_sysfs, s->sysfs);
+	IWLIST_PREPEND(same_sysfs, first, s);
+
+	r = hashmap_replace(m->device_stubs_by_sysfs, s->sysfs, first);
+	if (r < 0) {
+		IWLIST_REMOVE(same_sysfs, first, s);
+		hashmap_remove(m->device_stubs, s->name);
+		free(s);
+		return r;
+	}
+
+	return 0;
+}
+
+static void
+device_stub_update_found(Manager *m, DeviceStub *s, bool add,
+	DeviceFound found)
+{
+	DeviceFound n;
+
+	assert(m);
+	assert(s);
+
+	n = add ? (s->found | found) : (s->found & ~found);
+	if (n == s->found)
+		return;
+
+	/* Same rules as in device_update_found_one(): if nobody sees
+         * the device anymore, or udev saw it before and doesn't now,
+         * it is gone, and there's no point in remembering it. */
+	if (n == DEVICE_NOT_FOUND ||
+		((s->found & DEVICE_FOUND_UDEV) && !(n & DEVICE_FOUND_UDEV)))
+		device_stub_free(m, s);
+	else
+		s->found = n;
+}
+
 static void
 device_init(Unit *u)
 {
@@ -289,6 +420,15 @@ device_update_description(Unit *u, struct udev_device *dev, const char *path)
 	return r;
 }
 
+static const char *
+device_udev_wants_property(Manager *m)
+{
+	assert(m);
+
+	return m->running_as == SYSTEMD_USER ? "SYSTEMD_USER_WANTS" :
+						     "SYSTEMD_WANTS";
+}
+
 static int
 device_add_udev_wants(Unit *u, struct udev_device *dev)
 {
@@ -301,9 +441,7 @@ device_add_udev_wants(Unit *u, struct udev_device *dev)
 	assert(u);
 	assert(dev);
 
-	property = u->manager->running_as == SYSTEMD_USER ?
-		      "SYSTEMD_USER_WANTS" :
-		      "SYSTEMD_WANTS";
+	property = device_udev_wants_property(u->manager);
 	wants = udev_device_get_property_value(dev, property);
 	if (!wants)
 		return 0;
@@ -335,7 +473,7 @@ device_add_udev_wants(Unit *u, struct udev_device *dev)
 
 static int
 device_setup_unit(Manager *m, struct udev_device *dev, const char *path,
-	bool main)
+	bool main, bool lazy)
 {
 	_cleanup_free_ char *e = NULL;
 	const char *sysfs;
@@ -374,6 +512,21 @@ device_setup_unit(Manager *m, struct udev_device *dev, const char *path,
 	}
 
 	if (!u) {
+		/* Unless the device pulls in other units itself, there
+                 * is no need for a unit before somebody asks for it. */
+		if (lazy &&
+			!(main &&
+				udev_device_get_property_value(dev,
+					device_udev_wants_property(m)))) {
+			r = device_stub_add(m, e, sysfs);
+			if (r < 0)
+				return log_oom();
+
+			return 0;
+		}
+
+		device_stub_remove(m, e);
+
 		delete = true;
 
 		u = unit_new(m, sizeof(Device));
@@ -428,14 +581,14 @@ device_process_new(Manager *m, struct udev_device *dev)
 		return 0;
 
 	/* Add the main unit named after the sysfs path */
-	r = device_setup_unit(m, dev, sysfs, true);
+	r = device_setup_unit(m, dev, sysfs, true, m->lazy_units);
 	if (r < 0)
 		return r;
 
 	/* Add an additional unit for the device node */
 	dn = udev_device_get_devnode(dev);
 	if (dn)
-		(void)device_setup_unit(m, dev, dn, false);
+		(void)device_setup_unit(m, dev, dn, false, m->lazy_units);
 
 	/* Add additional units for all symlinks */
 	first = udev_device_get_devlinks_list_entry(dev);
@@ -463,7 +616,7 @@ device_process_new(Manager *m, struct udev_device *dev)
 				st.st_rdev != udev_device_get_devnum(dev))
 				continue;
 
-		(void)device_setup_unit(m, dev, p, false);
+		(void)device_setup_unit(m, dev, p, false, m->lazy_units);
 	}
 
 	/* Add additional units for all explicitly configured
@@ -481,7 +634,8 @@ device_process_new(Manager *m, struct udev_device *dev)
 			e[l] = 0;
 
 			if (path_is_absolute(e))
-				(void)device_setup_unit(m, dev, e, false);
+				(void)device_setup_unit(m, dev, e, false,
+					m->lazy_units);
 			else
 				log_warning(
 					"SYSTEMD_ALIAS for %s is not an absolute path, ignoring: %s",
@@ -539,6 +693,7 @@ device_update_found_by_sysfs(Manager *m, const char *sysfs, bool add,
 	DeviceFound found, bool now)
 {
 	Device *d, *l, *n;
+	DeviceStub *s, *sl, *sn;
 
 	assert(m);
 	assert(sysfs);
@@ -550,6 +705,10 @@ device_update_found_by_sysfs(Manager *m, const char *sysfs, bool add,
 	IWLIST_FOREACH_SAFE (same_sysfs, d, n, l)
 		device_update_found_one(d, add, found, now);
 
+	sl = hashmap_get(m->device_stubs_by_sysfs, sysfs);
+	IWLIST_FOREACH_SAFE (same_sysfs, s, sn, sl)
+		device_stub_update_found(m, s, add, found);
+
 	return 0;
 }
 
@@ -571,8 +730,15 @@ device_update_found_by_name(Manager *m, const char *path, bool add,
 		return log_oom();
 
 	u = manager_get_unit(m, e);
-	if (!u)
+	if (!u) {
+		DeviceStub *s;
+
+		s = hashmap_get(m->device_stubs, e);
+		if (s)
+			device_stub_update_found(m, s, add, found);
+
 		return 0;
+	}
 
 	device_update_found_one(DEVICE(u), add, found, now);
 	return 0;
@@ -658,9 +824,62 @@ fail:
 	return r;
 }
 
+static int
+device_materialize(Manager *m, const char *name, Unit **ret)
+{
+	_cleanup_udev_device_unref_ struct udev_device *dev = NULL;
+	_cleanup_free_ char *path = NULL;
+	DeviceFound found;
+	DeviceStub *s;
+	Unit *u;
+	bool main;
+	int r;
+
+	assert(m);
+	assert(name);
+	assert(ret);
+
+	s = hashmap_get(m->device_stubs, name);
+	if (!s)
+		return 0;
+
+	path = unit_name_to_path(name);
+	if (!path)
+		return -ENOMEM;
+
+	found = s->found;
+	main = path_equal(path, s->sysfs);
+
+	dev = udev_device_new_from_syspath(m->udev, s->sysfs);
+	if (!dev) {
+		/* The device vanished behind our back, forget it and
+                 * let the caller create an ordinary unit. */
+		device_stub_free(m, s);
+		return 0;
+	}
+
+	/* This consumes the stub */
+	r = device_setup_unit(m, dev, path, main, false);
+	if (r < 0)
+		return r;
+
+	u = manager_get_unit(m, name);
+	if (!u)
+		return 0;
+
+	/* The state is set up by coldplug, like for every other
+         * device we learnt about from udev */
+	device_update_found_one(DEVICE(u), true, found, false);
+
+	*ret = u;
+	return 1;
+}
+
 static void
 device_shutdown(Manager *m)
 {
+	DeviceStub *s;
+
 	assert(m);
 
 	m->udev_event_source = sd_event_source_unref(m->udev_event_source);
@@ -672,6 +891,14 @@ device_shutdown(Manager *m)
 
 	hashmap_free(m->devices_by_sysfs);
 	m->devices_by_sysfs = NULL;
+
+	while ((s = hashmap_first(m->device_stubs)))
+		device_stub_free(m, s);
+
+	hashmap_free(m->device_stubs);
+	m->device_stubs = NULL;
+	hashmap_free(m->device_stubs_by_sysfs);
+	m->device_stubs_by_sysfs = NULL;
 }
 
 static int
@@ -914,7 +1141,7 @@ device_found_node(Manager *m, const char *node, bool add, DeviceFound found,
                  * under the name referenced in /proc/swaps or
                  * /proc/self/mountinfo. */
 
-		(void)device_setup_unit(m, dev, node, false);
+		(void)device_setup_unit(m, dev, node, false, m->lazy_units);
 	}
 
 	/* Update the device unit's state, should it exist */
@@ -959,6 +1186,7 @@ const UnitVTable device_vtable = {
         .following_set = device_following_set,
 
         .enumerate = device_enumerate,
+        .materialize = device_materialize,
         .shutdown = device_shutdown,
         .supported = device_supported,
 
@@ -1348,7 +1348,7 @@ exec_child(ExecCommand *command, const ExecContext *context,
 	_cleanup_free_ char *mac_selinux_context_net = NULL;
 	const char *username = NULL, *home = NULL, *shell = NULL;
 	unsigned n_dont_close = 0;
-	int dont_close[n_fds + 4];
+	int dont_close[n_fds + 6];
 	uid_t uid = UID_INVALID;
 	gid_t gid = GID_INVALID;
 	int i, r;
@@ -1400,6 +1400,12 @@ exec_child(ExecCommand *command, const ExecContext *context,
 			dont_close[n_dont_close++] =
 				runtime->netns_storage_socket[1];
 	}
+	if (params->namespace_template) {
+		dont_close[n_dont_close++] =
+			params->namespace_template->storage_socket[0];
+		dont_close[n_dont_close++] =
+			params->namespace_template->storage_socket[1];
+	}
 
 	r = close_all_fds(dont_close, n_dont_close);
 	if (r < 0) {
@@ -1666,13 +1672,27 @@ exec_child(ExecCommand *command, const ExecContext *context,
 				var = strjoina(runtime->var_tmp_dir, "/tmp");
 		}
 
-		r = setup_namespace(
-			params->apply_chroot ? context->root_directory : NULL,
-			context->read_write_dirs, context->read_only_dirs,
-			context->inaccessible_dirs, tmp, var,
-			params->bus_endpoint_path, context->private_devices,
-			context->protect_home, context->protect_system,
-			context->mount_flags);
+		if (params->namespace_template)
+			r = setup_namespace_template(params->namespace_template,
+				params->apply_chroot ? context->root_directory :
+							     NULL,
+				context->read_write_dirs,
+				context->read_only_dirs,
+				context->inaccessible_dirs,
+				context->private_devices,
+				context->protect_home, context->protect_system,
+				context->mount_flags);
+		else
+			r = setup_namespace(params->apply_chroot ?
+					      context->root_directory :
+					      NULL,
+				context->read_write_dirs,
+				context->read_only_dirs,
+				context->inaccessible_dirs, tmp, var,
+				params->bus_endpoint_path,
+				context->private_devices,
+				context->protect_home, context->protect_system,
+				context->mount_flags);
 
 		/* If we couldn't set up the namespace this is
                  * probably due to a missing capability. In this case,
@@ -229,6 +229,7 @@ struct ExecParameters {
 	int *idle_pipe;
 	char *bus_endpoint_path;
 	int bus_endpoint_fd;
+	NamespaceTemplate *namespace_template;
 };
 
 int exec_spawn(ExecCommand *command, const ExecContext *context,
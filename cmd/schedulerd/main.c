@@ -124,6 +124,7 @@ static bool arg_default_memory_accounting = false;
 static EmergencyAction arg_cad_burst_action = EMERGENCY_ACTION_REBOOT_FORCE;
 static bool arg_default_tasks_accounting = false;
 static uint64_t arg_default_tasks_max = (uint64_t)-1;
+static bool arg_lazy_units = false;
 
 static void
 nop_handler(int sig)
@@ -745,6 +746,8 @@ parse_config_file(void)
 			&arg_default_tasks_accounting },
 		{ "Manager", "DefaultTasksMax", config_parse_tasks_max, 0,
 			&arg_default_tasks_max },
+		{ "Manager", "LazyUnits", config_parse_bool, 0,
+			&arg_lazy_units },
 		{}
 	};
 
@@ -1905,6 +1908,7 @@ main(int argc, char *argv[])
 	m->default_memory_accounting = arg_default_memory_accounting;
 	m->default_tasks_accounting = arg_default_tasks_accounting;
 	m->default_tasks_max = arg_default_tasks_max;
+	m->lazy_units = arg_lazy_units;
 	m->runtime_watchdog = arg_runtime_watchdog;
 	m->shutdown_watchdog = arg_shutdown_watchdog;
 
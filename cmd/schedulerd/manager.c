@@ -92,6 +92,9 @@
 #define JOBS_IN_PROGRESS_PERIOD_DIVISOR 3
 #define CGROUPS_AGENT_RCVBUF_SIZE (8 * 1024 * 1024)
 
+/* Maximum time spent on garbage collection per main loop iteration */
+#define GC_BUDGET_USEC (5 * USEC_PER_MSEC)
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd,
 	uint32_t revents, void *userdata);
 static int manager_dispatch_cgroups_agent_fd(sd_event_source *source, int fd,
@@ -632,13 +635,15 @@ manager_new(SystemdRunningAs running_as, bool test_run, Manager **_m)
 	m->pin_cgroupfs_fd = m->notify_fd = m->cgrpfs_exit_fd =
 		m->cgroups_agent_fd = m->signal_fd = m->time_change_fd =
 			m->dev_autofs_fd = m->private_listen_fd =
-				m->utab_inotify_fd = -1;
+				m->utab_inotify_fd = m->mountinfo_fd = -1;
 	m->current_job_id =
 		1; /* start as id #1, so that we can leave #0 around as "null-like" value */
 
 	m->ask_password_inotify_fd = -1;
 	m->have_ask_password = -EINVAL; /* we don't know */
 
+	m->gc_generation = 1; /* units start out with 0, i.e. uncached */
+
 	m->test_run = test_run;
 
 	/* Reboot immediately if the user hits C-A-D more often than 7x per 2s */
@@ -1012,17 +1017,23 @@ enum {
 };
 
 static void
-unit_gc_mark_good(Unit *u, unsigned gc_marker)
+unit_gc_mark_good(Unit *u, unsigned gc_marker, bool cache)
 {
 	Iterator i;
 	Unit *other;
 
 	u->gc_marker = gc_marker + GC_OFFSET_GOOD;
 
+	/* Remember the verdict across sweeps, unless it was derived
+         * from a UnitRef, whose source we cannot find again when it
+         * changes */
+	if (cache)
+		u->gc_generation = u->manager->gc_generation;
+
 	/* Recursively mark referenced units as GOOD as well */
 	SET_FOREACH (other, u->dependencies[UNIT_REFERENCES], i)
 		if (other->gc_marker == gc_marker + GC_OFFSET_UNSURE)
-			unit_gc_mark_good(other, gc_marker);
+			unit_gc_mark_good(other, gc_marker, cache);
 }
 
 static void
@@ -1030,7 +1041,7 @@ unit_gc_sweep(Unit *u, unsigned gc_marker)
 {
 	Iterator i;
 	Unit *other;
-	bool is_bad;
+	bool is_bad, cache = true;
 
 	assert(u);
 
@@ -1043,7 +1054,16 @@ unit_gc_sweep(Unit *u, unsigned gc_marker)
 	if (u->in_cleanup_queue)
 		goto bad;
 
-	if (!unit_may_gc(u))
+	if (!unit_may_gc(u)) {
+		/* This is cheap to check again, hence not cached */
+		unit_gc_mark_good(u, gc_marker, true);
+		u->gc_generation = 0;
+		return;
+	}
+
+	/* Found to be needed by an earlier sweep, and nothing it
+         * depended on has changed since */
+	if (u->gc_generation == u->manager->gc_generation)
 		goto good;
 
 	u->gc_marker = gc_marker + GC_OFFSET_IN_PATH;
@@ -1067,8 +1087,10 @@ unit_gc_sweep(Unit *u, unsigned gc_marker)
 			unit_gc_sweep(ref->source, gc_marker);
 
 			if (ref->source->gc_marker ==
-				gc_marker + GC_OFFSET_GOOD)
+				gc_marker + GC_OFFSET_GOOD) {
+				cache = false;
 				goto good;
+			}
 
 			if (ref->source->gc_marker != gc_marker + GC_OFFSET_BAD)
 				is_bad = false;
@@ -1092,7 +1114,7 @@ bad:
 	return;
 
 good:
-	unit_gc_mark_good(u, gc_marker);
+	unit_gc_mark_good(u, gc_marker, cache);
 }
 
 static unsigned
@@ -1101,24 +1123,43 @@ manager_dispatch_gc_queue(Manager *m)
 	Unit *u;
 	unsigned n = 0;
 	unsigned gc_marker;
+	usec_t deadline;
 
 	assert(m);
 
 	/* log_debug("Running GC..."); */
 
 	m->gc_marker += _GC_OFFSET_MAX;
-	if (m->gc_marker + _GC_OFFSET_MAX <= _GC_OFFSET_MAX)
+	if (m->gc_marker + _GC_OFFSET_MAX <= _GC_OFFSET_MAX) {
 		m->gc_marker = 1;
 
+		/* Markers of units that have not been looked at for a
+                 * long time may now match again, start over */
+		m->gc_generation++;
+	}
+
 	gc_marker = m->gc_marker;
+	deadline = now(CLOCK_MONOTONIC) + GC_BUDGET_USEC;
 
 	while ((u = m->gc_queue)) {
 		assert(u->in_gc_queue);
 
+		/* Once the budget is used up, leave the rest of the
+                 * queue for the next iteration. Units left UNSURE by
+                 * this sweep are still finished, since the verdict
+                 * on them is only valid with the current marker. */
+		if (n > 0 && u->gc_marker != gc_marker + GC_OFFSET_UNSURE &&
+			now(CLOCK_MONOTONIC) >= deadline) {
+			log_debug("Garbage collection budget exhausted, %u units left in queue.",
+				m->n_in_gc_queue);
+			break;
+		}
+
 		unit_gc_sweep(u, gc_marker);
 
 		IWLIST_REMOVE(gc_queue, m->gc_queue, u);
 		u->in_gc_queue = false;
+		m->n_in_gc_queue--;
 
 		n++;
 
@@ -1131,8 +1172,6 @@ manager_dispatch_gc_queue(Manager *m)
 		}
 	}
 
-	m->n_in_gc_queue = 0;
-
 	return n;
 }
 
@@ -1202,10 +1241,12 @@ manager_clear_jobs_and_units(Manager *m)
 	assert(!m->cleanup_queue);
 	assert(!m->gc_queue);
 	assert(!m->stop_when_unneeded_queue);
+	assert(!m->coldplug_queue);
 
 	assert(hashmap_isempty(m->jobs));
 	assert(hashmap_isempty(m->units));
 
+	m->coldplugged = false;
 	m->n_on_console = 0;
 	m->n_running_jobs = 0;
 }
@@ -1284,6 +1325,8 @@ manager_free(Manager *m)
 	assert(hashmap_isempty(m->units_requiring_mounts_for));
 	hashmap_free(m->units_requiring_mounts_for);
 
+	manager_flush_namespace_templates(m);
+
 	free(m);
 	return NULL;
 }
@@ -1375,6 +1418,8 @@ manager_coldplug(Manager *m)
 			r = q;
 	}
 
+	m->coldplugged = true;
+
 	return r;
 }
 
@@ -1615,6 +1660,109 @@ tr_abort:
 	return r;
 }
 
+int
+manager_add_jobs(Manager *m, JobType type, Unit **units, unsigned n_units,
+	JobMode mode, bool override, sd_bus_error *unit_errors, sd_bus_error *e)
+{
+	Transaction *tr;
+	unsigned k, n_added = 0;
+	int r = 0;
+
+	assert(m);
+	assert(type < _JOB_TYPE_MAX);
+	assert(units || n_units == 0);
+	assert(mode < _JOB_MODE_MAX);
+
+	/* Like manager_add_job(), but enqueues jobs for a number of
+         * units in a single transaction. The first unit that can be
+         * added anchors the transaction, all others are pulled in by
+         * it without mattering to it, so that one of them failing does
+         * not fail the others. Callers should check unit->job for the
+         * outcome of each. If unit_errors is not NULL, it has room for
+         * the error of each unit that could not be added. */
+
+	if (mode == JOB_ISOLATE)
+		return sd_bus_error_setf(e, SD_BUS_ERROR_INVALID_ARGS,
+			"Isolate is not valid for multiple units.");
+
+	if (n_units == 0)
+		return 0;
+
+	tr = transaction_new(mode == JOB_REPLACE_IRREVERSIBLY);
+	if (!tr)
+		return -ENOMEM;
+
+	for (k = 0; k < n_units; k++) {
+		_cleanup_bus_error_free_ sd_bus_error error =
+			SD_BUS_ERROR_NULL;
+		struct tx_job_submission sub = {
+			.unit = units[k],
+			.type = job_type_collapse(type, units[k]),
+			.parent = tr->anchor_job,
+			.matters = !tr->anchor_job,
+			.override = override,
+			.conflicts = false,
+			.ignore_requirements = (mode ==
+						       JOB_IGNORE_DEPENDENCIES ||
+				mode == JOB_IGNORE_REQUIREMENTS),
+			.ignore_order = (mode == JOB_IGNORE_DEPENDENCIES),
+		};
+		uint32_t first_id = m->current_job_id;
+		bool anchored = !!tr->anchor_job;
+		int q;
+
+		log_unit_debug(units[k]->id, "Trying to enqueue job %s/%s/%s",
+			units[k]->id, job_type_to_string(type),
+			job_mode_to_string(mode));
+
+		q = tx_submit_job(tr, &sub, &error);
+		if (q < 0) {
+			log_unit_warning(units[k]->id,
+				"Failed to add job for %s to transaction, ignoring: %s",
+				units[k]->id, bus_error_message(&error, q));
+
+			if (unit_errors) {
+				if (sd_bus_error_is_set(&error))
+					sd_bus_error_copy(&unit_errors[k],
+						&error);
+				else
+					sd_bus_error_set_errno(&unit_errors[k],
+						q);
+			}
+
+			/* The job of the unit itself, and those of the
+                         * dependencies added before the one that
+                         * failed, must not be started without it */
+			transaction_rollback(tr, first_id);
+			if (!anchored)
+				tr->anchor_job = NULL;
+
+			r = q;
+			continue;
+		}
+
+		n_added++;
+	}
+
+	if (n_added == 0) {
+		transaction_free(tr);
+		return sd_bus_error_set_errnof(e, r, "No job could be added.");
+	}
+
+	r = transaction_activate(tr, m, mode, e);
+	if (r < 0) {
+		transaction_abort(tr);
+		transaction_free(tr);
+		return r;
+	}
+
+	log_debug("Enqueued %u jobs of type %s in one transaction.", n_added,
+		job_type_to_string(type));
+
+	transaction_free(tr);
+	return 0;
+}
+
 int
 manager_add_job_by_name(Manager *m, JobType type, const char *name,
 	JobMode mode, bool override, sd_bus_error *e, Job **_ret)
@@ -1686,6 +1834,51 @@ manager_dispatch_target_deps_queue(Manager *m)
 	return r;
 }
 
+static int
+manager_dispatch_coldplug_queue(Manager *m)
+{
+	_cleanup_hashmap_free_ Hashmap *deferred_work = NULL;
+	int (*proc)(Unit *);
+	Iterator i;
+	Unit *u;
+	int r = 0;
+
+	assert(m);
+
+	/* Units materialized after the initial coldplug still need
+         * their initial state set up, the same way manager_coldplug()
+         * does it for everything else. */
+	if (!m->coldplug_queue)
+		return 0;
+
+	deferred_work = hashmap_new(&trivial_hash_ops);
+	if (!deferred_work)
+		return -ENOMEM;
+
+	while ((u = m->coldplug_queue)) {
+		int q;
+
+		assert(u->in_coldplug_queue);
+
+		IWLIST_REMOVE(coldplug_queue, m->coldplug_queue, u);
+		u->in_coldplug_queue = false;
+
+		q = unit_coldplug(u, deferred_work);
+		if (q < 0)
+			r = q;
+	}
+
+	HASHMAP_FOREACH_KEY (proc, u, deferred_work, i) {
+		int q;
+
+		q = proc(u);
+		if (q < 0)
+			r = q;
+	}
+
+	return r;
+}
+
 unsigned
 manager_dispatch_load_queue(Manager *m)
 {
@@ -1716,6 +1909,10 @@ manager_dispatch_load_queue(Manager *m)
          * should be loaded and have aliases resolved */
 	(void)manager_dispatch_target_deps_queue(m);
 
+	/* Now that they are loaded, set up the state of units that
+         * were materialized from a side table */
+	(void)manager_dispatch_coldplug_queue(m);
+
 	return n;
 }
 
@@ -1760,6 +1957,21 @@ manager_load_unit_prepare(Manager *m, const char *name, const char *path,
 		return 1;
 	}
 
+	if (!path) {
+		r = manager_materialize_unit(m, name, &ret);
+		if (r < 0)
+			return r;
+		if (r > 0) {
+			unit_add_to_dbus_queue(ret);
+			unit_add_to_gc_queue(ret);
+
+			if (_ret)
+				*_ret = ret;
+
+			return 0;
+		}
+	}
+
 	ret = unit_new(m, unit_vtable[t]->object_size);
 	if (!ret)
 		return -ENOMEM;
@@ -2634,7 +2846,9 @@ manager_loop(Manager *m)
 		if (manager_dispatch_load_queue(m) > 0)
 			continue;
 
-		if (manager_dispatch_gc_queue(m) > 0)
+		/* If garbage collection ran out of time, process the
+                 * other queues and pending events before continuing */
+		if (manager_dispatch_gc_queue(m) > 0 && !m->gc_queue)
 			continue;
 
 		if (manager_dispatch_cleanup_queue(m) > 0)
@@ -2658,6 +2872,9 @@ manager_loop(Manager *m)
 		} else
 			wait_usec = USEC_INFINITY;
 
+		if (m->gc_queue)
+			wait_usec = 0;
+
 		r = sd_event_run(m->event, wait_usec);
 		if (r < 0)
 			return log_error_errno(r,
@@ -3234,6 +3451,7 @@ manager_reload(Manager *m)
 	/* From here on there is no way back. */
 	manager_clear_jobs_and_units(m);
 	manager_undo_generators(m);
+	manager_flush_namespace_templates(m);
 	lookup_paths_free(&m->lookup_paths);
 
 	/* Find new unit paths */
@@ -3852,6 +4070,44 @@ manager_get_units_requiring_mounts_for(Manager *m, const char *path)
 		streq(p, "/") ? "" : p);
 }
 
+int
+manager_materialize_unit(Manager *m, const char *name, Unit **_ret)
+{
+	Unit *ret = NULL;
+	UnitType t;
+	int r;
+
+	assert(m);
+	assert(name);
+
+	/* Creates a unit from the lazy side table of its type, if the
+         * type keeps one and has an entry for this name. */
+
+	if (!m->lazy_units)
+		return 0;
+
+	t = unit_name_to_type(name);
+	if (t < 0 || !unit_vtable[t]->materialize)
+		return 0;
+
+	r = unit_vtable[t]->materialize(m, name, &ret);
+	if (r <= 0)
+		return r;
+
+	assert(ret);
+	log_unit_debug(ret->id, "Materialized %s from lazy state.", ret->id);
+
+	/* If the initial coldplug is over, nobody else will set up the
+         * state of this unit for us */
+	if (m->coldplugged)
+		unit_add_to_coldplug_queue(ret);
+
+	if (_ret)
+		*_ret = ret;
+
+	return 1;
+}
+
 const char *
 manager_get_runtime_prefix(Manager *m)
 {
@@ -3861,6 +4117,174 @@ manager_get_runtime_prefix(Manager *m)
 						       getenv("XDG_RUNTIME_DIR");
 }
 
+#ifdef SVC_PLATFORM_Linux
+static int
+manager_dispatch_mountinfo_fd(sd_event_source *source, int fd,
+	uint32_t revents, void *userdata)
+{
+	Manager *m = userdata;
+
+	assert(m);
+	assert(revents & (EPOLLPRI | EPOLLERR));
+
+	/* Namespace templates prepared before this change did not see
+         * it, so they are not used anymore. Polling the file is enough
+         * to acknowledge the change, there is no need to read it. */
+	m->mountinfo_generation++;
+
+	return 0;
+}
+
+static int
+manager_watch_mountinfo(Manager *m)
+{
+	int r;
+
+	assert(m);
+
+	if (m->mountinfo_fd >= 0)
+		return 0;
+
+	m->mountinfo_fd = open("/proc/self/mountinfo",
+		O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (m->mountinfo_fd < 0)
+		return -errno;
+
+	r = sd_event_add_io(m->event, &m->mountinfo_event_source,
+		m->mountinfo_fd, EPOLLPRI, manager_dispatch_mountinfo_fd, m);
+	if (r < 0) {
+		m->mountinfo_fd = safe_close(m->mountinfo_fd);
+		return r;
+	}
+
+	/* Dispatch this before SIGCHLD, so that the mount table
+         * changes of an exiting process are seen before its
+         * successors are started. */
+	(void)sd_event_source_set_priority(m->mountinfo_event_source, -10);
+
+	return 0;
+}
+#endif
+
+int
+manager_get_namespace_template(Manager *m, const char *id,
+	const ExecContext *c, const ExecParameters *p, NamespaceTemplate **ret)
+{
+#ifdef SVC_PLATFORM_Linux
+	_cleanup_free_ char *key = NULL, *settings = NULL, *template = NULL;
+	NamespaceTemplate *t;
+	int r;
+
+	assert(m);
+	assert(id);
+	assert(c);
+	assert(p);
+	assert(ret);
+
+	*ret = NULL;
+
+	/* Processes sharing a namespace see each other's mounts in it,
+         * so only instances of the same template unit share one */
+	if (!unit_name_is_instance(id))
+		return 0;
+
+	/* Private /tmp directories and bus endpoints are specific to
+         * each unit, so such namespaces cannot be shared */
+	if (c->private_tmp || p->bus_endpoint_path)
+		return 0;
+
+	if (strv_isempty(c->read_write_dirs) &&
+		strv_isempty(c->read_only_dirs) &&
+		strv_isempty(c->inaccessible_dirs) && c->mount_flags == 0 &&
+		!c->private_devices && c->protect_system == PROTECT_SYSTEM_NO &&
+		c->protect_home == PROTECT_HOME_NO)
+		return 0;
+
+	r = namespace_template_key(p->apply_chroot ? c->root_directory : NULL,
+		c->read_write_dirs, c->read_only_dirs, c->inaccessible_dirs,
+		c->private_devices, c->protect_home, c->protect_system,
+		c->mount_flags, &settings);
+	if (r < 0)
+		return r;
+
+	template = unit_name_template(id);
+	if (!template)
+		return -ENOMEM;
+
+	key = strjoin(template, "\n", settings, NULL);
+	if (!key)
+		return -ENOMEM;
+
+	t = hashmap_get(m->namespace_templates, key);
+	if (t) {
+		if (t->generation == m->mountinfo_generation) {
+			*ret = t;
+			return 0;
+		}
+
+		/* The mount table changed since the namespace was
+                 * prepared, so prepare a new one from the current
+                 * table. Running services keep the old one. */
+		hashmap_remove(m->namespace_templates, key);
+		namespace_template_free(t);
+	}
+
+	/* Without a watch we could not tell when a template goes stale,
+         * hence don't use templates at all then */
+	r = manager_watch_mountinfo(m);
+	if (r < 0) {
+		log_debug_errno(r,
+			"Failed to watch /proc/self/mountinfo, not using namespace templates: %m");
+		return 0;
+	}
+
+	r = hashmap_ensure_allocated(&m->namespace_templates,
+		&string_hash_ops);
+	if (r < 0)
+		return r;
+
+	r = namespace_template_new(key, &t);
+	if (r < 0)
+		return r;
+
+	t->generation = m->mountinfo_generation;
+
+	r = hashmap_put(m->namespace_templates, t->key, t);
+	if (r < 0) {
+		namespace_template_free(t);
+		return r;
+	}
+
+	*ret = t;
+	return 1;
+#else
+	*ret = NULL;
+	return 0;
+#endif
+}
+
+void
+manager_flush_namespace_templates(Manager *m)
+{
+#ifdef SVC_PLATFORM_Linux
+	NamespaceTemplate *t;
+
+	assert(m);
+
+	/* Services started from now on set up their namespaces from
+         * scratch again, running ones keep theirs */
+	while ((t = hashmap_steal_first(m->namespace_templates)))
+		namespace_template_free(t);
+
+	hashmap_free(m->namespace_templates);
+	m->namespace_templates = NULL;
+
+	m->mountinfo_event_source =
+		sd_event_source_unref(m->mountinfo_event_source);
+	m->mountinfo_fd = safe_close(m->mountinfo_fd);
+#endif
+}
+
 ManagerState
 manager_state(Manager *m)
 {
@@ -149,6 +149,10 @@ struct Manager {
 	/* Units that might be subject to StopWhenUnneeded= clean-up */
 	IWLIST_HEAD(Unit, stop_when_unneeded_queue);
 
+	/* Units materialized from a lazy side table after coldplug,
+         * whose initial state still has to be set up */
+	IWLIST_HEAD(Unit, coldplug_queue);
+
 	sd_event *event;
 
 	/* We use two hash tables here, since the same PID might be
@@ -221,12 +225,20 @@ struct Manager {
 	sd_event_source *udev_event_source;
 	Hashmap *devices_by_sysfs;
 
+	/* Devices not yet backed by a unit, if lazy_units is set */
+	Hashmap *device_stubs; /* unit name => DeviceStub 1:1 */
+	Hashmap *device_stubs_by_sysfs; /* sysfs path => DeviceStub 1:n */
+
 	/* Data specific to the mount subsystem */
 	FILE *proc_self_mountinfo;
 	sd_event_source *mount_event_source;
 	int utab_inotify_fd;
 	sd_event_source *mount_utab_event_source;
 
+	/* Mounts not yet backed by a unit, if lazy_units is set */
+	Hashmap *mount_stubs; /* unit name => MountStub 1:1 */
+	unsigned mount_stubs_generation;
+
 	/* Data specific to the swap filesystem */
 	FILE *proc_swaps;
 	sd_event_source *swap_event_source;
@@ -260,6 +272,8 @@ struct Manager {
 
 	/* Data specific to the Automount subsystem */
 	int dev_autofs_fd;
+	Set *automounts_pending; /* Automounts with mount requests to submit */
+	sd_event_source *automount_batch_event_source;
 
 	/* Data specific to the cgroup subsystem */
 	Hashmap *cgroup_unit;
@@ -267,6 +281,7 @@ struct Manager {
 	char *cgroup_root;
 
 	int gc_marker;
+	unsigned gc_generation;
 	unsigned n_in_gc_queue;
 
 	/* Make sure the user cannot accidentally unmount our cgroup
@@ -286,6 +301,13 @@ struct Manager {
 
 	bool test_run: 1;
 
+	/* Set once the initial coldplug of all units is done */
+	bool coldplugged: 1;
+
+	/* Keep unreferenced device and mount state in compact side
+         * tables and only create units for it on demand */
+	bool lazy_units;
+
 	ShowStatus show_status;
 	bool confirm_spawn;
 	bool no_console_output;
@@ -342,6 +364,15 @@ struct Manager {
 	/* Used for processing polkit authorization responses */
 	Hashmap *polkit_registry;
 
+	/* Prepared mount namespaces of service instances, keyed by
+         * their template and sandbox settings. */
+	Hashmap *namespace_templates;
+	/* Bumped whenever the mount table changes, watched for as long
+         * as there are namespace templates */
+	int mountinfo_fd;
+	sd_event_source *mountinfo_event_source;
+	unsigned mountinfo_generation;
+
 	/* When the user hits C-A-D more than 7 times per 2s, do something immediately... */
 	RateLimit ctrl_alt_del_ratelimit;
 	EmergencyAction cad_burst_action;
@@ -370,6 +401,9 @@ int manager_load_unit_from_dbus_path(Manager *m, const char *s, sd_bus_error *e,
 
 int manager_add_job(Manager *m, JobType type, Unit *unit, JobMode mode,
 	bool override, sd_bus_error *e, Job **_ret);
+int manager_add_jobs(Manager *m, JobType type, Unit **units, unsigned n_units,
+	JobMode mode, bool override, sd_bus_error *unit_errors,
+	sd_bus_error *e);
 int manager_add_job_by_name(Manager *m, JobType type, const char *name,
 	JobMode mode, bool force, sd_bus_error *e, Job **_ret);
 
@@ -417,8 +451,14 @@ void manager_flip_auto_status(Manager *m, bool enable);
 
 Set *manager_get_units_requiring_mounts_for(Manager *m, const char *path);
 
+int manager_materialize_unit(Manager *m, const char *name, Unit **_ret);
+
 const char *manager_get_runtime_prefix(Manager *m);
 
+int manager_get_namespace_template(Manager *m, const char *id,
+	const ExecContext *c, const ExecParameters *p, NamespaceTemplate **ret);
+void manager_flush_namespace_templates(Manager *m);
+
 ManagerState manager_state(Manager *m);
 
 void manager_ref_console(Manager *m);
@@ -48,6 +48,22 @@
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct libmnt_table *, mnt_free_table);
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct libmnt_iter *, mnt_free_iter);
 
+typedef struct MountStub MountStub;
+
+/* A mount listed in /proc/self/mountinfo that nothing references
+ * yet. If lazy units are enabled we keep only this around instead of
+ * a full unit. All strings are stored right after the structure. */
+struct MountStub {
+	const char *name;
+	const char *what;
+	const char *where;
+	const char *options;
+	const char *fstype;
+
+	/* Value of mount_stubs_generation when last seen */
+	unsigned generation;
+};
+
 static const UnitActiveState state_translation_table[_MOUNT_STATE_MAX] = {
 	[MOUNT_DEAD] = UNIT_INACTIVE,
 	[MOUNT_MOUNTING] = UNIT_ACTIVATING,
@@ -1514,9 +1530,82 @@ mount_dispatch_timer(sd_event_source *source, usec_t usec, void *userdata)
 	return 0;
 }
 
+static int
+mount_stub_put(Manager *m, const char *name, const char *what,
+	const char *where, const char *options, const char *fstype)
+{
+	size_t ln, lwt, lwr, lo, lf;
+	MountStub *s;
+	char *p;
+	int r;
+
+	assert(m);
+
+	s = hashmap_get(m->mount_stubs, name);
+	if (s) {
+		if (streq(s->what, what) && streq(s->options, options) &&
+			streq(s->fstype, fstype)) {
+			s->generation = m->mount_stubs_generation;
+			return 0;
+		}
+
+		hashmap_remove(m->mount_stubs, name);
+		free(s);
+	}
+
+	r = hashmap_ensure_allocated(&m->mount_stubs, &string_hash_ops);
+	if (r < 0)
+		return r;
+
+	ln = strlen(name) + 1;
+	lwt = strlen(what) + 1;
+	lwr = strlen(where) + 1;
+	lo = strlen(options) + 1;
+	lf = strlen(fstype) + 1;
+
+	s = malloc(sizeof(MountStub) + ln + lwt + lwr + lo + lf);
+	if (!s)
+		return -ENOMEM;
+
+	p = (char *)(s + 1);
+	s->name = memcpy(p, name, ln);
+	s->what = memcpy(p += ln, what, lwt);
+	s->where = memcpy(p += lwt, where, lwr);
+	s->options = memcpy(p += lwr, options, lo);
+	s->fstype = memcpy(p += lo, fstype, lf);
+	s->generation = m->mount_stubs_generation;
+
+	r = hashmap_put(m->mount_stubs, s->name, s);
+	if (r < 0) {
+		free(s);
+		return r;
+	}
+
+	return 0;
+}
+
+static void
+mount_stubs_sweep(Manager *m)
+{
+	MountStub *s;
+	Iterator i;
+
+	assert(m);
+
+	/* Forget about all mounts that weren't seen in the last
+         * pass over /proc/self/mountinfo */
+	HASHMAP_FOREACH (s, m->mount_stubs, i) {
+		if (s->generation == m->mount_stubs_generation)
+			continue;
+
+		hashmap_remove(m->mount_stubs, s->name);
+		free(s);
+	}
+}
+
 static int
 mount_setup_unit(Manager *m, const char *what, const char *where,
-	const char *options, const char *fstype, bool set_flags)
+	const char *options, const char *fstype, bool set_flags, bool lazy)
 {
 	_cleanup_free_ char *e = NULL, *w = NULL, *o = NULL, *f = NULL;
 	bool load_extras = false;
@@ -1550,6 +1639,13 @@ mount_setup_unit(Manager *m, const char *what, const char *where,
 
 	u = manager_get_unit(m, e);
 	if (!u) {
+		/* Nobody cares about this mount yet, just remember it */
+		if (lazy)
+			return mount_stub_put(m, e, what, where, options,
+				fstype);
+
+		free(hashmap_remove(m->mount_stubs, e));
+
 		delete = true;
 
 		u = unit_new(m, sizeof(Mount));
@@ -1712,6 +1808,8 @@ mount_load_proc_self_mountinfo(Manager *m, bool set_flags)
 		return log_error_errno(r,
 			"Failed to parse /proc/self/mountinfo: %m");
 
+	m->mount_stubs_generation++;
+
 	for (;;) {
 		const char *device, *path, *options, *fstype;
 		_cleanup_free_ const char *d = NULL, *p = NULL;
@@ -1741,7 +1839,8 @@ mount_load_proc_self_mountinfo(Manager *m, bool set_flags)
 		(void)device_found_node(m, d, true, DEVICE_FOUND_MOUNT,
 			set_flags);
 
-		(void)mount_setup_unit(m, d, p, options, fstype, set_flags);
+		(void)mount_setup_unit(m, d, p, options, fstype, set_flags,
+			m->lazy_units);
 	}
 
 	return 0;
@@ -1761,6 +1860,40 @@ mount_shutdown(Manager *m)
 		m->proc_self_mountinfo = NULL;
 	}
 	m->utab_inotify_fd = safe_close(m->utab_inotify_fd);
+
+	hashmap_free_free(m->mount_stubs);
+	m->mount_stubs = NULL;
+}
+
+static int
+mount_materialize(Manager *m, const char *name, Unit **ret)
+{
+	_cleanup_free_ MountStub *s = NULL;
+	Unit *u;
+	int r;
+
+	assert(m);
+	assert(name);
+	assert(ret);
+
+	s = hashmap_remove(m->mount_stubs, name);
+	if (!s)
+		return 0;
+
+	/* Set up the unit just like mount_load_proc_self_mountinfo()
+         * would have, had it not been lazy. Coldplug will then put it
+         * into mounted state. */
+	r = mount_setup_unit(m, s->what, s->where, s->options, s->fstype,
+		false, false);
+	if (r < 0)
+		return r;
+
+	u = manager_get_unit(m, name);
+	if (!u)
+		return 0;
+
+	*ret = u;
+	return 1;
 }
 
 static int
@@ -1837,6 +1970,8 @@ mount_enumerate(Manager *m)
 	if (r < 0)
 		goto fail;
 
+	mount_stubs_sweep(m);
+
 	return 0;
 
 fail:
@@ -1851,6 +1986,7 @@ mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents,
 	_cleanup_set_free_ Set *around = NULL, *gone = NULL;
 	Manager *m = userdata;
 	const char *what;
+	MountStub *stub;
 	Iterator i;
 	Unit *u;
 	int r;
@@ -1992,6 +2128,18 @@ mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents,
 			false;
 	}
 
+	HASHMAP_FOREACH (stub, m->mount_stubs, i) {
+		Set **which;
+
+		/* Mounts we didn't create units for count as well */
+		which = stub->generation == m->mount_stubs_generation ?
+			      &around :
+			      &gone;
+		if (set_ensure_allocated(which, &string_hash_ops) < 0 ||
+			set_put(*which, stub->what) < 0)
+			log_oom();
+	}
+
 	SET_FOREACH (what, gone, i) {
 		if (set_contains(around, what))
 			continue;
@@ -2001,6 +2149,11 @@ mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents,
 			true);
 	}
 
+	/* Only drop vanished stubs now, the sets above point into them */
+	set_free(gone);
+	gone = NULL;
+	mount_stubs_sweep(m);
+
 	return 0;
 }
 
@@ -2125,6 +2278,7 @@ const UnitVTable mount_vtable = {
         .can_transient = true,
 
         .enumerate = mount_enumerate,
+        .materialize = mount_materialize,
         .shutdown = mount_shutdown,
 
         .status_message_formats = {
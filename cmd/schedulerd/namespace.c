@@ -605,10 +605,9 @@ setup_tmp_dirs(const char *id, char **tmp_dir, char **var_tmp_dir)
 	return 0;
 }
 
-int
-setup_netns(int netns_storage_socket[2])
+static int
+namespace_storage_take(int storage_socket[2], int *ret)
 {
-	_cleanup_close_ int netns = -1;
 	union {
 		struct cmsghdr cmsghdr;
 		uint8_t buf[CMSG_SPACE(sizeof(int))];
@@ -618,7 +617,65 @@ setup_netns(int netns_storage_socket[2])
 		.msg_controllen = sizeof(control),
 	};
 	struct cmsghdr *cmsg;
-	int r;
+	int fd = -1;
+
+	/* Must be called with the lock on the storage socket taken.
+         * Returns -1 in *ret if nothing has been stored yet. */
+
+	if (recvmsg(storage_socket[0], &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) <
+		0) {
+		if (errno != EAGAIN)
+			return -errno;
+
+		*ret = -1;
+		return 0;
+	}
+
+	CMSG_FOREACH (cmsg, &mh)
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_RIGHTS) {
+			assert(cmsg->cmsg_len == CMSG_LEN(sizeof(int)));
+			fd = *(int *)CMSG_DATA(cmsg);
+		}
+
+	if (fd < 0)
+		return -EIO;
+
+	*ret = fd;
+	return 0;
+}
+
+static int
+namespace_storage_put(int storage_socket[2], int fd)
+{
+	union {
+		struct cmsghdr cmsghdr;
+		uint8_t buf[CMSG_SPACE(sizeof(int))];
+	} control = {};
+	struct msghdr mh = {
+		.msg_control = &control,
+		.msg_controllen = sizeof(control),
+	};
+	struct cmsghdr *cmsg;
+
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	mh.msg_controllen = cmsg->cmsg_len;
+
+	if (sendmsg(storage_socket[1], &mh, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		return -errno;
+
+	return 0;
+}
+
+int
+setup_netns(int netns_storage_socket[2])
+{
+	_cleanup_close_ int netns = -1;
+	int r, q;
 
 	assert(netns_storage_socket);
 	assert(netns_storage_socket[0] >= 0);
@@ -635,13 +692,11 @@ setup_netns(int netns_storage_socket[2])
 	if (lockf(netns_storage_socket[0], F_LOCK, 0) < 0)
 		return -errno;
 
-	if (recvmsg(netns_storage_socket[0], &mh,
-		    MSG_DONTWAIT | MSG_CMSG_CLOEXEC) < 0) {
-		if (errno != EAGAIN) {
-			r = -errno;
-			goto fail;
-		}
+	r = namespace_storage_take(netns_storage_socket, &netns);
+	if (r < 0)
+		goto fail;
 
+	if (netns < 0) {
 		/* Nothing stored yet, so let's create a new namespace */
 
 		if (unshare(CLONE_NEWNET) < 0) {
@@ -662,13 +717,6 @@ setup_netns(int netns_storage_socket[2])
 	} else {
 		/* Yay, found something, so let's join the namespace */
 
-		CMSG_FOREACH (cmsg, &mh)
-			if (cmsg->cmsg_level == SOL_SOCKET &&
-				cmsg->cmsg_type == SCM_RIGHTS) {
-				assert(cmsg->cmsg_len == CMSG_LEN(sizeof(int)));
-				netns = *(int *)CMSG_DATA(cmsg);
-			}
-
 		if (setns(netns, CLONE_NEWNET) < 0) {
 			r = -errno;
 			goto fail;
@@ -677,18 +725,9 @@ setup_netns(int netns_storage_socket[2])
 		r = 0;
 	}
 
-	cmsg = CMSG_FIRSTHDR(&mh);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
-	memcpy(CMSG_DATA(cmsg), &netns, sizeof(int));
-	mh.msg_controllen = cmsg->cmsg_len;
-
-	if (sendmsg(netns_storage_socket[1], &mh, MSG_DONTWAIT | MSG_NOSIGNAL) <
-		0) {
-		r = -errno;
-		goto fail;
-	}
+	q = namespace_storage_put(netns_storage_socket, netns);
+	if (q < 0)
+		r = q;
 
 fail:
 	lockf(netns_storage_socket[0], F_ULOCK, 0);
@@ -696,6 +735,162 @@ fail:
 	return r;
 }
 
+int
+namespace_template_key(const char *root_directory, char **read_write_dirs,
+	char **read_only_dirs, char **inaccessible_dirs, bool private_dev,
+	ProtectHome protect_home, ProtectSystem protect_system,
+	unsigned long mount_flags, char **ret)
+{
+	_cleanup_free_ char *k = NULL;
+	size_t allocated = 0, n = 0;
+	char **lists[] = { read_write_dirs, read_only_dirs,
+		inaccessible_dirs };
+	unsigned i;
+	char **j;
+
+	assert(ret);
+
+	/* Serializes everything setup_namespace() takes that is not
+         * specific to a single unit into a string, so that identical
+         * sandboxes map to the same key. Each path is prefixed by the
+         * number of its list and terminated by a newline, which cannot
+         * be part of a unit file setting. */
+
+	for (i = 0; i < ELEMENTSOF(lists); i++)
+		STRV_FOREACH (j, lists[i]) {
+			size_t l = strlen(*j);
+
+			if (!GREEDY_REALLOC(k, allocated, n + l + 3))
+				return -ENOMEM;
+
+			k[n++] = '0' + i;
+			memcpy(k + n, *j, l);
+			n += l;
+			k[n++] = '\n';
+		}
+
+	if (!GREEDY_REALLOC(k, allocated, n + 1))
+		return -ENOMEM;
+	k[n] = 0;
+
+	if (asprintf(ret, "%s%s\n%i %i %i %lu", k, strempty(root_directory),
+		    private_dev, protect_home, protect_system, mount_flags) < 0)
+		return -ENOMEM;
+
+	return 0;
+}
+
+int
+namespace_template_new(const char *key, NamespaceTemplate **ret)
+{
+	NamespaceTemplate *t;
+
+	assert(key);
+	assert(ret);
+
+	t = new0(NamespaceTemplate, 1);
+	if (!t)
+		return -ENOMEM;
+
+	t->storage_socket[0] = t->storage_socket[1] = -1;
+
+	t->key = strdup(key);
+	if (!t->key) {
+		free(t);
+		return -ENOMEM;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0,
+		    t->storage_socket) < 0) {
+		namespace_template_free(t);
+		return -errno;
+	}
+
+	*ret = t;
+	return 0;
+}
+
+NamespaceTemplate *
+namespace_template_free(NamespaceTemplate *t)
+{
+	if (!t)
+		return NULL;
+
+	safe_close_pair(t->storage_socket);
+	free(t->key);
+	free(t);
+
+	return NULL;
+}
+
+int
+setup_namespace_template(NamespaceTemplate *t, const char *root_directory,
+	char **read_write_dirs, char **read_only_dirs,
+	char **inaccessible_dirs, bool private_dev, ProtectHome protect_home,
+	ProtectSystem protect_system, unsigned long mount_flags)
+{
+	_cleanup_close_ int mntns = -1, proc_self = -1;
+	int r, q;
+
+	assert(t);
+
+	/* Works like setup_netns(): the first process to get here sets
+         * up the namespace and leaves a reference to it in the storage
+         * socket, everybody else just joins it. setns() also moves us
+         * to the root of the namespace, which is where the first
+         * process ended up in case of a root directory. */
+
+	if (lockf(t->storage_socket[0], F_LOCK, 0) < 0)
+		return -errno;
+
+	r = namespace_storage_take(t->storage_socket, &mntns);
+	if (r < 0)
+		goto finish;
+
+	if (mntns < 0) {
+		/* Pin /proc/self before we move to the root directory,
+                 * which need not have /proc mounted */
+		proc_self = open("/proc/self",
+			O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOCTTY);
+		if (proc_self < 0) {
+			r = -errno;
+			goto finish;
+		}
+
+		r = setup_namespace(root_directory, read_write_dirs,
+			read_only_dirs, inaccessible_dirs, NULL, NULL, NULL,
+			private_dev, protect_home, protect_system,
+			mount_flags);
+		if (r < 0)
+			goto finish;
+
+		mntns = openat(proc_self, "ns/mnt",
+			O_RDONLY | O_CLOEXEC | O_NOCTTY);
+		if (mntns < 0) {
+			r = -errno;
+			goto finish;
+		}
+
+		r = 1;
+	} else {
+		if (setns(mntns, CLONE_NEWNS) < 0)
+			r = -errno;
+		else
+			r = 0;
+	}
+
+	/* Put the reference back even if we failed to join, the next
+         * process might be luckier */
+	q = namespace_storage_put(t->storage_socket, mntns);
+	if (q < 0 && r >= 0)
+		r = q;
+
+finish:
+	lockf(t->storage_socket[0], F_ULOCK, 0);
+
+	return r;
+}
+
 static const char *const protect_home_table[_PROTECT_HOME_MAX] = {
 	[PROTECT_HOME_NO] = "no",
 	[PROTECT_HOME_YES] = "yes",
@@ -45,6 +45,29 @@ int setup_namespace(const char *chroot, char **read_write_dirs,
 	ProtectHome protect_home, ProtectSystem protect_system,
 	unsigned long mount_flags);
 
+/* A mount namespace prepared by the first instance of a template unit
+ * to run with a certain sandbox configuration, which all further
+ * instances with the same configuration join instead of setting up
+ * their own. */
+typedef struct NamespaceTemplate {
+	char *key;
+	int storage_socket[2];
+	/* Mount table generation the namespace was prepared from */
+	unsigned generation;
+} NamespaceTemplate;
+
+int namespace_template_key(const char *root_directory, char **read_write_dirs,
+	char **read_only_dirs, char **inaccessible_dirs, bool private_dev,
+	ProtectHome protect_home, ProtectSystem protect_system,
+	unsigned long mount_flags, char **ret);
+int namespace_template_new(const char *key, NamespaceTemplate **ret);
+NamespaceTemplate *namespace_template_free(NamespaceTemplate *t);
+
+int setup_namespace_template(NamespaceTemplate *t, const char *root_directory,
+	char **read_write_dirs, char **read_only_dirs,
+	char **inaccessible_dirs, bool private_dev, ProtectHome protect_home,
+	ProtectSystem protect_system, unsigned long mount_flags);
+
 int setup_tmp_dirs(const char *id, char **tmp_dir, char **var_tmp_dir);
 
 int setup_netns(int netns_storage_socket[2]);
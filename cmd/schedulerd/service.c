@@ -1355,6 +1355,13 @@ service_spawn(Service *s, ExecCommand *c, usec_t timeout, bool pass_fds,
 	if (s->type == SERVICE_IDLE)
 		exec_params.idle_pipe = UNIT(s)->manager->idle_pipe;
 
+	r = manager_get_namespace_template(UNIT(s)->manager, UNIT(s)->id,
+		&s->exec_context, &exec_params,
+		&exec_params.namespace_template);
+	if (r < 0)
+		log_unit_debug_errno(UNIT(s)->id, r,
+			"Failed to get namespace template, ignoring: %m");
+
 	r = exec_spawn(c, &s->exec_context, &exec_params, s->exec_runtime,
 		&pid);
 	if (r < 0)
@@ -1261,6 +1261,28 @@ tx_submit_job(Transaction *tx, struct tx_job_submission *sub, sd_bus_error *e)
 		sub->ignore_requirements, sub->ignore_order, e);
 }
 
+void
+transaction_rollback(Transaction *tr, uint32_t id)
+{
+	Iterator i;
+	Job *j, *k;
+
+	assert(tr);
+
+	/* Deletes every job created since the job id counter stood at
+         * id, i.e. whatever a failed submission left behind. Links can
+         * only lead from such new jobs to older ones, so the rest of
+         * the transaction stays intact. */
+
+again:
+	HASHMAP_FOREACH (j, tr->jobs, i)
+		IWLIST_FOREACH (transaction, k, j)
+			if (k->id - id < k->manager->current_job_id - id) {
+				transaction_delete_job(tr, k, false);
+				goto again;
+			}
+}
+
 int
 transaction_add_isolate_jobs(Transaction *tr, Manager *m)
 {
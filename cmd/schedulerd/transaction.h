@@ -57,3 +57,4 @@ int transaction_activate(Transaction *tr, Manager *m, JobMode mode,
 	sd_bus_error *e);
 int transaction_add_isolate_jobs(Transaction *tr, Manager *m);
 void transaction_abort(Transaction *tr);
+void transaction_rollback(Transaction *tr, uint32_t id);
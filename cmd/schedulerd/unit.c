@@ -383,6 +383,21 @@ unit_add_to_cleanup_queue(Unit *u)
 	u->in_cleanup_queue = true;
 }
 
+static void
+unit_gc_invalidate(Unit *u)
+{
+	Iterator i;
+	Unit *other;
+
+	/* Units that were found to be needed because of this one have
+         * to be looked at again */
+	SET_FOREACH (other, u->dependencies[UNIT_REFERENCES], i)
+		if (other->gc_generation == u->manager->gc_generation) {
+			other->gc_generation = 0;
+			unit_gc_invalidate(other);
+		}
+}
+
 void
 unit_add_to_gc_queue(Unit *u)
 {
@@ -394,6 +409,9 @@ unit_add_to_gc_queue(Unit *u)
 	if (!unit_may_gc(u))
 		return;
 
+	u->gc_generation = 0;
+	unit_gc_invalidate(u);
+
 	IWLIST_PREPEND(gc_queue, u->manager->gc_queue, u);
 	u->in_gc_queue = true;
 
@@ -622,6 +640,9 @@ unit_free(Unit *u)
 		IWLIST_REMOVE(stop_when_unneeded_queue,
 			u->manager->stop_when_unneeded_queue, u);
 
+	if (u->in_coldplug_queue)
+		IWLIST_REMOVE(coldplug_queue, u->manager->coldplug_queue, u);
+
 	if (u->on_console)
 		manager_unref_console(u->manager);
 
@@ -1211,6 +1232,18 @@ unit_add_to_target_deps_queue(Unit *u)
 	u->in_target_deps_queue = true;
 }
 
+void
+unit_add_to_coldplug_queue(Unit *u)
+{
+	assert(u);
+
+	if (u->in_coldplug_queue)
+		return;
+
+	IWLIST_PREPEND(coldplug_queue, u->manager->coldplug_queue, u);
+	u->in_coldplug_queue = true;
+}
+
 int
 unit_add_default_target_dependency(Unit *u, Unit *target)
 {
@@ -181,6 +181,9 @@ struct Unit {
 	/* Queue of units with StopWhenUnneeded set that shell be checked for clean-up. */
 	IWLIST_FIELDS(Unit, stop_when_unneeded_queue);
 
+	/* Late coldplug queue */
+	IWLIST_FIELDS(Unit, coldplug_queue);
+
 	/* PIDs we keep an eye on. Note that a unit might have many
          * more, but these are the ones we care enough about to
          * process SIGCHLD for */
@@ -192,6 +195,11 @@ struct Unit {
 	/* Used during GC sweeps */
 	unsigned gc_marker;
 
+	/* If equal to the manager's GC generation, this unit was found to
+         * be needed through its referencing units and is not re-examined
+         * until something in that chain changes */
+	unsigned gc_generation;
+
 	/* When deserializing, temporarily store the job type for this
          * unit here, if there was a job scheduled.
          * Only for deserializing from a legacy version. New style uses full
@@ -255,6 +263,7 @@ struct Unit {
 	bool in_cgroup_queue: 1;
 	bool in_target_deps_queue: 1;
 	bool in_stop_when_unneeded_queue: 1;
+	bool in_coldplug_queue: 1;
 
 	bool sent_dbus_new_signal: 1;
 
@@ -453,6 +462,13 @@ struct UnitVTable {
          * to put the units into the initial state.  */
 	int (*enumerate)(Manager *m);
 
+	/* If lazy units are enabled, enumerate() may record objects in
+         * a side table instead of creating units for them. This is
+         * called when a unit of this type is requested by name, and
+         * should create the unit from the side table entry, if there
+         * is one. Returns > 0 if a unit was created. */
+	int (*materialize)(Manager *m, const char *name, Unit **ret);
+
 	/* Type specific cleanups. */
 	void (*shutdown)(Manager *m);
 
@@ -556,6 +572,7 @@ void unit_add_to_dbus_queue(Unit *u);
 void unit_add_to_cleanup_queue(Unit *u);
 void unit_add_to_gc_queue(Unit *u);
 void unit_add_to_target_deps_queue(Unit *u);
+void unit_add_to_coldplug_queue(Unit *u);
 void unit_add_to_stop_when_unneeded_queue(Unit *u);
 
 int unit_merge(Unit *u, Unit *other);
@@ -411,42 +411,47 @@ manager_get_user_by_pid(Manager *m, pid_t pid, User **user)
 int
 manager_get_idle_hint(Manager *m, dual_timestamp *t)
 {
-	Session *s;
-	bool idle_hint;
 	dual_timestamp ts = { 0, 0 };
-	Iterator i;
+	Session *s;
+	usec_t n;
+	int r;
 
 	assert(m);
 
-	idle_hint = !manager_is_inhibited(m, INHIBIT_IDLE, INHIBIT_BLOCK, t,
-		false, false, 0, NULL);
+	if (manager_is_inhibited(m, INHIBIT_IDLE, INHIBIT_BLOCK, t, false,
+		    false, 0, NULL))
+		return false;
 
-	HASHMAP_FOREACH (s, m->sessions, i) {
-		dual_timestamp k;
-		int ih;
+	/* The idle state of the sessions is kept up to date as they
+         * change, only sessions whose TTY might have been used since
+         * or has gone idle by now need to be looked at again */
+	n = now(CLOCK_MONOTONIC);
+	while ((s = prioq_peek(m->sessions_idle_recheck)) &&
+		s->idle_recheck <= n) {
+		r = session_update_idle(s);
+		if (r < 0)
+			return r;
+	}
 
-		ih = session_get_idle_hint(s, &k);
-		if (ih < 0)
-			return ih;
+	/* We are busy as long as any session is, since the earliest
+         * one became busy. Otherwise we are idle since the last
+         * session became idle. */
+	s = prioq_peek(m->sessions_busy);
+	if (s) {
+		if (t)
+			*t = s->idle_state_timestamp;
 
-		if (!ih) {
-			if (!idle_hint) {
-				if (k.monotonic < ts.monotonic)
-					ts = k;
-			} else {
-				idle_hint = false;
-				ts = k;
-			}
-		} else if (idle_hint) {
-			if (k.monotonic > ts.monotonic)
-				ts = k;
-		}
+		return false;
 	}
 
+	s = prioq_peek(m->sessions_idle);
+	if (s)
+		ts = s->idle_state_timestamp;
+
 	if (t)
 		*t = ts;
 
-	return idle_hint;
+	return true;
 }
 
 bool
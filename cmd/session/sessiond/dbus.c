@@ -522,6 +522,497 @@ method_list_seats(sd_bus *bus, sd_bus_message *message, void *userdata,
 	return sd_bus_send(bus, reply, NULL);
 }
 
+typedef struct ListFilter {
+	uid_t uid;
+	const char *seat;
+	SessionClass class;
+} ListFilter;
+
+static int
+list_filter_read(sd_bus_message *message, sd_bus_error *error, ListFilter *f)
+{
+	int r;
+
+	assert(message);
+	assert(f);
+
+	*f = (ListFilter){
+		.uid = UID_INVALID,
+		.class = _SESSION_CLASS_INVALID,
+	};
+
+	r = sd_bus_message_enter_container(message, 'a', "{sv}");
+	if (r < 0)
+		return r;
+
+	while ((r = sd_bus_message_enter_container(message, 'e', "sv")) > 0) {
+		const char *name, *class;
+		uint32_t uid;
+
+		r = sd_bus_message_read(message, "s", &name);
+		if (r < 0)
+			return r;
+
+		if (streq(name, "UID")) {
+			r = sd_bus_message_read(message, "v", "u", &uid);
+			if (r < 0)
+				return r;
+
+			f->uid = uid;
+		} else if (streq(name, "Seat")) {
+			r = sd_bus_message_read(message, "v", "s", &f->seat);
+			if (r < 0)
+				return r;
+		} else if (streq(name, "Class")) {
+			r = sd_bus_message_read(message, "v", "s", &class);
+			if (r < 0)
+				return r;
+
+			f->class = session_class_from_string(class);
+			if (f->class < 0)
+				return sd_bus_error_setf(error,
+					SD_BUS_ERROR_INVALID_ARGS,
+					"Invalid session class %s", class);
+		} else
+			return sd_bus_error_setf(error,
+				SD_BUS_ERROR_INVALID_ARGS,
+				"Unknown filter %s", name);
+
+		r = sd_bus_message_exit_container(message);
+		if (r < 0)
+			return r;
+	}
+	if (r < 0)
+		return r;
+
+	return sd_bus_message_exit_container(message);
+}
+
+static bool
+session_matches_filter(Session *s, const ListFilter *f)
+{
+	if (f->uid != UID_INVALID && s->user->uid != f->uid)
+		return false;
+
+	if (f->seat && !streq(s->seat ? s->seat->id : "", f->seat))
+		return false;
+
+	if (f->class >= 0 && s->class != f->class)
+		return false;
+
+	return true;
+}
+
+static bool
+user_matches_filter(User *u, const ListFilter *f)
+{
+	Session *s;
+
+	if (f->uid != UID_INVALID && u->uid != f->uid)
+		return false;
+
+	if (!f->seat && f->class < 0)
+		return true;
+
+	/* Users match if any of their sessions does */
+	IWLIST_FOREACH (sessions_by_user, s, u->sessions)
+		if (session_matches_filter(s, f))
+			return true;
+
+	return false;
+}
+
+static bool
+seat_matches_filter(Seat *seat, const ListFilter *f)
+{
+	Session *s;
+
+	if (f->seat && !streq(seat->id, f->seat))
+		return false;
+
+	if (f->uid == UID_INVALID && f->class < 0)
+		return true;
+
+	IWLIST_FOREACH (sessions_by_seat, s, seat->sessions)
+		if (session_matches_filter(s, f))
+			return true;
+
+	return false;
+}
+
+static int
+append_session_properties(sd_bus_message *reply, Session *s)
+{
+	dual_timestamp idle_since;
+	int idle_hint, r;
+
+	idle_hint = session_get_idle_hint(s, &idle_since);
+	if (idle_hint < 0)
+		return idle_hint;
+
+	r = sd_bus_message_open_container(reply, 'a', "{sv}");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply,
+		"{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}",
+		"Id", "s", s->id,
+		"User", "u", (uint32_t)s->user->uid,
+		"Name", "s", s->user->name,
+		"Seat", "s", s->seat ? s->seat->id : "",
+		"VTNr", "u", (uint32_t)s->vtnr,
+		"TTY", "s", strempty(s->tty),
+		"Display", "s", strempty(s->display),
+		"Remote", "b", s->remote,
+		"RemoteHost", "s", strempty(s->remote_host),
+		"RemoteUser", "s", strempty(s->remote_user),
+		"Service", "s", strempty(s->service),
+		"Desktop", "s", strempty(s->desktop));
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply,
+		"{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}",
+		"Scope", "s", strempty(s->scope),
+		"Leader", "u", (uint32_t)s->leader,
+		"Audit", "u", s->audit_id,
+		"Type", "s", session_type_to_string(s->type),
+		"Class", "s", session_class_to_string(s->class),
+		"Active", "b", session_is_active(s),
+		"State", "s", session_state_to_string(session_get_state(s)),
+		"IdleHint", "b", idle_hint > 0,
+		"IdleSinceHint", "t", idle_since.realtime,
+		"IdleSinceHintMonotonic", "t", idle_since.monotonic,
+		"LockedHint", "b", session_get_locked_hint(s) > 0,
+		"Timestamp", "t", s->timestamp.realtime,
+		"TimestampMonotonic", "t", s->timestamp.monotonic);
+	if (r < 0)
+		return r;
+
+	return sd_bus_message_close_container(reply);
+}
+
+static int
+append_user_properties(sd_bus_message *reply, User *u)
+{
+	dual_timestamp idle_since;
+	int idle_hint, r;
+	Session *s;
+
+	idle_hint = user_get_idle_hint(u, &idle_since);
+	if (idle_hint < 0)
+		return idle_hint;
+
+	r = sd_bus_message_open_container(reply, 'a', "{sv}");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply,
+		"{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}",
+		"UID", "u", (uint32_t)u->uid,
+		"GID", "u", (uint32_t)u->gid,
+		"Name", "s", u->name,
+		"Timestamp", "t", u->timestamp.realtime,
+		"TimestampMonotonic", "t", u->timestamp.monotonic,
+		"RuntimePath", "s", strempty(u->runtime_path),
+		"Service", "s", strempty(u->service),
+		"Slice", "s", strempty(u->slice),
+		"Display", "s", u->display ? u->display->id : "",
+		"State", "s", user_state_to_string(user_get_state(u)),
+		"IdleHint", "b", idle_hint > 0,
+		"IdleSinceHint", "t", idle_since.realtime,
+		"IdleSinceHintMonotonic", "t", idle_since.monotonic);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'e', "sv");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply, "s", "Sessions");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'v', "as");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "s");
+	if (r < 0)
+		return r;
+
+	IWLIST_FOREACH (sessions_by_user, s, u->sessions) {
+		r = sd_bus_message_append(reply, "s", s->id);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_message_close_container(reply);
+}
+
+static int
+append_seat_properties(sd_bus_message *reply, Seat *seat)
+{
+	dual_timestamp idle_since;
+	int idle_hint, r;
+	Session *s;
+
+	idle_hint = seat_get_idle_hint(seat, &idle_since);
+	if (idle_hint < 0)
+		return idle_hint;
+
+	r = sd_bus_message_open_container(reply, 'a', "{sv}");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply, "{sv}{sv}{sv}{sv}{sv}{sv}{sv}{sv}",
+		"Id", "s", seat->id,
+		"ActiveSession", "s", seat->active ? seat->active->id : "",
+		"CanMultiSession", "b", seat_can_multi_session(seat),
+		"CanTTY", "b", seat_can_tty(seat),
+		"CanGraphical", "b", seat_can_graphical(seat),
+		"IdleHint", "b", idle_hint > 0,
+		"IdleSinceHint", "t", idle_since.realtime,
+		"IdleSinceHintMonotonic", "t", idle_since.monotonic);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'e', "sv");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_append(reply, "s", "Sessions");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'v', "as");
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "s");
+	if (r < 0)
+		return r;
+
+	IWLIST_FOREACH (sessions_by_seat, s, seat->sessions) {
+		r = sd_bus_message_append(reply, "s", s->id);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_message_close_container(reply);
+}
+
+/* The Ex variants of the list calls return the properties commonly
+ * needed by clients inline, so that they do not have to query every
+ * object separately, and take an optional set of filters. */
+
+static int
+method_list_sessions_ex(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	Manager *m = userdata;
+	Session *session;
+	ListFilter filter;
+	Iterator i;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	r = list_filter_read(message, error, &filter);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(soa{sv})");
+	if (r < 0)
+		return r;
+
+	HASHMAP_FOREACH (session, m->sessions, i) {
+		_cleanup_free_ char *p = NULL;
+
+		if (!session->user || !session_matches_filter(session, &filter))
+			continue;
+
+		p = session_bus_path(session);
+		if (!p)
+			return -ENOMEM;
+
+		r = sd_bus_message_open_container(reply, 'r', "soa{sv}");
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_append(reply, "so", session->id, p);
+		if (r < 0)
+			return r;
+
+		r = append_session_properties(reply, session);
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_close_container(reply);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
+static int
+method_list_users_ex(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	Manager *m = userdata;
+	ListFilter filter;
+	User *user;
+	Iterator i;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	r = list_filter_read(message, error, &filter);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(uoa{sv})");
+	if (r < 0)
+		return r;
+
+	HASHMAP_FOREACH (user, m->users, i) {
+		_cleanup_free_ char *p = NULL;
+
+		if (!user_matches_filter(user, &filter))
+			continue;
+
+		p = user_bus_path(user);
+		if (!p)
+			return -ENOMEM;
+
+		r = sd_bus_message_open_container(reply, 'r', "uoa{sv}");
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_append(reply, "uo", (uint32_t)user->uid, p);
+		if (r < 0)
+			return r;
+
+		r = append_user_properties(reply, user);
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_close_container(reply);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
+static int
+method_list_seats_ex(sd_bus *bus, sd_bus_message *message, void *userdata,
+	sd_bus_error *error)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	Manager *m = userdata;
+	ListFilter filter;
+	Seat *seat;
+	Iterator i;
+	int r;
+
+	assert(bus);
+	assert(message);
+	assert(m);
+
+	r = list_filter_read(message, error, &filter);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_new_method_return(message, &reply);
+	if (r < 0)
+		return r;
+
+	r = sd_bus_message_open_container(reply, 'a', "(soa{sv})");
+	if (r < 0)
+		return r;
+
+	HASHMAP_FOREACH (seat, m->seats, i) {
+		_cleanup_free_ char *p = NULL;
+
+		if (!seat_matches_filter(seat, &filter))
+			continue;
+
+		p = seat_bus_path(seat);
+		if (!p)
+			return -ENOMEM;
+
+		r = sd_bus_message_open_container(reply, 'r', "soa{sv}");
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_append(reply, "so", seat->id, p);
+		if (r < 0)
+			return r;
+
+		r = append_seat_properties(reply, seat);
+		if (r < 0)
+			return r;
+
+		r = sd_bus_message_close_container(reply);
+		if (r < 0)
+			return r;
+	}
+
+	r = sd_bus_message_close_container(reply);
+	if (r < 0)
+		return r;
+
+	return sd_bus_send(bus, reply, NULL);
+}
+
 static int
 method_list_inhibitors(sd_bus *bus, sd_bus_message *message, void *userdata,
 	sd_bus_error *error)
@@ -2191,6 +2682,12 @@ const sd_bus_vtable manager_vtable[] = { SD_BUS_VTABLE_START(0),
 		SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ListSeats", NULL, "a(so)", method_list_seats,
 		SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ListSessionsEx", "a{sv}", "a(soa{sv})",
+		method_list_sessions_ex, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ListUsersEx", "a{sv}", "a(uoa{sv})",
+		method_list_users_ex, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ListSeatsEx", "a{sv}", "a(soa{sv})",
+		method_list_seats_ex, SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("ListInhibitors", NULL, "a(ssssuu)",
 		method_list_inhibitors, SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_METHOD("CreateSession", "uusssssussbssa(sv)", "soshusub",
@@ -2621,14 +3118,20 @@ manager_start_slice(Manager *manager, const char *slice,
 int
 manager_start_scope(Manager *manager, const char *scope, pid_t pid,
 	const char *slice, const char *description, const char *after,
-	const char *after2, uint64_t tasks_max, sd_bus_error *error, char **job)
+	const char *after2, uint64_t tasks_max,
+	sd_bus_message_handler_t callback, void *userdata, sd_bus_slot **slot)
 {
-	_cleanup_bus_message_unref_ sd_bus_message *m = NULL, *reply = NULL;
+	_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
 	int r;
 
 	assert(manager);
 	assert(scope);
 	assert(pid > 1);
+	assert(callback);
+
+	/* Unlike the other calls to the service manager this one does
+         * not wait for the reply: it is issued for every new session,
+         * and a login storm should not be serialized on it. */
 
 	r = sd_bus_message_new_method_call(manager->bus, &m, SVC_DBUS_BUSNAME,
 		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
@@ -2696,25 +3199,10 @@ manager_start_scope(Manager *manager, const char *scope, pid_t pid,
 	if (r < 0)
 		return r;
 
-	r = sd_bus_call(manager->bus, m, 0, error, &reply);
+	r = sd_bus_call_async(manager->bus, slot, m, callback, userdata, 0);
 	if (r < 0)
 		return r;
 
-	if (job) {
-		const char *j;
-		char *copy;
-
-		r = sd_bus_message_read(reply, "o", &j);
-		if (r < 0)
-			return r;
-
-		copy = strdup(j);
-		if (!copy)
-			return -ENOMEM;
-
-		*job = copy;
-	}
-
 	return 1;
 }
 
@@ -74,7 +74,7 @@ device_detach(Device *d)
 
 	if (!seat_has_master_device(s)) {
 		seat_add_to_gc_queue(s);
-		seat_send_changed(s, "CanGraphical", NULL);
+		seat_can_graphical_changed(s);
 	}
 }
 
@@ -128,5 +128,5 @@ device_attach(Device *d, Seat *s)
 	}
 
 	if (!had_master && d->master)
-		seat_send_changed(s, "CanGraphical", NULL);
+		seat_can_graphical_changed(s);
 }
@@ -59,11 +59,80 @@ inhibitor_new(Manager *m, const char *id)
 	return i;
 }
 
+static int
+inhibitor_compare(const void *a, const void *b)
+{
+	const Inhibitor *x = a, *y = b;
+
+	if (x->since.monotonic < y->since.monotonic)
+		return -1;
+	if (x->since.monotonic > y->since.monotonic)
+		return 1;
+
+	return 0;
+}
+
+static void
+inhibitor_unindex(Inhibitor *i)
+{
+	unsigned k;
+
+	if (!i->indexed)
+		return;
+
+	for (k = 0; k < INHIBIT_WHAT_BITS; k++)
+		if (i->what & (1 << k))
+			prioq_remove(i->manager->inhibitors_by_what[i->mode][k],
+				i, &i->since_idx[k]);
+
+	i->indexed = false;
+}
+
+static int
+inhibitor_index(Inhibitor *i)
+{
+	unsigned k;
+	int r;
+
+	assert(i->mode >= 0 && i->mode < _INHIBIT_MODE_MAX);
+
+	if (i->indexed)
+		return 0;
+
+	for (k = 0; k < INHIBIT_WHAT_BITS; k++)
+		i->since_idx[k] = PRIOQ_IDX_NULL;
+
+	i->indexed = true;
+
+	for (k = 0; k < INHIBIT_WHAT_BITS; k++) {
+		Prioq **q = &i->manager->inhibitors_by_what[i->mode][k];
+
+		if (!(i->what & (1 << k)))
+			continue;
+
+		r = prioq_ensure_allocated(q, inhibitor_compare);
+		if (r < 0)
+			goto fail;
+
+		r = prioq_put(*q, i, &i->since_idx[k]);
+		if (r < 0)
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	/* prioq_remove() skips queues we did not get to */
+	inhibitor_unindex(i);
+	return r;
+}
+
 void
 inhibitor_free(Inhibitor *i)
 {
 	assert(i);
 
+	inhibitor_unindex(i);
 	hashmap_remove(i->manager->inhibitors, i->id);
 
 	inhibitor_remove_fifo(i);
@@ -156,6 +225,9 @@ inhibitor_start(Inhibitor *i)
 
 	dual_timestamp_get(&i->since);
 
+	if (inhibitor_index(i) < 0)
+		return log_oom();
+
 	log_debug("Inhibitor %s (%s) pid=" PID_FMT " uid=" UID_FMT
 		  " mode=%s started.",
 		strna(i->who), strna(i->why), i->pid, i->uid,
@@ -186,6 +258,7 @@ inhibitor_stop(Inhibitor *i)
 	if (i->state_file)
 		unlink(i->state_file);
 
+	inhibitor_unindex(i);
 	i->started = false;
 
 	manager_send_changed(i->manager,
@@ -344,15 +417,14 @@ inhibitor_remove_fifo(Inhibitor *i)
 InhibitWhat
 manager_inhibit_what(Manager *m, InhibitMode mm)
 {
-	Inhibitor *i;
-	Iterator j;
 	InhibitWhat what = 0;
+	unsigned k;
 
 	assert(m);
 
-	HASHMAP_FOREACH (i, m->inhibitors, j)
-		if (i->mode == mm)
-			what |= i->what;
+	for (k = 0; k < INHIBIT_WHAT_BITS; k++)
+		if (!prioq_isempty(m->inhibitors_by_what[mm][k]))
+			what |= 1 << k;
 
 	return what;
 }
@@ -384,11 +456,49 @@ manager_is_inhibited(Manager *m, InhibitWhat w, InhibitMode mm,
 	Iterator j;
 	struct dual_timestamp ts = { 0, 0 };
 	bool inhibited = false;
+	unsigned k;
 
 	assert(m);
 	assert(w > 0 && w < _INHIBIT_WHAT_MAX);
 
+	if (!(manager_inhibit_what(m, mm) & w)) {
+		if (since)
+			*since = ts;
+
+		return false;
+	}
+
+	/* Without filters, the oldest inhibitor of each bit is all we
+         * need to look at */
+	if (!ignore_inactive && !ignore_uid) {
+		for (k = 0; k < INHIBIT_WHAT_BITS; k++) {
+			if (!(w & (1 << k)))
+				continue;
+
+			i = prioq_peek(m->inhibitors_by_what[mm][k]);
+			if (!i)
+				continue;
+
+			if (!inhibited || i->since.monotonic < ts.monotonic) {
+				ts = i->since;
+
+				if (offending)
+					*offending = i;
+			}
+
+			inhibited = true;
+		}
+
+		if (since)
+			*since = ts;
+
+		return inhibited;
+	}
+
 	HASHMAP_FOREACH (i, m->inhibitors, j) {
+		if (!i->indexed)
+			continue;
+
 		if (!(i->what & w))
 			continue;
 
@@ -36,6 +36,10 @@ typedef enum InhibitWhat {
 	_INHIBIT_WHAT_INVALID = -1
 } InhibitWhat;
 
+/* One bit per kind of inhibitor, _INHIBIT_WHAT_MAX being the next one */
+#define INHIBIT_WHAT_BITS __builtin_ctz(_INHIBIT_WHAT_MAX)
+assert_cc(1 << INHIBIT_WHAT_BITS == _INHIBIT_WHAT_MAX);
+
 typedef enum InhibitMode {
 	INHIBIT_BLOCK,
 	INHIBIT_DELAY,
@@ -68,6 +72,11 @@ struct Inhibitor {
 
 	char *fifo_path;
 	int fifo_fd;
+
+	/* Position in the manager's queues of started inhibitors, one
+         * per bit of what */
+	bool indexed;
+	unsigned since_idx[INHIBIT_WHAT_BITS];
 };
 
 Inhibitor *inhibitor_new(Manager *m, const char *id);
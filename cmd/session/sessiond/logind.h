@@ -25,6 +25,8 @@
 #include "bsdcapability.h"
 #include "hashmap.h"
 #include "list.h"
+#include "login-snapshot.h"
+#include "prioq.h"
 #include "sd-bus.h"
 #include "sd-event.h"
 #include "set.h"
@@ -49,6 +51,9 @@ struct udev_device;
 #define IGNORE_LID_SWITCH_STARTUP_USEC (3 * USEC_PER_MINUTE)
 #define IGNORE_LID_SWITCH_SUSPEND_USEC (30 * USEC_PER_SEC)
 
+/* How long the atime of session TTYs is cached */
+#define IDLE_HINT_REFRESH_USEC (10 * USEC_PER_SEC)
+
 struct Manager {
 	sd_event *event;
 	sd_bus *bus;
@@ -60,12 +65,22 @@ struct Manager {
 	Hashmap *inhibitors;
 	Hashmap *buttons;
 
+	/* Started inhibitors by mode and bit of what, oldest first */
+	Prioq *inhibitors_by_what[_INHIBIT_MODE_MAX][INHIBIT_WHAT_BITS];
+
 	Set *busnames;
 
 	IWLIST_HEAD(Seat, seat_gc_queue);
 	IWLIST_HEAD(Session, session_gc_queue);
 	IWLIST_HEAD(User, user_gc_queue);
 
+	/* Objects whose state files need to be written */
+	IWLIST_HEAD(Seat, seat_save_queue);
+	IWLIST_HEAD(Session, session_save_queue);
+	IWLIST_HEAD(User, user_save_queue);
+	unsigned long n_state_writes;
+	unsigned long n_state_writes_saved;
+
 #ifdef SVC_USE_libudev
 	struct udev *udev;
 	struct udev_monitor *udev_seat_monitor, *udev_device_monitor,
@@ -77,6 +92,9 @@ struct Manager {
 	sd_event_source *udev_button_event_source;
 #endif
 
+	/* Set while a batch of udev events is processed */
+	bool udev_batch;
+
 	sd_event_source *console_active_event_source;
 	int console_active_fd;
 
@@ -117,6 +135,14 @@ struct Manager {
 	usec_t idle_action_not_before_usec;
 	HandleAction idle_action;
 
+	/* Started sessions by idle state, from which the combined idle
+         * hint is taken: busy ones earliest busy first, idle ones
+         * latest idle first. Sessions whose state depends on their
+         * TTY are also queued by when to look at it again. */
+	Prioq *sessions_busy;
+	Prioq *sessions_idle;
+	Prioq *sessions_idle_recheck;
+
 	HandleAction handle_power_key;
 	HandleAction handle_suspend_key;
 	HandleAction handle_hibernate_key;
@@ -136,6 +162,14 @@ struct Manager {
 
 	size_t runtime_dir_size;
 	uint64_t user_tasks_max;
+
+	/* Set when the snapshot of all state files needs to be written */
+	bool snapshot_dirty;
+	uint64_t snapshot_generation;
+
+	/* The snapshot left behind by the previous instance, only
+         * while state is restored at startup */
+	LoginSnapshot *restore_snapshot;
 };
 
 Manager *manager_new(void);
@@ -161,6 +195,12 @@ int manager_spawn_autovt(Manager *m, unsigned int vtnr);
 
 void manager_gc(Manager *m, bool drop_not_started);
 
+void manager_snapshot_update(Manager *m, const char *state_file,
+	char ***fields, ino_t *inode);
+void manager_snapshot_drop(Manager *m, char ***fields);
+int manager_parse_state(Manager *m, LoginSnapshotKind kind, const char *name,
+	const char *state_file, ...) _sentinel_;
+
 bool manager_shall_kill(Manager *m, const char *user);
 
 int manager_get_idle_hint(Manager *m, dual_timestamp *t);
@@ -198,8 +238,8 @@ int manager_start_slice(Manager *manager, const char *slice,
 	uint64_t tasks_max, sd_bus_error *error, char **job);
 int manager_start_scope(Manager *manager, const char *scope, pid_t pid,
 	const char *slice, const char *description, const char *after,
-	const char *after2, uint64_t tasks_max, sd_bus_error *error,
-	char **job);
+	const char *after2, uint64_t tasks_max,
+	sd_bus_message_handler_t callback, void *userdata, sd_bus_slot **slot);
 int manager_start_unit(Manager *manager, const char *unit, sd_bus_error *error,
 	char **job);
 int manager_stop_unit(Manager *manager, const char *unit, sd_bus_error *error,
@@ -481,6 +481,8 @@ seat_send_signal(Seat *s, bool new_seat)
 
 	assert(s);
 
+	seat_save_pending(s);
+
 	p = seat_bus_path(s);
 	if (!p)
 		return -ENOMEM;
@@ -501,6 +503,8 @@ seat_send_changed(Seat *s, const char *properties, ...)
 	if (!s->started)
 		return 0;
 
+	seat_save_pending(s);
+
 	p = seat_bus_path(s);
 	if (!p)
 		return -ENOMEM;
@@ -66,6 +66,16 @@ seat_new(Manager *m, const char *id)
 	return s;
 }
 
+static void
+seat_remove_from_save_queue(Seat *s)
+{
+	if (!s->in_save_queue)
+		return;
+
+	IWLIST_REMOVE(save_queue, s->manager->seat_save_queue, s);
+	s->in_save_queue = false;
+}
+
 void
 seat_free(Seat *s)
 {
@@ -86,6 +96,8 @@ seat_free(Seat *s)
 
 	hashmap_remove(s->manager->seats, s->id);
 
+	seat_remove_from_save_queue(s);
+	manager_snapshot_drop(s->manager, &s->state_fields);
 	free(s->positions);
 	free(s->state_file);
 	free(s);
@@ -93,6 +105,40 @@ seat_free(Seat *s)
 
 int
 seat_save(Seat *s)
+{
+	assert(s);
+
+	/* The state file is written once per main loop iteration, no
+         * matter how often it changes within it */
+
+	if (s->in_save_queue) {
+		s->manager->n_state_writes_saved++;
+		return 0;
+	}
+
+	IWLIST_PREPEND(save_queue, s->manager->seat_save_queue, s);
+	s->in_save_queue = true;
+
+	return 0;
+}
+
+int
+seat_save_pending(Seat *s)
+{
+	assert(s);
+
+	/* Clients read the state file as soon as they see one of our
+         * signals, so it has to be written out before we send one */
+
+	if (!s->in_save_queue)
+		return 0;
+
+	s->manager->n_state_writes++;
+	return seat_save_now(s);
+}
+
+int
+seat_save_now(Seat *s)
 {
 	_cleanup_free_ char *temp_path = NULL;
 	_cleanup_fclose_ FILE *f = NULL;
@@ -100,6 +146,8 @@ seat_save(Seat *s)
 
 	assert(s);
 
+	seat_remove_from_save_queue(s);
+
 	if (!s->started)
 		return 0;
 
@@ -152,7 +200,10 @@ seat_save(Seat *s)
 		r = -errno;
 		unlink(s->state_file);
 		unlink(temp_path);
-	}
+		manager_snapshot_drop(s->manager, &s->state_fields);
+	} else
+		manager_snapshot_update(s->manager, s->state_file,
+			&s->state_fields, &s->state_inode);
 
 finish:
 	if (r < 0)
@@ -254,6 +305,19 @@ seat_set_active(Seat *s, Session *session)
 	old_active = s->active;
 	s->active = session;
 
+	seat_save(s);
+
+	if (session) {
+		session_save(session);
+		user_save(session->user);
+	}
+
+	if (old_active) {
+		session_save(old_active);
+		if (!session || session->user != old_active->user)
+			user_save(old_active->user);
+	}
+
 	if (old_active) {
 #ifdef SVC_HAVE_libudev
 		session_device_pause_all(old_active);
@@ -273,19 +337,6 @@ seat_set_active(Seat *s, Session *session)
 	if (!session || session->started)
 		seat_send_changed(s, "ActiveSession", NULL);
 
-	seat_save(s);
-
-	if (session) {
-		session_save(session);
-		user_save(session->user);
-	}
-
-	if (old_active) {
-		session_save(old_active);
-		if (!session || session->user != old_active->user)
-			user_save(old_active->user);
-	}
-
 	return 0;
 }
 
@@ -477,7 +528,9 @@ seat_stop(Seat *s, bool force)
 
 	seat_stop_sessions(s, force);
 
+	seat_remove_from_save_queue(s);
 	unlink(s->state_file);
+	manager_snapshot_drop(s->manager, &s->state_fields);
 	seat_add_to_gc_queue(s);
 
 	if (s->started)
@@ -645,6 +698,22 @@ seat_has_master_device(Seat *s)
 	return !!s->devices && s->devices->master;
 }
 
+void
+seat_can_graphical_changed(Seat *s)
+{
+	assert(s);
+
+	/* During a batch of udev events, only note the change, and let
+         * the manager send one signal at the end */
+	if (s->manager->udev_batch) {
+		s->can_graphical_changed = true;
+		return;
+	}
+
+	s->can_graphical_changed = false;
+	seat_send_changed(s, "CanGraphical", NULL);
+}
+
 bool
 seat_can_graphical(Seat *s)
 {
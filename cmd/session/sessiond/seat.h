@@ -32,6 +32,8 @@ struct Seat {
 	char *id;
 
 	char *state_file;
+	char **state_fields; /* As last written, for the snapshot */
+	ino_t state_inode;
 
 	IWLIST_HEAD(Device, devices);
 
@@ -43,15 +45,20 @@ struct Seat {
 	size_t position_count;
 
 	bool in_gc_queue: 1;
+	bool in_save_queue: 1;
 	bool started: 1;
+	bool can_graphical_changed: 1;
 
 	IWLIST_FIELDS(Seat, gc_queue);
+	IWLIST_FIELDS(Seat, save_queue);
 };
 
 Seat *seat_new(Manager *m, const char *id);
 void seat_free(Seat *s);
 
 int seat_save(Seat *s);
+int seat_save_now(Seat *s);
+int seat_save_pending(Seat *s);
 int seat_load(Seat *s);
 
 int seat_apply_acls(Seat *s, Session *old_active);
@@ -96,3 +103,4 @@ char *seat_bus_path(Seat *s);
 
 int seat_send_signal(Seat *s, bool new_seat);
 int seat_send_changed(Seat *s, const char *properties, ...) _sentinel_;
+void seat_can_graphical_changed(Seat *s);
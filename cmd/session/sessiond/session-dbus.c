@@ -730,6 +730,8 @@ session_send_signal(Session *s, bool new_session)
 
 	assert(s);
 
+	session_save_pending(s);
+
 	p = session_bus_path(s);
 	if (!p)
 		return -ENOMEM;
@@ -750,6 +752,8 @@ session_send_changed(Session *s, const char *properties, ...)
 	if (!s->started)
 		return 0;
 
+	session_save_pending(s);
+
 	p = session_bus_path(s);
 	if (!p)
 		return -ENOMEM;
@@ -813,7 +817,7 @@ session_send_create_reply(Session *s, sd_bus_error *error)
 		return 0;
 
 	if (!sd_bus_error_is_set(error) &&
-		(s->scope_job || s->user->service_job))
+		(s->scope_slot || s->scope_job || s->user->service_job))
 		return 0;
 
 	c = s->create_message;
@@ -828,7 +832,7 @@ session_send_create_reply(Session *s, sd_bus_error *error)
 
 	/* Update the session state file before we notify the client
          * about the result. */
-	session_save(s);
+	session_save_now(s);
 
 	p = session_bus_path(s);
 	if (!p)
@@ -87,6 +87,137 @@ session_new(Manager *m, const char *id)
 	return s;
 }
 
+static void
+session_remove_from_save_queue(Session *s)
+{
+	if (!s->in_save_queue)
+		return;
+
+	IWLIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+	s->in_save_queue = false;
+}
+
+static int
+session_compare_busy(const void *a, const void *b)
+{
+	const Session *x = a, *y = b;
+
+	if (x->idle_state_timestamp.monotonic <
+		y->idle_state_timestamp.monotonic)
+		return -1;
+	if (x->idle_state_timestamp.monotonic >
+		y->idle_state_timestamp.monotonic)
+		return 1;
+
+	return 0;
+}
+
+static int
+session_compare_idle(const void *a, const void *b)
+{
+	return session_compare_busy(b, a);
+}
+
+static int
+session_compare_idle_recheck(const void *a, const void *b)
+{
+	const Session *x = a, *y = b;
+
+	if (x->idle_recheck < y->idle_recheck)
+		return -1;
+	if (x->idle_recheck > y->idle_recheck)
+		return 1;
+
+	return 0;
+}
+
+static void
+session_untrack_idle(Session *s)
+{
+	Manager *m = s->manager;
+
+	if (!s->idle_tracked)
+		return;
+
+	prioq_remove(s->idle_state ? m->sessions_idle : m->sessions_busy, s,
+		&s->idle_state_idx);
+	prioq_remove(m->sessions_idle_recheck, s, &s->idle_recheck_idx);
+
+	s->idle_tracked = false;
+}
+
+int
+session_update_idle(Session *s)
+{
+	Manager *m;
+	dual_timestamp k;
+	Prioq **q;
+	usec_t n;
+	int ih, r;
+
+	assert(s);
+
+	m = s->manager;
+
+	/* Files the current idle state of the session in the manager's
+         * queues, so that manager_get_idle_hint() only has to look at
+         * the sessions that changed */
+
+	session_untrack_idle(s);
+
+	ih = session_get_idle_hint(s, &k);
+	if (ih < 0)
+		return ih;
+
+	s->idle_state = ih;
+	s->idle_state_timestamp = k;
+	s->idle_recheck = USEC_INFINITY;
+
+	/* Without an explicit hint, the TTY might be used any time,
+         * and a busy TTY becomes idle at some point */
+	if (!s->idle_hint && !s->display) {
+		n = now(CLOCK_MONOTONIC);
+
+		s->idle_recheck = s->tty_atime_checked + IDLE_HINT_REFRESH_USEC;
+		if (!ih && s->tty_atime > 0 && m->idle_action_usec > 0 &&
+			k.monotonic + m->idle_action_usec > n)
+			s->idle_recheck = MIN(s->idle_recheck,
+				k.monotonic + m->idle_action_usec);
+	}
+
+	s->idle_state_idx = s->idle_recheck_idx = PRIOQ_IDX_NULL;
+	s->idle_tracked = true;
+
+	q = ih ? &m->sessions_idle : &m->sessions_busy;
+	r = prioq_ensure_allocated(q,
+		ih ? session_compare_idle : session_compare_busy);
+	if (r < 0)
+		goto fail;
+
+	r = prioq_put(*q, s, &s->idle_state_idx);
+	if (r < 0)
+		goto fail;
+
+	if (s->idle_recheck != USEC_INFINITY) {
+		r = prioq_ensure_allocated(&m->sessions_idle_recheck,
+			session_compare_idle_recheck);
+		if (r < 0)
+			goto fail;
+
+		r = prioq_put(m->sessions_idle_recheck, s,
+			&s->idle_recheck_idx);
+		if (r < 0)
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	/* prioq_remove() skips queues we did not get to */
+	session_untrack_idle(s);
+	return r;
+}
+
 void
 session_free(Session *s)
 {
@@ -133,6 +264,7 @@ session_free(Session *s)
 	}
 
 	free(s->scope_job);
+	sd_bus_slot_unref(s->scope_slot);
 
 	sd_bus_message_unref(s->create_message);
 
@@ -144,7 +276,10 @@ session_free(Session *s)
 	free(s->desktop);
 
 	hashmap_remove(s->manager->sessions, s->id);
+	session_untrack_idle(s);
 
+	session_remove_from_save_queue(s);
+	manager_snapshot_drop(s->manager, &s->state_fields);
 	free(s->state_file);
 	free(s);
 }
@@ -161,6 +296,40 @@ session_set_user(Session *s, User *u)
 
 int
 session_save(Session *s)
+{
+	assert(s);
+
+	/* The state file is written once per main loop iteration, no
+         * matter how often it changes within it */
+
+	if (s->in_save_queue) {
+		s->manager->n_state_writes_saved++;
+		return 0;
+	}
+
+	IWLIST_PREPEND(save_queue, s->manager->session_save_queue, s);
+	s->in_save_queue = true;
+
+	return 0;
+}
+
+int
+session_save_pending(Session *s)
+{
+	assert(s);
+
+	/* Clients read the state file as soon as they see one of our
+         * signals, so it has to be written out before we send one */
+
+	if (!s->in_save_queue)
+		return 0;
+
+	s->manager->n_state_writes++;
+	return session_save_now(s);
+}
+
+int
+session_save_now(Session *s)
 {
 	_cleanup_free_ char *temp_path = NULL;
 	_cleanup_fclose_ FILE *f = NULL;
@@ -168,6 +337,8 @@ session_save(Session *s)
 
 	assert(s);
 
+	session_remove_from_save_queue(s);
+
 	if (!s->user)
 		return -ESTALE;
 
@@ -296,7 +467,10 @@ session_save(Session *s)
 		r = -errno;
 		unlink(s->state_file);
 		unlink(temp_path);
-	}
+		manager_snapshot_drop(s->manager, &s->state_fields);
+	} else
+		manager_snapshot_update(s->manager, s->state_file,
+			&s->state_fields, &s->state_inode);
 
 finish:
 	if (r < 0)
@@ -319,9 +493,10 @@ session_load(Session *s)
 
 	assert(s);
 
-	r = parse_env_file(s->state_file, NEWLINE, "REMOTE", &remote, "SCOPE",
-		&s->scope, "SCOPE_JOB", &s->scope_job, "FIFO", &s->fifo_path,
-		"SEAT", &seat, "TTY", &s->tty, "DISPLAY", &s->display,
+	r = manager_parse_state(s->manager, LOGIN_SNAPSHOT_SESSION, s->id,
+		s->state_file, "REMOTE", &remote, "SCOPE", &s->scope,
+		"SCOPE_JOB", &s->scope_job, "FIFO", &s->fifo_path, "SEAT",
+		&seat, "TTY", &s->tty, "DISPLAY", &s->display,
 		"REMOTE_HOST", &s->remote_host, "REMOTE_USER", &s->remote_user,
 		"SERVICE", &s->service, "DESKTOP", &s->desktop, "VTNR", &vtnr,
 		"STATE", &state, "POS", &pos, "LEADER", &leader, "TYPE", &type,
@@ -497,6 +672,103 @@ session_activate(Session *s)
 	return 0;
 }
 
+static void
+session_start_finish(Session *s)
+{
+	assert(s);
+
+	log_struct(s->class == SESSION_BACKGROUND ? LOG_DEBUG : LOG_INFO,
+		LOG_MESSAGE_ID(SD_MESSAGE_SESSION_START), "SESSION_ID=%s",
+		s->id, "USER_ID=%s", s->user->name, "LEADER=" PID_FMT,
+		s->leader,
+		LOG_MESSAGE("New session %s of user %s.", s->id, s->user->name),
+		NULL);
+
+	if (!dual_timestamp_is_set(&s->timestamp))
+		dual_timestamp_get(&s->timestamp);
+
+	if (s->seat)
+		seat_read_active_vt(s->seat);
+
+	s->started = true;
+	session_update_idle(s);
+
+	user_elect_display(s->user);
+
+	/* Save data */
+	session_save(s);
+	user_save(s->user);
+	if (s->seat)
+		seat_save(s->seat);
+
+	/* Send signals */
+	session_send_signal(s, true);
+	user_send_changed(s->user, "Sessions", "Display", NULL);
+	if (s->seat) {
+		if (s->seat->active == s)
+			seat_send_changed(s->seat, "Sessions", "ActiveSession",
+				NULL);
+		else
+			seat_send_changed(s->seat, "Sessions", NULL);
+	}
+}
+
+static int
+session_start_scope_reply(sd_bus *bus, sd_bus_message *reply, void *userdata,
+	sd_bus_error *ret_error)
+{
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	Session *s = userdata;
+	const sd_bus_error *e;
+	const char *job;
+	int r;
+
+	assert(reply);
+	assert(s);
+
+	s->scope_slot = sd_bus_slot_unref(s->scope_slot);
+
+	e = sd_bus_message_get_error(reply);
+	if (e) {
+		r = sd_bus_error_get_errno(e);
+		log_error_errno(r, "Failed to start session scope %s: %s",
+			s->scope, bus_error_message(e, r));
+		sd_bus_error_copy(&error, e);
+		goto fail;
+	}
+
+	r = sd_bus_message_read(reply, "o", &job);
+	if (r < 0) {
+		bus_log_parse_error(r);
+		sd_bus_error_set_errno(&error, r);
+		goto fail;
+	}
+
+	r = free_and_strdup(&s->scope_job, job);
+	if (r < 0) {
+		log_oom();
+		sd_bus_error_set_errno(&error, r);
+		goto fail;
+	}
+
+	/* Only now that the scope is underway the session is
+         * announced */
+	session_start_finish(s);
+
+	return 0;
+
+fail:
+	/* The session was never announced, so it just goes away
+         * again */
+	hashmap_remove(s->manager->session_units, s->scope);
+	free(s->scope);
+	s->scope = NULL;
+
+	session_send_create_reply(s, &error);
+	session_add_to_gc_queue(s);
+	return 0;
+}
+
 static int
 session_start_scope(Session *s)
 {
@@ -506,8 +778,7 @@ session_start_scope(Session *s)
 	assert(s->user);
 
 	if (!s->scope) {
-		_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-		char *scope, *job = NULL;
+		char *scope;
 		const char *description;
 
 		scope = strjoin("session-", s->id, ".scope", NULL);
@@ -517,23 +788,20 @@ session_start_scope(Session *s)
 		description = strjoina("Session ", s->id, " of user ",
 			s->user->name, NULL);
 
+		/* The job is filled in by session_start_scope_reply() */
 		r = manager_start_scope(s->manager, scope, s->leader,
 			s->user->slice, description, "systemd-logind.service",
 			"systemd-user-sessions.service",
 			(uint64_t)-1, /* disable TasksMax= for the scope, rely on the slice setting for it */
-			&error, &job);
+			session_start_scope_reply, s, &s->scope_slot);
 		if (r < 0) {
 			log_error_errno(r,
-				"Failed to start session scope %s: %s", scope,
-				bus_error_message(&error, r));
+				"Failed to start session scope %s: %m", scope);
 			free(scope);
 			return r;
-		} else {
-			s->scope = scope;
-
-			free(s->scope_job);
-			s->scope_job = job;
 		}
+
+		s->scope = scope;
 	}
 
 	if (s->scope)
@@ -552,7 +820,7 @@ session_start(Session *s)
 	if (!s->user)
 		return -ESTALE;
 
-	if (s->started)
+	if (s->started || s->scope_slot)
 		return 0;
 
 	r = user_start(s->user);
@@ -564,39 +832,10 @@ session_start(Session *s)
 	if (r < 0)
 		return r;
 
-	log_struct(s->class == SESSION_BACKGROUND ? LOG_DEBUG : LOG_INFO,
-		LOG_MESSAGE_ID(SD_MESSAGE_SESSION_START), "SESSION_ID=%s",
-		s->id, "USER_ID=%s", s->user->name, "LEADER=" PID_FMT,
-		s->leader,
-		LOG_MESSAGE("New session %s of user %s.", s->id, s->user->name),
-		NULL);
-
-	if (!dual_timestamp_is_set(&s->timestamp))
-		dual_timestamp_get(&s->timestamp);
-
-	if (s->seat)
-		seat_read_active_vt(s->seat);
-
-	s->started = true;
-
-	user_elect_display(s->user);
-
-	/* Save data */
-	session_save(s);
-	user_save(s->user);
-	if (s->seat)
-		seat_save(s->seat);
-
-	/* Send signals */
-	session_send_signal(s, true);
-	user_send_changed(s->user, "Sessions", "Display", NULL);
-	if (s->seat) {
-		if (s->seat->active == s)
-			seat_send_changed(s->seat, "Sessions", "ActiveSession",
-				NULL);
-		else
-			seat_send_changed(s->seat, "Sessions", NULL);
-	}
+	/* If the scope is still being created, the session is started
+         * by session_start_scope_reply() once that succeeded */
+	if (!s->scope_slot)
+		session_start_finish(s);
 
 	return 0;
 }
@@ -690,7 +929,9 @@ session_finalize(Session *s)
 		session_device_free(sd);
 #endif
 
+	session_remove_from_save_queue(s);
 	unlink(s->state_file);
+	manager_snapshot_drop(s->manager, &s->state_fields);
 	session_add_to_gc_queue(s);
 	user_add_to_gc_queue(s->user);
 
@@ -797,6 +1038,43 @@ get_process_ctty_atime(pid_t pid, usec_t *atime)
 	return get_tty_atime(p, atime);
 }
 
+static int
+session_get_tty_atime(Session *s, usec_t *atime)
+{
+	usec_t n;
+	int r = -ENOENT;
+
+	assert(s);
+	assert(atime);
+
+	/* With many sessions, stat()ing all their TTYs on every query
+         * adds up, hence cache the result for a while */
+	n = now(CLOCK_MONOTONIC);
+	if (s->tty_atime_checked > 0 &&
+		n < s->tty_atime_checked + IDLE_HINT_REFRESH_USEC) {
+		if (s->tty_atime <= 0)
+			return -ENODATA;
+
+		*atime = s->tty_atime;
+		return 0;
+	}
+
+	/* For sessions with an explicitly configured tty, let's check
+         * its atime */
+	if (s->tty)
+		r = get_tty_atime(s->tty, atime);
+
+	/* For sessions with a leader but no explicitly configured
+         * tty, let's check the controlling tty of the leader */
+	if (r < 0 && s->leader > 0)
+		r = get_process_ctty_atime(s->leader, atime);
+
+	s->tty_atime = r < 0 ? 0 : *atime;
+	s->tty_atime_checked = n;
+
+	return r;
+}
+
 int
 session_get_idle_hint(Session *s, dual_timestamp *t)
 {
@@ -818,21 +1096,9 @@ session_get_idle_hint(Session *s, dual_timestamp *t)
 	if (s->display)
 		goto dont_know;
 
-	/* For sessions with an explicitly configured tty, let's check
-         * its atime */
-	if (s->tty) {
-		r = get_tty_atime(s->tty, &atime);
-		if (r >= 0)
-			goto found_atime;
-	}
-
-	/* For sessions with a leader but no explicitly configured
-         * tty, let's check the controlling tty of the leader */
-	if (s->leader > 0) {
-		r = get_process_ctty_atime(s->leader, &atime);
-		if (r >= 0)
-			goto found_atime;
-	}
+	r = session_get_tty_atime(s, &atime);
+	if (r >= 0)
+		goto found_atime;
 
 dont_know:
 	if (t)
@@ -863,6 +1129,9 @@ session_set_idle_hint(Session *s, bool b)
 	s->idle_hint = b;
 	dual_timestamp_get(&s->idle_hint_timestamp);
 
+	if (s->started)
+		session_update_idle(s);
+
 	session_send_changed(s, "IdleHint", "IdleSinceHint",
 		"IdleSinceHintMonotonic", NULL);
 
@@ -986,7 +1255,7 @@ session_check_gc(Session *s, bool drop_not_started)
 {
 	assert(s);
 
-	if (drop_not_started && !s->started)
+	if (drop_not_started && !s->started && !s->scope_slot)
 		return false;
 
 	if (!s->user)
@@ -998,6 +1267,9 @@ session_check_gc(Session *s, bool drop_not_started)
 			return true;
 	}
 
+	if (s->scope_slot)
+		return true;
+
 	if (s->scope_job && manager_job_is_active(s->manager, s->scope_job))
 		return true;
 
@@ -73,6 +73,8 @@ struct Session {
 	SessionClass class;
 
 	char *state_file;
+	char **state_fields; /* As last written, for the snapshot */
+	ino_t state_inode;
 
 	User *user;
 
@@ -89,6 +91,7 @@ struct Session {
 
 	char *scope;
 	char *scope_job;
+	sd_bus_slot *scope_slot; /* StartTransientUnit() still pending */
 
 	Seat *seat;
 	unsigned int vtnr;
@@ -105,10 +108,22 @@ struct Session {
 	bool idle_hint;
 	dual_timestamp idle_hint_timestamp;
 
+	usec_t tty_atime; /* 0 if unknown */
+	usec_t tty_atime_checked; /* CLOCK_MONOTONIC */
+
+	/* Idle state as last filed in the manager's queues */
+	bool idle_state;
+	dual_timestamp idle_state_timestamp;
+	usec_t idle_recheck; /* CLOCK_MONOTONIC */
+	unsigned idle_state_idx;
+	unsigned idle_recheck_idx;
+
 	bool locked_hint;
 
 	bool in_gc_queue: 1;
+	bool in_save_queue: 1;
 	bool started: 1;
+	bool idle_tracked: 1;
 
 	bool stopping;
 
@@ -123,6 +138,7 @@ struct Session {
 	IWLIST_FIELDS(Session, sessions_by_seat);
 
 	IWLIST_FIELDS(Session, gc_queue);
+	IWLIST_FIELDS(Session, save_queue);
 };
 
 Session *session_new(Manager *m, const char *id);
@@ -134,6 +150,7 @@ int session_activate(Session *s);
 bool session_is_active(Session *s);
 int session_get_idle_hint(Session *s, dual_timestamp *t);
 void session_set_idle_hint(Session *s, bool b);
+int session_update_idle(Session *s);
 int session_get_locked_hint(Session *s);
 void session_set_locked_hint(Session *s, bool b);
 int session_create_fifo(Session *s);
@@ -142,6 +159,8 @@ int session_stop(Session *s, bool force);
 int session_finalize(Session *s);
 void session_release(Session *s);
 int session_save(Session *s);
+int session_save_now(Session *s);
+int session_save_pending(Session *s);
 int session_load(Session *s);
 int session_kill(Session *s, KillWho who, int signo);
 
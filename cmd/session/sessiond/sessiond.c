@@ -25,8 +25,10 @@
 #include "bus-error.h"
 #include "bus-util.h"
 #include "conf-parser.h"
+#include "fileio.h"
 #include "label.h"
 #include "logind.h"
+#include "login-snapshot.h"
 #include "mkdir.h"
 #include "sd-daemon.h"
 #include "strv.h"
@@ -123,6 +125,7 @@ manager_free(Manager *m)
 	Seat *s;
 	Inhibitor *i;
 	Button *b;
+	unsigned k, l;
 
 	assert(m);
 
@@ -155,6 +158,16 @@ manager_free(Manager *m)
 	hashmap_free(m->inhibitors);
 	hashmap_free(m->buttons);
 
+	login_snapshot_unref(m->restore_snapshot);
+
+	for (k = 0; k < _INHIBIT_MODE_MAX; k++)
+		for (l = 0; l < INHIBIT_WHAT_BITS; l++)
+			prioq_free(m->inhibitors_by_what[k][l]);
+
+	prioq_free(m->sessions_busy);
+	prioq_free(m->sessions_idle);
+	prioq_free(m->sessions_idle_recheck);
+
 	hashmap_free(m->user_units);
 	hashmap_free(m->session_units);
 
@@ -540,38 +553,95 @@ manager_enumerate_inhibitors(Manager *m)
 }
 
 #ifdef SVC_HAVE_libudev
+/* Upper bound for the events handled in one go, so that a hotplug storm
+ * cannot starve everything else */
+#define UDEV_BATCH_MAX 256
+
+static int
+manager_dispatch_udev_batch(Manager *m, struct udev_monitor *monitor,
+	int (*process)(Manager *m, struct udev_device *d))
+{
+	_cleanup_(ordered_hashmap_freep) OrderedHashmap *batch = NULL;
+	struct udev_device *d;
+	unsigned n;
+	Iterator i;
+	Seat *seat;
+	int r = 0;
+
+	assert(m);
+	assert(monitor);
+
+	batch = ordered_hashmap_new(&string_hash_ops);
+	if (!batch)
+		return -ENOMEM;
+
+	/* Read everything that is queued, and keep only the last event
+         * of every device, in the order of these last events. It alone
+         * determines the state the device ends up in. */
+	for (n = 0; n < UDEV_BATCH_MAX; n++) {
+		struct udev_device *old;
+
+		d = udev_monitor_receive_device(monitor);
+		if (!d)
+			break;
+
+		old = ordered_hashmap_remove(batch, udev_device_get_syspath(d));
+		if (old)
+			udev_device_unref(old);
+
+		r = ordered_hashmap_put(batch, udev_device_get_syspath(d), d);
+		if (r < 0) {
+			udev_device_unref(d);
+			break;
+		}
+	}
+
+	if (n == 0)
+		return -ENOMEM;
+
+	if (n > ordered_hashmap_size(batch))
+		log_debug("Processing %u udev events, %u after merging.", n,
+			ordered_hashmap_size(batch));
+
+	m->udev_batch = true;
+
+	while ((d = ordered_hashmap_steal_first(batch))) {
+		process(m, d);
+		udev_device_unref(d);
+	}
+
+	m->udev_batch = false;
+
+	/* Tell clients about every seat at most once per batch */
+	HASHMAP_FOREACH (seat, m->seats, i)
+		if (seat->can_graphical_changed)
+			seat_can_graphical_changed(seat);
+
+	return r < 0 ? r : 0;
+}
+
 static int
 manager_dispatch_seat_udev(sd_event_source *s, int fd, uint32_t revents,
 	void *userdata)
 {
-	_cleanup_udev_device_unref_ struct udev_device *d = NULL;
 	Manager *m = userdata;
 
 	assert(m);
 
-	d = udev_monitor_receive_device(m->udev_seat_monitor);
-	if (!d)
-		return -ENOMEM;
-
-	manager_process_seat_device(m, d);
-	return 0;
+	return manager_dispatch_udev_batch(m, m->udev_seat_monitor,
+		manager_process_seat_device);
 }
 
 static int
 manager_dispatch_device_udev(sd_event_source *s, int fd, uint32_t revents,
 	void *userdata)
 {
-	_cleanup_udev_device_unref_ struct udev_device *d = NULL;
 	Manager *m = userdata;
 
 	assert(m);
 
-	d = udev_monitor_receive_device(m->udev_device_monitor);
-	if (!d)
-		return -ENOMEM;
-
-	manager_process_seat_device(m, d);
-	return 0;
+	return manager_dispatch_udev_batch(m, m->udev_device_monitor,
+		manager_process_seat_device);
 }
 
 static int
@@ -604,17 +674,12 @@ static int
 manager_dispatch_button_udev(sd_event_source *s, int fd, uint32_t revents,
 	void *userdata)
 {
-	_cleanup_udev_device_unref_ struct udev_device *d = NULL;
 	Manager *m = userdata;
 
 	assert(m);
 
-	d = udev_monitor_receive_device(m->udev_button_monitor);
-	if (!d)
-		return -ENOMEM;
-
-	manager_process_button_device(m, d);
-	return 0;
+	return manager_dispatch_udev_batch(m, m->udev_button_monitor,
+		manager_process_button_device);
 }
 #endif
 
@@ -1075,6 +1140,199 @@ manager_gc(Manager *m, bool drop_not_started)
 	}
 }
 
+void
+manager_snapshot_update(Manager *m, const char *state_file, char ***fields,
+	ino_t *inode)
+{
+	char **l = NULL;
+	struct stat st;
+	int r;
+
+	assert(m);
+	assert(state_file);
+	assert(fields);
+	assert(inode);
+
+	/* Keeps the key/value pairs just written to a state file around,
+         * so that the snapshot can be regenerated without reading all
+         * state files again. Readers compare the inode to find out
+         * whether the snapshot still matches the file. */
+
+	if (stat(state_file, &st) < 0)
+		r = -errno;
+	else
+		r = load_env_file_pairs(NULL, state_file, NULL, &l);
+	if (r < 0)
+		log_warning_errno(r,
+			"Failed to read back %s, leaving it out of the snapshot: %m",
+			state_file);
+	else
+		*inode = st.st_ino;
+
+	strv_free(*fields);
+	*fields = l;
+
+	m->snapshot_dirty = true;
+}
+
+void
+manager_snapshot_drop(Manager *m, char ***fields)
+{
+	assert(m);
+	assert(fields);
+
+	if (!*fields)
+		return;
+
+	strv_free(*fields);
+	*fields = NULL;
+
+	m->snapshot_dirty = true;
+}
+
+int
+manager_parse_state(Manager *m, LoginSnapshotKind kind, const char *name,
+	const char *state_file, ...)
+{
+	struct stat st;
+	va_list ap;
+	int r = -ENOENT;
+
+	assert(m);
+	assert(name);
+	assert(state_file);
+
+	/* Works like parse_env_file(), but during startup takes the
+         * data from the snapshot the previous instance left behind if
+         * it still matches the state file. That saves reading and
+         * parsing thousands of files one by one. */
+
+	va_start(ap, state_file);
+
+	if (m->restore_snapshot) {
+		if (stat(state_file, &st) < 0)
+			r = -errno;
+		else
+			r = login_snapshot_getv(m->restore_snapshot, kind, name,
+				st.st_ino, ap);
+	}
+
+	if (IN_SET(r, -ENOENT, -ESTALE, -EBADMSG))
+		r = parse_env_filev(state_file, NEWLINE, ap);
+
+	va_end(ap);
+
+	return r;
+}
+
+static unsigned
+manager_dispatch_save_queue(Manager *m)
+{
+	Session *session;
+	User *user;
+	Seat *seat;
+	unsigned n = 0;
+
+	assert(m);
+
+	while ((seat = m->seat_save_queue)) {
+		seat_save_now(seat);
+		n++;
+	}
+
+	while ((user = m->user_save_queue)) {
+		user_save_now(user);
+		n++;
+	}
+
+	while ((session = m->session_save_queue)) {
+		session_save_now(session);
+		n++;
+	}
+
+	if (n > 0) {
+		m->n_state_writes += n;
+		log_debug("Wrote %u state files, %lu writes so far, %lu saved by coalescing.",
+			n, m->n_state_writes, m->n_state_writes_saved);
+	}
+
+	return n;
+}
+
+static int
+manager_write_snapshot(Manager *m)
+{
+	LoginSnapshotObject *objects[_LOGIN_SNAPSHOT_KIND_MAX] = {};
+	size_t n[_LOGIN_SNAPSHOT_KIND_MAX] = {};
+	char(*uids)[DECIMAL_STR_MAX(uid_t) + 1] = NULL;
+	Session *session;
+	User *user;
+	Seat *seat;
+	Iterator i;
+	int r, k;
+
+	assert(m);
+
+	m->snapshot_dirty = false;
+
+	objects[LOGIN_SNAPSHOT_SESSION] = new (LoginSnapshotObject,
+		hashmap_size(m->sessions) + 1);
+	objects[LOGIN_SNAPSHOT_USER] = new (LoginSnapshotObject,
+		hashmap_size(m->users) + 1);
+	objects[LOGIN_SNAPSHOT_SEAT] = new (LoginSnapshotObject,
+		hashmap_size(m->seats) + 1);
+	uids = malloc((hashmap_size(m->users) + 1) * sizeof(*uids));
+	if (!objects[LOGIN_SNAPSHOT_SESSION] || !objects[LOGIN_SNAPSHOT_USER] ||
+		!objects[LOGIN_SNAPSHOT_SEAT] || !uids) {
+		r = -ENOMEM;
+		goto finish;
+	}
+
+	HASHMAP_FOREACH (session, m->sessions, i)
+		if (session->state_fields)
+			objects[LOGIN_SNAPSHOT_SESSION]
+			       [n[LOGIN_SNAPSHOT_SESSION]++] =
+				       (LoginSnapshotObject){ session->id,
+					       session->state_fields,
+					       session->state_inode };
+
+	HASHMAP_FOREACH (user, m->users, i)
+		if (user->state_fields) {
+			k = n[LOGIN_SNAPSHOT_USER]++;
+			snprintf(uids[k], sizeof(uids[k]), UID_FMT, user->uid);
+			objects[LOGIN_SNAPSHOT_USER][k] = (LoginSnapshotObject){
+				uids[k], user->state_fields, user->state_inode
+			};
+		}
+
+	HASHMAP_FOREACH (seat, m->seats, i)
+		if (seat->state_fields)
+			objects[LOGIN_SNAPSHOT_SEAT][n[LOGIN_SNAPSHOT_SEAT]++] =
+				(LoginSnapshotObject){ seat->id,
+					seat->state_fields, seat->state_inode };
+
+	r = mkdir_safe_label(LOGIN_SNAPSHOT_DIR, 0755, 0, 0);
+	if (r < 0)
+		goto finish;
+
+	r = login_snapshot_write(LOGIN_SNAPSHOT_PATH,
+		++m->snapshot_generation, objects, n);
+
+finish:
+	if (r < 0) {
+		/* Better no snapshot than an outdated one, readers fall
+                 * back to the state files */
+		unlink(LOGIN_SNAPSHOT_PATH);
+		log_error_errno(r, "Failed to write login snapshot: %m");
+	}
+
+	for (k = 0; k < _LOGIN_SNAPSHOT_KIND_MAX; k++)
+		free(objects[k]);
+	free(uids);
+
+	return r;
+}
+
 static int
 manager_dispatch_idle_action(sd_event_source *s, uint64_t t, void *userdata)
 {
@@ -1183,6 +1441,11 @@ manager_startup(Manager *m)
 			"Failed to set up lid switch ignore event source: %m");
 
 	/* Deserialize state */
+	r = login_snapshot_open(LOGIN_SNAPSHOT_PATH, &m->restore_snapshot);
+	if (r < 0 && r != -ENOENT)
+		log_debug_errno(r,
+			"Failed to open login snapshot, reading state files: %m");
+
 	r = manager_enumerate_devices(m);
 	if (r < 0)
 		log_warning_errno(r, "Device enumeration failed: %m");
@@ -1207,6 +1470,8 @@ manager_startup(Manager *m)
 	if (r < 0)
 		log_warning_errno(r, "Button enumeration failed: %m");
 
+	m->restore_snapshot = login_snapshot_unref(m->restore_snapshot);
+
 	/* Remove stale objects before we start them */
 	manager_gc(m, false);
 
@@ -1249,14 +1514,26 @@ manager_run(Manager *m)
 		r = sd_event_get_state(m->event);
 		if (r < 0)
 			return r;
-		if (r == SD_EVENT_FINISHED)
+		if (r == SD_EVENT_FINISHED) {
+			/* Leave an up-to-date snapshot behind for the
+                         * next instance */
+			manager_dispatch_save_queue(m);
+			if (m->snapshot_dirty)
+				manager_write_snapshot(m);
 			return 0;
+		}
 
 		manager_gc(m, true);
 
 		if (manager_dispatch_delayed(m) > 0)
 			continue;
 
+		/* Publish everything that changed in this iteration at
+                 * once */
+		manager_dispatch_save_queue(m);
+		if (m->snapshot_dirty)
+			manager_write_snapshot(m);
+
 		if (m->action_what != 0 && !m->action_job) {
 			usec_t x, y;
 
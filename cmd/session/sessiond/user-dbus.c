@@ -353,6 +353,8 @@ user_send_signal(User *u, bool new_user)
 
 	assert(u);
 
+	user_save_pending(u);
+
 	p = user_bus_path(u);
 	if (!p)
 		return -ENOMEM;
@@ -374,6 +376,8 @@ user_send_changed(User *u, const char *properties, ...)
 	if (!u->started)
 		return 0;
 
+	user_save_pending(u);
+
 	p = user_bus_path(u);
 	if (!p)
 		return -ENOMEM;
@@ -76,6 +76,16 @@ fail:
 	return NULL;
 }
 
+static void
+user_remove_from_save_queue(User *u)
+{
+	if (!u->in_save_queue)
+		return;
+
+	IWLIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+	u->in_save_queue = false;
+}
+
 void
 user_free(User *u)
 {
@@ -104,6 +114,8 @@ user_free(User *u)
 
 	hashmap_remove(u->manager->users, UID_TO_PTR(u->uid));
 
+	user_remove_from_save_queue(u);
+	manager_snapshot_drop(u->manager, &u->state_fields);
 	free(u->name);
 	free(u->state_file);
 	free(u);
@@ -111,6 +123,40 @@ user_free(User *u)
 
 int
 user_save(User *u)
+{
+	assert(u);
+
+	/* The state file is written once per main loop iteration, no
+         * matter how often it changes within it */
+
+	if (u->in_save_queue) {
+		u->manager->n_state_writes_saved++;
+		return 0;
+	}
+
+	IWLIST_PREPEND(save_queue, u->manager->user_save_queue, u);
+	u->in_save_queue = true;
+
+	return 0;
+}
+
+int
+user_save_pending(User *u)
+{
+	assert(u);
+
+	/* Clients read the state file as soon as they see one of our
+         * signals, so it has to be written out before we send one */
+
+	if (!u->in_save_queue)
+		return 0;
+
+	u->manager->n_state_writes++;
+	return user_save_now(u);
+}
+
+int
+user_save_now(User *u)
 {
 	_cleanup_free_ char *temp_path = NULL;
 	_cleanup_fclose_ FILE *f = NULL;
@@ -119,6 +165,8 @@ user_save(User *u)
 	assert(u);
 	assert(u->state_file);
 
+	user_remove_from_save_queue(u);
+
 	if (!u->started)
 		return 0;
 
@@ -253,7 +301,10 @@ user_save(User *u)
 		r = -errno;
 		unlink(u->state_file);
 		unlink(temp_path);
-	}
+		manager_snapshot_drop(u->manager, &u->state_fields);
+	} else
+		manager_snapshot_update(u->manager, u->state_file,
+			&u->state_fields, &u->state_inode);
 
 finish:
 	if (r < 0)
@@ -268,15 +319,19 @@ user_load(User *u)
 {
 	_cleanup_free_ char *display = NULL, *realtime = NULL,
 			    *monotonic = NULL;
+	char uid[DECIMAL_STR_MAX(uid_t) + 1];
 	Session *s = NULL;
 	int r;
 
 	assert(u);
 
-	r = parse_env_file(u->state_file, NEWLINE, "RUNTIME", &u->runtime_path,
-		"SERVICE", &u->service, "SERVICE_JOB", &u->service_job, "SLICE",
-		&u->slice, "SLICE_JOB", &u->slice_job, "DISPLAY", &display,
-		"REALTIME", &realtime, "MONOTONIC", &monotonic, NULL);
+	xsprintf(uid, UID_FMT, u->uid);
+
+	r = manager_parse_state(u->manager, LOGIN_SNAPSHOT_USER, uid,
+		u->state_file, "RUNTIME", &u->runtime_path, "SERVICE",
+		&u->service, "SERVICE_JOB", &u->service_job, "SLICE", &u->slice,
+		"SLICE_JOB", &u->slice_job, "DISPLAY", &display, "REALTIME",
+		&realtime, "MONOTONIC", &monotonic, NULL);
 	if (r < 0) {
 		if (r == -ENOENT)
 			return 0;
@@ -624,7 +679,9 @@ user_finalize(User *u)
 	}
 #endif
 
+	user_remove_from_save_queue(u);
 	unlink(u->state_file);
+	manager_snapshot_drop(u->manager, &u->state_fields);
 	user_add_to_gc_queue(u);
 
 	if (u->started) {
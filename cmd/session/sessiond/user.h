@@ -45,6 +45,8 @@ struct User {
 	char *name;
 
 	char *state_file;
+	char **state_fields; /* As last written, for the snapshot */
+	ino_t state_inode;
 	char *runtime_path;
 
 	char *service;
@@ -58,11 +60,13 @@ struct User {
 	dual_timestamp timestamp;
 
 	bool in_gc_queue: 1;
+	bool in_save_queue: 1;
 	bool started: 1;
 	bool stopping: 1;
 
 	IWLIST_HEAD(Session, sessions);
 	IWLIST_FIELDS(User, gc_queue);
+	IWLIST_FIELDS(User, save_queue);
 };
 
 User *user_new(Manager *m, uid_t uid, gid_t gid, const char *name);
@@ -75,6 +79,8 @@ int user_finalize(User *u);
 UserState user_get_state(User *u);
 int user_get_idle_hint(User *u, dual_timestamp *t);
 int user_save(User *u);
+int user_save_now(User *u);
+int user_save_pending(User *u);
 int user_load(User *u);
 int user_kill(User *u, int signo);
 int user_check_linger_file(User *u);
@@ -46,6 +46,7 @@
 #include "copy.h"
 #include "dropin.h"
 #include "env-util.h"
+#include "event-util.h"
 #include "exit-status.h"
 #include "fileio.h"
 #include "initreq.h"
@@ -60,6 +61,7 @@
 #include "path-util.h"
 #include "sd-bus.h"
 #include "sd-daemon.h"
+#include "sd-event.h"
 #include "sd-login.h"
 #include "sd-shutdown.h"
 #include "set.h"
@@ -559,39 +561,227 @@ output_units_list(const UnitInfo *unit_infos, unsigned c)
 	return 0;
 }
 
+/* How long each container gets to answer when all of them are asked */
+#define MACHINE_TIMEOUT_USEC (5 * USEC_PER_SEC)
+
+typedef int (*machine_append_t)(sd_bus_message *m);
+typedef int (*machine_reply_t)(sd_bus_message *reply, unsigned idx,
+	void *userdata);
+
+typedef struct MachineCalls {
+	sd_event *event;
+	const char *member;
+	machine_reply_t handler;
+	void *userdata;
+	bool quiet;
+	unsigned n_pending;
+	int error;
+} MachineCalls;
+
+typedef struct MachineCall {
+	MachineCalls *calls;
+	sd_bus *bus;
+	sd_event_source *timeout;
+	const char *machine;
+	unsigned idx;
+	bool pending;
+} MachineCall;
+
+static void
+machine_call_done(MachineCall *call)
+{
+	MachineCalls *calls = call->calls;
+
+	call->pending = false;
+	call->timeout = sd_event_source_unref(call->timeout);
+
+	calls->n_pending--;
+	if (calls->n_pending == 0 || calls->error < 0)
+		sd_event_exit(calls->event, calls->error);
+}
+
 static int
-get_unit_list(sd_bus *bus, const char *machine, char **patterns,
-	UnitInfo **unit_infos, int c, sd_bus_message **_reply)
+machine_call_timeout(sd_event_source *s, uint64_t usec, void *userdata)
 {
-	_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
-	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
-	size_t size = c;
+	MachineCall *call = userdata;
+
+	/* The reply timeout of the call only runs once the connection
+         * is authenticated, this also covers a container that hangs
+         * before that */
+	log_full(call->calls->quiet ? LOG_DEBUG : LOG_ERR,
+		"Timed out calling %s on container %s.", call->calls->member,
+		call->machine);
+
+	sd_bus_close(call->bus);
+	machine_call_done(call);
+
+	return 0;
+}
+
+static int
+machine_call_reply(sd_bus *bus, sd_bus_message *reply, void *userdata,
+	sd_bus_error *ret_error)
+{
+	MachineCall *call = userdata;
+	MachineCalls *calls = call->calls;
+	const sd_bus_error *e;
 	int r;
-	UnitInfo u;
 
-	assert(bus);
-	assert(unit_infos);
-	assert(_reply);
+	if (!call->pending)
+		return 0;
 
-	r = sd_bus_message_new_method_call(bus, &m, SVC_DBUS_BUSNAME,
-		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
-		"ListUnitsFiltered");
+	/* Containers that fail or time out are skipped, but a reply
+         * that cannot be handled fails the whole listing */
+	e = sd_bus_message_get_error(reply);
+	if (e)
+		log_full(calls->quiet ? LOG_DEBUG : LOG_ERR,
+			"Failed to call %s on container %s: %s", calls->member,
+			call->machine,
+			bus_error_message(e, sd_bus_message_get_errno(reply)));
+	else {
+		r = calls->handler(reply, call->idx, calls->userdata);
+		if (r < 0 && calls->error == 0)
+			calls->error = r;
+	}
 
-	if (r < 0)
-		return bus_log_create_error(r);
+	machine_call_done(call);
+
+	return 0;
+}
+
+/* Calls member on the manager of each of the machines, all at once on
+ * one event loop, and hands the replies to handler in the order they
+ * arrive, together with the index of the machine they came from */
+static int
+call_machines(char **machines, const char *interface, const char *member,
+	machine_append_t append, machine_reply_t handler, void *userdata,
+	bool quiet)
+{
+	_cleanup_event_unref_ sd_event *event = NULL;
+	_cleanup_free_ MachineCall *call = NULL;
+	MachineCalls calls = {
+		.member = member,
+		.handler = handler,
+		.userdata = userdata,
+		.quiet = quiet,
+	};
+	unsigned n, k;
+	int r = 0;
 
-	r = sd_bus_message_append_strv(m, arg_states);
+	assert(interface);
+	assert(member);
+	assert(handler);
+
+	n = strv_length(machines);
+	if (n == 0)
+		return 0;
+
+	r = sd_event_new(&event);
 	if (r < 0)
-		return bus_log_create_error(r);
+		return log_error_errno(r, "Failed to allocate event loop: %m");
 
-	r = sd_bus_call(bus, m, 0, &error, &reply);
-	if (r < 0) {
-		log_error("Failed to list units: %s",
-			bus_error_message(&error, r));
-		return r;
+	calls.event = event;
+
+	call = new0(MachineCall, n);
+	if (!call)
+		return log_oom();
+
+	for (k = 0; k < n; k++) {
+		_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+
+		call[k].calls = &calls;
+		call[k].machine = machines[k];
+		call[k].idx = k;
+
+		/* This only connects, authentication and the call itself
+                 * are done on the event loop */
+		r = sd_bus_open_system_machine(&call[k].bus, machines[k]);
+		if (r < 0) {
+			log_full_errno(quiet ? LOG_DEBUG : LOG_ERR, r,
+				"Failed to connect to container %s: %m",
+				machines[k]);
+			r = 0;
+			continue;
+		}
+
+		r = sd_bus_attach_event(call[k].bus, event, 0);
+		if (r < 0) {
+			log_error_errno(r,
+				"Failed to attach bus to event loop: %m");
+			goto finish;
+		}
+
+		r = sd_bus_message_new_method_call(call[k].bus, &m,
+			SVC_DBUS_BUSNAME, "/org/freedesktop/systemd1",
+			interface, member);
+		if (r < 0) {
+			r = bus_log_create_error(r);
+			goto finish;
+		}
+
+		if (append) {
+			r = append(m);
+			if (r < 0) {
+				r = bus_log_create_error(r);
+				goto finish;
+			}
+		}
+
+		r = sd_bus_call_async(call[k].bus, NULL, m, machine_call_reply,
+			&call[k], MACHINE_TIMEOUT_USEC);
+		if (r < 0) {
+			log_full_errno(quiet ? LOG_DEBUG : LOG_ERR, r,
+				"Failed to call %s on container %s: %m", member,
+				machines[k]);
+			r = 0;
+			continue;
+		}
+
+		r = sd_event_add_time(event, &call[k].timeout, CLOCK_MONOTONIC,
+			now(CLOCK_MONOTONIC) + MACHINE_TIMEOUT_USEC, 0,
+			machine_call_timeout, &call[k]);
+		if (r < 0) {
+			log_error_errno(r, "Failed to add timer: %m");
+			goto finish;
+		}
+
+		call[k].pending = true;
+		calls.n_pending++;
+	}
+
+	if (calls.n_pending > 0) {
+		r = sd_event_loop(event);
+		if (r < 0 && calls.error == 0)
+			log_error_errno(r, "Failed to run event loop: %m");
 	}
 
+finish:
+	/* Not flushed, a container that didn't answer might not read
+         * either */
+	for (k = 0; k < n; k++) {
+		sd_event_source_unref(call[k].timeout);
+
+		if (call[k].bus) {
+			sd_bus_detach_event(call[k].bus);
+			sd_bus_close(call[k].bus);
+			sd_bus_unref(call[k].bus);
+		}
+	}
+
+	return r;
+}
+
+static int
+parse_unit_list(sd_bus_message *reply, const char *machine, char **patterns,
+	UnitInfo **unit_infos, int c)
+{
+	size_t size = c;
+	UnitInfo u;
+	int r;
+
+	assert(reply);
+	assert(unit_infos);
+
 	r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY,
 		"(ssssssouso)");
 	if (r < 0)
@@ -615,6 +805,50 @@ get_unit_list(sd_bus *bus, const char *machine, char **patterns,
 	if (r < 0)
 		return bus_log_parse_error(r);
 
+	return c;
+}
+
+static int
+append_unit_states(sd_bus_message *m)
+{
+	return sd_bus_message_append_strv(m, arg_states);
+}
+
+static int
+get_unit_list(sd_bus *bus, const char *machine, char **patterns,
+	UnitInfo **unit_infos, int c, sd_bus_message **_reply)
+{
+	_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+	int r;
+
+	assert(bus);
+	assert(unit_infos);
+	assert(_reply);
+
+	r = sd_bus_message_new_method_call(bus, &m, SVC_DBUS_BUSNAME,
+		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
+		"ListUnitsFiltered");
+
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = append_unit_states(m);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_call(bus, m, 0, &error, &reply);
+	if (r < 0) {
+		log_error("Failed to list units: %s",
+			bus_error_message(&error, r));
+		return r;
+	}
+
+	c = parse_unit_list(reply, machine, patterns, unit_infos, c);
+	if (c < 0)
+		return c;
+
 	*_reply = reply;
 	reply = NULL;
 
@@ -632,6 +866,37 @@ message_set_freep(Set **set)
 	set_free(*set);
 }
 
+typedef struct UnitList {
+	char **machines;
+	char **patterns;
+	UnitInfo *unit_infos;
+	int c;
+	Set *replies;
+} UnitList;
+
+static int
+unit_list_reply(sd_bus_message *reply, unsigned idx, void *userdata)
+{
+	UnitList *l = userdata;
+	int c, r;
+
+	c = parse_unit_list(reply, l->machines[idx], l->patterns,
+		&l->unit_infos, l->c);
+	if (c < 0)
+		return c;
+
+	l->c = c;
+
+	/* The unit infos point into the reply */
+	r = set_put(l->replies, sd_bus_message_ref(reply));
+	if (r < 0) {
+		sd_bus_message_unref(reply);
+		return log_oom();
+	}
+
+	return 0;
+}
+
 static int
 get_unit_list_recursive(sd_bus *bus, char **patterns, UnitInfo **_unit_infos,
 	Set **_replies, char ***_machines)
@@ -662,37 +927,30 @@ get_unit_list_recursive(sd_bus *bus, char **patterns, UnitInfo **_unit_infos,
 
 	if (arg_recursive) {
 		_cleanup_strv_free_ char **machines = NULL;
-		char **i;
+		UnitList l;
 
 		r = sd_get_machine_names(&machines);
 		if (r < 0)
 			return r;
 
-		STRV_FOREACH (i, machines) {
-			_cleanup_bus_close_unref_ sd_bus *container = NULL;
-			int k;
-
-			r = sd_bus_open_system_machine(&container, *i);
-			if (r < 0) {
-				log_error_errno(r,
-					"Failed to connect to container %s: %m",
-					*i);
-				continue;
-			}
+		l = (UnitList){
+			.machines = machines,
+			.patterns = patterns,
+			.unit_infos = unit_infos,
+			.c = c,
+			.replies = replies,
+		};
 
-			k = get_unit_list(container, *i, patterns, &unit_infos,
-				c, &reply);
-			if (k < 0)
-				return k;
+		r = call_machines(machines, SVC_DBUS_INTERFACE ".Manager",
+			"ListUnitsFiltered", append_unit_states,
+			unit_list_reply, &l, false);
 
-			c = k;
+		/* Whatever arrived so far is freed with the rest */
+		unit_infos = l.unit_infos;
+		c = l.c;
 
-			r = set_put(replies, reply);
-			if (r < 0) {
-				sd_bus_message_unref(reply);
-				return r;
-			}
-		}
+		if (r < 0)
+			return r;
 
 		*_machines = machines;
 		machines = NULL;
@@ -1525,25 +1783,156 @@ list_dependencies_print(const char *name, int level, unsigned int branches,
 	return 0;
 }
 
+static const char *dependencies[_DEPENDENCY_MAX] = {
+	[DEPENDENCY_FORWARD] = "Requires\0"
+			       "RequiresOverridable\0"
+			       "Requisite\0"
+			       "RequisiteOverridable\0"
+			       "Wants\0"
+			       "BindsTo\0",
+	[DEPENDENCY_REVERSE] = "RequiredBy\0"
+			       "RequiredByOverridable\0"
+			       "WantedBy\0"
+			       "PartOf\0"
+			       "BoundBy\0",
+	[DEPENDENCY_AFTER] = "After\0",
+	[DEPENDENCY_BEFORE] = "Before\0",
+};
+
+typedef struct DependencyNode {
+	char *state;
+	char **deps;
+} DependencyNode;
+
+static void
+dependency_tree_free(Hashmap *tree)
+{
+	DependencyNode *node;
+	char *name;
+	Iterator i;
+
+	HASHMAP_FOREACH_KEY (node, name, tree, i) {
+		free(node->state);
+		strv_free(node->deps);
+		free(node);
+		free(name);
+	}
+
+	hashmap_free(tree);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(Hashmap *, dependency_tree_free);
+#define _cleanup_dependency_tree_free_ _cleanup_(dependency_tree_freep)
+
+/* Asks the manager for all units the tree below name is made of, with
+ * their states and dependencies, instead of asking for each of them
+ * separately. Returns -EOPNOTSUPP if the manager doesn't know how. */
 static int
-list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps)
+list_dependencies_get_tree(sd_bus *bus, const char *name, Hashmap **ret)
 {
-	static const char *dependencies[_DEPENDENCY_MAX] = {
-		[DEPENDENCY_FORWARD] = "Requires\0"
-				       "RequiresOverridable\0"
-				       "Requisite\0"
-				       "RequisiteOverridable\0"
-				       "Wants\0"
-				       "BindsTo\0",
-		[DEPENDENCY_REVERSE] = "RequiredBy\0"
-				       "RequiredByOverridable\0"
-				       "WantedBy\0"
-				       "PartOf\0"
-				       "BoundBy\0",
-		[DEPENDENCY_AFTER] = "After\0",
-		[DEPENDENCY_BEFORE] = "Before\0",
-	};
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	_cleanup_bus_message_unref_ sd_bus_message *m = NULL, *reply = NULL;
+	_cleanup_dependency_tree_free_ Hashmap *tree = NULL;
+	_cleanup_strv_free_ char **types = NULL;
+	int r;
+
+	assert(bus);
+	assert(name);
+	assert(ret);
+
+	types = strv_split_nulstr(dependencies[arg_dependency]);
+	if (!types)
+		return log_oom();
 
+	r = sd_bus_message_new_method_call(bus, &m, SVC_DBUS_BUSNAME,
+		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
+		"ListUnitDependencies");
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append(m, "s", name);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append_strv(m, types);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append(m, "ub", 0, arg_all);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_call(bus, m, 0, &error, &reply);
+	if (r < 0) {
+		if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+			return -EOPNOTSUPP;
+
+		log_error("Failed to list dependencies of %s: %s", name,
+			bus_error_message(&error, r));
+		return r;
+	}
+
+	tree = hashmap_new(&string_hash_ops);
+	if (!tree)
+		return log_oom();
+
+	r = sd_bus_message_enter_container(reply, 'a', "(ssas)");
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	while ((r = sd_bus_message_enter_container(reply, 'r', "ssas")) > 0) {
+		_cleanup_free_ DependencyNode *node = NULL;
+		_cleanup_free_ char *id = NULL;
+		const char *unit, *state;
+
+		r = sd_bus_message_read(reply, "ss", &unit, &state);
+		if (r < 0)
+			return bus_log_parse_error(r);
+
+		node = new0(DependencyNode, 1);
+		id = strdup(unit);
+		if (!node || !id)
+			return log_oom();
+
+		node->state = strdup(state);
+		if (!node->state)
+			return log_oom();
+
+		r = sd_bus_message_read_strv(reply, &node->deps);
+		if (r < 0) {
+			free(node->state);
+			return bus_log_parse_error(r);
+		}
+
+		r = hashmap_put(tree, id, node);
+		if (r < 0) {
+			free(node->state);
+			strv_free(node->deps);
+			return log_oom();
+		}
+		id = NULL;
+		node = NULL;
+
+		r = sd_bus_message_exit_container(reply);
+		if (r < 0)
+			return bus_log_parse_error(r);
+	}
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	r = sd_bus_message_exit_container(reply);
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	*ret = tree;
+	tree = NULL;
+
+	return 0;
+}
+
+static int
+list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps)
+{
 	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
 	_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
 	_cleanup_strv_free_ char **ret = NULL;
@@ -1632,10 +2021,11 @@ list_dependencies_compare(const void *_a, const void *_b)
 }
 
 static int
-list_dependencies_one(sd_bus *bus, const char *name, int level, char ***units,
-	unsigned int branches)
+list_dependencies_one(sd_bus *bus, Hashmap *tree, const char *name, int level,
+	char ***units, unsigned int branches)
 {
 	_cleanup_strv_free_ char **deps = NULL;
+	DependencyNode *node;
 	char **c;
 	int r = 0;
 
@@ -1647,9 +2037,16 @@ list_dependencies_one(sd_bus *bus, const char *name, int level, char ***units,
 	if (r < 0)
 		return log_oom();
 
-	r = list_dependencies_get_dependencies(bus, name, &deps);
-	if (r < 0)
-		return r;
+	node = hashmap_get(tree, name);
+	if (node) {
+		deps = strv_copy(node->deps);
+		if (!deps)
+			return log_oom();
+	} else {
+		r = list_dependencies_get_dependencies(bus, name, &deps);
+		if (r < 0)
+			return r;
+	}
 
 	qsort_safe(deps, strv_length(deps), sizeof(char *),
 		list_dependencies_compare);
@@ -1673,8 +2070,15 @@ list_dependencies_one(sd_bus *bus, const char *name, int level, char ***units,
 			int state;
 			const char *on;
 
-			state = check_one_unit(bus, *c,
-				"activating\0active\0reloading\0", true);
+			node = hashmap_get(tree, *c);
+			if (node)
+				state = nulstr_contains(
+					"activating\0active\0reloading\0",
+					node->state);
+			else
+				state = check_one_unit(bus, *c,
+					"activating\0active\0reloading\0",
+					true);
 			on = state > 0 ? ansi_highlight_green() :
 					       ansi_highlight_red();
 			printf("%s%s%s ", on,
@@ -1687,7 +2091,8 @@ list_dependencies_one(sd_bus *bus, const char *name, int level, char ***units,
 			return r;
 
 		if (arg_all || unit_name_to_type(*c) == UNIT_TARGET) {
-			r = list_dependencies_one(bus, *c, level + 1, units,
+			r = list_dependencies_one(bus, tree, *c, level + 1,
+				units,
 				(branches << 1) | (c[1] == NULL ? 0 : 1));
 			if (r < 0)
 				return r;
@@ -1703,9 +2108,11 @@ list_dependencies_one(sd_bus *bus, const char *name, int level, char ***units,
 static int
 list_dependencies(sd_bus *bus, char **args)
 {
+	_cleanup_dependency_tree_free_ Hashmap *tree = NULL;
 	_cleanup_strv_free_ char **units = NULL;
 	_cleanup_free_ char *unit = NULL;
 	const char *u;
+	int r;
 
 	assert(bus);
 
@@ -1717,11 +2124,16 @@ list_dependencies(sd_bus *bus, char **args)
 	} else
 		u = SPECIAL_DEFAULT_TARGET;
 
+	/* Older managers are asked for one unit at a time */
+	r = list_dependencies_get_tree(bus, u, &tree);
+	if (r < 0 && r != -EOPNOTSUPP)
+		return r;
+
 	pager_open_if_enabled();
 
 	puts(u);
 
-	return list_dependencies_one(bus, u, 0, &units, 0);
+	return list_dependencies_one(bus, tree, u, 0, &units, 0);
 }
 
 struct machine_info {
@@ -1777,23 +2189,27 @@ compare_machine_info(const void *a, const void *b)
 static int
 get_machine_properties(sd_bus *bus, struct machine_info *mi)
 {
-	_cleanup_bus_close_unref_ sd_bus *container = NULL;
-	int r;
-
+	assert(bus);
 	assert(mi);
 
-	if (!bus) {
-		r = sd_bus_open_system_machine(&container, mi->name);
-		if (r < 0)
-			return r;
+	return bus_map_all_properties(bus, SVC_DBUS_BUSNAME,
+		"/org/freedesktop/systemd1", machine_info_property_map, mi);
+}
 
-		bus = container;
-	}
+static int
+append_all_interfaces(sd_bus_message *m)
+{
+	return sd_bus_message_append(m, "s", "");
+}
 
-	r = bus_map_all_properties(bus, SVC_DBUS_BUSNAME,
-		"/org/freedesktop/systemd1", machine_info_property_map, mi);
-	if (r < 0)
-		return r;
+static int
+machine_properties_reply(sd_bus_message *reply, unsigned idx, void *userdata)
+{
+	struct machine_info *mi = userdata;
+
+	/* Like for the host, missing properties are simply not shown */
+	(void)bus_message_map_all_properties(sd_bus_message_get_bus(reply),
+		reply, machine_info_property_map, &mi[idx]);
 
 	return 0;
 }
@@ -1809,11 +2225,11 @@ get_machine_list(sd_bus *bus, struct machine_info **_machine_infos,
 	char **patterns)
 {
 	struct machine_info *machine_infos = NULL;
-	_cleanup_strv_free_ char **m = NULL;
+	_cleanup_strv_free_ char **m = NULL, **containers = NULL;
 	_cleanup_free_ char *hn = NULL;
 	size_t sz = 0;
 	char **i;
-	int c = 0;
+	int c = 0, first, r;
 
 	hn = gethostname_malloc();
 	if (!hn)
@@ -1831,6 +2247,8 @@ get_machine_list(sd_bus *bus, struct machine_info **_machine_infos,
 		c++;
 	}
 
+	first = c;
+
 	sd_get_machine_names(&m);
 	STRV_FOREACH (i, m) {
 		_cleanup_free_ char *class = NULL;
@@ -1849,15 +2267,25 @@ get_machine_list(sd_bus *bus, struct machine_info **_machine_infos,
 
 		machine_infos[c].is_host = false;
 		machine_infos[c].name = strdup(*i);
-		if (!machine_infos[c].name) {
-			free_machines_list(machine_infos, c);
+		if (!machine_infos[c].name ||
+			strv_extend(&containers, *i) < 0) {
+			free_machines_list(machine_infos, c + 1);
 			return log_oom();
 		}
 
-		get_machine_properties(NULL, &machine_infos[c]);
 		c++;
 	}
 
+	/* The containers are all asked at once, so that a slow one
+         * doesn't hold up the others */
+	r = call_machines(containers, "org.freedesktop.DBus.Properties",
+		"GetAll", append_all_interfaces, machine_properties_reply,
+		machine_infos + first, true);
+	if (r < 0) {
+		free_machines_list(machine_infos, c);
+		return r;
+	}
+
 	*_machine_infos = machine_infos;
 	return c;
 }
@@ -2592,6 +3020,27 @@ method_to_verb(const char *method)
 	return "n/a";
 }
 
+/* Methods that queue jobs for a number of units in one transaction */
+static const struct {
+	const char *method;
+	const char *batch_method;
+} unit_batch_actions[] = { { "StartUnit", "StartUnits" },
+	{ "StopUnit", "StopUnits" }, { "RestartUnit", "RestartUnits" } };
+
+static void
+log_start_unit_error(const char *method, const char *name,
+	const sd_bus_error *error, int r)
+{
+	log_error("Failed to %s %s: %s", method_to_verb(method), name,
+		bus_error_message(error, r));
+
+	if (!sd_bus_error_has_name(error, BUS_ERROR_NO_SUCH_UNIT) &&
+		!sd_bus_error_has_name(error, BUS_ERROR_UNIT_MASKED))
+		log_error(
+			"See system logs and 'systemctl status %s' for details.",
+			name);
+}
+
 static int
 start_unit_one(sd_bus *bus, const char *method, const char *name,
 	const char *mode, sd_bus_error *error, BusWaitForJobs *w)
@@ -2624,24 +3073,12 @@ start_unit_one(sd_bus *bus, const char *method, const char *name,
 
 	r = sd_bus_call(bus, m, 0, error, &reply);
 	if (r < 0) {
-		const char *verb;
-
 		if (r == -ENOENT && arg_action != ACTION_SYSTEMCTL)
 			/* There's always a fallback possible for
                          * legacy actions. */
 			return -EADDRNOTAVAIL;
 
-		verb = method_to_verb(method);
-
-		log_error("Failed to %s %s: %s", verb, name,
-			bus_error_message(error, r));
-
-		if (!sd_bus_error_has_name(error, BUS_ERROR_NO_SUCH_UNIT) &&
-			!sd_bus_error_has_name(error, BUS_ERROR_UNIT_MASKED))
-			log_error(
-				"See system logs and 'systemctl status %s' for details.",
-				name);
-
+		log_start_unit_error(method, name, error, r);
 		return r;
 	}
 
@@ -2662,12 +3099,124 @@ start_unit_one(sd_bus *bus, const char *method, const char *name,
 	return 0;
 }
 
+/* Queues jobs for all units in a single call, which the manager adds in
+ * a single transaction, with globs expanded by the manager. Returns
+ * -EOPNOTSUPP if the manager does not know how to, otherwise the names
+ * of the units and the exit status for the first failed unit. */
 static int
-expand_names(sd_bus *bus, char **names, const char *suffix, char ***ret)
+start_units_batch(sd_bus *bus, const char *method, char **names,
+	const char *mode, BusWaitForJobs *w, char ***ret_units,
+	int *ret_status)
 {
-	_cleanup_strv_free_ char **mangled = NULL, **globs = NULL;
+	_cleanup_bus_message_unref_ sd_bus_message *m = NULL, *reply = NULL;
+	_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+	_cleanup_strv_free_ char **units = NULL;
+	const char *batch_method = NULL, *name, *path, *error_name,
+		   *error_message;
+	int need_reload, status = 0, r;
+	unsigned i;
+
+	assert(bus);
+	assert(method);
+	assert(mode);
+	assert(ret_units);
+	assert(ret_status);
+
+	for (i = 0; i < ELEMENTSOF(unit_batch_actions); i++)
+		if (streq(unit_batch_actions[i].method, method))
+			batch_method = unit_batch_actions[i].batch_method;
+	if (!batch_method)
+		return -EOPNOTSUPP;
+
+	log_debug("Calling manager for %s on %u units, %s", batch_method,
+		strv_length(names), mode);
+
+	r = sd_bus_message_new_method_call(bus, &m, SVC_DBUS_BUSNAME,
+		"/org/freedesktop/systemd1", SVC_DBUS_INTERFACE ".Manager",
+		batch_method);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_set_allow_interactive_authorization(m,
+		arg_ask_password);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append_strv(m, names);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_message_append(m, "s", mode);
+	if (r < 0)
+		return bus_log_create_error(r);
+
+	r = sd_bus_call(bus, m, 0, &error, &reply);
+	if (r < 0) {
+		if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+			return -EOPNOTSUPP;
+
+		log_error("Failed to %s units: %s", method_to_verb(method),
+			bus_error_message(&error, r));
+
+		*ret_units = NULL;
+		*ret_status = translate_bus_error_to_exit_status(r, &error);
+		return 0;
+	}
+
+	r = sd_bus_message_enter_container(reply, 'a', "(sobss)");
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	while ((r = sd_bus_message_read(reply, "(sobss)", &name, &path,
+			&need_reload, &error_name, &error_message)) > 0) {
+		if (!isempty(error_name)) {
+			_cleanup_bus_error_free_ sd_bus_error e =
+				SD_BUS_ERROR_NULL;
+			int q;
+
+			q = sd_bus_error_set(&e, error_name,
+				isempty(error_message) ? NULL : error_message);
+			log_start_unit_error(method, name, &e, q);
+
+			if (status == 0)
+				status = translate_bus_error_to_exit_status(q,
+					&e);
+			continue;
+		}
+
+		if (need_reload)
+			warn_unit_file_changed(name);
+
+		if (w && !streq(path, "/")) {
+			log_debug("Adding %s to the set", path);
+			r = bus_wait_for_jobs_add(w, path);
+			if (r < 0)
+				return log_oom();
+		}
+
+		r = strv_extend(&units, name);
+		if (r < 0)
+			return log_oom();
+	}
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	r = sd_bus_message_exit_container(reply);
+	if (r < 0)
+		return bus_log_parse_error(r);
+
+	*ret_units = units;
+	units = NULL;
+	*ret_status = status;
+
+	return 0;
+}
+
+static int
+mangle_unit_globs(char **names, const char *suffix, char ***ret)
+{
+	_cleanup_strv_free_ char **mangled = NULL;
 	char **name;
-	int r = 0, i;
 
 	STRV_FOREACH (name, names) {
 		char *t;
@@ -2680,10 +3229,33 @@ expand_names(sd_bus *bus, char **names, const char *suffix, char ***ret)
 		if (!t)
 			return log_oom();
 
-		if (string_is_glob(t))
-			r = strv_consume(&globs, t);
+		if (strv_consume(&mangled, t) < 0)
+			return log_oom();
+	}
+
+	*ret = mangled;
+	mangled = NULL;
+
+	return 0;
+}
+
+static int
+expand_names(sd_bus *bus, char **names, const char *suffix, char ***ret)
+{
+	_cleanup_strv_free_ char **all = NULL, **mangled = NULL,
+				 **globs = NULL;
+	char **name;
+	int r = 0, i;
+
+	r = mangle_unit_globs(names, suffix, &all);
+	if (r < 0)
+		return r;
+
+	STRV_FOREACH (name, all) {
+		if (string_is_glob(*name))
+			r = strv_extend(&globs, *name);
 		else
-			r = strv_consume(&mangled, t);
+			r = strv_extend(&mangled, *name);
 		if (r < 0)
 			return log_oom();
 	}
@@ -2760,6 +3332,7 @@ start_unit(sd_bus *bus, char **args)
 	_cleanup_(bus_wait_for_jobs_freep) BusWaitForJobs *w = NULL;
 	const char *method, *mode, *one_name, *suffix = NULL;
 	_cleanup_strv_free_ char **names = NULL;
+	bool batched = false;
 	char **name;
 	int r = 0;
 
@@ -2790,27 +3363,51 @@ start_unit(sd_bus *bus, char **args)
 		one_name = action_table[arg_action].target;
 	}
 
-	if (one_name)
-		names = strv_new(one_name, NULL);
-	else {
-		r = expand_names(bus, args + 1, suffix, &names);
-		if (r < 0)
-			log_error_errno(r, "Failed to expand names: %m");
-	}
-
 	if (!arg_no_block) {
 		r = bus_wait_for_jobs_new(bus, &w);
 		if (r < 0)
 			return log_error_errno(r, "Could not watch jobs: %m");
 	}
 
-	STRV_FOREACH (name, names) {
-		_cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-		int q;
+	/* Let the manager expand the names and queue all jobs at once */
+	if (!one_name && !streq(mode, "isolate")) {
+		_cleanup_strv_free_ char **mangled = NULL;
+		int status;
+
+		r = mangle_unit_globs(args + 1, suffix, &mangled);
+		if (r < 0)
+			return r;
 
-		q = start_unit_one(bus, method, *name, mode, &error, w);
-		if (r >= 0 && q < 0)
-			r = translate_bus_error_to_exit_status(q, &error);
+		r = start_units_batch(bus, method, mangled, mode, w, &names,
+			&status);
+		if (r < 0 && r != -EOPNOTSUPP)
+			return r;
+
+		batched = r >= 0;
+		r = batched ? status : 0;
+	}
+
+	if (!batched) {
+		if (one_name)
+			names = strv_new(one_name, NULL);
+		else {
+			r = expand_names(bus, args + 1, suffix, &names);
+			if (r < 0)
+				log_error_errno(r,
+					"Failed to expand names: %m");
+		}
+
+		STRV_FOREACH (name, names) {
+			_cleanup_bus_error_free_ sd_bus_error error =
+				SD_BUS_ERROR_NULL;
+			int q;
+
+			q = start_unit_one(bus, method, *name, mode, &error,
+				w);
+			if (r >= 0 && q < 0)
+				r = translate_bus_error_to_exit_status(q,
+					&error);
+		}
 	}
 
 	if (!arg_no_block) {
@@ -115,6 +115,7 @@ static const char *arg_root = NULL;
 static const char *arg_machine = NULL;
 static off_t arg_vacuum_size = (off_t)-1;
 static usec_t arg_vacuum_time = USEC_INFINITY;
+static unsigned arg_threads = 0;
 
 static enum {
 	ACTION_SHOW,
@@ -249,6 +250,16 @@ format_timestamp_maybe_utc(char *buf, size_t l, usec_t t)
 	return format_timestamp(buf, l, t);
 }
 
+static int
+flush_output(OutputPipeline *pipeline, bool *ellipsized)
+{
+	/* Without threads entries are written as they are shown */
+	if (!pipeline)
+		return 0;
+
+	return output_pipeline_flush(pipeline, ellipsized);
+}
+
 static int
 parse_boot_descriptor(const char *x, sd_id128_t *boot_id, int *offset)
 {
@@ -317,6 +328,7 @@ help(void)
 	       "                                   short-precise, short-monotonic, verbose,\n"
 	       "                                   export, json, json-pretty, json-sse, cat)\n"
 	       "     --utc                 Express time in Coordinated Universal Time (UTC)\n"
+	       "     --threads[=N]         Format entries on N threads, or one per CPU\n"
 	       "  -x --catalog             Add message explanations where available\n"
 	       "     --no-full             Ellipsize fields\n"
 	       "  -a --all                 Show all fields, including long and unprintable\n"
@@ -383,6 +395,7 @@ parse_argv(int argc, char *argv[])
 		ARG_FLUSH,
 		ARG_VACUUM_SIZE,
 		ARG_VACUUM_TIME,
+		ARG_THREADS,
 	};
 
 	static const struct option options[] = {
@@ -435,7 +448,8 @@ parse_argv(int argc, char *argv[])
 		{ "utc", no_argument, NULL, ARG_UTC },
 		{ "flush", no_argument, NULL, ARG_FLUSH },
 		{ "vacuum-size", required_argument, NULL, ARG_VACUUM_SIZE },
-		{ "vacuum-time", required_argument, NULL, ARG_VACUUM_TIME }, {}
+		{ "vacuum-time", required_argument, NULL, ARG_VACUUM_TIME },
+		{ "threads", optional_argument, NULL, ARG_THREADS }, {}
 	};
 
 	int c, r;
@@ -820,6 +834,26 @@ parse_argv(int argc, char *argv[])
 			arg_action = ACTION_FLUSH;
 			break;
 
+		case ARG_THREADS:
+			if (optarg) {
+				r = safe_atou(optarg, &arg_threads);
+				if (r < 0 || arg_threads == 0) {
+					log_error(
+						"Failed to parse number of threads '%s'",
+						optarg);
+					return -EINVAL;
+				}
+			} else {
+				long n;
+
+				n = sysconf(_SC_NPROCESSORS_ONLN);
+				arg_threads = n > 0 ? (unsigned)n : 1;
+			}
+
+			arg_threads = MIN(arg_threads, OUTPUT_THREADS_MAX);
+
+			break;
+
 		case '?':
 			return -EINVAL;
 
@@ -2046,11 +2080,13 @@ main(int argc, char *argv[])
 {
 	int r;
 	_cleanup_journal_close_ sd_journal *j = NULL;
+	_cleanup_output_pipeline_free_ OutputPipeline *pipeline = NULL;
 	bool need_seek = false;
 	sd_id128_t previous_boot_id;
 	bool previous_boot_id_valid = false, first_line = true;
 	int n_shown = 0;
 	bool ellipsized = false;
+	int flags;
 
 	setlocale(LC_ALL, "");
 	log_parse_environment();
@@ -2393,11 +2429,23 @@ main(int argc, char *argv[])
 		}
 	}
 
+	flags = arg_all * OUTPUT_SHOW_ALL | arg_full * OUTPUT_FULL_WIDTH |
+		colors_enabled() * OUTPUT_COLOR | arg_catalog * OUTPUT_CATALOG |
+		arg_utc * OUTPUT_UTC;
+
+	/* One thread is no better than formatting entries right away */
+	if (arg_threads > 1) {
+		r = output_pipeline_new(&pipeline, stdout, arg_threads,
+			arg_output, 0, flags);
+		if (r < 0) {
+			log_error_errno(r, "Failed to start threads: %m");
+			goto finish;
+		}
+	}
+
 	for (;;) {
 		while (arg_lines < 0 || n_shown < arg_lines ||
 			(arg_follow && !first_line)) {
-			int flags;
-
 			if (need_seek) {
 				if (!arg_reverse)
 					r = sd_journal_next(j);
@@ -2446,24 +2494,27 @@ main(int argc, char *argv[])
 				if (r >= 0) {
 					if (previous_boot_id_valid &&
 						!sd_id128_equal(boot_id,
-							previous_boot_id))
+							previous_boot_id)) {
+						r = flush_output(pipeline,
+							&ellipsized);
+						if (r < 0)
+							goto finish;
+
 						printf("%s-- Reboot --%s\n",
 							ansi_highlight(),
 							ansi_highlight_off());
+					}
 
 					previous_boot_id = boot_id;
 					previous_boot_id_valid = true;
 				}
 			}
 
-			flags = arg_all * OUTPUT_SHOW_ALL |
-				arg_full * OUTPUT_FULL_WIDTH |
-				colors_enabled() * OUTPUT_COLOR |
-				arg_catalog * OUTPUT_CATALOG |
-				arg_utc * OUTPUT_UTC;
-
-			r = output_journal(stdout, j, arg_output, 0, flags,
-				&ellipsized);
+			if (pipeline)
+				r = output_pipeline_add(pipeline, j);
+			else
+				r = output_journal(stdout, j, arg_output, 0,
+					flags, &ellipsized);
 			need_seek = true;
 			if (r == -EADDRNOTAVAIL)
 				break;
@@ -2488,6 +2539,10 @@ main(int argc, char *argv[])
 			}
 		}
 
+		r = flush_output(pipeline, &ellipsized);
+		if (r < 0)
+			goto finish;
+
 		if (!arg_follow) {
 			if (arg_show_cursor) {
 				_cleanup_free_ char *cursor = NULL;
@@ -2514,6 +2569,15 @@ main(int argc, char *argv[])
 	}
 
 finish:
+	if (pipeline) {
+		int k;
+
+		/* Write out whatever was formatted until we stopped */
+		k = flush_output(pipeline, &ellipsized);
+		if (k < 0 && r >= 0)
+			r = k;
+	}
+
 	pager_close();
 
 	strv_free(arg_file);
@@ -808,8 +808,7 @@ dispatch_message_real(Server *s, struct iovec *iovec, unsigned n, unsigned m,
 		o_owner_uid[sizeof("OBJECT_SYSTEMD_OWNER_UID=") +
 			DECIMAL_STR_MAX(uid_t)];
 	_cleanup_free_ char *cmdline1 = NULL, *cmdline2 = NULL;
-	uid_t object_uid;
-	gid_t object_gid;
+	ProcessInfo info;
 	char *x;
 	int r;
 	char *t, *c;
@@ -848,33 +847,35 @@ dispatch_message_real(Server *s, struct iovec *iovec, unsigned n, unsigned m,
 		sprintf(gid, "_GID=" GID_FMT, ucred->gid);
 		IOVEC_SET_STRING(iovec[n++], gid);
 
-		r = get_process_comm(ucred->pid, &t);
+		r = get_process_info(ucred->pid,
+			PROCESS_INFO_COMM | PROCESS_INFO_EXE |
+				PROCESS_INFO_CMDLINE | PROCESS_INFO_CAPEFF,
+			&info);
 		if (r >= 0) {
-			x = strjoina("_COMM=", t);
-			free(t);
-			IOVEC_SET_STRING(iovec[n++], x);
-		}
+			if (info.mask & PROCESS_INFO_COMM) {
+				x = strjoina("_COMM=", info.comm);
+				IOVEC_SET_STRING(iovec[n++], x);
+			}
 
-		r = get_process_exe(ucred->pid, &t);
-		if (r >= 0) {
-			x = strjoina("_EXE=", t);
-			free(t);
-			IOVEC_SET_STRING(iovec[n++], x);
-		}
+			if (info.mask & PROCESS_INFO_EXE) {
+				x = strjoina("_EXE=", info.exe);
+				IOVEC_SET_STRING(iovec[n++], x);
+			}
 
-		r = get_process_cmdline(ucred->pid, 0, false, &t);
-		if (r >= 0) {
 			/* At most _SC_ARG_MAX (2MB usually), which is too much to put on stack.
                          * Let's use a heap allocation for this one. */
-			cmdline1 = set_iovec_field_free(iovec, &n,
-				"_CMDLINE=", t);
-		}
+			if (info.mask & PROCESS_INFO_CMDLINE) {
+				cmdline1 = set_iovec_field_free(iovec, &n,
+					"_CMDLINE=", info.cmdline);
+				info.cmdline = NULL;
+			}
 
-		r = get_process_capeff(ucred->pid, &t);
-		if (r >= 0) {
-			x = strjoina("_CAP_EFFECTIVE=", t);
-			free(t);
-			IOVEC_SET_STRING(iovec[n++], x);
+			if (info.mask & PROCESS_INFO_CAPEFF) {
+				x = strjoina("_CAP_EFFECTIVE=", info.capeff);
+				IOVEC_SET_STRING(iovec[n++], x);
+			}
+
+			process_info_done(&info);
 		}
 
 #ifdef HAVE_AUDIT
@@ -971,36 +972,42 @@ dispatch_message_real(Server *s, struct iovec *iovec, unsigned n, unsigned m,
 	assert(n <= m);
 
 	if (object_pid) {
-		r = get_process_uid(object_pid, &object_uid);
+		r = get_process_info(object_pid,
+			PROCESS_INFO_UID | PROCESS_INFO_GID |
+				PROCESS_INFO_COMM | PROCESS_INFO_EXE |
+				PROCESS_INFO_CMDLINE,
+			&info);
 		if (r >= 0) {
-			sprintf(o_uid, "OBJECT_UID=" UID_FMT, object_uid);
-			IOVEC_SET_STRING(iovec[n++], o_uid);
-		}
+			if (info.mask & PROCESS_INFO_UID) {
+				sprintf(o_uid, "OBJECT_UID=" UID_FMT,
+					info.uid);
+				IOVEC_SET_STRING(iovec[n++], o_uid);
+			}
 
-		r = get_process_gid(object_pid, &object_gid);
-		if (r >= 0) {
-			sprintf(o_gid, "OBJECT_GID=" GID_FMT, object_gid);
-			IOVEC_SET_STRING(iovec[n++], o_gid);
-		}
+			if (info.mask & PROCESS_INFO_GID) {
+				sprintf(o_gid, "OBJECT_GID=" GID_FMT,
+					info.gid);
+				IOVEC_SET_STRING(iovec[n++], o_gid);
+			}
 
-		r = get_process_comm(object_pid, &t);
-		if (r >= 0) {
-			x = strjoina("OBJECT_COMM=", t);
-			free(t);
-			IOVEC_SET_STRING(iovec[n++], x);
-		}
+			if (info.mask & PROCESS_INFO_COMM) {
+				x = strjoina("OBJECT_COMM=", info.comm);
+				IOVEC_SET_STRING(iovec[n++], x);
+			}
 
-		r = get_process_exe(object_pid, &t);
-		if (r >= 0) {
-			x = strjoina("OBJECT_EXE=", t);
-			free(t);
-			IOVEC_SET_STRING(iovec[n++], x);
-		}
+			if (info.mask & PROCESS_INFO_EXE) {
+				x = strjoina("OBJECT_EXE=", info.exe);
+				IOVEC_SET_STRING(iovec[n++], x);
+			}
 
-		r = get_process_cmdline(object_pid, 0, false, &t);
-		if (r >= 0)
-			cmdline2 = set_iovec_field_free(iovec, &n,
-				"OBJECT_CMDLINE=", t);
+			if (info.mask & PROCESS_INFO_CMDLINE) {
+				cmdline2 = set_iovec_field_free(iovec, &n,
+					"OBJECT_CMDLINE=", info.cmdline);
+				info.cmdline = NULL;
+			}
+
+			process_info_done(&info);
+		}
 
 #ifdef HAVE_AUDIT
 		r = audit_session_from_pid(object_pid, &audit);
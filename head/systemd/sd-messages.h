@@ -51,6 +51,9 @@ _SD_BEGIN_DECLARATIONS;
 #define SD_MESSAGE_COREDUMP                                                    \
 	SD_ID128_MAKE(fc, 2e, 22, bc, 6e, e6, 47, b6, b9, 07, 29, ab, 34, a2,  \
 		50, b1)
+#define SD_MESSAGE_COREDUMP_STACKTRACE                                         \
+	SD_ID128_MAKE(8f, d3, d9, 7a, e1, 08, 4d, 6c, 91, 7e, 06, 77, cd, f0,  \
+		98, c9)
 
 #define SD_MESSAGE_SESSION_START                                               \
 	SD_ID128_MAKE(8d, 45, 62, 0c, 1a, 43, 48, db, b1, 74, 10, da, 57, c6,  \
@@ -44,17 +44,24 @@ int sd_rtnl_new_from_netlink(sd_rtnl **nl, int fd);
 int sd_rtnl_open(sd_rtnl **nl, unsigned n_groups, ...);
 int sd_rtnl_open_fd(sd_rtnl **nl, int fd, unsigned n_groups, ...);
 int sd_rtnl_inc_rcvbuf(const sd_rtnl *const rtnl, const int size);
+int sd_rtnl_set_strict_check(sd_rtnl *nl, int b);
 
 sd_rtnl *sd_rtnl_ref(sd_rtnl *nl);
 sd_rtnl *sd_rtnl_unref(sd_rtnl *nl);
 
 int sd_rtnl_send(sd_rtnl *nl, sd_rtnl_message *message, uint32_t *serial);
+int sd_rtnl_send_many(sd_rtnl *nl, sd_rtnl_message **messages, unsigned n,
+	uint32_t *serials);
 int sd_rtnl_call_async(sd_rtnl *nl, sd_rtnl_message *message,
 	sd_rtnl_message_handler_t callback, void *userdata, uint64_t usec,
 	uint32_t *serial);
 int sd_rtnl_call_async_cancel(sd_rtnl *nl, uint32_t serial);
 int sd_rtnl_call(sd_rtnl *nl, sd_rtnl_message *message, uint64_t timeout,
 	sd_rtnl_message **reply);
+int sd_rtnl_call_many(sd_rtnl *nl, sd_rtnl_message **messages, unsigned n,
+	uint64_t timeout, sd_rtnl_message **replies);
+int sd_rtnl_call_dump(sd_rtnl *nl, sd_rtnl_message *message, uint64_t timeout,
+	sd_rtnl_message_handler_t callback, void *userdata);
 
 int sd_rtnl_get_events(sd_rtnl *nl);
 int sd_rtnl_get_timeout(sd_rtnl *nl, uint64_t *timeout);
@@ -17,47 +17,126 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/ioctl.h>
+#include <pthread.h>
+
 #include "bsdxattr.h"
 
 #include "copy.h"
 #include "util.h"
 
-#ifdef SVC_HAVE_sys_sendfile_h
+#ifdef HAVE_sys_sendfile_h
 #include <sys/sendfile.h>
 #endif
 
+#if defined(SVC_PLATFORM_Linux) || defined(HAVE_copy_file_range)
+#define USE_COPY_FILE_RANGE 1
+#endif
+
 #define COPY_BUFFER_SIZE (16 * 1024)
 
-int
-copy_bytes(int fdf, int fdt, off_t max_bytes, bool try_reflink)
+/* The most we ask the kernel to copy in one go */
+#define COPY_CHUNK_MAX ((size_t)(1024 * 1024 * 1024))
+
+/* Regular files of a tree are copied by up to this many threads, with
+ * up to this many files queued for them */
+#define COPY_THREADS_MAX 4U
+#define COPY_JOBS_MAX 32U
+
+typedef struct CopyMethods {
+	bool try_copy_file_range;
+	bool try_sendfile;
+} CopyMethods;
+
+#define COPY_METHODS_INIT                                                      \
+	{                                                                      \
+		.try_copy_file_range = true, .try_sendfile = true,             \
+	}
+
+static int
+reflink_fd(int fdf, int fdt)
 {
-	bool try_sendfile = true;
-	int r;
+#ifdef SVC_PLATFORM_Linux
+	struct stat a, b;
 
-	assert(fdf >= 0);
-	assert(fdt >= 0);
+	/* A clone replaces the whole destination, hence only use it if
+         * all of the source is to be copied into an empty file */
+
+	if (fstat(fdf, &a) < 0 || fstat(fdt, &b) < 0)
+		return -errno;
+
+	if (!S_ISREG(a.st_mode) || !S_ISREG(b.st_mode) || b.st_size != 0)
+		return -EINVAL;
+
+	if (lseek(fdf, 0, SEEK_CUR) != 0)
+		return -EINVAL;
+
+	if (ioctl(fdt, FICLONE, fdf) < 0)
+		return -errno;
+
+	/* Leave the file offsets where a regular copy would have */
+	if (lseek(fdf, 0, SEEK_END) < 0 || lseek(fdt, 0, SEEK_END) < 0)
+		return -errno;
+
+	return 0;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
+/* Copies max_bytes bytes, or everything up to EOF if max_bytes is -1.
+ * Returns 1 if we stopped because of the limit, 0 on EOF. */
+static int
+copy_range(int fdf, int fdt, off_t max_bytes, CopyMethods *c)
+{
+	bool copied = false;
+	int r;
 
 	for (;;) {
-		size_t m = COPY_BUFFER_SIZE;
+		size_t m = COPY_CHUNK_MAX;
 		ssize_t n;
 
 		if (max_bytes != (off_t)-1) {
 			if (max_bytes <= 0)
-				return -EFBIG;
+				return 1;
 
 			if ((off_t)m > max_bytes)
 				m = (size_t)max_bytes;
 		}
 
+#ifdef USE_COPY_FILE_RANGE
+		/* First, let the file system copy the data for us. It
+                 * might share or clone extents rather than copying
+                 * them, and never moves the data through userspace. */
+		if (c->try_copy_file_range) {
+			n = copy_file_range(fdf, NULL, fdt, NULL, m, 0);
+			if (n < 0) {
+				if (!IN_SET(errno, EINVAL, ENOSYS, EXDEV,
+					    EBADF, EOPNOTSUPP, ETXTBSY))
+					return -errno;
+
+				c->try_copy_file_range = false;
+				/* use fallback below */
+			} else if (n == 0 && !copied) {
+				/* Files in virtual file systems claim to be
+                                 * empty, don't trust this */
+				c->try_copy_file_range = false;
+			} else if (n == 0) /* EOF */
+				break;
+			else
+				goto next;
+		}
+#endif
+
 #ifdef HAVE_sys_sendfile_h
-		/* First try sendfile(), unless we already tried */
-		if (try_sendfile) {
+		/* Then try sendfile(), unless we already tried */
+		if (c->try_sendfile) {
 			n = sendfile(fdt, fdf, NULL, m);
 			if (n < 0) {
 				if (errno != EINVAL && errno != ENOSYS)
 					return -errno;
 
-				try_sendfile = false;
+				c->try_sendfile = false;
 				/* use fallback below */
 			} else if (n == 0) /* EOF */
 				break;
@@ -69,9 +148,9 @@ copy_bytes(int fdf, int fdt, off_t max_bytes, bool try_reflink)
 
 		/* As a fallback just copy bits by hand */
 		{
-			char buf[m];
+			char buf[MIN(m, (size_t)COPY_BUFFER_SIZE)];
 
-			n = read(fdf, buf, m);
+			n = read(fdf, buf, sizeof(buf));
 			if (n < 0)
 				return -errno;
 			if (n == 0) /* EOF */
@@ -83,12 +162,210 @@ copy_bytes(int fdf, int fdt, off_t max_bytes, bool try_reflink)
 		}
 
 	next:
+		copied = true;
+
+		if (max_bytes != (off_t)-1) {
+			assert(max_bytes >= n);
+			max_bytes -= n;
+		}
+	}
+
+	return 0;
+}
+
+static int
+copy_data_extents(int fdf, int fdt, CopyMethods *c)
+{
+#ifdef SEEK_DATA
+	off_t start, dstart, data, hole;
+	struct stat a, b;
+	int r;
+
+	/* Copies only the parts of a sparse file that contain data, and
+         * seeks over the holes in between, so that they stay holes in
+         * the destination. */
+
+	if (fstat(fdf, &a) < 0 || fstat(fdt, &b) < 0)
+		return -errno;
+
+	if (!S_ISREG(a.st_mode) || !S_ISREG(b.st_mode))
+		return -EOPNOTSUPP;
+
+	/* Files without holes are copied faster in one go */
+	if ((off_t)a.st_blocks * 512 >= a.st_size)
+		return -EOPNOTSUPP;
+
+	start = lseek(fdf, 0, SEEK_CUR);
+	if (start < 0)
+		return -errno;
+
+	dstart = lseek(fdt, 0, SEEK_CUR);
+	if (dstart < 0)
+		return -errno;
+
+	/* Skipping over a hole would leave old data in place */
+	if (start >= a.st_size || b.st_size > dstart)
+		return -EOPNOTSUPP;
+
+	for (data = start;;) {
+		data = lseek(fdf, data, SEEK_DATA);
+		if (data < 0) {
+			if (errno == ENXIO) /* Only a hole left */
+				break;
+
+			return -errno;
+		}
+
+		hole = lseek(fdf, data, SEEK_HOLE);
+		if (hole < 0)
+			return -errno;
+
+		if (lseek(fdf, data, SEEK_SET) < 0 ||
+			lseek(fdt, dstart + data - start, SEEK_SET) < 0)
+			return -errno;
+
+		r = copy_range(fdf, fdt, hole - data, c);
+		if (r < 0)
+			return r;
+		if (r == 0) /* The file shrank while we copied it */
+			break;
+
+		data = hole;
+	}
+
+	/* Make sure trailing holes are accounted for */
+	if (fstat(fdf, &a) < 0 || fstat(fdt, &b) < 0)
+		return -errno;
+
+	if (b.st_size < dstart + a.st_size - start &&
+		ftruncate(fdt, dstart + a.st_size - start) < 0)
+		return -errno;
+
+	if (lseek(fdf, a.st_size, SEEK_SET) < 0 ||
+		lseek(fdt, dstart + a.st_size - start, SEEK_SET) < 0)
+		return -errno;
+
+	return 0;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
+int
+copy_bytes(int fdf, int fdt, off_t max_bytes, bool try_reflink)
+{
+	CopyMethods c = COPY_METHODS_INIT;
+	int r;
+
+	assert(fdf >= 0);
+	assert(fdt >= 0);
+
+	if (max_bytes == (off_t)-1) {
+		if (try_reflink && reflink_fd(fdf, fdt) >= 0)
+			return 0;
+
+		r = copy_data_extents(fdf, fdt, &c);
+		if (r != -EOPNOTSUPP)
+			return r;
+	}
+
+	r = copy_range(fdf, fdt, max_bytes, &c);
+	if (r < 0)
+		return r;
+
+	return r > 0 ? -EFBIG : 0;
+}
+
+#define SPARSE_BLOCK_SIZE 4096
+
+static bool
+block_is_zero(const uint8_t *p, size_t n)
+{
+	n = MIN(n, (size_t)SPARSE_BLOCK_SIZE);
+
+	return p[0] == 0 && memcmp(p, p + 1, n - 1) == 0;
+}
+
+int
+copy_bytes_sparse(int fdf, int fdt, off_t max_bytes)
+{
+	_cleanup_free_ uint8_t *buf = NULL;
+	off_t offset;
+
+	assert(fdf >= 0);
+	assert(fdt >= 0);
+
+	/* Like copy_bytes(), but instead of writing blocks that contain
+         * only zeroes, seeks over them, so that they become holes in
+         * the destination, which needs to be a regular file. */
+
+	buf = malloc(COPY_BUFFER_SIZE * 8);
+	if (!buf)
+		return -ENOMEM;
+
+	offset = lseek(fdt, 0, SEEK_CUR);
+	if (offset < 0)
+		return -errno;
+
+	for (;;) {
+		size_t m = COPY_BUFFER_SIZE * 8, i;
+		ssize_t n;
+
+		if (max_bytes != (off_t)-1) {
+			if (max_bytes <= 0)
+				return -EFBIG;
+
+			if ((off_t)m > max_bytes)
+				m = (size_t)max_bytes;
+		}
+
+		n = loop_read(fdf, buf, m, false);
+		if (n < 0)
+			return n;
+		if (n == 0) /* EOF */
+			break;
+
+		for (i = 0; i < (size_t)n;) {
+			size_t l;
+			bool zero;
+			int r;
+
+			/* Find the run of blocks that are all data or all
+                         * zeroes */
+			zero = block_is_zero(buf + i, (size_t)n - i);
+			for (l = SPARSE_BLOCK_SIZE; i + l < (size_t)n;
+				l += SPARSE_BLOCK_SIZE) {
+				size_t left = (size_t)n - i - l;
+
+				if (block_is_zero(buf + i + l, left) != zero)
+					break;
+			}
+
+			l = MIN(l, (size_t)n - i);
+
+			if (zero) {
+				if (lseek(fdt, l, SEEK_CUR) < 0)
+					return -errno;
+			} else {
+				r = loop_write(fdt, buf + i, l, false);
+				if (r < 0)
+					return r;
+			}
+
+			i += l;
+			offset += l;
+		}
+
 		if (max_bytes != (off_t)-1) {
 			assert(max_bytes >= n);
 			max_bytes -= n;
 		}
 	}
 
+	/* Make sure trailing holes are accounted for */
+	if (ftruncate(fdt, offset) < 0)
+		return -errno;
+
 	return 0;
 }
 
@@ -117,16 +394,11 @@ fd_copy_symlink(int df, const char *from, const struct stat *st, int dt,
 }
 
 static int
-fd_copy_regular(int df, const char *from, const struct stat *st, int dt,
-	const char *to)
+fd_copy_regular_open(int df, const char *from, const struct stat *st, int dt,
+	const char *to, int *ret_fdf, int *ret_fdt)
 {
-	_cleanup_close_ int fdf = -1, fdt = -1;
-	struct timespec ts[2];
-	int r, q;
-
-	assert(from);
-	assert(st);
-	assert(to);
+	_cleanup_close_ int fdf = -1;
+	int fdt;
 
 	fdf = openat(df, from, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW);
 	if (fdf < 0)
@@ -138,8 +410,23 @@ fd_copy_regular(int df, const char *from, const struct stat *st, int dt,
 	if (fdt < 0)
 		return -errno;
 
+	*ret_fdf = fdf;
+	*ret_fdt = fdt;
+	fdf = -1;
+
+	return 0;
+}
+
+static int
+fd_copy_regular_data(int fdf, int fdt, const struct stat *st, int dt,
+	const char *to)
+{
+	struct timespec ts[2];
+	int r, q;
+
 	r = copy_bytes(fdf, fdt, (off_t)-1, true);
 	if (r < 0) {
+		safe_close(fdt);
 		unlinkat(dt, to, 0);
 		return r;
 	}
@@ -157,8 +444,6 @@ fd_copy_regular(int df, const char *from, const struct stat *st, int dt,
 	(void)copy_xattr(fdf, fdt);
 
 	q = close(fdt);
-	fdt = -1;
-
 	if (q < 0) {
 		r = -errno;
 		unlinkat(dt, to, 0);
@@ -167,6 +452,180 @@ fd_copy_regular(int df, const char *from, const struct stat *st, int dt,
 	return r;
 }
 
+static int
+fd_copy_regular(int df, const char *from, const struct stat *st, int dt,
+	const char *to)
+{
+	_cleanup_close_ int fdf = -1;
+	int fdt = -1, r;
+
+	assert(from);
+	assert(st);
+	assert(to);
+
+	r = fd_copy_regular_open(df, from, st, dt, to, &fdf, &fdt);
+	if (r < 0)
+		return r;
+
+	return fd_copy_regular_data(fdf, fdt, st, dt, to);
+}
+
+/* While a tree is copied, the directory walk creates each regular file
+ * and then leaves copying its contents to a pool of threads */
+
+typedef struct CopyJob {
+	int fdf, fdt, dt;
+	char *to;
+	struct stat st;
+} CopyJob;
+
+typedef struct CopyPool {
+	pthread_mutex_t mutex;
+	pthread_cond_t queued;
+	pthread_cond_t dequeued;
+
+	CopyJob jobs[COPY_JOBS_MAX];
+	unsigned first, n_jobs;
+
+	pthread_t threads[COPY_THREADS_MAX];
+	unsigned n_threads, n_threads_max;
+
+	bool done;
+	int r;
+} CopyPool;
+
+static void
+copy_job_run(CopyPool *p, CopyJob *j)
+{
+	int r;
+
+	r = fd_copy_regular_data(j->fdf, j->fdt, &j->st, j->dt, j->to);
+
+	safe_close(j->fdf);
+	safe_close(j->dt);
+	free(j->to);
+
+	if (r < 0) {
+		pthread_mutex_lock(&p->mutex);
+		p->r = r;
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+
+static void *
+copy_pool_thread(void *userdata)
+{
+	CopyPool *p = userdata;
+
+	for (;;) {
+		CopyJob j;
+
+		pthread_mutex_lock(&p->mutex);
+
+		while (p->n_jobs == 0 && !p->done)
+			pthread_cond_wait(&p->queued, &p->mutex);
+
+		if (p->n_jobs == 0) {
+			pthread_mutex_unlock(&p->mutex);
+			break;
+		}
+
+		j = p->jobs[p->first];
+		p->first = (p->first + 1) % COPY_JOBS_MAX;
+		p->n_jobs--;
+
+		pthread_cond_signal(&p->dequeued);
+		pthread_mutex_unlock(&p->mutex);
+
+		copy_job_run(p, &j);
+	}
+
+	return NULL;
+}
+
+static void
+copy_pool_init(CopyPool *p)
+{
+	long n;
+
+	zero(*p);
+
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->queued, NULL);
+	pthread_cond_init(&p->dequeued, NULL);
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	p->n_threads_max = n > 1 ? MIN((unsigned)n, COPY_THREADS_MAX) : 0;
+}
+
+static int
+copy_pool_submit(CopyPool *p, int df, const char *from, const struct stat *st,
+	int dt, const char *to)
+{
+	_cleanup_close_ int fdf = -1;
+	CopyJob j = {};
+	int fdt = -1, r;
+
+	r = fd_copy_regular_open(df, from, st, dt, to, &fdf, &fdt);
+	if (r < 0)
+		return r;
+
+	/* Start threads lazily, so that we need none for trees without
+         * any files to copy */
+	if (p->n_threads < p->n_threads_max &&
+		pthread_create(&p->threads[p->n_threads], NULL,
+			copy_pool_thread, p) == 0)
+		p->n_threads++;
+	else if (p->n_threads == 0)
+		p->n_threads_max = 0;
+
+	j.dt = fcntl(dt, F_DUPFD_CLOEXEC, 3);
+	j.to = strdup(to);
+	if (p->n_threads == 0 || j.dt < 0 || !j.to) {
+		safe_close(j.dt);
+		free(j.to);
+		return fd_copy_regular_data(fdf, fdt, st, dt, to);
+	}
+
+	j.fdf = fdf;
+	j.fdt = fdt;
+	j.st = *st;
+	fdf = -1;
+
+	pthread_mutex_lock(&p->mutex);
+
+	while (p->n_jobs >= COPY_JOBS_MAX)
+		pthread_cond_wait(&p->dequeued, &p->mutex);
+
+	p->jobs[(p->first + p->n_jobs) % COPY_JOBS_MAX] = j;
+	p->n_jobs++;
+
+	pthread_cond_signal(&p->queued);
+	pthread_mutex_unlock(&p->mutex);
+
+	return 0;
+}
+
+static int
+copy_pool_finish(CopyPool *p)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&p->mutex);
+	p->done = true;
+	pthread_cond_broadcast(&p->queued);
+	pthread_mutex_unlock(&p->mutex);
+
+	for (i = 0; i < p->n_threads; i++)
+		pthread_join(p->threads[i], NULL);
+
+	pthread_cond_destroy(&p->dequeued);
+	pthread_cond_destroy(&p->queued);
+	pthread_mutex_destroy(&p->mutex);
+
+	return p->r;
+}
+
 static int
 fd_copy_fifo(int df, const char *from, const struct stat *st, int dt,
 	const char *to)
@@ -215,7 +674,7 @@ fd_copy_node(int df, const char *from, const struct stat *st, int dt,
 
 static int
 fd_copy_directory(int df, const char *from, const struct stat *st, int dt,
-	const char *to, dev_t original_device, bool merge)
+	const char *to, dev_t original_device, bool merge, CopyPool *pool)
 {
 	_cleanup_close_ int fdf = -1, fdt = -1;
 	_cleanup_closedir_ DIR *d = NULL;
@@ -280,10 +739,10 @@ fd_copy_directory(int df, const char *from, const struct stat *st, int dt,
 			if (buf.st_dev != original_device)
 				continue;
 			q = fd_copy_directory(dirfd(d), de->d_name, &buf, fdt,
-				de->d_name, original_device, merge);
+				de->d_name, original_device, merge, pool);
 		} else if (S_ISREG(buf.st_mode))
-			q = fd_copy_regular(dirfd(d), de->d_name, &buf, fdt,
-				de->d_name);
+			q = copy_pool_submit(pool, dirfd(d), de->d_name, &buf,
+				fdt, de->d_name);
 		else if (S_ISLNK(buf.st_mode))
 			q = fd_copy_symlink(dirfd(d), de->d_name, &buf, fdt,
 				de->d_name);
@@ -306,6 +765,25 @@ fd_copy_directory(int df, const char *from, const struct stat *st, int dt,
 	return r;
 }
 
+static int
+fd_copy_tree(int df, const char *from, const struct stat *st, int dt,
+	const char *to, bool merge)
+{
+	CopyPool pool;
+	int r, q;
+
+	copy_pool_init(&pool);
+
+	r = fd_copy_directory(df, from, st, dt, to, st->st_dev, merge, &pool);
+
+	/* Wait until all files are complete */
+	q = copy_pool_finish(&pool);
+	if (q < 0)
+		r = q;
+
+	return r;
+}
+
 int
 copy_tree_at(int fdf, const char *from, int fdt, const char *to, bool merge)
 {
@@ -320,8 +798,7 @@ copy_tree_at(int fdf, const char *from, int fdt, const char *to, bool merge)
 	if (S_ISREG(st.st_mode))
 		return fd_copy_regular(fdf, from, &st, fdt, to);
 	else if (S_ISDIR(st.st_mode))
-		return fd_copy_directory(fdf, from, &st, fdt, to, st.st_dev,
-			merge);
+		return fd_copy_tree(fdf, from, &st, fdt, to, merge);
 	else if (S_ISLNK(st.st_mode))
 		return fd_copy_symlink(fdf, from, &st, fdt, to);
 	else if (S_ISFIFO(st.st_mode))
@@ -352,8 +829,7 @@ copy_directory_fd(int dirfd, const char *to, bool merge)
 	if (!S_ISDIR(st.st_mode))
 		return -ENOTDIR;
 
-	return fd_copy_directory(dirfd, NULL, &st, AT_FDCWD, to, st.st_dev,
-		merge);
+	return fd_copy_tree(dirfd, NULL, &st, AT_FDCWD, to, merge);
 }
 
 int
@@ -32,5 +32,6 @@ int copy_tree_at(int fdf, const char *from, int fdt, const char *to,
 	bool merge);
 int copy_directory_fd(int dirfd, const char *to, bool merge);
 int copy_bytes(int fdf, int fdt, off_t max_bytes, bool try_reflink);
+int copy_bytes_sparse(int fdf, int fdt, off_t max_bytes);
 int copy_times(int fdf, int fdt);
 int copy_xattr(int fdf, int fdt);
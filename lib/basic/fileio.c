@@ -555,22 +555,35 @@ parse_env_file_push(const char *filename, unsigned line, const char *key,
 }
 
 int
-parse_env_file(const char *fname, const char *newline, ...)
+parse_env_filev(const char *fname, const char *newline, va_list ap)
 {
-	va_list ap;
+	va_list aq;
 	int r, n_pushed = 0;
 
 	if (!newline)
 		newline = NEWLINE;
 
-	va_start(ap, newline);
+	va_copy(aq, ap);
 	r = parse_env_file_internal(NULL, fname, newline, parse_env_file_push,
-		&ap, &n_pushed);
-	va_end(ap);
+		&aq, &n_pushed);
+	va_end(aq);
 
 	return r < 0 ? r : n_pushed;
 }
 
+int
+parse_env_file(const char *fname, const char *newline, ...)
+{
+	va_list ap;
+	int r;
+
+	va_start(ap, newline);
+	r = parse_env_filev(fname, newline, ap);
+	va_end(ap);
+
+	return r;
+}
+
 static int
 load_env_file_push(const char *filename, unsigned line, const char *key,
 	char *value, void *userdata, int *n_pushed)
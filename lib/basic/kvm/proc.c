@@ -31,12 +31,16 @@
 #define p_comm kp_comm
 #define p_ruid kp_ruid
 #define p_rgid kp_rgid
+#define p_uid kp_uid
+#define p_gid kp_groups[0]
 #elif defined(SVC_PLATFORM_FreeBSD)
 #define p_ppid ki_ppid
 #define p_stat ki_stat
 #define p_comm ki_comm
 #define p_ruid ki_ruid
 #define p_rgid ki_rgid
+#define p_uid ki_uid
+#define p_gid ki_groups[0]
 #elif defined(SVC_PLATFORM_OpenBSD)
 /* epsilon */
 #else
@@ -190,3 +194,64 @@ get_process_gid(pid_t pid, gid_t *gid)
 	struct kinfo_proc *info = get_pid_info(pid);
 	return info->p_rgid;
 }
+
+int
+get_process_info(pid_t pid, ProcessInfoMask mask, ProcessInfo *ret)
+{
+	struct kinfo_proc *info;
+	ProcessInfo i = {};
+	char **argv = NULL;
+
+	assert(ret);
+
+	/* One kvm_getprocs() call serves all fields but the command line
+         * and executable, which come from the argument vector. The
+         * effective capability set has no equivalent here. */
+	info = get_pid_info(pid);
+	if (!info)
+		return -ESRCH;
+
+	i.uid = info->p_ruid;
+	i.euid = info->p_uid;
+	i.gid = info->p_rgid;
+	i.egid = info->p_gid;
+	i.ppid = info->p_ppid;
+	i.mask = mask &
+		(PROCESS_INFO_UID | PROCESS_INFO_GID | PROCESS_INFO_PPID);
+
+	if (mask & PROCESS_INFO_COMM) {
+		i.comm = strdup(info->p_comm);
+		if (!i.comm)
+			goto oom;
+
+		i.mask |= PROCESS_INFO_COMM;
+	}
+
+	if (mask & (PROCESS_INFO_CMDLINE | PROCESS_INFO_EXE))
+		argv = kvm_getargv(g_kd, info, 0);
+
+	if (argv && argv[0]) {
+		if (mask & PROCESS_INFO_CMDLINE) {
+			i.cmdline = strv_join(argv, " ");
+			if (!i.cmdline)
+				goto oom;
+
+			i.mask |= PROCESS_INFO_CMDLINE;
+		}
+
+		if (mask & PROCESS_INFO_EXE) {
+			i.exe = strdup(argv[0]);
+			if (!i.exe)
+				goto oom;
+
+			i.mask |= PROCESS_INFO_EXE;
+		}
+	}
+
+	*ret = i;
+	return 0;
+
+oom:
+	process_info_done(&i);
+	return -ENOMEM;
+}
@@ -0,0 +1,427 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "login-snapshot.h"
+#include "strv.h"
+#include "util.h"
+
+struct LoginSnapshot {
+	unsigned n_ref;
+
+	void *map;
+	size_t size;
+
+	dev_t dev;
+	ino_t ino;
+};
+
+typedef struct SnapshotBuffer {
+	uint8_t *data;
+	size_t size;
+	size_t allocated;
+} SnapshotBuffer;
+
+static int
+buffer_reserve(SnapshotBuffer *b, size_t align, size_t size, uint64_t *ret)
+{
+	size_t offset;
+
+	offset = ALIGN_TO(b->size, align);
+	if (offset + size > UINT32_MAX)
+		return -E2BIG;
+
+	if (!GREEDY_REALLOC0(b->data, b->allocated, offset + size))
+		return -ENOMEM;
+
+	b->size = offset + size;
+	*ret = offset;
+	return 0;
+}
+
+static int
+buffer_put_string(SnapshotBuffer *b, const char *s, uint32_t *ret)
+{
+	uint64_t offset;
+	size_t l;
+	int r;
+
+	l = strlen(s) + 1;
+
+	r = buffer_reserve(b, 1, l, &offset);
+	if (r < 0)
+		return r;
+
+	memcpy(b->data + offset, s, l);
+	*ret = (uint32_t)offset;
+	return 0;
+}
+
+static int
+object_compare(const void *a, const void *b)
+{
+	const LoginSnapshotObject *x = a, *y = b;
+
+	return strcmp(x->name, y->name);
+}
+
+static int
+buffer_put_table(SnapshotBuffer *b, LoginSnapshotObject *objects,
+	size_t n_objects, uint64_t *ret)
+{
+	uint64_t table;
+	size_t i;
+	int r;
+
+	/* Readers look entries up by bisection */
+	qsort_safe(objects, n_objects, sizeof(LoginSnapshotObject),
+		object_compare);
+
+	r = buffer_reserve(b, 8, n_objects * sizeof(LoginSnapshotEntry),
+		&table);
+	if (r < 0)
+		return r;
+
+	for (i = 0; i < n_objects; i++) {
+		LoginSnapshotEntry e = {};
+		uint64_t fields;
+		size_t n_fields, j;
+
+		n_fields = strv_length(objects[i].fields) / 2;
+
+		r = buffer_put_string(b, objects[i].name, &e.name);
+		if (r < 0)
+			return r;
+
+		r = buffer_reserve(b, 4, n_fields * 2 * sizeof(uint32_t),
+			&fields);
+		if (r < 0)
+			return r;
+
+		for (j = 0; j < n_fields * 2; j++) {
+			uint32_t s;
+
+			r = buffer_put_string(b, objects[i].fields[j], &s);
+			if (r < 0)
+				return r;
+
+			/* The buffer might have moved */
+			memcpy(b->data + fields + j * sizeof(uint32_t), &s,
+				sizeof(s));
+		}
+
+		e.n_fields = n_fields;
+		e.fields_offset = fields;
+		e.inode = objects[i].inode;
+		memcpy(b->data + table + i * sizeof(LoginSnapshotEntry), &e,
+			sizeof(e));
+	}
+
+	*ret = table;
+	return 0;
+}
+
+int
+login_snapshot_write(const char *path, uint64_t generation,
+	LoginSnapshotObject *objects[_LOGIN_SNAPSHOT_KIND_MAX],
+	size_t n_objects[_LOGIN_SNAPSHOT_KIND_MAX])
+{
+	_cleanup_free_ char *temp_path = NULL;
+	_cleanup_fclose_ FILE *f = NULL;
+	SnapshotBuffer b = {};
+	LoginSnapshotHeader h = {};
+	uint64_t offset;
+	int r, k;
+
+	assert(path);
+
+	r = buffer_reserve(&b, 8, sizeof(LoginSnapshotHeader), &offset);
+	if (r < 0)
+		goto finish;
+
+	memcpy(h.signature, LOGIN_SNAPSHOT_SIGNATURE, sizeof(h.signature));
+	h.version = LOGIN_SNAPSHOT_VERSION;
+	h.header_size = sizeof(LoginSnapshotHeader);
+	h.generation = generation;
+
+	for (k = 0; k < _LOGIN_SNAPSHOT_KIND_MAX; k++) {
+		r = buffer_put_table(&b, objects[k], n_objects[k],
+			&h.table_offset[k]);
+		if (r < 0)
+			goto finish;
+
+		h.n_entries[k] = n_objects[k];
+	}
+
+	h.size = b.size;
+	memcpy(b.data, &h, sizeof(h));
+
+	r = fopen_temporary(path, &f, &temp_path);
+	if (r < 0)
+		goto finish;
+
+	fchmod(fileno(f), 0644);
+
+	fwrite(b.data, 1, b.size, f);
+	fflush(f);
+
+	if (ferror(f) || rename(temp_path, path) < 0) {
+		r = -errno;
+		unlink(temp_path);
+	}
+
+finish:
+	free(b.data);
+	return r;
+}
+
+static const void *
+snapshot_get(LoginSnapshot *s, uint64_t offset, uint64_t size)
+{
+	if (offset > s->size || size > s->size - offset)
+		return NULL;
+
+	return (const uint8_t *)s->map + offset;
+}
+
+static const char *
+snapshot_get_string(LoginSnapshot *s, uint32_t offset)
+{
+	const char *p;
+
+	if (offset >= s->size)
+		return NULL;
+
+	/* The string has to be terminated within the file */
+	p = (const char *)s->map + offset;
+	if (!memchr(p, 0, s->size - offset))
+		return NULL;
+
+	return p;
+}
+
+int
+login_snapshot_open(const char *path, LoginSnapshot **ret)
+{
+	_cleanup_close_ int fd = -1;
+	const LoginSnapshotHeader *h;
+	LoginSnapshot *s;
+	struct stat st;
+	void *p;
+	int k;
+
+	assert(path);
+	assert(ret);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+
+	if (st.st_size < (off_t)sizeof(LoginSnapshotHeader) ||
+		st.st_size > UINT32_MAX)
+		return -EBADMSG;
+
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -errno;
+
+	h = p;
+	if (memcmp(h->signature, LOGIN_SNAPSHOT_SIGNATURE,
+		    sizeof(h->signature)) != 0 ||
+		h->header_size < sizeof(LoginSnapshotHeader) ||
+		h->size != (uint64_t)st.st_size) {
+		munmap(p, st.st_size);
+		return -EBADMSG;
+	}
+
+	if (h->version != LOGIN_SNAPSHOT_VERSION) {
+		munmap(p, st.st_size);
+		return -EPROTONOSUPPORT;
+	}
+
+	s = new0(LoginSnapshot, 1);
+	if (!s) {
+		munmap(p, st.st_size);
+		return -ENOMEM;
+	}
+
+	s->n_ref = 1;
+	s->map = p;
+	s->size = st.st_size;
+	s->dev = st.st_dev;
+	s->ino = st.st_ino;
+
+	for (k = 0; k < _LOGIN_SNAPSHOT_KIND_MAX; k++)
+		if (!snapshot_get(s, h->table_offset[k],
+			    (uint64_t)h->n_entries[k] *
+				    sizeof(LoginSnapshotEntry))) {
+			login_snapshot_unref(s);
+			return -EBADMSG;
+		}
+
+	*ret = s;
+	return 0;
+}
+
+LoginSnapshot *
+login_snapshot_ref(LoginSnapshot *s)
+{
+	if (!s)
+		return NULL;
+
+	assert(s->n_ref > 0);
+	s->n_ref++;
+
+	return s;
+}
+
+LoginSnapshot *
+login_snapshot_unref(LoginSnapshot *s)
+{
+	if (!s)
+		return NULL;
+
+	assert(s->n_ref > 0);
+	s->n_ref--;
+
+	if (s->n_ref > 0)
+		return NULL;
+
+	munmap(s->map, s->size);
+	free(s);
+
+	return NULL;
+}
+
+bool
+login_snapshot_is_current(LoginSnapshot *s, const struct stat *st)
+{
+	assert(s);
+	assert(st);
+
+	/* The file is only ever replaced, never modified in place. As
+         * long as we keep the old one mapped, its inode cannot be reused. */
+	return s->dev == st->st_dev && s->ino == st->st_ino;
+}
+
+static const LoginSnapshotEntry *
+snapshot_find(LoginSnapshot *s, LoginSnapshotKind kind, const char *name)
+{
+	const LoginSnapshotHeader *h = s->map;
+	const LoginSnapshotEntry *table;
+	size_t lower = 0, upper;
+
+	table = snapshot_get(s, h->table_offset[kind], 0);
+	upper = h->n_entries[kind];
+
+	while (lower < upper) {
+		size_t i = (lower + upper) / 2;
+		const char *n;
+		int c;
+
+		n = snapshot_get_string(s, table[i].name);
+		if (!n)
+			return NULL;
+
+		c = strcmp(name, n);
+		if (c == 0)
+			return table + i;
+		if (c < 0)
+			upper = i;
+		else
+			lower = i + 1;
+	}
+
+	return NULL;
+}
+
+int
+login_snapshot_getv(LoginSnapshot *s, LoginSnapshotKind kind,
+	const char *name, uint64_t inode, va_list ap)
+{
+	const LoginSnapshotEntry *e;
+	const uint32_t *fields;
+	int n_found = 0;
+	uint32_t i;
+
+	assert(s);
+	assert(kind >= 0 && kind < _LOGIN_SNAPSHOT_KIND_MAX);
+	assert(name);
+
+	/* Works like parse_env_file() on the state file of the object
+         * with the specified inode. Returns -ENOENT if the object is
+         * not in the snapshot, and -ESTALE if its state file has been
+         * replaced since the snapshot was taken. */
+
+	e = snapshot_find(s, kind, name);
+	if (!e)
+		return -ENOENT;
+
+	if (e->inode != inode)
+		return -ESTALE;
+
+	fields = snapshot_get(s, e->fields_offset,
+		(uint64_t)e->n_fields * 2 * sizeof(uint32_t));
+	if (!fields)
+		return -EBADMSG;
+
+	for (i = 0; i < e->n_fields; i++) {
+		const char *key, *value, *k;
+		va_list aq;
+
+		key = snapshot_get_string(s, fields[i * 2]);
+		value = snapshot_get_string(s, fields[i * 2 + 1]);
+		if (!key || !value)
+			return -EBADMSG;
+
+		va_copy(aq, ap);
+		while ((k = va_arg(aq, const char *))) {
+			char **v;
+
+			v = va_arg(aq, char **);
+
+			if (streq(key, k)) {
+				char *t;
+
+				t = strdup(value);
+				if (!t) {
+					va_end(aq);
+					return -ENOMEM;
+				}
+
+				free(*v);
+				*v = t;
+				n_found++;
+				break;
+			}
+		}
+		va_end(aq);
+	}
+
+	return n_found;
+}
@@ -0,0 +1,95 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#pragma once
+
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "macro.h"
+
+/* A binary snapshot of the state of all sessions, users and seats,
+ * published by the login manager next to the per-object state files
+ * and mmap()ed by sd-login readers. It is replaced atomically as a
+ * whole, and contains the same key/value pairs as the state files.
+ * Each entry records the inode of the state file it was taken from;
+ * readers only use it if that still matches, and parse the state file
+ * otherwise.
+ *
+ * The file is only ever placed below /run, hence uses native byte
+ * order. All offsets are relative to the beginning of the file. */
+
+#define LOGIN_SNAPSHOT_DIR SVC_PKGRUNSTATEDIR "/login"
+#define LOGIN_SNAPSHOT_PATH LOGIN_SNAPSHOT_DIR "/snapshot"
+
+#define LOGIN_SNAPSHOT_SIGNATURE                                               \
+	((const char[]){ 'I', 'W', 'L', 'O', 'G', 'I', 'N', 'S' })
+#define LOGIN_SNAPSHOT_VERSION 1
+
+typedef enum LoginSnapshotKind {
+	LOGIN_SNAPSHOT_SESSION,
+	LOGIN_SNAPSHOT_USER,
+	LOGIN_SNAPSHOT_SEAT,
+	_LOGIN_SNAPSHOT_KIND_MAX,
+	_LOGIN_SNAPSHOT_KIND_INVALID = -1
+} LoginSnapshotKind;
+
+typedef struct LoginSnapshotHeader {
+	uint8_t signature[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t generation;
+	uint64_t size;
+	uint64_t table_offset[_LOGIN_SNAPSHOT_KIND_MAX];
+	uint32_t n_entries[_LOGIN_SNAPSHOT_KIND_MAX];
+	uint32_t reserved;
+} LoginSnapshotHeader;
+
+/* The entries of each table are sorted by name */
+typedef struct LoginSnapshotEntry {
+	uint32_t name;
+	uint32_t n_fields;
+	uint64_t fields_offset; /* n_fields pairs of key and value offsets */
+	uint64_t inode;
+} LoginSnapshotEntry;
+
+/* Input for login_snapshot_write() */
+typedef struct LoginSnapshotObject {
+	const char *name;
+	char **fields; /* alternating keys and values */
+	uint64_t inode;
+} LoginSnapshotObject;
+
+typedef struct LoginSnapshot LoginSnapshot;
+
+int login_snapshot_write(const char *path, uint64_t generation,
+	LoginSnapshotObject *objects[_LOGIN_SNAPSHOT_KIND_MAX],
+	size_t n_objects[_LOGIN_SNAPSHOT_KIND_MAX]);
+
+int login_snapshot_open(const char *path, LoginSnapshot **ret);
+LoginSnapshot *login_snapshot_ref(LoginSnapshot *s);
+LoginSnapshot *login_snapshot_unref(LoginSnapshot *s);
+bool login_snapshot_is_current(LoginSnapshot *s, const struct stat *st);
+
+int login_snapshot_getv(LoginSnapshot *s, LoginSnapshotKind kind,
+	const char *name, uint64_t inode, va_list ap);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(LoginSnapshot *, login_snapshot_unref);
+#define _cleanup_login_snapshot_unref_                                         \
+	_cleanup_(login_snapshot_unrefp)
@@ -130,3 +130,71 @@ get_process_exe(pid_t pid, char **line)
 
 	return 0;
 }
+
+int
+get_process_info(pid_t pid, ProcessInfoMask mask, ProcessInfo *ret)
+{
+	struct proc_bsdinfo info, again;
+	char buf[PROC_PIDPATHINFO_MAXSIZE];
+	ProcessInfo i = {};
+	int r;
+
+	assert(ret);
+
+	r = proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof info);
+	if (r <= 0)
+		return errno == ESRCH || r == 0 ? -ESRCH : -errno;
+
+	i.uid = info.pbi_ruid;
+	i.euid = info.pbi_uid;
+	i.gid = info.pbi_rgid;
+	i.egid = info.pbi_gid;
+	i.ppid = info.pbi_ppid;
+	i.mask = mask &
+		(PROCESS_INFO_UID | PROCESS_INFO_GID | PROCESS_INFO_PPID);
+
+	if (mask & PROCESS_INFO_COMM) {
+		i.comm = strdup(info.pbi_comm);
+		if (!i.comm)
+			goto oom;
+
+		i.mask |= PROCESS_INFO_COMM;
+	}
+
+	if ((mask & PROCESS_INFO_EXE) &&
+		proc_pidpath(pid, buf, sizeof buf) > 0) {
+		i.exe = strdup(buf);
+		if (!i.exe)
+			goto oom;
+
+		i.mask |= PROCESS_INFO_EXE;
+	}
+
+	if ((mask & PROCESS_INFO_CMDLINE) &&
+		proc_name(pid, buf, sizeof buf) > 0) {
+		i.cmdline = strdup(buf);
+		if (!i.cmdline)
+			goto oom;
+
+		i.mask |= PROCESS_INFO_CMDLINE;
+	}
+
+	/* There is no pidfd to pin the process with, so make sure the PID
+         * was not recycled while we looked up the path and name. */
+	if (mask & (PROCESS_INFO_EXE | PROCESS_INFO_CMDLINE)) {
+		r = proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &again,
+			sizeof again);
+		if (r <= 0 || again.pbi_start_tvsec != info.pbi_start_tvsec ||
+			again.pbi_start_tvusec != info.pbi_start_tvusec) {
+			process_info_done(&i);
+			return -ESRCH;
+		}
+	}
+
+	*ret = i;
+	return 0;
+
+oom:
+	process_info_done(&i);
+	return -ENOMEM;
+}
@@ -129,6 +129,10 @@
 #define SOL_NETLINK 270
 #endif
 
+#ifndef NETLINK_GET_STRICT_CHK
+#define NETLINK_GET_STRICT_CHK 12
+#endif
+
 #ifndef __NR_memfd_create
 #if defined __x86_64__
 #define __NR_memfd_create 319
@@ -1030,6 +1034,48 @@ missing_renameat2(int oldfd, const char *oldname, int newfd,
 #define RENAME_NOREPLACE (1 << 0)
 #endif
 
+#ifndef HAVE_copy_file_range
+
+#ifndef __NR_copy_file_range
+#if defined __x86_64__
+#define __NR_copy_file_range 326
+#elif defined __arm__
+#define __NR_copy_file_range 391
+#elif defined __aarch64__
+#define __NR_copy_file_range 285
+#elif defined _MIPS_SIM
+#if _MIPS_SIM == _MIPS_SIM_ABI32
+#define __NR_copy_file_range 4360
+#endif
+#if _MIPS_SIM == _MIPS_SIM_NABI32
+#define __NR_copy_file_range 6324
+#endif
+#if _MIPS_SIM == _MIPS_SIM_ABI64
+#define __NR_copy_file_range 5320
+#endif
+#elif defined __i386__
+#define __NR_copy_file_range 377
+#else
+#warning "__NR_copy_file_range unknown for your architecture"
+#define __NR_copy_file_range 0xffffffff
+#endif
+#endif
+
+static inline ssize_t
+missing_copy_file_range(int fd_in, loff_t *off_in, int fd_out,
+	loff_t *off_out, size_t len, unsigned flags)
+{
+	return syscall(__NR_copy_file_range, fd_in, off_in, fd_out, off_out,
+		len, flags);
+}
+
+#define copy_file_range missing_copy_file_range
+#endif
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 #if !HAVE_DECL_KCMP
 static inline int
 missing_kcmp(pid_t pid1, pid_t pid2, int type, unsigned long idx1,
@@ -4,6 +4,7 @@
  */
 
 #include <ctype.h>
+#include <fcntl.h>
 
 #include "fileio.h"
 #include "util.h"
@@ -99,24 +100,12 @@ get_process_comm(pid_t pid, char **name)
 	return r;
 }
 
-int
-get_process_cmdline(pid_t pid, size_t max_length, bool comm_fallback,
-	char **line)
+static int
+read_cmdline(FILE *f, size_t max_length, char **ret)
 {
-	_cleanup_fclose_ FILE *f = NULL;
 	char *r = NULL, *k;
-	const char *p;
 	int c;
 
-	assert(line);
-	assert(pid >= 0);
-
-	p = procfs_file_alloca(pid, "cmdline");
-
-	f = fopen(p, "re");
-	if (!f)
-		return -errno;
-
 	if (max_length == 0) {
 		size_t len = 0, allocated = 0;
 
@@ -170,10 +159,35 @@ get_process_cmdline(pid_t pid, size_t max_length, bool comm_fallback,
 			*k = 0;
 	}
 
+	*ret = r;
+	return 0;
+}
+
+int
+get_process_cmdline(pid_t pid, size_t max_length, bool comm_fallback,
+	char **line)
+{
+	_cleanup_fclose_ FILE *f = NULL;
+	char *r = NULL;
+	const char *p;
+	int h;
+
+	assert(line);
+	assert(pid >= 0);
+
+	p = procfs_file_alloca(pid, "cmdline");
+
+	f = fopen(p, "re");
+	if (!f)
+		return -errno;
+
+	h = read_cmdline(f, max_length, &r);
+	if (h < 0)
+		return h;
+
 	/* Kernel threads have no argv[] */
 	if (isempty(r)) {
 		_cleanup_free_ char *t = NULL;
-		int h;
 
 		free(r);
 
@@ -207,6 +221,7 @@ get_process_link_contents(const char *proc_file, char **name)
 
 	return 0;
 }
+
 int
 get_process_exe(pid_t pid, char **name)
 {
@@ -277,3 +292,187 @@ get_process_gid(pid_t pid, gid_t *gid)
 	assert_cc(sizeof(uid_t) == sizeof(gid_t));
 	return get_process_id(pid, "Gid:", gid);
 }
+
+static FILE *
+proc_fopenat(int dfd, const char *name)
+{
+	int fd;
+	FILE *f;
+
+	fd = openat(dfd, name, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	f = fdopen(fd, "re");
+	if (!f)
+		safe_close(fd);
+
+	return f;
+}
+
+static int
+process_info_error(int r)
+{
+	/* Fields we may not look at are simply left out, but a process
+         * that is gone fails the whole snapshot. */
+	if (r == -EPERM || r == -EACCES)
+		return 0;
+	if (r == -ENOENT)
+		return -ESRCH;
+
+	return r;
+}
+
+static int
+process_info_read_status(int dfd, ProcessInfoMask mask, ProcessInfo *i)
+{
+	_cleanup_fclose_ FILE *f = NULL;
+	char line[LINE_MAX];
+
+	f = proc_fopenat(dfd, "status");
+	if (!f)
+		return process_info_error(-errno);
+
+	FOREACH_LINE(line, f, return -errno)
+	{
+		unsigned long a, b;
+		const char *p;
+
+		truncate_nl(line);
+
+		if ((mask & PROCESS_INFO_UID) &&
+			(p = startswith(line, "Uid:"))) {
+			if (sscanf(p, "%lu %lu", &a, &b) != 2)
+				return -EIO;
+
+			i->uid = (uid_t)a;
+			i->euid = (uid_t)b;
+			i->mask |= PROCESS_INFO_UID;
+
+		} else if ((mask & PROCESS_INFO_GID) &&
+			(p = startswith(line, "Gid:"))) {
+			if (sscanf(p, "%lu %lu", &a, &b) != 2)
+				return -EIO;
+
+			i->gid = (gid_t)a;
+			i->egid = (gid_t)b;
+			i->mask |= PROCESS_INFO_GID;
+
+		} else if ((mask & PROCESS_INFO_PPID) &&
+			(p = startswith(line, "PPid:"))) {
+			if (sscanf(p, "%lu", &a) != 1)
+				return -EIO;
+
+			if ((unsigned long)(pid_t)a != a)
+				return -ERANGE;
+
+			i->ppid = (pid_t)a;
+			i->mask |= PROCESS_INFO_PPID;
+
+		} else if ((mask & PROCESS_INFO_CAPEFF) &&
+			(p = startswith(line, "CapEff:"))) {
+			p += strspn(p, WHITESPACE);
+
+			i->capeff = strndup(p, strcspn(p, WHITESPACE));
+			if (!i->capeff)
+				return -ENOMEM;
+
+			i->mask |= PROCESS_INFO_CAPEFF;
+		}
+	}
+
+	return 0;
+}
+
+int
+get_process_info(pid_t pid, ProcessInfoMask mask, ProcessInfo *ret)
+{
+	_cleanup_close_ int dfd = -1;
+	ProcessInfo i = {};
+	const char *p;
+	int r = 0;
+
+	assert(pid >= 0);
+	assert(ret);
+
+	/* All files are opened relative to the /proc/<pid> directory,
+         * which stays tied to the process it was opened for, like a
+         * pidfd: once that one is reaped, lookups below it fail even if
+         * the PID has been recycled. Hence every field we return was
+         * read from the same process. */
+	p = procfs_file_alloca(pid, "");
+	dfd = open(p, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0)
+		return errno == ENOENT ? -ESRCH : -errno;
+
+	if (mask &
+		(PROCESS_INFO_UID | PROCESS_INFO_GID | PROCESS_INFO_PPID |
+			PROCESS_INFO_CAPEFF)) {
+		r = process_info_read_status(dfd, mask, &i);
+		if (r < 0)
+			goto fail;
+	}
+
+	if (mask & PROCESS_INFO_COMM) {
+		_cleanup_fclose_ FILE *f = NULL;
+
+		f = proc_fopenat(dfd, "comm");
+		if (!f)
+			r = process_info_error(-errno);
+		else {
+			r = read_line(f, LONG_LINE_MAX, &i.comm);
+			if (r >= 0)
+				i.mask |= PROCESS_INFO_COMM;
+		}
+		if (r < 0)
+			goto fail;
+	}
+
+	if (mask & PROCESS_INFO_EXE) {
+		r = readlinkat_malloc(dfd, "exe", &i.exe);
+		if (r >= 0) {
+			char *d;
+
+			d = endswith(i.exe, " (deleted)");
+			if (d)
+				*d = '\0';
+
+			i.mask |= PROCESS_INFO_EXE;
+
+		} else if (r == -ENOENT)
+			/* Kernel threads have no executable */
+			r = 0;
+		else {
+			r = process_info_error(r);
+			if (r < 0)
+				goto fail;
+		}
+	}
+
+	if (mask & PROCESS_INFO_CMDLINE) {
+		_cleanup_fclose_ FILE *f = NULL;
+
+		f = proc_fopenat(dfd, "cmdline");
+		if (!f)
+			r = process_info_error(-errno);
+		else {
+			r = read_cmdline(f, 0, &i.cmdline);
+			if (r >= 0) {
+				/* Kernel threads have no argv[] either */
+				if (isempty(i.cmdline))
+					i.cmdline = mfree(i.cmdline);
+				else
+					i.mask |= PROCESS_INFO_CMDLINE;
+			}
+		}
+		if (r < 0)
+			goto fail;
+	}
+
+	*ret = i;
+	return 0;
+
+fail:
+	process_info_done(&i);
+	return r;
+}
@@ -743,6 +743,18 @@ get_process_capeff(pid_t pid, char **capeff)
 	return get_status_field(p, "\nCapEff:", capeff);
 }
 
+void
+process_info_done(ProcessInfo *i)
+{
+	assert(i);
+
+	i->comm = mfree(i->comm);
+	i->exe = mfree(i->exe);
+	i->cmdline = mfree(i->cmdline);
+	i->capeff = mfree(i->capeff);
+	i->mask = 0;
+}
+
 static int
 get_process_link_contents(const char *proc_file, char **name)
 {
@@ -372,6 +372,37 @@ int get_process_cwd(pid_t pid, char **cwd);
 int get_process_root(pid_t pid, char **root);
 int get_process_environ(pid_t pid, char **environ);
 
+typedef enum ProcessInfoMask {
+	PROCESS_INFO_COMM = 1 << 0,
+	PROCESS_INFO_EXE = 1 << 1,
+	PROCESS_INFO_CMDLINE = 1 << 2,
+	PROCESS_INFO_UID = 1 << 3, /* real and effective */
+	PROCESS_INFO_GID = 1 << 4, /* real and effective */
+	PROCESS_INFO_CAPEFF = 1 << 5,
+	PROCESS_INFO_PPID = 1 << 6,
+} ProcessInfoMask;
+
+/* A snapshot of several attributes of one process, gathered in one go
+ * rather than with one get_process_xyz() call each. The mask lists the
+ * fields that could actually be retrieved; fields the caller may not
+ * access, or that a process does not have (like the command line of a
+ * kernel thread), are left out. */
+typedef struct ProcessInfo {
+	ProcessInfoMask mask;
+
+	char *comm;
+	char *exe;
+	char *cmdline; /* formatted like get_process_cmdline() */
+	char *capeff;
+
+	uid_t uid, euid;
+	gid_t gid, egid;
+	pid_t ppid;
+} ProcessInfo;
+
+int get_process_info(pid_t pid, ProcessInfoMask mask, ProcessInfo *ret);
+void process_info_done(ProcessInfo *i);
+
 char hexchar(int x) _const_;
 int unhexchar(char c) _const_;
 char octchar(int x) _const_;
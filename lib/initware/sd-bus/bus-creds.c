@@ -822,22 +822,32 @@ bus_creds_add_more(sd_bus_creds *c, uint64_t mask, pid_t pid, pid_t tid)
 			c->mask |= SD_BUS_CREDS_SELINUX_CONTEXT;
 	}
 
-	if (missing & SD_BUS_CREDS_COMM) {
-		r = get_process_comm(pid, &c->comm);
-		if (r < 0) {
-			if (r != -EPERM && r != -EACCES)
-				return r;
-		} else
+	if (missing & (SD_BUS_CREDS_COMM | SD_BUS_CREDS_EXE)) {
+		ProcessInfoMask want = 0;
+		ProcessInfo info;
+
+		if (missing & SD_BUS_CREDS_COMM)
+			want |= PROCESS_INFO_COMM;
+		if (missing & SD_BUS_CREDS_EXE)
+			want |= PROCESS_INFO_EXE;
+
+		r = get_process_info(pid, want, &info);
+		if (r < 0)
+			return r;
+
+		if (info.mask & PROCESS_INFO_COMM) {
+			c->comm = info.comm;
+			info.comm = NULL;
 			c->mask |= SD_BUS_CREDS_COMM;
-	}
+		}
 
-	if (missing & SD_BUS_CREDS_EXE) {
-		r = get_process_exe(pid, &c->exe);
-		if (r < 0) {
-			if (r != -EPERM && r != -EACCES)
-				return r;
-		} else
+		if (info.mask & PROCESS_INFO_EXE) {
+			c->exe = info.exe;
+			info.exe = NULL;
 			c->mask |= SD_BUS_CREDS_EXE;
+		}
+
+		process_info_done(&info);
 	}
 
 	if (missing & SD_BUS_CREDS_CMDLINE) {
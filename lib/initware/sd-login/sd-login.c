@@ -18,14 +18,17 @@
 ***/
 
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "cgroup-util.h"
 #include "fileio.h"
 #include "login-shared.h"
+#include "login-snapshot.h"
 #include "macro.h"
 #include "sd-login.h"
 #include "strv.h"
@@ -181,31 +184,109 @@ sd_peer_get_slice(int fd, char **slice)
 	return cg_pid_get_slice(ucred.pid, slice);
 }
 
+static const char *const state_dir_table[_LOGIN_SNAPSHOT_KIND_MAX] = {
+	[LOGIN_SNAPSHOT_SESSION] = SVC_PKGRUNSTATEDIR "/sessions/",
+	[LOGIN_SNAPSHOT_USER] = SVC_PKGRUNSTATEDIR "/users/",
+	[LOGIN_SNAPSHOT_SEAT] = SVC_PKGRUNSTATEDIR "/seats/",
+};
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LoginSnapshot *snapshot_cache = NULL;
+
+static LoginSnapshot *
+snapshot_acquire(void)
+{
+	LoginSnapshot *s;
+	struct stat st;
+
+	/* Returns the snapshot of all session, user and seat state the
+         * login manager publishes, or NULL if there is none and the
+         * individual state files need to be parsed. The mapping is
+         * kept around until the snapshot is replaced. */
+
+	if (stat(LOGIN_SNAPSHOT_PATH, &st) < 0)
+		return NULL;
+
+	pthread_mutex_lock(&snapshot_mutex);
+
+	if (!snapshot_cache ||
+		!login_snapshot_is_current(snapshot_cache, &st)) {
+		snapshot_cache = login_snapshot_unref(snapshot_cache);
+		(void)login_snapshot_open(LOGIN_SNAPSHOT_PATH, &snapshot_cache);
+	}
+
+	s = login_snapshot_ref(snapshot_cache);
+
+	pthread_mutex_unlock(&snapshot_mutex);
+
+	return s;
+}
+
+static void
+snapshot_releasep(LoginSnapshot **s)
+{
+	if (!*s)
+		return;
+
+	pthread_mutex_lock(&snapshot_mutex);
+	login_snapshot_unref(*s);
+	pthread_mutex_unlock(&snapshot_mutex);
+}
+
 static int
-file_of_uid(uid_t uid, char **p)
+parse_state(LoginSnapshotKind kind, const char *name, ...)
 {
-	assert(p);
+	_cleanup_(snapshot_releasep) LoginSnapshot *s = NULL;
+	_cleanup_free_ char *p = NULL;
+	struct stat st;
+	va_list ap;
+	int r = -ESTALE;
+
+	/* Looks up the fields of a session, user or seat like
+         * parse_env_file() does on its state file. The snapshot is
+         * only used if it was taken from the current state file, which
+         * is cheaper to check than to parse. */
 
-	if (asprintf(p, SVC_PKGRUNSTATEDIR "/users/" UID_FMT, uid) < 0)
+	p = strappend(state_dir_table[kind], name);
+	if (!p)
 		return -ENOMEM;
 
-	return 0;
+	if (stat(p, &st) < 0)
+		return -errno;
+
+	va_start(ap, name);
+
+	s = snapshot_acquire();
+	if (s)
+		r = login_snapshot_getv(s, kind, name, st.st_ino, ap);
+
+	if (IN_SET(r, -ESTALE, -ENOENT, -EBADMSG))
+		r = parse_env_filev(p, NEWLINE, ap);
+
+	va_end(ap);
+
+	return r;
+}
+
+static int
+parse_uid_state(uid_t uid, const char *variable, char **value)
+{
+	char name[DECIMAL_STR_MAX(uid_t) + 1];
+
+	snprintf(name, sizeof(name), UID_FMT, uid);
+
+	return parse_state(LOGIN_SNAPSHOT_USER, name, variable, value, NULL);
 }
 
 _public_ int
 sd_uid_get_state(uid_t uid, char **state)
 {
-	_cleanup_free_ char *p = NULL;
 	char *s = NULL;
 	int r;
 
 	assert_return(state, -EINVAL);
 
-	r = file_of_uid(uid, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "STATE", &s, NULL);
+	r = parse_uid_state(uid, "STATE", &s);
 	if (r == -ENOENT) {
 		free(s);
 		s = strdup("offline");
@@ -225,16 +306,12 @@ sd_uid_get_state(uid_t uid, char **state)
 _public_ int
 sd_uid_get_display(uid_t uid, char **session)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 	int r;
 
 	assert_return(session, -EINVAL);
 
-	r = file_of_uid(uid, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "DISPLAY", &s, NULL);
+	r = parse_uid_state(uid, "DISPLAY", &s);
 	if (r < 0)
 		return r;
 
@@ -250,7 +327,7 @@ sd_uid_get_display(uid_t uid, char **session)
 _public_ int
 sd_uid_is_on_seat(uid_t uid, int require_active, const char *seat)
 {
-	_cleanup_free_ char *t = NULL, *s = NULL, *p = NULL;
+	_cleanup_free_ char *t = NULL, *s = NULL;
 	size_t l;
 	int r;
 	const char *word, *variable, *state;
@@ -259,11 +336,7 @@ sd_uid_is_on_seat(uid_t uid, int require_active, const char *seat)
 
 	variable = require_active ? "ACTIVE_UID" : "UIDS";
 
-	p = strappend(SVC_PKGRUNSTATEDIR "/seats/", seat);
-	if (!p)
-		return -ENOMEM;
-
-	r = parse_env_file(p, NEWLINE, variable, &s, NULL);
+	r = parse_state(LOGIN_SNAPSHOT_SEAT, seat, variable, &s, NULL);
 
 	if (r < 0)
 		return r;
@@ -286,15 +359,11 @@ sd_uid_is_on_seat(uid_t uid, int require_active, const char *seat)
 static int
 uid_get_array(uid_t uid, const char *variable, char ***array)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 	char **a;
 	int r;
 
-	r = file_of_uid(uid, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, variable, &s, NULL);
+	r = parse_uid_state(uid, variable, &s);
 	if (r < 0) {
 		if (r == -ENOENT) {
 			if (array)
@@ -348,46 +417,33 @@ sd_uid_get_seats(uid_t uid, int require_active, char ***seats)
 }
 
 static int
-file_of_session(const char *session, char **_p)
+parse_session_state(const char *session, const char *variable, char **value)
 {
-	char *p;
+	_cleanup_free_ char *buf = NULL;
 	int r;
 
-	assert(_p);
-
 	if (session) {
 		if (!session_id_valid(session))
 			return -EINVAL;
-
-		p = strappend(SVC_PKGRUNSTATEDIR "/sessions/", session);
 	} else {
-		_cleanup_free_ char *buf = NULL;
-
 		r = sd_pid_get_session(0, &buf);
 		if (r < 0)
 			return r;
 
-		p = strappend(SVC_PKGRUNSTATEDIR "/sessions/", buf);
+		session = buf;
 	}
 
-	if (!p)
-		return -ENOMEM;
-
-	*_p = p;
-	return 0;
+	return parse_state(LOGIN_SNAPSHOT_SESSION, session, variable, value,
+		NULL);
 }
 
 _public_ int
 sd_session_is_active(const char *session)
 {
 	int r;
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 
-	r = file_of_session(session, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "ACTIVE", &s, NULL);
+	r = parse_session_state(session, "ACTIVE", &s);
 	if (r < 0)
 		return r;
 
@@ -401,13 +457,9 @@ _public_ int
 sd_session_is_remote(const char *session)
 {
 	int r;
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 
-	r = file_of_session(session, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "REMOTE", &s, NULL);
+	r = parse_session_state(session, "REMOTE", &s);
 	if (r < 0)
 		return r;
 
@@ -420,16 +472,12 @@ sd_session_is_remote(const char *session)
 _public_ int
 sd_session_get_state(const char *session, char **state)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 	int r;
 
 	assert_return(state, -EINVAL);
 
-	r = file_of_session(session, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "STATE", &s, NULL);
+	r = parse_session_state(session, "STATE", &s);
 	if (r < 0)
 		return r;
 	else if (!s)
@@ -445,15 +493,11 @@ _public_ int
 sd_session_get_uid(const char *session, uid_t *uid)
 {
 	int r;
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 
 	assert_return(uid, -EINVAL);
 
-	r = file_of_session(session, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, "UID", &s, NULL);
+	r = parse_session_state(session, "UID", &s);
 	if (r < 0)
 		return r;
 
@@ -466,16 +510,12 @@ sd_session_get_uid(const char *session, uid_t *uid)
 static int
 session_get_string(const char *session, const char *field, char **value)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *s = NULL;
 	int r;
 
 	assert_return(value, -EINVAL);
 
-	r = file_of_session(session, &p);
-	if (r < 0)
-		return r;
-
-	r = parse_env_file(p, NEWLINE, field, &s, NULL);
+	r = parse_session_state(session, field, &s);
 	if (r < 0)
 		return r;
 
@@ -576,46 +616,39 @@ sd_session_get_remote_host(const char *session, char **remote_host)
 }
 
 static int
-file_of_seat(const char *seat, char **_p)
+seat_of(const char *seat, const char **ret, char **buf)
 {
-	char *p;
 	int r;
 
-	assert(_p);
-
-	if (seat)
-		p = strappend(SVC_PKGRUNSTATEDIR "/seats/", seat);
-	else {
-		_cleanup_free_ char *buf = NULL;
+	assert(ret);
+	assert(buf);
 
-		r = sd_session_get_seat(NULL, &buf);
+	if (!seat) {
+		r = sd_session_get_seat(NULL, buf);
 		if (r < 0)
 			return r;
 
-		p = strappend(SVC_PKGRUNSTATEDIR "/seats/", buf);
+		seat = *buf;
 	}
 
-	if (!p)
-		return -ENOMEM;
-
-	*_p = p;
-	p = NULL;
+	*ret = seat;
 	return 0;
 }
 
 _public_ int
 sd_seat_get_active(const char *seat, char **session, uid_t *uid)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL, *t = NULL;
+	_cleanup_free_ char *buf = NULL, *s = NULL, *t = NULL;
 	int r;
 
 	assert_return(session || uid, -EINVAL);
 
-	r = file_of_seat(seat, &p);
+	r = seat_of(seat, &seat, &buf);
 	if (r < 0)
 		return r;
 
-	r = parse_env_file(p, NEWLINE, "ACTIVE", &s, "ACTIVE_UID", &t, NULL);
+	r = parse_state(LOGIN_SNAPSHOT_SEAT, seat, "ACTIVE", &s, "ACTIVE_UID",
+		&t, NULL);
 	if (r < 0)
 		return r;
 
@@ -643,18 +676,18 @@ _public_ int
 sd_seat_get_sessions(const char *seat, char ***sessions, uid_t **uids,
 	unsigned *n_uids)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL, *t = NULL;
+	_cleanup_free_ char *buf = NULL, *s = NULL, *t = NULL;
 	_cleanup_strv_free_ char **a = NULL;
 	_cleanup_free_ uid_t *b = NULL;
 	unsigned n = 0;
 	int r;
 
-	r = file_of_seat(seat, &p);
+	r = seat_of(seat, &seat, &buf);
 	if (r < 0)
 		return r;
 
-	r = parse_env_file(p, NEWLINE, "SESSIONS", &s, "ACTIVE_SESSIONS", &t,
-		NULL);
+	r = parse_state(LOGIN_SNAPSHOT_SEAT, seat, "SESSIONS", &s,
+		"ACTIVE_SESSIONS", &t, NULL);
 
 	if (r < 0)
 		return r;
@@ -718,16 +751,16 @@ sd_seat_get_sessions(const char *seat, char ***sessions, uid_t **uids,
 static int
 seat_get_can(const char *seat, const char *variable)
 {
-	_cleanup_free_ char *p = NULL, *s = NULL;
+	_cleanup_free_ char *buf = NULL, *s = NULL;
 	int r;
 
 	assert_return(variable, -EINVAL);
 
-	r = file_of_seat(seat, &p);
+	r = seat_of(seat, &seat, &buf);
 	if (r < 0)
 		return r;
 
-	r = parse_env_file(p, NEWLINE, variable, &s, NULL);
+	r = parse_state(LOGIN_SNAPSHOT_SEAT, seat, variable, &s, NULL);
 	if (r < 0)
 		return r;
 	if (!s)
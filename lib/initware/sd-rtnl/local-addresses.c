@@ -53,135 +53,107 @@ address_compare(const void *_a, const void *_b)
 	return memcmp(&a->address, &b->address, FAMILY_ADDRESS_SIZE(a->family));
 }
 
-int
-local_addresses(sd_rtnl *context, int ifindex, int af,
-	struct local_address **ret)
-{
-	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL, *reply = NULL;
-	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
-	_cleanup_free_ struct local_address *list = NULL;
-	size_t n_list = 0, n_allocated = 0;
-	sd_rtnl_message *m;
-	int r;
+/* What the dump callbacks below collect */
+typedef struct AddressList {
+	int ifindex;
+	int af;
 
-	assert(ret);
+	struct local_address *list;
+	size_t n_list;
+	size_t n_allocated;
+} AddressList;
 
-	if (context)
-		rtnl = sd_rtnl_ref(context);
-	else {
-		r = sd_rtnl_open(&rtnl, 0);
-		if (r < 0)
-			return r;
-	}
+static int
+address_handler(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	AddressList *l = userdata;
+	struct local_address *a;
+	unsigned char flags;
+	uint16_t type;
+	int ifi, family, r;
 
-	r = sd_rtnl_message_new_addr(rtnl, &req, RTM_GETADDR, 0, af);
+	r = sd_rtnl_message_get_type(m, &type);
 	if (r < 0)
 		return r;
+	if (type != RTM_NEWADDR)
+		return 0;
 
-	r = sd_rtnl_call(rtnl, req, 0, &reply);
+	r = sd_rtnl_message_addr_get_ifindex(m, &ifi);
 	if (r < 0)
 		return r;
+	if (l->ifindex > 0 && ifi != l->ifindex)
+		return 0;
 
-	for (m = reply; m; m = sd_rtnl_message_next(m)) {
-		struct local_address *a;
-		unsigned char flags;
-		uint16_t type;
-		int ifi, family;
-
-		r = sd_rtnl_message_get_errno(m);
-		if (r < 0)
-			return r;
-
-		r = sd_rtnl_message_get_type(m, &type);
-		if (r < 0)
-			return r;
-		if (type != RTM_NEWADDR)
-			continue;
-
-		r = sd_rtnl_message_addr_get_ifindex(m, &ifi);
-		if (r < 0)
-			return r;
-		if (ifindex > 0 && ifi != ifindex)
-			continue;
-
-		r = sd_rtnl_message_addr_get_family(m, &family);
-		if (r < 0)
-			return r;
-		if (af != AF_UNSPEC && af != family)
-			continue;
+	r = sd_rtnl_message_addr_get_family(m, &family);
+	if (r < 0)
+		return r;
+	if (l->af != AF_UNSPEC && l->af != family)
+		return 0;
 
-		r = sd_rtnl_message_addr_get_flags(m, &flags);
-		if (r < 0)
-			return r;
-		if (flags & IFA_F_DEPRECATED)
-			continue;
+	r = sd_rtnl_message_addr_get_flags(m, &flags);
+	if (r < 0)
+		return r;
+	if (flags & IFA_F_DEPRECATED)
+		return 0;
 
-		if (!GREEDY_REALLOC0(list, n_allocated, n_list + 1))
-			return -ENOMEM;
+	if (!GREEDY_REALLOC0(l->list, l->n_allocated, l->n_list + 1))
+		return -ENOMEM;
 
-		a = list + n_list;
+	a = l->list + l->n_list;
 
-		r = sd_rtnl_message_addr_get_scope(m, &a->scope);
-		if (r < 0)
-			return r;
+	r = sd_rtnl_message_addr_get_scope(m, &a->scope);
+	if (r < 0)
+		return r;
 
-		if (ifindex == 0 &&
-			(a->scope == RT_SCOPE_HOST ||
-				a->scope == RT_SCOPE_NOWHERE))
-			continue;
+	if (l->ifindex == 0 &&
+		(a->scope == RT_SCOPE_HOST || a->scope == RT_SCOPE_NOWHERE))
+		return 0;
 
-		switch (family) {
-		case AF_INET:
-			r = sd_rtnl_message_read_in_addr(m, IFA_LOCAL,
+	switch (family) {
+	case AF_INET:
+		r = sd_rtnl_message_read_in_addr(m, IFA_LOCAL, &a->address.in);
+		if (r < 0) {
+			r = sd_rtnl_message_read_in_addr(m, IFA_ADDRESS,
 				&a->address.in);
-			if (r < 0) {
-				r = sd_rtnl_message_read_in_addr(m, IFA_ADDRESS,
-					&a->address.in);
-				if (r < 0)
-					continue;
-			}
-			break;
-
-		case AF_INET6:
-			r = sd_rtnl_message_read_in6_addr(m, IFA_LOCAL,
-				&a->address.in6);
-			if (r < 0) {
-				r = sd_rtnl_message_read_in6_addr(m,
-					IFA_ADDRESS, &a->address.in6);
-				if (r < 0)
-					continue;
-			}
-			break;
-
-		default:
-			continue;
+			if (r < 0)
+				return 0;
 		}
+		break;
 
-		a->ifindex = ifi;
-		a->family = family;
+	case AF_INET6:
+		r = sd_rtnl_message_read_in6_addr(m, IFA_LOCAL,
+			&a->address.in6);
+		if (r < 0) {
+			r = sd_rtnl_message_read_in6_addr(m, IFA_ADDRESS,
+				&a->address.in6);
+			if (r < 0)
+				return 0;
+		}
+		break;
 
-		n_list++;
-	};
+	default:
+		return 0;
+	}
 
-	if (n_list > 0)
-		qsort(list, n_list, sizeof(struct local_address),
-			address_compare);
+	a->ifindex = ifi;
+	a->family = family;
 
-	*ret = list;
-	list = NULL;
+	l->n_list++;
 
-	return (int)n_list;
+	return 0;
 }
 
 int
-local_gateways(sd_rtnl *context, int ifindex, int af,
+local_addresses(sd_rtnl *context, int ifindex, int af,
 	struct local_address **ret)
 {
-	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL, *reply = NULL;
+	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL;
 	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
-	_cleanup_free_ struct local_address *list = NULL;
-	sd_rtnl_message *m = NULL;
-	size_t n_list = 0, n_allocated = 0;
+	AddressList l = {
+		.ifindex = ifindex,
+		.af = af,
+	};
+	bool strict = false;
 	int r;
 
 	assert(ret);
@@ -194,102 +166,155 @@ local_gateways(sd_rtnl *context, int ifindex, int af,
 			return r;
 	}
 
-	r = sd_rtnl_message_new_route(rtnl, &req, RTM_GETROUTE, af,
-		RTPROT_UNSPEC);
+	/* Let the kernel skip the addresses of all other interfaces, if
+         * it can. This changes how the connection treats other dump
+         * requests too, hence only enable it temporarily. */
+	if (ifindex > 0)
+		strict = sd_rtnl_set_strict_check(rtnl, true) > 0;
+
+	/* Hosts may have a lot of addresses, look at them right in the
+         * read buffer rather than copying each one */
+	r = rtnl_message_new_addr_dump(rtnl, &req, ifindex, af);
+	if (r >= 0)
+		r = sd_rtnl_call_dump(rtnl, req, 0, address_handler, &l);
+
+	if (strict)
+		(void)sd_rtnl_set_strict_check(rtnl, false);
+
+	if (r < 0) {
+		free(l.list);
+		return r;
+	}
+
+	if (l.n_list > 0)
+		qsort(l.list, l.n_list, sizeof(struct local_address),
+			address_compare);
+
+	*ret = l.list;
+
+	return (int)l.n_list;
+}
+
+static int
+gateway_handler(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	AddressList *l = userdata;
+	struct local_address *a;
+	uint16_t type;
+	unsigned char dst_len, src_len;
+	uint32_t ifi;
+	int family, r;
+
+	r = sd_rtnl_message_get_type(m, &type);
 	if (r < 0)
 		return r;
+	if (type != RTM_NEWROUTE)
+		return 0;
 
-	r = sd_rtnl_message_request_dump(req, true);
+	/* We only care for default routes */
+	r = sd_rtnl_message_route_get_dst_prefixlen(m, &dst_len);
 	if (r < 0)
 		return r;
+	if (dst_len != 0)
+		return 0;
 
-	r = sd_rtnl_call(rtnl, req, 0, &reply);
+	r = sd_rtnl_message_route_get_src_prefixlen(m, &src_len);
 	if (r < 0)
 		return r;
+	if (src_len != 0)
+		return 0;
 
-	for (m = reply; m; m = sd_rtnl_message_next(m)) {
-		struct local_address *a;
-		uint16_t type;
-		unsigned char dst_len, src_len;
-		uint32_t ifi;
-		int family;
+	r = sd_rtnl_message_read_u32(m, RTA_OIF, &ifi);
+	if (r ==
+		-ENODATA) /* Not all routes have an RTA_OIF attribute (for example nexthop ones) */
+		return 0;
+	if (r < 0)
+		return r;
+	if (l->ifindex > 0 && (int)ifi != l->ifindex)
+		return 0;
 
-		r = sd_rtnl_message_get_errno(m);
-		if (r < 0)
-			return r;
+	r = sd_rtnl_message_route_get_family(m, &family);
+	if (r < 0)
+		return r;
+	if (l->af != AF_UNSPEC && l->af != family)
+		return 0;
 
-		r = sd_rtnl_message_get_type(m, &type);
-		if (r < 0)
-			return r;
-		if (type != RTM_NEWROUTE)
-			continue;
+	if (!GREEDY_REALLOC0(l->list, l->n_allocated, l->n_list + 1))
+		return -ENOMEM;
 
-		/* We only care for default routes */
-		r = sd_rtnl_message_route_get_dst_prefixlen(m, &dst_len);
-		if (r < 0)
-			return r;
-		if (dst_len != 0)
-			continue;
+	a = l->list + l->n_list;
 
-		r = sd_rtnl_message_route_get_src_prefixlen(m, &src_len);
+	switch (family) {
+	case AF_INET:
+		r = sd_rtnl_message_read_in_addr(m, RTA_GATEWAY,
+			&a->address.in);
 		if (r < 0)
-			return r;
-		if (src_len != 0)
-			continue;
+			return 0;
 
-		r = sd_rtnl_message_read_u32(m, RTA_OIF, &ifi);
-		if (r ==
-			-ENODATA) /* Not all routes have an RTA_OIF attribute (for example nexthop ones) */
-			continue;
+		break;
+	case AF_INET6:
+		r = sd_rtnl_message_read_in6_addr(m, RTA_GATEWAY,
+			&a->address.in6);
 		if (r < 0)
-			return r;
-		if (ifindex > 0 && (int)ifi != ifindex)
-			continue;
+			return 0;
 
-		r = sd_rtnl_message_route_get_family(m, &family);
-		if (r < 0)
-			return r;
-		if (af != AF_UNSPEC && af != family)
-			continue;
+		break;
+	default:
+		return 0;
+	}
 
-		if (!GREEDY_REALLOC0(list, n_allocated, n_list + 1))
-			return -ENOMEM;
+	sd_rtnl_message_read_u32(m, RTA_PRIORITY, &a->metric);
 
-		a = list + n_list;
+	a->ifindex = ifi;
+	a->family = family;
 
-		switch (family) {
-		case AF_INET:
-			r = sd_rtnl_message_read_in_addr(m, RTA_GATEWAY,
-				&a->address.in);
-			if (r < 0)
-				continue;
+	l->n_list++;
 
-			break;
-		case AF_INET6:
-			r = sd_rtnl_message_read_in6_addr(m, RTA_GATEWAY,
-				&a->address.in6);
-			if (r < 0)
-				continue;
+	return 0;
+}
 
-			break;
-		default:
-			continue;
-		}
+int
+local_gateways(sd_rtnl *context, int ifindex, int af,
+	struct local_address **ret)
+{
+	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL;
+	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
+	AddressList l = {
+		.ifindex = ifindex,
+		.af = af,
+	};
+	int r;
 
-		sd_rtnl_message_read_u32(m, RTA_PRIORITY, &a->metric);
+	assert(ret);
 
-		a->ifindex = ifi;
-		a->family = family;
+	if (context)
+		rtnl = sd_rtnl_ref(context);
+	else {
+		r = sd_rtnl_open(&rtnl, 0);
+		if (r < 0)
+			return r;
+	}
 
-		n_list++;
+	r = sd_rtnl_message_new_route(rtnl, &req, RTM_GETROUTE, af,
+		RTPROT_UNSPEC);
+	if (r < 0)
+		return r;
+
+	r = sd_rtnl_message_request_dump(req, true);
+	if (r < 0)
+		return r;
+
+	r = sd_rtnl_call_dump(rtnl, req, 0, gateway_handler, &l);
+	if (r < 0) {
+		free(l.list);
+		return r;
 	}
 
-	if (n_list > 0)
-		qsort(list, n_list, sizeof(struct local_address),
+	if (l.n_list > 0)
+		qsort(l.list, l.n_list, sizeof(struct local_address),
 			address_compare);
 
-	*ret = list;
-	list = NULL;
+	*ret = l.list;
 
-	return (int)n_list;
+	return (int)l.n_list;
 }
@@ -36,6 +36,12 @@
 
 #define RTNL_CONTAINER_DEPTH 32
 
+/* Upper bounds for the requests written with a single sendmsg(). The
+ * kernel answers them all before the call returns, so this also limits
+ * how many replies pile up in the receive buffer at once. */
+#define RTNL_BATCH_MAX 64
+#define RTNL_BATCH_SIZE_MAX (32 * 1024)
+
 struct reply_callback {
 	sd_rtnl_message_handler_t callback;
 	void *userdata;
@@ -78,6 +84,7 @@ struct sd_rtnl {
 	size_t rbuffer_allocated;
 
 	bool processing: 1;
+	bool strict_check: 1;
 
 	uint32_t serial;
 
@@ -86,6 +93,15 @@ struct sd_rtnl {
 
 	IWLIST_HEAD(struct match_callback, match_callbacks);
 
+	/* The dump sd_rtnl_call_dump() is waiting for. Its replies are
+         * handed to the callback straight from the read buffer. */
+	uint32_t dump_serial;
+	sd_rtnl_message_handler_t dump_callback;
+	void *dump_userdata;
+	sd_rtnl_message *dump_view;
+	int dump_error;
+	bool dump_done: 1;
+
 	pid_t original_pid;
 
 	sd_event_source *io_event_source;
@@ -100,6 +116,7 @@ struct sd_rtnl_message {
 	sd_rtnl *rtnl;
 
 	struct nlmsghdr *hdr;
+	void *rbuffer; /* receive buffer hdr points into, if handed over */
 	const struct NLTypeSystem *(container_type_system
 			[RTNL_CONTAINER_DEPTH]); /* the type of the container and all its parents */
 	size_t container_offsets
@@ -116,6 +133,7 @@ struct sd_rtnl_message {
 int message_new(sd_rtnl *rtnl, sd_rtnl_message **ret, uint16_t type);
 
 int socket_write_message(sd_rtnl *nl, sd_rtnl_message *m);
+int socket_write_messages(sd_rtnl *nl, sd_rtnl_message **m, unsigned n);
 int socket_read_message(sd_rtnl *nl);
 
 int rtnl_rqueue_make_room(sd_rtnl *rtnl);
@@ -625,6 +625,12 @@ sd_rtnl_message_new_addr(sd_rtnl *rtnl, sd_rtnl_message **ret,
 
 	ifa->ifa_index = index;
 	ifa->ifa_family = family;
+
+	/* Dump requests have to leave this unset, or the kernel refuses
+         * them when strict checking is enabled */
+	if (nlmsg_type == RTM_GETADDR)
+		return 0;
+
 	if (family == AF_INET)
 		ifa->ifa_prefixlen = 32;
 	else if (family == AF_INET6)
@@ -665,7 +671,10 @@ sd_rtnl_message_unref(sd_rtnl_message *m)
 	while (m && REFCNT_DEC(m->n_ref) == 0) {
 		unsigned i;
 
-		free(m->hdr);
+		if (m->rbuffer)
+			free(m->rbuffer);
+		else
+			free(m->hdr);
 
 		for (i = 0; i <= m->n_containers; i++)
 			free(m->rta_offset_tb[i]);
@@ -1524,11 +1533,19 @@ rtnl_message_parse(sd_rtnl_message *m, size_t **rta_offset_tb,
 	unsigned short type;
 	size_t *tb;
 
-	tb = new0(size_t, max + 1);
-	if (!tb)
-		return -ENOMEM;
+	/* Reuse the table if there is one already, which is the case
+         * for the views handed out while reading a dump */
+	if (*rta_offset_tb && *rta_tb_size >= max + 1) {
+		tb = *rta_offset_tb;
+		memzero(tb, sizeof(size_t) * *rta_tb_size);
+	} else {
+		tb = new0(size_t, max + 1);
+		if (!tb)
+			return -ENOMEM;
 
-	*rta_tb_size = max + 1;
+		free(*rta_offset_tb);
+		*rta_tb_size = max + 1;
+	}
 
 	for (; RTA_OK(rta, rt_len); rta = RTA_NEXT(rta, rt_len)) {
 		type = RTA_TYPE(rta);
@@ -1575,6 +1592,53 @@ socket_write_message(sd_rtnl *nl, sd_rtnl_message *m)
 	return k;
 }
 
+/* Writes as many of the specified sealed messages as fit into a single
+ * datagram. The kernel processes the messages of a datagram one after
+ * the other, and replies to each of them individually. Returns the
+ * number of messages sent, or a negative error code. */
+int
+socket_write_messages(sd_rtnl *nl, sd_rtnl_message **m, unsigned n)
+{
+	union {
+		struct sockaddr sa;
+		struct sockaddr_nl nl;
+	} addr = {
+		.nl.nl_family = AF_NETLINK,
+	};
+	struct iovec iov[RTNL_BATCH_MAX];
+	struct msghdr mh = {
+		.msg_name = &addr.sa,
+		.msg_namelen = sizeof(addr),
+		.msg_iov = iov,
+	};
+	size_t size = 0;
+	ssize_t k;
+
+	assert(nl);
+	assert(m);
+	assert(n > 0);
+
+	while (mh.msg_iovlen < MIN(n, (unsigned)RTNL_BATCH_MAX)) {
+		struct nlmsghdr *hdr = m[mh.msg_iovlen]->hdr;
+
+		assert(hdr);
+
+		/* Always send at least one message, however large */
+		if (mh.msg_iovlen > 0 &&
+			size + hdr->nlmsg_len > RTNL_BATCH_SIZE_MAX)
+			break;
+
+		iov[mh.msg_iovlen++] = IOVEC_MAKE(hdr, hdr->nlmsg_len);
+		size += hdr->nlmsg_len;
+	}
+
+	k = sendmsg(nl->fd, &mh, 0);
+	if (k < 0)
+		return (errno == EAGAIN) ? 0 : -errno;
+
+	return (int)mh.msg_iovlen;
+}
+
 static int
 socket_recv_message(int fd, struct iovec *iov, uint32_t *_group, bool peek)
 {
@@ -1648,6 +1712,147 @@ socket_recv_message(int fd, struct iovec *iov, uint32_t *_group, bool peek)
 	return r;
 }
 
+static int
+dump_view_set(sd_rtnl *rtnl, struct nlmsghdr *hdr, const NLType *nl_type)
+{
+	sd_rtnl_message *m;
+	unsigned i;
+	int r;
+
+	if (!rtnl->dump_view) {
+		r = message_new_empty(rtnl, &rtnl->dump_view);
+		if (r < 0)
+			return r;
+	}
+
+	m = rtnl->dump_view;
+
+	/* Drop whatever the previous callback left behind */
+	for (i = 1; i <= m->n_containers; i++) {
+		free(m->rta_offset_tb[i]);
+		m->rta_offset_tb[i] = NULL;
+		m->rta_tb_size[i] = 0;
+		m->container_type_system[i] = NULL;
+	}
+	m->n_containers = 0;
+
+	m->hdr = hdr;
+	m->sealed = true;
+	m->container_type_system[0] = NULL;
+
+	if (nl_type->type != NLA_NESTED)
+		return 0;
+
+	m->container_type_system[0] = nl_type->type_system;
+
+	return rtnl_message_parse(m, &m->rta_offset_tb[0], &m->rta_tb_size[0],
+		nl_type->type_system->max,
+		(struct rtattr *)((uint8_t *)NLMSG_DATA(hdr) +
+			NLMSG_ALIGN(nl_type->size)),
+		NLMSG_PAYLOAD(hdr, nl_type->size));
+}
+
+static int
+dump_view_release(sd_rtnl *rtnl)
+{
+	sd_rtnl_message *m = rtnl->dump_view;
+	struct nlmsghdr *hdr;
+
+	if (REFCNT_GET(m->n_ref) <= 1) {
+		m->hdr = NULL;
+		return 0;
+	}
+
+	/* The callback kept a reference, hence give it a copy it can
+         * hold on to, and use a new view for the next message */
+	rtnl->dump_view = sd_rtnl_message_unref(m);
+
+	hdr = memdup(m->hdr, m->hdr->nlmsg_len);
+	if (hdr) {
+		m->hdr = hdr;
+		return 0;
+	}
+
+	/* Without memory for a copy, hand over the whole receive
+         * buffer instead, and let the next read allocate a new one.
+         * The dump fails with this, so no callback gets to run, and
+         * to drop the message, while we are still looking at the rest
+         * of the buffer. */
+	m->rbuffer = rtnl->rbuffer;
+	rtnl->rbuffer = NULL;
+	rtnl->rbuffer_allocated = 0;
+
+	return -ENOMEM;
+}
+
+/* Hands the messages of a datagram that belongs to the dump that
+ * sd_rtnl_call_dump() is reading to its callback, without copying them
+ * or allocating anything per message */
+static int
+socket_dispatch_dump(sd_rtnl *rtnl, size_t len)
+{
+	struct nlmsghdr *new_msg;
+	int r;
+
+	for (new_msg = rtnl->rbuffer; NLMSG_OK(new_msg, len);
+		new_msg = NLMSG_NEXT(new_msg, len)) {
+		const NLType *nl_type;
+
+		if (new_msg->nlmsg_pid != rtnl->sockaddr.nl.nl_pid ||
+			new_msg->nlmsg_seq != rtnl->dump_serial ||
+			new_msg->nlmsg_type == NLMSG_NOOP)
+			continue;
+
+		if (IN_SET(new_msg->nlmsg_type, NLMSG_DONE, NLMSG_ERROR)) {
+			int error = 0;
+
+			/* Both carry an error code, the kernel uses the
+                         * latter if it could not even start the dump */
+			if (new_msg->nlmsg_len >= NLMSG_LENGTH(sizeof(int)))
+				error = *(int *)NLMSG_DATA(new_msg);
+
+			if (error < 0 && rtnl->dump_error >= 0)
+				rtnl->dump_error = error;
+
+			rtnl->dump_done = true;
+			break;
+		}
+
+		/* Once the callback failed, just drain the rest */
+		if (rtnl->dump_error < 0)
+			continue;
+
+		r = type_system_get_type(NULL, &nl_type, new_msg->nlmsg_type);
+		if (r < 0) {
+			if (r == -ENOTSUP)
+				log_debug(
+					"sd-rtnl: ignored message with unknown type: %i",
+					new_msg->nlmsg_type);
+
+			continue;
+		}
+
+		if (new_msg->nlmsg_len < NLMSG_LENGTH(nl_type->size)) {
+			log_debug(
+				"sd-rtnl: message larger than expected, dropping");
+			continue;
+		}
+
+		r = dump_view_set(rtnl, new_msg, nl_type);
+		if (r >= 0)
+			r = rtnl->dump_callback(rtnl, rtnl->dump_view,
+				rtnl->dump_userdata);
+		if (r < 0)
+			rtnl->dump_error = r;
+
+		r = dump_view_release(rtnl);
+		if (r < 0 && rtnl->dump_error >= 0)
+			rtnl->dump_error = r;
+	}
+
+	return 1;
+}
+
 /* On success, the number of bytes received is returned and *ret points to the received message
  * which has a valid header and the correct size.
  * If nothing useful was received 0 is returned.
@@ -1666,8 +1871,6 @@ socket_read_message(sd_rtnl *rtnl)
 	unsigned i = 0;
 
 	assert(rtnl);
-	assert(rtnl->rbuffer);
-	assert(rtnl->rbuffer_allocated >= sizeof(struct nlmsghdr));
 
 	/* read nothing, just get the pending message size */
 	r = socket_recv_message(rtnl->fd, &iov, &group, true);
@@ -1676,7 +1879,8 @@ socket_read_message(sd_rtnl *rtnl)
 	else
 		len = (size_t)r;
 
-	/* make room for the pending message */
+	/* make room for the pending message, there might be no buffer
+         * at all if dump_view_release() handed it over */
 	if (!greedy_realloc((void **)&rtnl->rbuffer, &rtnl->rbuffer_allocated,
 		    len, sizeof(uint8_t)))
 		return -ENOMEM;
@@ -1695,6 +1899,10 @@ socket_read_message(sd_rtnl *rtnl)
 		/* message did not fit in read buffer */
 		return -EIO;
 
+	if (rtnl->dump_callback && !group && NLMSG_OK(rtnl->rbuffer, len) &&
+		rtnl->rbuffer->nlmsg_seq == rtnl->dump_serial)
+		return socket_dispatch_dump(rtnl, len);
+
 	if (NLMSG_OK(rtnl->rbuffer, len) &&
 		rtnl->rbuffer->nlmsg_flags & NLM_F_MULTI) {
 		multi_part = true;
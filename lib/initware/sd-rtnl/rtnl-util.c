@@ -104,6 +104,32 @@ rtnl_set_link_properties(sd_rtnl **rtnl, int ifindex, const char *alias,
 	return 0;
 }
 
+int
+rtnl_message_new_addr_dump(sd_rtnl *rtnl, sd_rtnl_message **ret, int ifindex,
+	int family)
+{
+	struct ifaddrmsg *ifa;
+	int r;
+
+	assert(ret);
+	assert(ifindex >= 0);
+
+	/* Requests only the addresses of the specified interface and
+         * family. The kernel only honours the interface index if strict
+         * checking is enabled on the connection, and older kernels do
+         * not support that at all, so callers have to check the replies
+         * themselves as well. */
+
+	r = sd_rtnl_message_new_addr(rtnl, ret, RTM_GETADDR, 0, family);
+	if (r < 0)
+		return r;
+
+	ifa = NLMSG_DATA((*ret)->hdr);
+	ifa->ifa_index = ifindex;
+
+	return 0;
+}
+
 int
 rtnl_message_new_synthetic_error(int error, uint32_t serial,
 	sd_rtnl_message **ret)
@@ -26,6 +26,8 @@
 
 int rtnl_message_new_synthetic_error(int error, uint32_t serial,
 	sd_rtnl_message **ret);
+int rtnl_message_new_addr_dump(sd_rtnl *rtnl, sd_rtnl_message **ret,
+	int ifindex, int family);
 uint32_t rtnl_message_get_serial(sd_rtnl_message *m);
 void rtnl_message_seal(sd_rtnl_message *m);
 
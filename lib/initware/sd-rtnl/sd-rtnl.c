@@ -217,6 +217,30 @@ sd_rtnl_inc_rcvbuf(const sd_rtnl *const rtnl, const int size)
 	return fd_inc_rcvbuf(rtnl->fd, size);
 }
 
+int
+sd_rtnl_set_strict_check(sd_rtnl *rtnl, int b)
+{
+	int v = !!b;
+
+	assert_return(rtnl, -EINVAL);
+	assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+
+	/* With strict checking enabled, the kernel validates the headers
+         * of dump requests, and uses the fields set in them to filter
+         * what it dumps. Returns > 0 if the setting was changed. */
+
+	if (rtnl->strict_check == v)
+		return 0;
+
+	if (setsockopt(rtnl->fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &v,
+		    sizeof(v)) < 0)
+		return -errno;
+
+	rtnl->strict_check = v;
+
+	return 1;
+}
+
 sd_rtnl *
 sd_rtnl_ref(sd_rtnl *rtnl)
 {
@@ -253,6 +277,7 @@ sd_rtnl_unref(sd_rtnl *rtnl)
 			sd_rtnl_message_unref(rtnl->wqueue[i]);
 		free(rtnl->wqueue);
 
+		sd_rtnl_message_unref(rtnl->dump_view);
 		free(rtnl->rbuffer);
 
 		hashmap_free_free(rtnl->reply_callbacks);
@@ -335,6 +360,91 @@ sd_rtnl_send(sd_rtnl *nl, sd_rtnl_message *message, uint32_t *serial)
 	return 1;
 }
 
+static bool
+rtnl_message_is_dump(sd_rtnl_message *m)
+{
+	/* The dump flags overlap with NLM_F_EXCL and NLM_F_REPLACE, and
+         * only carry that meaning in requests for information */
+	switch (m->hdr->nlmsg_type) {
+	case RTM_GETLINK:
+	case RTM_GETADDR:
+	case RTM_GETROUTE:
+	case RTM_GETNEIGH:
+		return (m->hdr->nlmsg_flags & NLM_F_DUMP) != 0;
+	default:
+		return false;
+	}
+}
+
+int
+sd_rtnl_send_many(sd_rtnl *nl, sd_rtnl_message **messages, unsigned n,
+	uint32_t *serials)
+{
+	unsigned i, sent = 0;
+	int r;
+
+	assert_return(nl, -EINVAL);
+	assert_return(!rtnl_pid_changed(nl), -ECHILD);
+	assert_return(messages || n == 0, -EINVAL);
+
+	for (i = 0; i < n; i++) {
+		assert_return(messages[i], -EINVAL);
+		assert_return(!messages[i]->sealed, -EPERM);
+
+		/* The kernel only runs one dump at a time per socket, a
+                 * second one in the same batch would fail with EBUSY */
+		assert_return(!rtnl_message_is_dump(messages[i]), -EINVAL);
+	}
+
+	for (i = 0; i < n; i++) {
+		rtnl_seal_message(nl, messages[i]);
+
+		if (serials)
+			serials[i] = rtnl_message_get_serial(messages[i]);
+	}
+
+	/* Anything queued before has to go out first */
+	while (nl->wqueue_size <= 0 && sent < n) {
+		r = socket_write_messages(nl, messages + sent, n - sent);
+		if (r < 0)
+			return r;
+		if (r == 0)
+			break;
+
+		sent += r;
+
+		if (sent >= n)
+			break;
+
+		/* The replies to what we just sent are in the receive
+                 * buffer already, move them out of the way before
+                 * sending more */
+		do {
+			r = socket_read_message(nl);
+		} while (r > 0);
+		if (r < 0)
+			return r;
+	}
+
+	if (sent < n) {
+		if (nl->wqueue_size + n - sent > RTNL_WQUEUE_MAX) {
+			log_debug("rtnl: exhausted the write queue size (%d)",
+				RTNL_WQUEUE_MAX);
+			return -ENOBUFS;
+		}
+
+		if (!GREEDY_REALLOC(nl->wqueue, nl->wqueue_allocated,
+			    nl->wqueue_size + n - sent))
+			return -ENOMEM;
+
+		for (i = sent; i < n; i++)
+			nl->wqueue[nl->wqueue_size++] =
+				sd_rtnl_message_ref(messages[i]);
+	}
+
+	return 1;
+}
+
 int
 rtnl_rqueue_make_room(sd_rtnl *rtnl)
 {
@@ -840,6 +950,207 @@ sd_rtnl_call(sd_rtnl *rtnl, sd_rtnl_message *message, uint64_t usec,
 	}
 }
 
+int
+sd_rtnl_call_many(sd_rtnl *rtnl, sd_rtnl_message **messages, unsigned n,
+	uint64_t usec, sd_rtnl_message **replies)
+{
+	_cleanup_free_ sd_rtnl_message **allocated = NULL;
+	_cleanup_free_ uint32_t *serials = NULL;
+	unsigned i = 0, j, n_left = n;
+	usec_t timeout;
+	int r;
+
+	assert_return(rtnl, -EINVAL);
+	assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+	assert_return(messages || n == 0, -EINVAL);
+
+	/* Like sd_rtnl_call(), but sends all messages at once and waits
+         * for all of their replies. replies[i] is set to the reply to
+         * messages[i], or NULL if there was none in time. Returns the
+         * error of the first failed request, if any. */
+
+	if (replies)
+		memzero(replies, sizeof(sd_rtnl_message *) * n);
+	else {
+		replies = allocated = new0(sd_rtnl_message *, n);
+		if (!replies)
+			return -ENOMEM;
+	}
+
+	if (n == 0)
+		return 1;
+
+	serials = new (uint32_t, n);
+	if (!serials)
+		return -ENOMEM;
+
+	r = sd_rtnl_send_many(rtnl, messages, n, serials);
+	if (r < 0)
+		return r;
+
+	timeout = calc_elapse(usec);
+
+	while (n_left > 0) {
+		usec_t left;
+
+		while (i < rtnl->rqueue_size) {
+			uint32_t received_serial;
+
+			received_serial =
+				rtnl_message_get_serial(rtnl->rqueue[i]);
+
+			/* Batches are short, no need for anything fancier */
+			for (j = 0; j < n; j++)
+				if (serials[j] == received_serial)
+					break;
+
+			if (j >= n || replies[j]) {
+				i++;
+				continue;
+			}
+
+			replies[j] = rtnl->rqueue[i];
+			memmove(rtnl->rqueue + i, rtnl->rqueue + i + 1,
+				sizeof(sd_rtnl_message *) *
+					(rtnl->rqueue_size - i - 1));
+			rtnl->rqueue_size--;
+			n_left--;
+		}
+
+		if (n_left <= 0)
+			break;
+
+		r = socket_read_message(rtnl);
+		if (r < 0)
+			goto finish;
+		if (r > 0)
+			continue;
+
+		if (timeout > 0) {
+			usec_t k;
+
+			k = now(CLOCK_MONOTONIC);
+			if (k >= timeout) {
+				r = -ETIMEDOUT;
+				goto finish;
+			}
+
+			left = timeout - k;
+		} else
+			left = (uint64_t)-1;
+
+		r = rtnl_poll(rtnl, true, left);
+		if (r < 0)
+			goto finish;
+		if (r == 0) {
+			r = -ETIMEDOUT;
+			goto finish;
+		}
+
+		r = dispatch_wqueue(rtnl);
+		if (r < 0)
+			goto finish;
+	}
+
+	r = 1;
+	for (j = 0; j < n; j++) {
+		int k;
+
+		k = sd_rtnl_message_get_errno(replies[j]);
+		if (k < 0) {
+			r = k;
+			break;
+		}
+	}
+
+finish:
+	if (allocated)
+		for (j = 0; j < n; j++)
+			sd_rtnl_message_unref(allocated[j]);
+
+	return r;
+}
+
+int
+sd_rtnl_call_dump(sd_rtnl *rtnl, sd_rtnl_message *message, uint64_t usec,
+	sd_rtnl_message_handler_t callback, void *userdata)
+{
+	usec_t timeout;
+	uint32_t serial;
+	int r;
+
+	assert_return(rtnl, -EINVAL);
+	assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+	assert_return(message, -EINVAL);
+	assert_return(callback, -EINVAL);
+	assert_return(rtnl_message_is_dump(message), -EINVAL);
+	assert_return(!rtnl->dump_callback, -EBUSY);
+
+	/* Like sd_rtnl_call() for a dump request, but instead of
+         * collecting the replies into a chain of messages, calls the
+         * callback for each of them as it is read. The message passed
+         * is a view into the read buffer that is reused for the next
+         * one, unless the callback takes a reference to it. If the
+         * callback fails, the rest of the dump is skipped and its error
+         * returned. */
+
+	r = sd_rtnl_send(rtnl, message, &serial);
+	if (r < 0)
+		return r;
+
+	rtnl->dump_serial = serial;
+	rtnl->dump_callback = callback;
+	rtnl->dump_userdata = userdata;
+	rtnl->dump_error = 0;
+	rtnl->dump_done = false;
+
+	timeout = calc_elapse(usec);
+
+	for (;;) {
+		usec_t left;
+
+		r = socket_read_message(rtnl);
+		if (r < 0)
+			break;
+		if (rtnl->dump_done) {
+			r = rtnl->dump_error < 0 ? rtnl->dump_error : 1;
+			break;
+		}
+		if (r > 0)
+			continue;
+
+		if (timeout > 0) {
+			usec_t n;
+
+			n = now(CLOCK_MONOTONIC);
+			if (n >= timeout) {
+				r = -ETIMEDOUT;
+				break;
+			}
+
+			left = timeout - n;
+		} else
+			left = (uint64_t)-1;
+
+		r = rtnl_poll(rtnl, true, left);
+		if (r < 0)
+			break;
+		if (r == 0) {
+			r = -ETIMEDOUT;
+			break;
+		}
+
+		r = dispatch_wqueue(rtnl);
+		if (r < 0)
+			break;
+	}
+
+	rtnl->dump_callback = NULL;
+	rtnl->dump_userdata = NULL;
+
+	return r;
+}
+
 int
 sd_rtnl_flush(sd_rtnl *rtnl)
 {
@@ -0,0 +1,325 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <net/if.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "local-addresses.h"
+#include "log.h"
+#include "macro.h"
+#include "rtnl-util.h"
+#include "sd-rtnl.h"
+#include "util.h"
+
+/* Creates, addresses and removes a number of dummy interfaces in a new
+ * network namespace, once with one request per round trip and once with
+ * all requests sent at once. Then compares dumping all links into a
+ * chain of messages with looking at them right in the read buffer, and
+ * enumerating the addresses of a single interface with and without
+ * letting the kernel filter them. */
+
+#define DEFAULT_LINKS 256
+#define LOOKUPS 100
+#define DUMPS 20
+
+typedef enum Step {
+	STEP_NEWLINK,
+	STEP_NEWADDR,
+	STEP_DELLINK,
+} Step;
+
+static int
+new_message(sd_rtnl *rtnl, Step step, unsigned i, sd_rtnl_message **ret)
+{
+	char name[IFNAMSIZ];
+	struct in_addr a;
+	int r;
+
+	snprintf(name, sizeof(name), "bench%u", i);
+
+	switch (step) {
+	case STEP_NEWLINK:
+		r = sd_rtnl_message_new_link(rtnl, ret, RTM_NEWLINK, 0);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_message_append_string(*ret, IFLA_IFNAME, name);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_message_open_container(*ret, IFLA_LINKINFO);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_message_append_string(*ret, IFLA_INFO_KIND,
+			"dummy");
+		if (r < 0)
+			return r;
+
+		return sd_rtnl_message_close_container(*ret);
+
+	case STEP_NEWADDR:
+		r = sd_rtnl_message_new_addr(rtnl, ret, RTM_NEWADDR,
+			(int)if_nametoindex(name), AF_INET);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_message_addr_set_prefixlen(*ret, 24);
+		if (r < 0)
+			return r;
+
+		/* 10.x.y.1/24 */
+		a.s_addr = htonl(0x0a000001 | (i << 8));
+		return sd_rtnl_message_append_in_addr(*ret, IFA_LOCAL, &a);
+
+	case STEP_DELLINK:
+		return sd_rtnl_message_new_link(rtnl, ret, RTM_DELLINK,
+			(int)if_nametoindex(name));
+	}
+
+	assert_not_reached("Unknown step");
+}
+
+static int
+run(sd_rtnl *rtnl, Step step, unsigned n, bool batch, usec_t *ret)
+{
+	sd_rtnl_message **m;
+	unsigned i;
+	usec_t t;
+	int r = 0;
+
+	m = new0(sd_rtnl_message *, n);
+	if (!m)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		r = new_message(rtnl, step, i, &m[i]);
+		if (r < 0)
+			goto finish;
+	}
+
+	t = now(CLOCK_MONOTONIC);
+
+	if (batch)
+		r = sd_rtnl_call_many(rtnl, m, n, 0, NULL);
+	else
+		for (i = 0; i < n && r >= 0; i++)
+			r = sd_rtnl_call(rtnl, m[i], 0, NULL);
+
+	*ret = now(CLOCK_MONOTONIC) - t;
+
+finish:
+	for (i = 0; i < n; i++)
+		sd_rtnl_message_unref(m[i]);
+	free(m);
+
+	return r;
+}
+
+static int
+count_handler(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	unsigned *n = userdata;
+	const char *name;
+	int r;
+
+	r = sd_rtnl_message_read_string(m, IFLA_IFNAME, &name);
+	if (r < 0)
+		return r;
+
+	(*n)++;
+	return 0;
+}
+
+static int
+dump(sd_rtnl *rtnl, bool view, unsigned *n, usec_t *ret)
+{
+	usec_t t;
+	unsigned i;
+	int r;
+
+	t = now(CLOCK_MONOTONIC);
+
+	for (i = 0; i < DUMPS; i++) {
+		_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL,
+							     *reply = NULL;
+		sd_rtnl_message *m;
+
+		*n = 0;
+
+		r = sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_message_request_dump(req, true);
+		if (r < 0)
+			return r;
+
+		if (view) {
+			r = sd_rtnl_call_dump(rtnl, req, 0, count_handler, n);
+			if (r < 0)
+				return r;
+
+			continue;
+		}
+
+		r = sd_rtnl_call(rtnl, req, 0, &reply);
+		if (r < 0)
+			return r;
+
+		for (m = reply; m; m = sd_rtnl_message_next(m)) {
+			r = count_handler(rtnl, m, n);
+			if (r < 0)
+				return r;
+		}
+	}
+
+	*ret = (now(CLOCK_MONOTONIC) - t) / DUMPS;
+	return 0;
+}
+
+static int
+lookup(sd_rtnl *rtnl, int ifindex, usec_t *ret)
+{
+	usec_t t;
+	unsigned i;
+	int r;
+
+	t = now(CLOCK_MONOTONIC);
+
+	for (i = 0; i < LOOKUPS; i++) {
+		_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL,
+							     *reply = NULL;
+
+		r = rtnl_message_new_addr_dump(rtnl, &req, ifindex, AF_INET);
+		if (r < 0)
+			return r;
+
+		r = sd_rtnl_call(rtnl, req, 0, &reply);
+		if (r < 0)
+			return r;
+	}
+
+	*ret = (now(CLOCK_MONOTONIC) - t) / LOOKUPS;
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const char *const steps[] = {
+		[STEP_NEWLINK] = "create",
+		[STEP_NEWADDR] = "address",
+		[STEP_DELLINK] = "remove",
+	};
+	_cleanup_rtnl_unref_ sd_rtnl *rtnl = NULL;
+	_cleanup_free_ struct local_address *a = NULL;
+	usec_t t[2][ELEMENTSOF(steps)], l[2];
+	unsigned n = DEFAULT_LINKS, n_links[2];
+	int ifindex, batch, r;
+	Step step;
+
+	log_set_max_level(LOG_INFO);
+	log_parse_environment();
+	log_open();
+
+	if (argc > 1 && (safe_atou(argv[1], &n) < 0 || n == 0 || n > 1000)) {
+		log_error("Invalid number of interfaces: %s", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	if (unshare(CLONE_NEWNET) < 0) {
+		log_info_errno(errno,
+			"Cannot create network namespace, skipping: %m");
+		return EXIT_TEST_SKIP;
+	}
+
+	r = sd_rtnl_open(&rtnl, 0);
+	if (r < 0) {
+		log_error_errno(r, "Failed to connect to netlink: %m");
+		return EXIT_FAILURE;
+	}
+
+	/* The second round leaves the interfaces around for the lookups */
+	for (batch = 0; batch <= 1; batch++)
+		for (step = 0; step <= (batch ? STEP_NEWADDR : STEP_DELLINK);
+			step++) {
+			r = run(rtnl, step, n, batch, &t[batch][step]);
+			if (r == -EOPNOTSUPP) {
+				log_info("No dummy interface support, skipping.");
+				return EXIT_TEST_SKIP;
+			}
+			if (r < 0) {
+				log_error_errno(r,
+					"Failed to %s interfaces: %m",
+					steps[step]);
+				return EXIT_FAILURE;
+			}
+		}
+
+	for (step = 0; step <= STEP_NEWADDR; step++)
+		log_info("%s %u interfaces: %.1fms one by one, %.1fms batched",
+			steps[step], n, (double)t[0][step] / USEC_PER_MSEC,
+			(double)t[1][step] / USEC_PER_MSEC);
+
+	r = dump(rtnl, false, &n_links[0], &l[0]);
+	if (r >= 0)
+		r = dump(rtnl, true, &n_links[1], &l[1]);
+	if (r < 0) {
+		log_error_errno(r, "Failed to dump links: %m");
+		return EXIT_FAILURE;
+	}
+	if (n_links[0] != n_links[1]) {
+		log_error("Dumps disagree: %u vs. %u links", n_links[0],
+			n_links[1]);
+		return EXIT_FAILURE;
+	}
+
+	log_info("dump %u links: %.1fms as a chain, %.1fms in place",
+		n_links[0], (double)l[0] / USEC_PER_MSEC,
+		(double)l[1] / USEC_PER_MSEC);
+
+	ifindex = (int)if_nametoindex("bench0");
+
+	r = local_addresses(rtnl, ifindex, AF_INET, &a);
+	if (r != 1) {
+		log_error_errno(r, "Failed to find address of bench0: %m");
+		return EXIT_FAILURE;
+	}
+
+	r = lookup(rtnl, 0, &l[0]);
+	if (r >= 0) {
+		r = sd_rtnl_set_strict_check(rtnl, true);
+		if (r == -ENOPROTOOPT) {
+			log_info("Kernel cannot filter dumps, skipping lookups.");
+			return EXIT_SUCCESS;
+		}
+	}
+	if (r >= 0)
+		r = lookup(rtnl, ifindex, &l[1]);
+	if (r < 0) {
+		log_error_errno(r, "Failed to dump addresses: %m");
+		return EXIT_FAILURE;
+	}
+
+	log_info("addresses of one of %u interfaces: %.1fus for a full dump, "
+		 "%.1fus filtered",
+		n, (double)l[0], (double)l[1]);
+
+	return EXIT_SUCCESS;
+}
@@ -431,6 +431,188 @@ test_get_addresses(sd_rtnl *rtnl)
 	}
 }
 
+static void
+test_call_many(sd_rtnl *rtnl, int ifindex)
+{
+	sd_rtnl_message *m[3] = {}, *replies[3] = {};
+	const char *name;
+	unsigned i;
+
+	assert_se(sd_rtnl_message_new_link(rtnl, &m[0], RTM_GETLINK,
+			  ifindex) >= 0);
+	assert_se(sd_rtnl_message_new_link(rtnl, &m[1], RTM_GETLINK,
+			  INT_MAX) >= 0);
+	assert_se(sd_rtnl_message_new_link(rtnl, &m[2], RTM_GETLINK,
+			  ifindex) >= 0);
+
+	/* The failure of one request does not affect the others */
+	assert_se(sd_rtnl_call_many(rtnl, m, 3, 0, replies) == -ENODEV);
+
+	assert_se(replies[0] && replies[1] && replies[2]);
+	assert_se(sd_rtnl_message_get_errno(replies[1]) == -ENODEV);
+
+	assert_se(sd_rtnl_message_read_string(replies[0], IFLA_IFNAME,
+			  &name) >= 0);
+	assert_se(streq(name, "lo"));
+	assert_se(sd_rtnl_message_read_string(replies[2], IFLA_IFNAME,
+			  &name) >= 0);
+	assert_se(streq(name, "lo"));
+
+	/* Messages are sealed once sent */
+	assert_se(sd_rtnl_call_many(rtnl, m, 3, 0, NULL) == -EPERM);
+
+	for (i = 0; i < ELEMENTSOF(m); i++) {
+		sd_rtnl_message_unref(m[i]);
+		sd_rtnl_message_unref(replies[i]);
+	}
+
+	assert_se(sd_rtnl_call_many(rtnl, NULL, 0, 0, NULL) == 1);
+}
+
+static void
+test_call_many_large(sd_rtnl *rtnl, int ifindex)
+{
+	sd_rtnl_message *m[3 * RTNL_BATCH_MAX] = {};
+	unsigned i;
+
+	/* More than fits into a single datagram */
+	for (i = 0; i < ELEMENTSOF(m); i++)
+		assert_se(sd_rtnl_message_new_link(rtnl, &m[i], RTM_GETLINK,
+				  ifindex) >= 0);
+
+	assert_se(sd_rtnl_call_many(rtnl, m, ELEMENTSOF(m), 0, NULL) == 1);
+
+	for (i = 0; i < ELEMENTSOF(m); i++)
+		sd_rtnl_message_unref(m[i]);
+}
+
+static void
+test_addr_dump(sd_rtnl *rtnl, int ifindex)
+{
+	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL, *reply = NULL;
+	sd_rtnl_message *m;
+	int r;
+
+	r = sd_rtnl_set_strict_check(rtnl, true);
+	if (r == -ENOPROTOOPT)
+		log_info("Kernel does not support strict checking.");
+	else
+		assert_se(r > 0);
+
+	assert_se(rtnl_message_new_addr_dump(rtnl, &req, ifindex, AF_INET) >=
+		0);
+	assert_se(sd_rtnl_call(rtnl, req, 0, &reply) >= 0);
+
+	for (m = reply; m; m = sd_rtnl_message_next(m)) {
+		int family, i;
+
+		assert_se(sd_rtnl_message_addr_get_family(m, &family) >= 0);
+		assert_se(family == AF_INET);
+
+		/* Only kernels with strict checking filter by interface */
+		assert_se(sd_rtnl_message_addr_get_ifindex(m, &i) >= 0);
+		assert_se(r < 0 || i == ifindex);
+	}
+
+	if (r > 0)
+		assert_se(sd_rtnl_set_strict_check(rtnl, false) > 0);
+}
+
+static int
+dump_handler(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	unsigned *n = userdata;
+	const char *name;
+	uint16_t type;
+
+	assert_se(sd_rtnl_message_get_type(m, &type) >= 0);
+	assert_se(type == RTM_NEWLINK);
+	assert_se(sd_rtnl_message_read_string(m, IFLA_IFNAME, &name) >= 0);
+	assert_se(!sd_rtnl_message_next(m));
+
+	log_info("dumped link %s", name);
+
+	(*n)++;
+
+	return 0;
+}
+
+static int
+dump_handler_fail(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	unsigned *n = userdata;
+
+	(*n)++;
+
+	return -EIO;
+}
+
+static int
+dump_handler_ref(sd_rtnl *rtnl, sd_rtnl_message *m, void *userdata)
+{
+	sd_rtnl_message **kept = userdata;
+
+	if (!*kept)
+		*kept = sd_rtnl_message_ref(m);
+
+	return 0;
+}
+
+static void
+test_call_dump(sd_rtnl *rtnl)
+{
+	_cleanup_rtnl_message_unref_ sd_rtnl_message *req = NULL, *reply = NULL,
+						     *kept = NULL;
+	sd_rtnl_message *m;
+	unsigned n = 0, n_dumped = 0;
+	const char *name;
+
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+	assert_se(sd_rtnl_message_request_dump(req, true) >= 0);
+	assert_se(sd_rtnl_call(rtnl, req, 0, &reply) >= 0);
+
+	for (m = reply; m; m = sd_rtnl_message_next(m))
+		n++;
+
+	/* Only dump requests are allowed */
+	req = sd_rtnl_message_unref(req);
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 1) >= 0);
+	assert_se(sd_rtnl_call_dump(rtnl, req, 0, dump_handler, &n_dumped) ==
+		-EINVAL);
+
+	req = sd_rtnl_message_unref(req);
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+	assert_se(sd_rtnl_message_request_dump(req, true) >= 0);
+	assert_se(sd_rtnl_call_dump(rtnl, req, 0, dump_handler, &n_dumped) ==
+		1);
+	assert_se(n_dumped == n);
+
+	/* A failing callback is not called again, and the connection
+         * remains usable */
+	n_dumped = 0;
+	req = sd_rtnl_message_unref(req);
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+	assert_se(sd_rtnl_message_request_dump(req, true) >= 0);
+	assert_se(sd_rtnl_call_dump(rtnl, req, 0, dump_handler_fail,
+			  &n_dumped) == -EIO);
+	assert_se(n_dumped == 1);
+
+	/* Messages the callback holds on to stay valid */
+	req = sd_rtnl_message_unref(req);
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+	assert_se(sd_rtnl_message_request_dump(req, true) >= 0);
+	assert_se(sd_rtnl_call_dump(rtnl, req, 0, dump_handler_ref, &kept) ==
+		1);
+	assert_se(kept);
+	assert_se(sd_rtnl_message_read_string(kept, IFLA_IFNAME, &name) >= 0);
+	assert_se(streq(name, "lo"));
+
+	reply = sd_rtnl_message_unref(reply);
+	req = sd_rtnl_message_unref(req);
+	assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 1) >= 0);
+	assert_se(sd_rtnl_call(rtnl, req, 0, &reply) == 1);
+}
+
 static void
 test_message(void)
 {
@@ -478,6 +660,14 @@ main(void)
 
 	test_message_link_bridge(rtnl);
 
+	test_call_many(rtnl, if_loopback);
+
+	test_call_many_large(rtnl, if_loopback);
+
+	test_addr_dump(rtnl, if_loopback);
+
+	test_call_dump(rtnl);
+
 	assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK,
 			  if_loopback) >= 0);
 	assert_se(m);
@@ -17,7 +17,10 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/stat.h>
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -430,6 +433,334 @@ compress_stream_xz(int fdf, int fdt, off_t max_bytes)
 #endif
 }
 
+#ifdef HAVE_XZ
+typedef struct XzChunk {
+	uint8_t *data;
+	size_t size;
+	bool ready;
+} XzChunk;
+
+typedef struct XzParallel {
+	int fdf;
+	uint64_t size;
+	uint64_t n_chunks;
+
+	lzma_filter filters[2];
+	lzma_options_lzma options;
+
+	/* A compressed chunk of zeroes, used for every chunk that turns
+         * out to be empty */
+	uint8_t *zero;
+	size_t zero_size;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* Chunk i is compressed into slot i % n_slots. Workers may only
+         * pick up chunks that are less than n_slots ahead of the last
+         * one written, so that a slot is free when they need it. */
+	XzChunk *slots;
+	unsigned n_slots;
+	uint64_t next;
+	uint64_t written;
+	uint64_t n_zero;
+	int error;
+} XzParallel;
+
+static bool
+buffer_is_zero(const uint8_t *p, size_t n)
+{
+	return n == 0 || (p[0] == 0 && memcmp(p, p + 1, n - 1) == 0);
+}
+
+static bool
+range_is_hole(int fd, uint64_t offset, size_t n)
+{
+	off_t d;
+
+	d = lseek(fd, offset, SEEK_DATA);
+	if (d < 0)
+		/* ENXIO means there is no more data after offset, anything
+                 * else that holes are not supported */
+		return errno == ENXIO;
+
+	return (uint64_t)d >= offset + n;
+}
+
+static int
+xz_encode_chunk(XzParallel *p, lzma_stream *s, const uint8_t *in, size_t n,
+	uint8_t *out, size_t *out_size)
+{
+	lzma_ret ret;
+
+	/* Reinitializing the same stream reuses the encoder's memory */
+	ret = lzma_stream_encoder(s, p->filters, LZMA_CHECK_CRC64);
+	if (ret != LZMA_OK) {
+		log_error("Failed to initialize XZ encoder: code %u", ret);
+		return -EINVAL;
+	}
+
+	s->next_in = in;
+	s->avail_in = n;
+	s->next_out = out;
+	s->avail_out = lzma_stream_buffer_bound(XZ_CHUNK_SIZE);
+
+	ret = lzma_code(s, LZMA_FINISH);
+	if (ret != LZMA_STREAM_END) {
+		log_error("Compression failed: code %u", ret);
+		return -EBADMSG;
+	}
+
+	*out_size = s->next_out - out;
+	return 0;
+}
+
+static void *
+xz_parallel_worker(void *userdata)
+{
+	XzParallel *p = userdata;
+	_cleanup_(lzma_end) lzma_stream s = LZMA_STREAM_INIT;
+	_cleanup_free_ uint8_t *in = NULL;
+	int r = 0;
+
+	in = malloc(XZ_CHUNK_SIZE);
+	if (!in)
+		r = -ENOMEM;
+
+	for (;;) {
+		uint64_t i, offset;
+		XzChunk *c;
+		size_t n;
+		ssize_t k;
+
+		pthread_mutex_lock(&p->mutex);
+
+		if (r < 0 && p->error == 0) {
+			p->error = r;
+			pthread_cond_broadcast(&p->cond);
+		}
+
+		while (p->error == 0 && p->next < p->n_chunks &&
+			p->next - p->written >= p->n_slots)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		if (p->error != 0 || p->next >= p->n_chunks) {
+			pthread_mutex_unlock(&p->mutex);
+			return NULL;
+		}
+
+		i = p->next++;
+		pthread_mutex_unlock(&p->mutex);
+
+		c = p->slots + i % p->n_slots;
+		offset = i * XZ_CHUNK_SIZE;
+		n = MIN(p->size - offset, (uint64_t)XZ_CHUNK_SIZE);
+
+		if (n == XZ_CHUNK_SIZE && range_is_hole(p->fdf, offset, n)) {
+			c->size = 0;
+			goto done;
+		}
+
+		k = pread(p->fdf, in, n, offset);
+		if (k < 0) {
+			r = -errno;
+			continue;
+		}
+		if ((size_t)k != n) {
+			r = -EIO;
+			continue;
+		}
+
+		if (n == XZ_CHUNK_SIZE && buffer_is_zero(in, n)) {
+			c->size = 0;
+			goto done;
+		}
+
+		r = xz_encode_chunk(p, &s, in, n, c->data, &c->size);
+		if (r < 0)
+			continue;
+
+	done:
+		pthread_mutex_lock(&p->mutex);
+		c->ready = true;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+
+static int
+xz_parallel_write(XzParallel *p, int fdt)
+{
+	uint64_t total_out = 0;
+	int r;
+
+	for (;;) {
+		XzChunk *c;
+
+		pthread_mutex_lock(&p->mutex);
+
+		if (p->written >= p->n_chunks || p->error != 0) {
+			r = p->error;
+			pthread_mutex_unlock(&p->mutex);
+			break;
+		}
+
+		c = p->slots + p->written % p->n_slots;
+		while (!c->ready && p->error == 0)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		pthread_mutex_unlock(&p->mutex);
+
+		if (!c->ready)
+			continue;
+
+		if (c->size == 0) {
+			r = loop_write(fdt, p->zero, p->zero_size, false);
+			total_out += p->zero_size;
+			p->n_zero++;
+		} else {
+			r = loop_write(fdt, c->data, c->size, false);
+			total_out += c->size;
+		}
+
+		pthread_mutex_lock(&p->mutex);
+		if (r < 0 && p->error == 0)
+			p->error = r;
+		c->ready = false;
+		p->written++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+	}
+
+	if (r >= 0)
+		log_debug("XZ compression finished (%" PRIu64 " -> %" PRIu64
+			  " bytes, %.1f%%, %" PRIu64 " of %" PRIu64
+			  " chunks empty)",
+			p->size, total_out,
+			p->size > 0 ? (double)total_out / p->size * 100 : 0.0,
+			p->n_zero, p->n_chunks);
+
+	return r;
+}
+#endif
+
+int
+compress_stream_xz_parallel(int fdf, int fdt, off_t max_bytes,
+	unsigned n_threads)
+{
+#ifdef HAVE_XZ
+	_cleanup_(lzma_end) lzma_stream s = LZMA_STREAM_INIT;
+	_cleanup_free_ uint8_t *zero = NULL;
+	_cleanup_free_ pthread_t *threads = NULL;
+	XzParallel p = {
+		.fdf = fdf,
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	unsigned i, n_started = 0;
+	struct stat st;
+	int r;
+
+	assert(fdf >= 0);
+	assert(fdt >= 0);
+
+	/* Splits the input into chunks that are compressed by a number
+         * of threads, each into a separate XZ stream. Concatenated XZ
+         * streams are a valid XZ file again, which can be decompressed
+         * chunk by chunk, and in parallel. Chunks that are holes in the
+         * input or contain only zeroes are not compressed again but
+         * replaced by a precomputed empty chunk. */
+
+	if (fstat(fdf, &st) < 0)
+		return -errno;
+
+	/* We need to be able to read the input at random offsets */
+	if (n_threads <= 1 || !S_ISREG(st.st_mode) ||
+		lseek(fdf, 0, SEEK_CUR) != 0)
+		return compress_stream_xz(fdf, fdt, max_bytes);
+
+	p.size = st.st_size;
+	if (max_bytes != -1 && p.size > (uint64_t)max_bytes)
+		p.size = max_bytes;
+	p.n_chunks = DIV_ROUND_UP(p.size, XZ_CHUNK_SIZE);
+
+	if (p.n_chunks <= 1)
+		return compress_stream_xz(fdf, fdt, max_bytes);
+
+	n_threads = MIN(n_threads, p.n_chunks);
+
+	if (lzma_lzma_preset(&p.options, LZMA_PRESET_DEFAULT))
+		return -EINVAL;
+
+	/* A larger dictionary than the chunk would just waste memory */
+	p.options.dict_size = MIN(p.options.dict_size, (uint32_t)XZ_CHUNK_SIZE);
+	p.filters[0] = (lzma_filter){ LZMA_FILTER_LZMA2, &p.options };
+	p.filters[1] = (lzma_filter){ LZMA_VLI_UNKNOWN, NULL };
+
+	zero = malloc0(XZ_CHUNK_SIZE);
+	p.zero = malloc(lzma_stream_buffer_bound(XZ_CHUNK_SIZE));
+	if (!zero || !p.zero) {
+		r = log_oom();
+		goto finish;
+	}
+
+	r = xz_encode_chunk(&p, &s, zero, XZ_CHUNK_SIZE, p.zero, &p.zero_size);
+	if (r < 0)
+		goto finish;
+
+	lzma_end(&s);
+
+	p.n_slots = n_threads * 2;
+	p.slots = new0(XzChunk, p.n_slots);
+	threads = new (pthread_t, n_threads);
+	if (!p.slots || !threads) {
+		r = log_oom();
+		goto finish;
+	}
+
+	for (i = 0; i < p.n_slots; i++) {
+		p.slots[i].data =
+			malloc(lzma_stream_buffer_bound(XZ_CHUNK_SIZE));
+		if (!p.slots[i].data) {
+			r = log_oom();
+			goto finish;
+		}
+	}
+
+	for (; n_started < n_threads; n_started++) {
+		r = pthread_create(&threads[n_started], NULL,
+			xz_parallel_worker, &p);
+		if (r != 0) {
+			r = -r;
+			break;
+		}
+	}
+
+	if (n_started == 0)
+		goto finish;
+
+	/* With fewer threads than asked for we just get slower */
+	r = xz_parallel_write(&p, fdt);
+
+	for (i = 0; i < n_started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (r >= 0 && lseek(fdf, p.size, SEEK_SET) < 0)
+		r = -errno;
+
+finish:
+	if (p.slots)
+		for (i = 0; i < p.n_slots; i++)
+			free(p.slots[i].data);
+	free(p.slots);
+	free(p.zero);
+
+	return r;
+#else
+	return -EPROTONOSUPPORT;
+#endif
+}
+
 #define LZ4_BUFSIZE (512 * 1024)
 
 int
@@ -524,7 +855,9 @@ decompress_stream_xz(int fdf, int fdt, off_t max_bytes)
 	assert(fdf >= 0);
 	assert(fdt >= 0);
 
-	ret = lzma_stream_decoder(&s, UINT64_MAX, 0);
+	/* Files written by compress_stream_xz_parallel() consist of
+         * several concatenated streams */
+	ret = lzma_stream_decoder(&s, UINT64_MAX, LZMA_CONCATENATED);
 	if (ret != LZMA_OK) {
 		log_error("Failed to initialize XZ decoder: code %u", ret);
 		return -ENOMEM;
@@ -588,6 +921,344 @@ decompress_stream_xz(int fdf, int fdt, off_t max_bytes)
 #endif
 }
 
+#ifdef HAVE_XZ
+typedef struct XzStreamInfo {
+	uint64_t offset;
+	uint64_t compressed_size;
+	uint64_t uncompressed_size;
+} XzStreamInfo;
+
+typedef struct XzUnpackChunk {
+	uint8_t *in;
+	uint8_t *out;
+	bool ready;
+} XzUnpackChunk;
+
+typedef struct XzUnpack {
+	int fdf;
+	XzStreamInfo *streams;
+	uint64_t n_streams;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* Same scheme as XzParallel: stream i is decoded into slot
+         * i % n_slots, at most n_slots ahead of the last one written */
+	XzUnpackChunk *slots;
+	unsigned n_slots;
+	uint64_t next;
+	uint64_t written;
+	int error;
+} XzUnpack;
+
+static int
+xz_index_streams(int fd, uint64_t size, XzStreamInfo **ret, uint64_t *ret_n)
+{
+	_cleanup_free_ XzStreamInfo *streams = NULL;
+	_cleanup_free_ uint8_t *index = NULL;
+	size_t allocated = 0, index_allocated = 0;
+	uint64_t pos = size, n = 0, i;
+
+	/* Finds the streams of a file made of concatenated XZ streams
+         * by walking back from the end, the way xz --list does: each
+         * stream ends in a footer, which gives the size of the index
+         * before it, which in turn gives the size of the stream. Only
+         * streams no larger than the ones compress_stream_xz_parallel()
+         * writes are accepted, which bounds the memory needed to
+         * decode them. Returns 0 if the file cannot be indexed. */
+
+	while (pos > 0) {
+		uint8_t footer[LZMA_STREAM_HEADER_SIZE];
+		lzma_stream_flags flags;
+		uint64_t memlimit = UINT64_MAX, stream_size;
+		size_t in_pos = 0;
+		lzma_index *idx = NULL;
+		ssize_t k;
+
+		if (pos < 2 * LZMA_STREAM_HEADER_SIZE)
+			return 0;
+
+		k = pread(fd, footer, sizeof(footer), pos - sizeof(footer));
+		if (k < 0)
+			return -errno;
+		if ((size_t)k != sizeof(footer))
+			return -EIO;
+
+		/* Stream padding, in multiples of four zero bytes */
+		if (memcmp(footer + sizeof(footer) - 4, "\0\0\0\0", 4) == 0) {
+			pos -= 4;
+			continue;
+		}
+
+		if (lzma_stream_footer_decode(&flags, footer) != LZMA_OK)
+			return 0;
+
+		if (pos < 2 * LZMA_STREAM_HEADER_SIZE + flags.backward_size)
+			return 0;
+
+		if (!GREEDY_REALLOC(index, index_allocated,
+			    flags.backward_size))
+			return -ENOMEM;
+
+		k = pread(fd, index, flags.backward_size,
+			pos - sizeof(footer) - flags.backward_size);
+		if (k < 0)
+			return -errno;
+		if ((uint64_t)k != flags.backward_size)
+			return -EIO;
+
+		if (lzma_index_buffer_decode(&idx, &memlimit, NULL, index,
+			    &in_pos, flags.backward_size) != LZMA_OK)
+			return 0;
+
+		if (!GREEDY_REALLOC(streams, allocated, n + 1)) {
+			lzma_index_end(idx, NULL);
+			return -ENOMEM;
+		}
+
+		stream_size = lzma_index_stream_size(idx);
+		streams[n].compressed_size = stream_size;
+		streams[n].uncompressed_size =
+			lzma_index_uncompressed_size(idx);
+		lzma_index_end(idx, NULL);
+
+		if (stream_size > pos ||
+			stream_size > lzma_stream_buffer_bound(XZ_CHUNK_SIZE) ||
+			streams[n].uncompressed_size > XZ_CHUNK_SIZE)
+			return 0;
+
+		pos -= stream_size;
+		streams[n++].offset = pos;
+	}
+
+	/* Found from the back, so turn them around */
+	for (i = 0; i < n / 2; i++) {
+		XzStreamInfo t = streams[i];
+
+		streams[i] = streams[n - 1 - i];
+		streams[n - 1 - i] = t;
+	}
+
+	*ret = streams;
+	streams = NULL;
+	*ret_n = n;
+
+	return 1;
+}
+
+static void *
+xz_unpack_worker(void *userdata)
+{
+	XzUnpack *p = userdata;
+	int r = 0;
+
+	for (;;) {
+		uint64_t i, memlimit = UINT64_MAX;
+		size_t in_pos = 0, out_pos = 0;
+		XzUnpackChunk *c;
+		XzStreamInfo *s;
+		lzma_ret ret;
+		ssize_t k;
+
+		pthread_mutex_lock(&p->mutex);
+
+		if (r < 0 && p->error == 0) {
+			p->error = r;
+			pthread_cond_broadcast(&p->cond);
+		}
+
+		while (p->error == 0 && p->next < p->n_streams &&
+			p->next - p->written >= p->n_slots)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		if (p->error != 0 || p->next >= p->n_streams) {
+			pthread_mutex_unlock(&p->mutex);
+			return NULL;
+		}
+
+		i = p->next++;
+		pthread_mutex_unlock(&p->mutex);
+
+		c = p->slots + i % p->n_slots;
+		s = p->streams + i;
+
+		k = pread(p->fdf, c->in, s->compressed_size, s->offset);
+		if (k < 0) {
+			r = -errno;
+			continue;
+		}
+		if ((uint64_t)k != s->compressed_size) {
+			r = -EIO;
+			continue;
+		}
+
+		ret = lzma_stream_buffer_decode(&memlimit, 0, NULL, c->in,
+			&in_pos, s->compressed_size, c->out, &out_pos,
+			s->uncompressed_size);
+		if (ret != LZMA_OK || in_pos != s->compressed_size ||
+			out_pos != s->uncompressed_size) {
+			log_error("Decompression failed: code %u", ret);
+			r = -EBADMSG;
+			continue;
+		}
+
+		pthread_mutex_lock(&p->mutex);
+		c->ready = true;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+
+static int
+xz_unpack_write(XzUnpack *p, int fdt)
+{
+	int r;
+
+	for (;;) {
+		XzUnpackChunk *c;
+		XzStreamInfo *s;
+
+		pthread_mutex_lock(&p->mutex);
+
+		if (p->written >= p->n_streams || p->error != 0) {
+			r = p->error;
+			pthread_mutex_unlock(&p->mutex);
+			return r;
+		}
+
+		c = p->slots + p->written % p->n_slots;
+		s = p->streams + p->written;
+		while (!c->ready && p->error == 0)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		pthread_mutex_unlock(&p->mutex);
+
+		if (!c->ready)
+			continue;
+
+		r = loop_write(fdt, c->out, s->uncompressed_size, false);
+
+		pthread_mutex_lock(&p->mutex);
+		if (r < 0 && p->error == 0)
+			p->error = r;
+		c->ready = false;
+		p->written++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+#endif
+
+int
+decompress_stream_xz_parallel(int fdf, int fdt, off_t max_bytes,
+	unsigned n_threads)
+{
+#ifdef HAVE_XZ
+	_cleanup_free_ pthread_t *threads = NULL;
+	XzUnpack p = {
+		.fdf = fdf,
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	uint64_t total_in = 0, total_out = 0, i;
+	unsigned n_started = 0;
+	struct stat st;
+	int r;
+
+	assert(fdf >= 0);
+	assert(fdt >= 0);
+
+	/* Decodes the streams of a file written by
+         * compress_stream_xz_parallel() on a number of threads and
+         * writes them out in order. Anything else, or input that
+         * cannot be read at random offsets, is decoded the usual way. */
+
+	if (fstat(fdf, &st) < 0)
+		return -errno;
+
+	if (n_threads <= 1 || !S_ISREG(st.st_mode) ||
+		lseek(fdf, 0, SEEK_CUR) != 0)
+		return decompress_stream_xz(fdf, fdt, max_bytes);
+
+	r = xz_index_streams(fdf, st.st_size, &p.streams, &p.n_streams);
+	if (r < 0)
+		return r;
+	if (r == 0 || p.n_streams <= 1) {
+		free(p.streams);
+		return decompress_stream_xz(fdf, fdt, max_bytes);
+	}
+
+	for (i = 0; i < p.n_streams; i++) {
+		total_in += p.streams[i].compressed_size;
+		total_out += p.streams[i].uncompressed_size;
+	}
+
+	if (max_bytes != -1 && total_out > (uint64_t)max_bytes) {
+		r = -EFBIG;
+		goto finish;
+	}
+
+	n_threads = MIN(n_threads, p.n_streams);
+	p.n_slots = n_threads * 2;
+	p.slots = new0(XzUnpackChunk, p.n_slots);
+	threads = new (pthread_t, n_threads);
+	if (!p.slots || !threads) {
+		r = log_oom();
+		goto finish;
+	}
+
+	for (i = 0; i < p.n_slots; i++) {
+		p.slots[i].in = malloc(lzma_stream_buffer_bound(XZ_CHUNK_SIZE));
+		p.slots[i].out = malloc(XZ_CHUNK_SIZE);
+		if (!p.slots[i].in || !p.slots[i].out) {
+			r = log_oom();
+			goto finish;
+		}
+	}
+
+	for (; n_started < n_threads; n_started++) {
+		r = pthread_create(&threads[n_started], NULL,
+			xz_unpack_worker, &p);
+		if (r != 0) {
+			r = -r;
+			break;
+		}
+	}
+
+	if (n_started == 0)
+		goto finish;
+
+	r = xz_unpack_write(&p, fdt);
+
+	for (i = 0; i < n_started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (r >= 0) {
+		if (lseek(fdf, st.st_size, SEEK_SET) < 0)
+			r = -errno;
+		else
+			log_debug("XZ decompression finished (%" PRIu64
+				  " -> %" PRIu64 " bytes, %" PRIu64
+				  " streams)",
+				total_in, total_out, p.n_streams);
+	}
+
+finish:
+	if (p.slots)
+		for (i = 0; i < p.n_slots; i++) {
+			free(p.slots[i].in);
+			free(p.slots[i].out);
+		}
+	free(p.slots);
+	free(p.streams);
+
+	return r;
+#else
+	log_error("Cannot decompress file. Compiled without XZ support.");
+	return -EPROTONOSUPPORT;
+#endif
+}
+
 int
 decompress_stream_lz4(int fdf, int fdt, off_t max_bytes)
 {
@@ -681,3 +1352,14 @@ decompress_stream(const char *filename, int fdf, int fdt, off_t max_bytes)
 	else
 		return -EPROTONOSUPPORT;
 }
+
+int
+decompress_stream_parallel(const char *filename, int fdf, int fdt,
+	off_t max_bytes, unsigned n_threads)
+{
+	if (endswith(filename, ".xz"))
+		return decompress_stream_xz_parallel(fdf, fdt, max_bytes,
+			n_threads);
+
+	return decompress_stream(filename, fdf, fdt, max_bytes);
+}
@@ -25,6 +25,10 @@
 
 #include "journal-def.h"
 
+/* Size of the independently compressed chunks written by
+ * compress_stream_xz_parallel() */
+#define XZ_CHUNK_SIZE (4U * 1024U * 1024U)
+
 const char *object_compressed_to_string(int compression);
 int object_compressed_from_string(const char *compression);
 
@@ -61,12 +65,19 @@ int decompress_startswith(int compression, const void *src, uint64_t src_size,
 	size_t prefix_len, uint8_t extra);
 
 int compress_stream_xz(int fdf, int fdt, off_t max_bytes);
+int compress_stream_xz_parallel(int fdf, int fdt, off_t max_bytes,
+	unsigned n_threads);
 int compress_stream_lz4(int fdf, int fdt, off_t max_bytes);
 
 int decompress_stream_xz(int fdf, int fdt, off_t max_size);
+int decompress_stream_xz_parallel(int fdf, int fdt, off_t max_size,
+	unsigned n_threads);
 int decompress_stream_lz4(int fdf, int fdt, off_t max_size);
 
 #define compress_stream compress_stream_xz
+#define compress_stream_parallel compress_stream_xz_parallel
 #define COMPRESSED_EXT ".xz"
 
 int decompress_stream(const char *filename, int fdf, int fdt, off_t max_bytes);
+int decompress_stream_parallel(const char *filename, int fdf, int fdt,
+	off_t max_bytes, unsigned n_threads);
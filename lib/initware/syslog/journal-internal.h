@@ -35,6 +35,7 @@
 typedef struct Match Match;
 typedef struct Location Location;
 typedef struct Directory Directory;
+typedef struct EntryField EntryField;
 
 typedef enum MatchType {
 	MATCH_DISCRETE,
@@ -82,6 +83,25 @@ struct Directory {
 	unsigned last_seen_generation;
 };
 
+struct EntryField {
+	uint64_t offset;
+	le64_t le_hash;
+	int compression;
+
+	bool checked: 1;
+	bool named: 1;
+	bool decoded: 1;
+
+	/* Where the name of uncompressed data is found in field_names,
+         * or (size_t) -1 if it has none */
+	size_t name;
+	size_t name_length;
+
+	/* Decompressed data, kept for the next entries */
+	void *data;
+	size_t size, allocated;
+};
+
 struct sd_journal {
 	char *path;
 	char *prefix;
@@ -120,6 +140,14 @@ struct sd_journal {
 
 	size_t data_threshold;
 
+	/* The fields of the current entry, read once for all lookups */
+	JournalFile *fields_file;
+	uint64_t fields_offset;
+	EntryField *fields;
+	size_t n_fields, n_fields_allocated;
+	char *field_names;
+	size_t field_names_size, field_names_allocated;
+
 	Hashmap *directories_by_path;
 	Hashmap *directories_by_wd;
 
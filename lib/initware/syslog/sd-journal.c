@@ -53,6 +53,8 @@
 #define DEFAULT_DATA_THRESHOLD (64 * 1024)
 
 static void remove_file_real(sd_journal *j, JournalFile *f);
+static void entry_fields_flush(sd_journal *j);
+static void entry_fields_free(sd_journal *j);
 
 static bool
 journal_pid_changed(sd_journal *j)
@@ -1459,6 +1461,9 @@ remove_file_real(sd_journal *j, JournalFile *f)
 		j->current_field = 0;
 	}
 
+	if (j->fields_file == f)
+		entry_fields_flush(j);
+
 	if (j->unique_file == f) {
 		/* Jump to the next unique_file or NULL if that one was last */
 		j->unique_file =
@@ -2057,6 +2062,8 @@ sd_journal_close(sd_journal *j)
 		free(p);
 	hashmap_free(j->errors);
 
+	entry_fields_free(j);
+
 	free(j->path);
 	free(j->prefix);
 	free(j->unique_field);
@@ -2158,154 +2165,260 @@ field_is_valid(const char *field)
 	return true;
 }
 
-_public_ int
-sd_journal_get_data(sd_journal *j, const char *field, const void **data,
+static int
+return_data(sd_journal *j, JournalFile *f, Object *o, const void **data,
 	size_t *size)
 {
-	JournalFile *f;
+	size_t t;
+	uint64_t l;
+	int compression;
+
+	l = le64toh(o->object.size) - offsetof(Object, data.payload);
+	t = (size_t)l;
+
+	/* We can't read objects larger than 4G on a 32bit machine */
+	if ((uint64_t)t != l)
+		return -E2BIG;
+
+	compression = o->object.flags & OBJECT_COMPRESSION_MASK;
+	if (compression) {
+#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+		size_t rsize;
+		int r;
+
+		r = decompress_blob(compression, o->data.payload, l,
+			&f->compress_buffer, &f->compress_buffer_size, &rsize,
+			j->data_threshold);
+		if (r < 0)
+			return r;
+
+		*data = f->compress_buffer;
+		*size = (size_t)rsize;
+#else
+		return -EPROTONOSUPPORT;
+#endif
+	} else {
+		*data = o->data.payload;
+		*size = t;
+	}
+
+	return 0;
+}
+
+static void
+entry_fields_flush(sd_journal *j)
+{
+	assert(j);
+
+	/* Keep the buffers around for the next entry */
+	j->n_fields = 0;
+	j->field_names_size = 0;
+	j->fields_file = NULL;
+	j->fields_offset = 0;
+}
+
+static void
+entry_fields_free(sd_journal *j)
+{
+	size_t i;
+
+	assert(j);
+
+	for (i = 0; i < j->n_fields_allocated; i++)
+		free(j->fields[i].data);
+
+	free(j->fields);
+	free(j->field_names);
+}
+
+/* Remembers the items of the current entry, so that looking up several
+ * of its fields doesn't walk the entry object again for each of them.
+ * Data objects are looked at when first needed, and what they contain
+ * is kept until we move on: the names of uncompressed fields and the
+ * contents of compressed ones. */
+static int
+entry_fields_load(sd_journal *j, JournalFile *f)
+{
 	uint64_t i, n;
-	size_t field_length;
-	int r;
 	Object *o;
+	int r;
 
-	assert_return(j, -EINVAL);
-	assert_return(!journal_pid_changed(j), -ECHILD);
-	assert_return(field, -EINVAL);
-	assert_return(data, -EINVAL);
-	assert_return(size, -EINVAL);
-	assert_return(field_is_valid(field), -EINVAL);
+	assert(j);
+	assert(f);
 
-	f = j->current_file;
-	if (!f)
-		return -EADDRNOTAVAIL;
+	if (j->fields_file == f && j->fields_offset == f->current_offset)
+		return 0;
 
-	if (f->current_offset <= 0)
-		return -EADDRNOTAVAIL;
+	entry_fields_flush(j);
 
 	r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
 	if (r < 0)
 		return r;
 
-	field_length = strlen(field);
-
 	n = journal_file_entry_n_items(o);
+	if (n > j->n_fields_allocated) {
+		EntryField *fields;
+
+		fields = realloc(j->fields, n * sizeof(EntryField));
+		if (!fields)
+			return -ENOMEM;
+
+		memzero(fields + j->n_fields_allocated,
+			(n - j->n_fields_allocated) * sizeof(EntryField));
+		j->fields = fields;
+		j->n_fields_allocated = n;
+	}
+
 	for (i = 0; i < n; i++) {
-		uint64_t p, l;
-		le64_t le_hash;
-		size_t t;
-		int compression;
-
-		p = le64toh(o->entry.items[i].object_offset);
-		le_hash = o->entry.items[i].hash;
-		r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
-		if (r < 0)
-			return r;
+		EntryField *e = j->fields + i;
+
+		e->offset = le64toh(o->entry.items[i].object_offset);
+		e->le_hash = o->entry.items[i].hash;
+		e->checked = e->named = e->decoded = false;
+	}
+
+	j->n_fields = n;
+	j->fields_file = f;
+	j->fields_offset = f->current_offset;
 
-		if (le_hash != o->data.hash)
+	return 0;
+}
+
+static int
+entry_field_move(JournalFile *f, EntryField *e, Object **ret)
+{
+	Object *o;
+	int r;
+
+	r = journal_file_move_to_object(f, OBJECT_DATA, e->offset, &o);
+	if (r < 0)
+		return r;
+
+	if (!e->checked) {
+		if (e->le_hash != o->data.hash)
 			return -EBADMSG;
 
-		l = le64toh(o->object.size) - offsetof(Object, data.payload);
+		e->compression = o->object.flags & OBJECT_COMPRESSION_MASK;
+		e->checked = true;
+	}
 
-		compression = o->object.flags & OBJECT_COMPRESSION_MASK;
-		if (compression) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
-			if (decompress_startswith(compression, o->data.payload,
-				    l, &f->compress_buffer,
-				    &f->compress_buffer_size, field,
-				    field_length, '=')) {
-				size_t rsize;
-
-				r = decompress_blob(compression,
-					o->data.payload, l, &f->compress_buffer,
-					&f->compress_buffer_size, &rsize,
-					j->data_threshold);
-				if (r < 0)
-					return r;
-
-				*data = f->compress_buffer;
-				*size = (size_t)rsize;
+	*ret = o;
+	return 0;
+}
 
-				return 0;
-			}
+static int
+entry_field_matches(sd_journal *j, JournalFile *f, EntryField *e,
+	const char *field, size_t field_length)
+{
+	const char *eq;
+	uint64_t l;
+	Object *o;
+	int r;
+
+	if (e->decoded)
+		return e->size > field_length &&
+			memcmp(e->data, field, field_length) == 0 &&
+			((const char *)e->data)[field_length] == '=';
+
+	if (e->named)
+		return e->name != (size_t)-1 &&
+			e->name_length == field_length &&
+			memcmp(j->field_names + e->name, field, field_length) ==
+			0;
+
+	r = entry_field_move(f, e, &o);
+	if (r < 0)
+		return r;
+
+	l = le64toh(o->object.size) - offsetof(Object, data.payload);
+
+	if (e->compression) {
+		/* Only decompress as much as needed to tell */
+#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+		return decompress_startswith(e->compression, o->data.payload,
+			l, &f->compress_buffer, &f->compress_buffer_size,
+			field, field_length, '=');
 #else
-			return -EPROTONOSUPPORT;
+		return -EPROTONOSUPPORT;
 #endif
-		} else if (l >= field_length + 1 &&
-			memcmp(o->data.payload, field, field_length) == 0 &&
-			o->data.payload[field_length] == '=') {
-			t = (size_t)l;
+	}
 
-			if ((uint64_t)t != l)
-				return -E2BIG;
+	e->name = (size_t)-1;
+	e->named = true;
 
-			*data = o->data.payload;
-			*size = t;
+	eq = memchr(o->data.payload, '=', (size_t)MIN(l, (uint64_t)SIZE_MAX));
+	if (!eq)
+		return 0;
 
-			return 0;
-		}
+	e->name_length = eq - (const char *)o->data.payload;
+	if (!GREEDY_REALLOC(j->field_names, j->field_names_allocated,
+		    j->field_names_size + e->name_length))
+		return -ENOMEM;
 
-		r = journal_file_move_to_object(f, OBJECT_ENTRY,
-			f->current_offset, &o);
-		if (r < 0)
-			return r;
-	}
+	memcpy(j->field_names + j->field_names_size, o->data.payload,
+		e->name_length);
+	e->name = j->field_names_size;
+	j->field_names_size += e->name_length;
 
-	return -ENOENT;
+	return e->name_length == field_length &&
+		memcmp(o->data.payload, field, field_length) == 0;
 }
 
 static int
-return_data(sd_journal *j, JournalFile *f, Object *o, const void **data,
-	size_t *size)
+entry_field_get(sd_journal *j, JournalFile *f, EntryField *e,
+	const void **data, size_t *size)
 {
-	size_t t;
-	uint64_t l;
-	int compression;
+	Object *o;
+	int r;
 
-	l = le64toh(o->object.size) - offsetof(Object, data.payload);
-	t = (size_t)l;
+	if (e->decoded) {
+		*data = e->data;
+		*size = e->size;
+		return 0;
+	}
 
-	/* We can't read objects larger than 4G on a 32bit machine */
-	if ((uint64_t)t != l)
-		return -E2BIG;
+	r = entry_field_move(f, e, &o);
+	if (r < 0)
+		return r;
 
-	compression = o->object.flags & OBJECT_COMPRESSION_MASK;
-	if (compression) {
+	if (e->compression) {
 #if defined(HAVE_XZ) || defined(HAVE_LZ4)
-		size_t rsize;
-		int r;
+		uint64_t l;
 
-		r = decompress_blob(compression, o->data.payload, l,
-			&f->compress_buffer, &f->compress_buffer_size, &rsize,
-			j->data_threshold);
+		l = le64toh(o->object.size) - offsetof(Object, data.payload);
+
+		r = decompress_blob(e->compression, o->data.payload, l,
+			&e->data, &e->allocated, &e->size, j->data_threshold);
 		if (r < 0)
 			return r;
 
-		*data = f->compress_buffer;
-		*size = (size_t)rsize;
+		e->decoded = true;
+
+		*data = e->data;
+		*size = e->size;
+		return 0;
 #else
 		return -EPROTONOSUPPORT;
 #endif
-	} else {
-		*data = o->data.payload;
-		*size = t;
 	}
 
-	return 0;
+	return return_data(j, f, o, data, size);
 }
 
 _public_ int
-sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size)
+sd_journal_get_data(sd_journal *j, const char *field, const void **data,
+	size_t *size)
 {
 	JournalFile *f;
-	uint64_t p, n;
-	le64_t le_hash;
+	size_t field_length, i;
 	int r;
-	Object *o;
 
 	assert_return(j, -EINVAL);
 	assert_return(!journal_pid_changed(j), -ECHILD);
+	assert_return(field, -EINVAL);
 	assert_return(data, -EINVAL);
 	assert_return(size, -EINVAL);
+	assert_return(field_is_valid(field), -EINVAL);
 
 	f = j->current_file;
 	if (!f)
@@ -2314,24 +2427,50 @@ sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size)
 	if (f->current_offset <= 0)
 		return -EADDRNOTAVAIL;
 
-	r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
+	r = entry_fields_load(j, f);
 	if (r < 0)
 		return r;
 
-	n = journal_file_entry_n_items(o);
-	if (j->current_field >= n)
-		return 0;
+	field_length = strlen(field);
+
+	for (i = 0; i < j->n_fields; i++) {
+		r = entry_field_matches(j, f, j->fields + i, field,
+			field_length);
+		if (r < 0)
+			return r;
+		if (r > 0)
+			return entry_field_get(j, f, j->fields + i, data, size);
+	}
 
-	p = le64toh(o->entry.items[j->current_field].object_offset);
-	le_hash = o->entry.items[j->current_field].hash;
-	r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+	return -ENOENT;
+}
+
+_public_ int
+sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size)
+{
+	JournalFile *f;
+	int r;
+
+	assert_return(j, -EINVAL);
+	assert_return(!journal_pid_changed(j), -ECHILD);
+	assert_return(data, -EINVAL);
+	assert_return(size, -EINVAL);
+
+	f = j->current_file;
+	if (!f)
+		return -EADDRNOTAVAIL;
+
+	if (f->current_offset <= 0)
+		return -EADDRNOTAVAIL;
+
+	r = entry_fields_load(j, f);
 	if (r < 0)
 		return r;
 
-	if (le_hash != o->data.hash)
-		return -EBADMSG;
+	if (j->current_field >= j->n_fields)
+		return 0;
 
-	r = return_data(j, f, o, data, size);
+	r = entry_field_get(j, f, j->fields + j->current_field, data, size);
 	if (r < 0)
 		return r;
 
@@ -3024,6 +3163,11 @@ sd_journal_set_data_threshold(sd_journal *j, size_t sz)
 	assert_return(j, -EINVAL);
 	assert_return(!journal_pid_changed(j), -ECHILD);
 
+	/* Compressed data of the current entry was cut off at the old
+         * threshold */
+	if (j->data_threshold != sz)
+		entry_fields_flush(j);
+
 	j->data_threshold = sz;
 	return 0;
 }
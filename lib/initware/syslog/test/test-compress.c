@@ -177,6 +177,82 @@ test_compress_stream(int compression, const char *cat,
 	assert_se(unlink(pattern2) == 0);
 }
 
+#ifdef HAVE_XZ
+/* Three chunks of data, one of zeroes, a hole and a short tail */
+static void
+test_compress_stream_xz_parallel(void)
+{
+	_cleanup_close_ int src = -1, dst = -1, dst2 = -1;
+	char pattern[] = "/tmp/systemd-test.xz.XXXXXX",
+	     pattern2[] = "/tmp/systemd-test.xz.XXXXXX",
+	     pattern3[] = "/tmp/systemd-test.xz.XXXXXX";
+	_cleanup_free_ char *cmd = NULL, *buf = NULL;
+	off_t size = 5 * XZ_CHUNK_SIZE + 4321;
+	unsigned i;
+
+	log_debug("/* testing parallel XZ compression */");
+
+	assert_se((src = mkostemp_safe(pattern, O_CLOEXEC)) >= 0);
+
+	buf = malloc(XZ_CHUNK_SIZE);
+	assert_se(buf);
+
+	for (i = 0; i < 3; i++) {
+		random_bytes(buf, XZ_CHUNK_SIZE / 2);
+		memset(buf + XZ_CHUNK_SIZE / 2, 'a' + i, XZ_CHUNK_SIZE / 2);
+		assert_se(loop_write(src, buf, XZ_CHUNK_SIZE, false) == 0);
+	}
+
+	memzero(buf, XZ_CHUNK_SIZE);
+	assert_se(loop_write(src, buf, XZ_CHUNK_SIZE, false) == 0);
+
+	assert_se(lseek(src, XZ_CHUNK_SIZE, SEEK_CUR) >= 0);
+	assert_se(loop_write(src, "tail", 4, false) == 0);
+	assert_se(ftruncate(src, size) == 0);
+	assert_se(lseek(src, 0, SEEK_SET) == 0);
+
+	assert_se((dst = mkostemp_safe(pattern2, O_CLOEXEC)) >= 0);
+	assert_se(compress_stream_xz_parallel(src, dst, -1, 4) == 0);
+	assert_se(lseek(src, 0, SEEK_CUR) == size);
+
+	/* The result is a series of streams, which xz handles as well */
+	assert_se(asprintf(&cmd, "xzcat %s | cmp %s -", pattern2,
+			  pattern) > 0);
+	assert_se(system(cmd) == 0);
+
+	assert_se((dst2 = mkostemp_safe(pattern3, O_CLOEXEC)) >= 0);
+	assert_se(lseek(dst, 0, SEEK_SET) == 0);
+	assert_se(decompress_stream_xz(dst, dst2, size) == 0);
+
+	free(cmd);
+	assert_se(asprintf(&cmd, "cmp %s %s", pattern, pattern3) > 0);
+	assert_se(system(cmd) == 0);
+
+	assert_se(lseek(dst, 0, SEEK_SET) == 0);
+	assert_se(lseek(dst2, 0, SEEK_SET) == 0);
+	assert_se(decompress_stream_xz(dst, dst2, size - 1) == -EFBIG);
+
+	/* The streams are decoded in parallel as well */
+	assert_se(lseek(dst, 0, SEEK_SET) == 0);
+	assert_se(lseek(dst2, 0, SEEK_SET) == 0);
+	assert_se(ftruncate(dst2, 0) == 0);
+	assert_se(decompress_stream_xz_parallel(dst, dst2, size, 4) == 0);
+	assert_se(lseek(dst, 0, SEEK_CUR) > 0);
+
+	free(cmd);
+	assert_se(asprintf(&cmd, "cmp %s %s", pattern, pattern3) > 0);
+	assert_se(system(cmd) == 0);
+
+	assert_se(lseek(dst, 0, SEEK_SET) == 0);
+	assert_se(decompress_stream_xz_parallel(dst, dst2, size - 1, 4) ==
+		-EFBIG);
+
+	assert_se(unlink(pattern) == 0);
+	assert_se(unlink(pattern2) == 0);
+	assert_se(unlink(pattern3) == 0);
+}
+#endif
+
 int
 main(int argc, char *argv[])
 {
@@ -201,6 +277,7 @@ main(int argc, char *argv[])
 		decompress_startswith_xz, data, sizeof(data), true);
 	test_compress_stream(OBJECT_COMPRESSED_XZ, "xzcat", compress_stream_xz,
 		decompress_stream_xz, argv[0]);
+	test_compress_stream_xz_parallel();
 #else
 	log_info("/* XZ test skipped */");
 #endif
@@ -0,0 +1,281 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "systemd/sd-journal.h"
+
+#include "journal-file.h"
+#include "journal-internal.h"
+#include "log.h"
+#include "logs-show.h"
+#include "macro.h"
+#include "util.h"
+
+/* Writes a journal file with entries that look like those of a busy
+ * service, with the usual trusted fields, a few of its own and a long
+ * field that ends up compressed, and then measures how fast they are
+ * read back by looking up fields one by one, and formatted the way
+ * syslogctl -o short and -o json do, with and without --threads. */
+
+#define DEFAULT_ENTRIES 20000
+#define N_FIELDS 24
+#define TRACE_SIZE 2048
+#define LOOKUPS 10
+#define THREADS 4
+
+static int
+write_entries(const char *path, unsigned n)
+{
+	static const char *const fixed[] = {
+		"_HOSTNAME=benchmark",
+		"_TRANSPORT=journal",
+		"_UID=0",
+		"_GID=0",
+		"_COMM=bench",
+		"_EXE=/usr/bin/bench",
+		"_CMDLINE=/usr/bin/bench --serve",
+		"_SYSTEMD_CGROUP=/system.slice/bench.service",
+		"_SYSTEMD_UNIT=bench.service",
+		"_SYSTEMD_SLICE=system.slice",
+		"SYSLOG_IDENTIFIER=bench",
+		"SYSLOG_FACILITY=3",
+		"CODE_FILE=src/bench.c",
+		"CODE_FUNC=handle_request",
+	};
+	char buf[N_FIELDS - ELEMENTSOF(fixed)][TRACE_SIZE + 32];
+	struct iovec iovec[N_FIELDS];
+	char trace[TRACE_SIZE + 1];
+	JournalFile *f;
+	unsigned i, k;
+	int r;
+
+	r = journal_file_open(path, O_RDWR | O_CREAT, 0644, true, false, NULL,
+		NULL, NULL, &f);
+	if (r < 0)
+		return r;
+
+	/* Long enough to be compressed */
+	for (k = 0; k < TRACE_SIZE; k++)
+		trace[k] = 'a' + k % 26;
+	trace[TRACE_SIZE] = 0;
+
+	for (k = 0; k < ELEMENTSOF(fixed); k++)
+		IOVEC_SET_STRING(iovec[k], fixed[k]);
+
+	for (i = 0; i < n && r >= 0; i++) {
+		dual_timestamp ts;
+
+		k = 0;
+		snprintf(buf[k++], sizeof(buf[0]), "_PID=%u", 1000 + i % 64);
+		snprintf(buf[k++], sizeof(buf[0]), "PRIORITY=%u", i % 8);
+		snprintf(buf[k++], sizeof(buf[0]), "CODE_LINE=%u", i % 1000);
+		snprintf(buf[k++], sizeof(buf[0]), "REQUEST_ID=%u", i);
+		snprintf(buf[k++], sizeof(buf[0]), "CLIENT=10.0.%u.%u",
+			i / 256 % 256, i % 256);
+		snprintf(buf[k++], sizeof(buf[0]), "LATENCY_USEC=%u",
+			i * 7 % 100000);
+		snprintf(buf[k++], sizeof(buf[0]), "TAG=%u", i % 3);
+		snprintf(buf[k++], sizeof(buf[0]), "TAG=%u", i % 5 + 3);
+		snprintf(buf[k++], sizeof(buf[0]),
+			"MESSAGE=Handled request %u in %u us", i,
+			i * 7 % 100000);
+		snprintf(buf[k++], sizeof(buf[0]), "TRACE=%u %s", i, trace);
+		assert(k == ELEMENTSOF(buf));
+
+		for (k = 0; k < ELEMENTSOF(buf); k++)
+			IOVEC_SET_STRING(iovec[ELEMENTSOF(fixed) + k], buf[k]);
+
+		dual_timestamp_get(&ts);
+		r = journal_file_append_entry(f, &ts, iovec, N_FIELDS, NULL,
+			NULL, NULL);
+	}
+
+	journal_file_close(f);
+	return r;
+}
+
+static int
+lookup(sd_journal *j, unsigned *n)
+{
+	static const char *const names[LOOKUPS] = {
+		"PRIORITY",
+		"_HOSTNAME",
+		"SYSLOG_IDENTIFIER",
+		"_COMM",
+		"_PID",
+		"SYSLOG_PID",
+		"_SOURCE_REALTIME_TIMESTAMP",
+		"MESSAGE",
+		"TRACE",
+		"REQUEST_ID",
+	};
+	unsigned k;
+	int r;
+
+	*n = 0;
+
+	SD_JOURNAL_FOREACH(j)
+	{
+		for (k = 0; k < LOOKUPS; k++) {
+			const void *data;
+			size_t l;
+
+			r = sd_journal_get_data(j, names[k], &data, &l);
+			if (r < 0 && r != -ENOENT)
+				return r;
+		}
+
+		(*n)++;
+	}
+
+	return 0;
+}
+
+static int
+output(sd_journal *j, OutputMode mode, unsigned n_threads, FILE *f,
+	unsigned *n)
+{
+	_cleanup_output_pipeline_free_ OutputPipeline *p = NULL;
+	int r;
+
+	*n = 0;
+
+	if (n_threads > 0) {
+		r = output_pipeline_new(&p, f, n_threads, mode, 0,
+			OUTPUT_FULL_WIDTH);
+		if (r < 0)
+			return r;
+	}
+
+	SD_JOURNAL_FOREACH(j)
+	{
+		if (p)
+			r = output_pipeline_add(p, j);
+		else
+			r = output_journal(f, j, mode, 0, OUTPUT_FULL_WIDTH,
+				NULL);
+		if (r < 0)
+			return r;
+
+		(*n)++;
+	}
+
+	return p ? output_pipeline_flush(p, NULL) : 0;
+}
+
+static int
+run(sd_journal *j, const char *label, OutputMode mode, unsigned n_threads,
+	FILE *f)
+{
+	usec_t t;
+	unsigned n;
+	int r;
+
+	t = now(CLOCK_MONOTONIC);
+
+	if (mode == _OUTPUT_MODE_INVALID)
+		r = lookup(j, &n);
+	else
+		r = output(j, mode, n_threads, f, &n);
+	if (r < 0)
+		return log_error_errno(r, "Failed to read entries: %m");
+
+	t = now(CLOCK_MONOTONIC) - t;
+
+	log_info("%s: %u entries in %.1fms, %.0f entries/s", label, n,
+		(double)t / USEC_PER_MSEC,
+		t > 0 ? (double)n * USEC_PER_SEC / t : 0.0);
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char t[] = "/var/tmp/journal-output-benchmark-XXXXXX";
+	_cleanup_journal_close_ sd_journal *j = NULL;
+	_cleanup_free_ char *path = NULL;
+	_cleanup_fclose_ FILE *f = NULL;
+	unsigned n = DEFAULT_ENTRIES;
+	int r;
+
+	log_set_max_level(LOG_INFO);
+	log_parse_environment();
+	log_open();
+
+	if (argc > 1 && (safe_atou(argv[1], &n) < 0 || n == 0)) {
+		log_error("Invalid number of entries: %s", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	/* journal_file_open requires a valid machine id */
+	if (access("/etc/machine-id", F_OK) != 0) {
+		log_info("No machine id, skipping.");
+		return EXIT_TEST_SKIP;
+	}
+
+	if (!mkdtemp(t)) {
+		log_info_errno(errno, "Cannot create directory, skipping: %m");
+		return EXIT_TEST_SKIP;
+	}
+
+	path = strappend(t, "/benchmark.journal");
+	if (!path) {
+		r = log_oom();
+		goto finish;
+	}
+
+	r = write_entries(path, n);
+	if (r < 0) {
+		log_error_errno(r, "Failed to write entries: %m");
+		goto finish;
+	}
+
+	f = fopen("/dev/null", "we");
+	if (!f) {
+		r = log_error_errno(errno, "Failed to open /dev/null: %m");
+		goto finish;
+	}
+
+	r = sd_journal_open_directory(&j, t, 0);
+	if (r < 0) {
+		log_error_errno(r, "Failed to open journal: %m");
+		goto finish;
+	}
+
+	r = run(j, "get_data", _OUTPUT_MODE_INVALID, 0, f);
+	if (r >= 0)
+		r = run(j, "short", OUTPUT_SHORT, 0, f);
+	if (r >= 0)
+		r = run(j, "json", OUTPUT_JSON, 0, f);
+	if (r >= 0)
+		r = run(j, "export", OUTPUT_EXPORT, 0, f);
+	if (r >= 0)
+		r = run(j, "short, " STRINGIFY(THREADS) " threads",
+			OUTPUT_SHORT, THREADS, f);
+	if (r >= 0)
+		r = run(j, "json, " STRINGIFY(THREADS) " threads", OUTPUT_JSON,
+			THREADS, f);
+
+finish:
+	rm_rf_dangerous(t, false, true, false);
+
+	return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <string.h>
 #include <time.h>
 
@@ -30,6 +31,7 @@
 #include "journal-internal.h"
 #include "log.h"
 #include "logs-show.h"
+#include "strxcpyx.h"
 #include "utf8.h"
 #include "util.h"
 
@@ -40,13 +42,236 @@
 
 #define JSON_THRESHOLD 4096
 
+/* Entries handed to a formatting thread at once */
+#define OUTPUT_BATCH_SIZE 256
+
+typedef struct OutputField {
+	size_t offset;
+	size_t size;
+} OutputField;
+
+/* The entry being formatted. Either it is read from the journal while it
+ * is formatted, or everything that is needed to format it has been
+ * copied out of the journal before, so that another thread can format
+ * it while the journal moves on. */
+typedef struct OutputEntry {
+	sd_journal *journal;
+
+	usec_t realtime;
+	usec_t monotonic;
+	sd_id128_t boot_id;
+	int realtime_error;
+	int monotonic_error;
+
+	char *cursor;
+	int cursor_error;
+	char *catalog;
+	int catalog_error;
+
+	char *data;
+	size_t data_size, data_allocated;
+	OutputField *fields;
+	size_t n_fields, n_fields_allocated;
+	size_t current_field;
+	int data_error;
+} OutputEntry;
+
+static size_t
+output_data_threshold(OutputMode mode, OutputFlags flags)
+{
+	switch (mode) {
+	case OUTPUT_SHORT:
+	case OUTPUT_SHORT_ISO:
+	case OUTPUT_SHORT_PRECISE:
+	case OUTPUT_SHORT_MONOTONIC:
+		/* Set the threshold to one bigger than the actual print
+                 * threshold, so that if the line is actually longer than
+                 * what we're willing to print, ellipsization will occur.
+                 * This way we won't output a misleading line without any
+                 * indication of truncation. */
+		return flags & (OUTPUT_SHOW_ALL | OUTPUT_FULL_WIDTH) ?
+			0 :
+			PRINT_CHAR_THRESHOLD + 1;
+
+	case OUTPUT_JSON:
+	case OUTPUT_JSON_PRETTY:
+	case OUTPUT_JSON_SSE:
+		return flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD;
+
+	default:
+		return 0;
+	}
+}
+
 static int
-print_catalog(FILE *f, sd_journal *j)
+output_entry_load(OutputEntry *e, sd_journal *j, OutputFlags flags)
+{
+	const void *data;
+	size_t length;
+
+	assert(e);
+	assert(j);
+
+	e->journal = NULL;
+	e->cursor = mfree(e->cursor);
+	e->catalog = mfree(e->catalog);
+	e->data_size = 0;
+	e->n_fields = 0;
+	e->current_field = 0;
+
+	/* Not pointing to any entry, there is nothing to format */
+	e->realtime_error = sd_journal_get_realtime_usec(j, &e->realtime);
+	if (e->realtime_error == -EADDRNOTAVAIL)
+		return e->realtime_error;
+
+	e->monotonic_error = sd_journal_get_monotonic_usec(j, &e->monotonic,
+		&e->boot_id);
+	e->cursor_error = sd_journal_get_cursor(j, &e->cursor);
+	e->catalog_error = flags & OUTPUT_CATALOG ?
+		sd_journal_get_catalog(j, &e->catalog) :
+		-ENOENT;
+
+	JOURNAL_FOREACH_DATA_RETVAL (j, data, length, e->data_error) {
+		OutputField *field;
+
+		if (!GREEDY_REALLOC(e->data, e->data_allocated,
+			    e->data_size + length) ||
+			!GREEDY_REALLOC(e->fields, e->n_fields_allocated,
+				e->n_fields + 1))
+			return -ENOMEM;
+
+		field = e->fields + e->n_fields++;
+		field->offset = e->data_size;
+		field->size = length;
+
+		memcpy(e->data + e->data_size, data, length);
+		e->data_size += length;
+	}
+
+	return 0;
+}
+
+static void
+output_entry_done(OutputEntry *e)
+{
+	assert(e);
+
+	free(e->cursor);
+	free(e->catalog);
+	free(e->data);
+	free(e->fields);
+}
+
+static int
+entry_enumerate_data(OutputEntry *e, const void **data, size_t *size)
+{
+	OutputField *field;
+
+	if (e->journal)
+		return sd_journal_enumerate_data(e->journal, data, size);
+
+	if (e->current_field >= e->n_fields)
+		return e->data_error;
+
+	field = e->fields + e->current_field++;
+	*data = e->data + field->offset;
+	*size = field->size;
+
+	return 1;
+}
+
+static void
+entry_restart_data(OutputEntry *e)
+{
+	if (e->journal)
+		sd_journal_restart_data(e->journal);
+	else
+		e->current_field = 0;
+}
+
+#define ENTRY_FOREACH_DATA_RETVAL(e, data, l, retval)                          \
+	for (entry_restart_data(e);                                            \
+		((retval) = entry_enumerate_data((e), &(data), &(l))) > 0;)
+
+static int
+entry_get_data(OutputEntry *e, const char *field, const void **data,
+	size_t *size)
+{
+	size_t i, l;
+
+	if (e->journal)
+		return sd_journal_get_data(e->journal, field, data, size);
+
+	l = strlen(field);
+
+	for (i = 0; i < e->n_fields; i++) {
+		const char *p = e->data + e->fields[i].offset;
+
+		if (e->fields[i].size > l && memcmp(p, field, l) == 0 &&
+			p[l] == '=') {
+			*data = p;
+			*size = e->fields[i].size;
+			return 0;
+		}
+	}
+
+	return e->data_error < 0 ? e->data_error : -ENOENT;
+}
+
+static int
+entry_get_realtime_usec(OutputEntry *e, usec_t *ret)
+{
+	if (e->journal)
+		return sd_journal_get_realtime_usec(e->journal, ret);
+
+	*ret = e->realtime;
+	return e->realtime_error;
+}
+
+static int
+entry_get_monotonic_usec(OutputEntry *e, usec_t *ret, sd_id128_t *boot_id)
+{
+	if (e->journal)
+		return sd_journal_get_monotonic_usec(e->journal, ret, boot_id);
+
+	*ret = e->monotonic;
+	*boot_id = e->boot_id;
+	return e->monotonic_error;
+}
+
+static int
+entry_get_cursor(OutputEntry *e, char **ret)
+{
+	if (e->journal)
+		return sd_journal_get_cursor(e->journal, ret);
+
+	if (e->cursor_error < 0)
+		return e->cursor_error;
+
+	*ret = strdup(e->cursor);
+	return *ret ? 0 : -ENOMEM;
+}
+
+static int
+entry_get_catalog(OutputEntry *e, char **ret)
+{
+	if (e->journal)
+		return sd_journal_get_catalog(e->journal, ret);
+
+	if (e->catalog_error < 0)
+		return e->catalog_error;
+
+	*ret = strdup(e->catalog);
+	return *ret ? 0 : -ENOMEM;
+}
+
+static int
+print_catalog(FILE *f, OutputEntry *e)
 {
 	int r;
 	_cleanup_free_ char *t = NULL, *z = NULL;
 
-	r = sd_journal_get_catalog(j, &t);
+	r = entry_get_catalog(e, &t);
 	if (r < 0)
 		return r;
 
@@ -194,8 +419,44 @@ print_multiline(FILE *f, unsigned prefix, unsigned n_columns, OutputFlags flags,
 	return ellipsized;
 }
 
+/* Consecutive entries are mostly logged within the same second, hence
+ * remember the last formatted second instead of going through the time
+ * zone conversion for every entry. */
+static int
+format_timestamp_short(char *buf, size_t l, time_t t, bool iso, bool utc)
+{
+	static thread_local struct {
+		bool valid, iso, utc;
+		time_t t;
+		char buf[64];
+	} cache;
+	struct tm tm, *p;
+
+	if (cache.valid && cache.t == t && cache.iso == iso &&
+		cache.utc == utc) {
+		strscpy(buf, l, cache.buf);
+		return 0;
+	}
+
+	p = utc ? gmtime_r(&t, &tm) : localtime_r(&t, &tm);
+	if (!p)
+		return -EINVAL;
+
+	if (strftime(cache.buf, sizeof(cache.buf),
+		    iso ? "%Y-%m-%dT%H:%M:%S%z" : "%b %d %H:%M:%S", p) <= 0)
+		return -EINVAL;
+
+	cache.valid = true;
+	cache.t = t;
+	cache.iso = iso;
+	cache.utc = utc;
+
+	strscpy(buf, l, cache.buf);
+	return 0;
+}
+
 static int
-output_short(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
+output_short(FILE *f, OutputEntry *e, OutputMode mode, unsigned n_columns,
 	OutputFlags flags)
 {
 	int r;
@@ -213,20 +474,9 @@ output_short(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	bool ellipsized = false;
 
 	assert(f);
-	assert(j);
-
-	/* Set the threshold to one bigger than the actual print
-         * threshold, so that if the line is actually longer than what
-         * we're willing to print, ellipsization will occur. This way
-         * we won't output a misleading line without any indication of
-         * truncation.
-         */
-	sd_journal_set_data_threshold(j,
-		flags & (OUTPUT_SHOW_ALL | OUTPUT_FULL_WIDTH) ?
-			      0 :
-			      PRINT_CHAR_THRESHOLD + 1);
+	assert(e);
 
-	JOURNAL_FOREACH_DATA_RETVAL (j, data, length, r) {
+	ENTRY_FOREACH_DATA_RETVAL (e, data, length, r) {
 		r = parse_field(data, length, "PRIORITY=", &priority,
 			&priority_len);
 		if (r < 0)
@@ -311,7 +561,7 @@ output_short(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 			r = safe_atou64(monotonic, &t);
 
 		if (r < 0)
-			r = sd_journal_get_monotonic_usec(j, &t, &boot_id);
+			r = entry_get_monotonic_usec(e, &t, &boot_id);
 
 		if (r < 0)
 			return log_error_errno(r,
@@ -326,49 +576,32 @@ output_short(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	} else {
 		char buf[64];
 		uint64_t x;
-		time_t t;
-		struct tm tm;
-		struct tm *(*gettime_r)(const time_t *, struct tm *);
 
 		r = -ENOENT;
-		gettime_r = (flags & OUTPUT_UTC) ? gmtime_r : localtime_r;
 
 		if (realtime)
 			r = safe_atou64(realtime, &x);
 
 		if (r < 0)
-			r = sd_journal_get_realtime_usec(j, &x);
+			r = entry_get_realtime_usec(e, &x);
 
 		if (r < 0)
 			return log_error_errno(r,
 				"Failed to get realtime timestamp: %m");
 
-		t = (time_t)(x / USEC_PER_SEC);
-
-		switch (mode) {
-		case OUTPUT_SHORT_ISO:
-			r = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z",
-				gettime_r(&t, &tm));
-			break;
-		case OUTPUT_SHORT_PRECISE:
-			r = strftime(buf, sizeof(buf), "%b %d %H:%M:%S",
-				gettime_r(&t, &tm));
-			if (r > 0) {
-				snprintf(buf + strlen(buf),
-					sizeof(buf) - strlen(buf), ".%06llu",
-					(unsigned long long)(x % USEC_PER_SEC));
-			}
-			break;
-		default:
-			r = strftime(buf, sizeof(buf), "%b %d %H:%M:%S",
-				gettime_r(&t, &tm));
-		}
-
-		if (r <= 0) {
+		r = format_timestamp_short(buf, sizeof(buf),
+			(time_t)(x / USEC_PER_SEC), mode == OUTPUT_SHORT_ISO,
+			flags & OUTPUT_UTC);
+		if (r < 0) {
 			log_error("Failed to format time.");
-			return -EINVAL;
+			return r;
 		}
 
+		if (mode == OUTPUT_SHORT_PRECISE)
+			snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+				".%06llu",
+				(unsigned long long)(x % USEC_PER_SEC));
+
 		fputs(buf, f);
 		n += strlen(buf);
 	}
@@ -407,13 +640,13 @@ output_short(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	}
 
 	if (flags & OUTPUT_CATALOG)
-		print_catalog(f, j);
+		print_catalog(f, e);
 
 	return ellipsized;
 }
 
 static int
-output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
+output_verbose(FILE *f, OutputEntry *e, OutputMode mode, unsigned n_columns,
 	OutputFlags flags)
 {
 	const void *data;
@@ -424,12 +657,9 @@ output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	int r;
 
 	assert(f);
-	assert(j);
-
-	sd_journal_set_data_threshold(j, 0);
+	assert(e);
 
-	r = sd_journal_get_data(j, "_SOURCE_REALTIME_TIMESTAMP", &data,
-		&length);
+	r = entry_get_data(e, "_SOURCE_REALTIME_TIMESTAMP", &data, &length);
 	if (r == -ENOENT)
 		log_debug("Source realtime timestamp not found");
 	else if (r < 0) {
@@ -455,7 +685,7 @@ output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	}
 
 	if (r < 0) {
-		r = sd_journal_get_realtime_usec(j, &realtime);
+		r = entry_get_realtime_usec(e, &realtime);
 		if (r < 0) {
 			log_full(r == -EADDRNOTAVAIL ? LOG_DEBUG : LOG_ERR,
 				"Failed to get realtime timestamp: %s",
@@ -464,7 +694,7 @@ output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 		}
 	}
 
-	r = sd_journal_get_cursor(j, &cursor);
+	r = entry_get_cursor(e, &cursor);
 	if (r < 0)
 		return log_error_errno(r, "Failed to get cursor: %m");
 
@@ -474,7 +704,7 @@ output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 			      format_timestamp_us(ts, sizeof(ts), realtime),
 		cursor);
 
-	JOURNAL_FOREACH_DATA_RETVAL (j, data, length, r) {
+	ENTRY_FOREACH_DATA_RETVAL (e, data, length, r) {
 		const char *c;
 		int fieldlen;
 		const char *on = "", *off = "";
@@ -517,13 +747,13 @@ output_verbose(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 		return r;
 
 	if (flags & OUTPUT_CATALOG)
-		print_catalog(f, j);
+		print_catalog(f, e);
 
 	return 0;
 }
 
 static int
-output_export(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
+output_export(FILE *f, OutputEntry *e, OutputMode mode, unsigned n_columns,
 	OutputFlags flags)
 {
 	sd_id128_t boot_id;
@@ -534,21 +764,19 @@ output_export(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	const void *data;
 	size_t length;
 
-	assert(j);
-
-	sd_journal_set_data_threshold(j, 0);
+	assert(e);
 
-	r = sd_journal_get_realtime_usec(j, &realtime);
+	r = entry_get_realtime_usec(e, &realtime);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to get realtime timestamp: %m");
 
-	r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+	r = entry_get_monotonic_usec(e, &monotonic, &boot_id);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to get monotonic timestamp: %m");
 
-	r = sd_journal_get_cursor(j, &cursor);
+	r = entry_get_cursor(e, &cursor);
 	if (r < 0)
 		return log_error_errno(r, "Failed to get cursor: %m");
 
@@ -559,7 +787,7 @@ output_export(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 		"_BOOT_ID=%s\n",
 		cursor, realtime, monotonic, sd_id128_to_string(boot_id, sid));
 
-	JOURNAL_FOREACH_DATA_RETVAL (j, data, length, r) {
+	ENTRY_FOREACH_DATA_RETVAL (e, data, length, r) {
 		/* We already printed the boot id, from the data in
                  * the header, hence let's suppress it here */
 		if (length >= 9 && startswith(data, "_BOOT_ID="))
@@ -647,7 +875,7 @@ json_escape(FILE *f, const char *p, size_t l, OutputFlags flags)
 }
 
 static int
-output_json(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
+output_json(FILE *f, OutputEntry *e, OutputMode mode, unsigned n_columns,
 	OutputFlags flags)
 {
 	uint64_t realtime, monotonic;
@@ -660,22 +888,19 @@ output_json(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	Hashmap *h = NULL;
 	bool done, separator;
 
-	assert(j);
-
-	sd_journal_set_data_threshold(j,
-		flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+	assert(e);
 
-	r = sd_journal_get_realtime_usec(j, &realtime);
+	r = entry_get_realtime_usec(e, &realtime);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to get realtime timestamp: %m");
 
-	r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+	r = entry_get_monotonic_usec(e, &monotonic, &boot_id);
 	if (r < 0)
 		return log_error_errno(r,
 			"Failed to get monotonic timestamp: %m");
 
-	r = sd_journal_get_cursor(j, &cursor);
+	r = entry_get_cursor(e, &cursor);
 	if (r < 0)
 		return log_error_errno(r, "Failed to get cursor: %m");
 
@@ -706,7 +931,7 @@ output_json(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 		return -ENOMEM;
 
 	/* First round, iterate through the entry and count how often each field appears */
-	JOURNAL_FOREACH_DATA_RETVAL (j, data, length, r) {
+	ENTRY_FOREACH_DATA_RETVAL (e, data, length, r) {
 		const char *eq;
 		char *n;
 		unsigned u;
@@ -746,8 +971,8 @@ output_json(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	do {
 		done = true;
 
-		SD_JOURNAL_FOREACH_DATA(j, data, length)
-		{
+		for (entry_restart_data(e);
+			entry_enumerate_data(e, &data, &length) > 0;) {
 			const char *eq;
 			char *kk, *n;
 			size_t m;
@@ -808,7 +1033,7 @@ output_json(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 
 				/* Iterate through the end of the list */
 
-				while (sd_journal_enumerate_data(j, &data,
+				while (entry_enumerate_data(e, &data,
 					       &length) > 0) {
 					if (length < m + 1)
 						continue;
@@ -860,19 +1085,17 @@ finish:
 }
 
 static int
-output_cat(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
+output_cat(FILE *f, OutputEntry *e, OutputMode mode, unsigned n_columns,
 	OutputFlags flags)
 {
 	const void *data;
 	size_t l;
 	int r;
 
-	assert(j);
+	assert(e);
 	assert(f);
 
-	sd_journal_set_data_threshold(j, 0);
-
-	r = sd_journal_get_data(j, "MESSAGE", &data, &l);
+	r = entry_get_data(e, "MESSAGE", &data, &l);
 	if (r < 0) {
 		/* An entry without MESSAGE=? */
 		if (r == -ENOENT)
@@ -889,7 +1112,7 @@ output_cat(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	return 0;
 }
 
-static int (*output_funcs[_OUTPUT_MODE_MAX])(FILE *f, sd_journal *j,
+static int (*output_funcs[_OUTPUT_MODE_MAX])(FILE *f, OutputEntry *e,
 	OutputMode mode, unsigned n_columns, OutputFlags flags) = {
 
 	[OUTPUT_SHORT] = output_short,
@@ -908,6 +1131,7 @@ int
 output_journal(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	OutputFlags flags, bool *ellipsized)
 {
+	OutputEntry e = { .journal = j };
 	int ret;
 	assert(mode >= 0);
 	assert(mode < _OUTPUT_MODE_MAX);
@@ -915,7 +1139,9 @@ output_journal(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	if (n_columns <= 0)
 		n_columns = columns();
 
-	ret = output_funcs[mode](f, j, mode, n_columns, flags);
+	sd_journal_set_data_threshold(j, output_data_threshold(mode, flags));
+
+	ret = output_funcs[mode](f, &e, mode, n_columns, flags);
 	fflush(stdout);
 
 	if (ellipsized && ret > 0)
@@ -924,6 +1150,300 @@ output_journal(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	return ret;
 }
 
+typedef struct OutputBatch {
+	OutputEntry entries[OUTPUT_BATCH_SIZE];
+	size_t n_entries;
+
+	/* Set by the worker that formatted the batch */
+	char *buf;
+	size_t size;
+	bool ellipsized;
+	int error;
+	bool ready;
+} OutputBatch;
+
+struct OutputPipeline {
+	FILE *f;
+	OutputMode mode;
+	unsigned n_columns;
+	OutputFlags flags;
+
+	pthread_t *threads;
+	unsigned n_threads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* Batch i is filled in slot i % n_slots. Batches up to queued
+         * are complete and may be picked up by a worker, next is the
+         * first one no worker has picked up yet, and written the first
+         * one that has not been written out. The batch being filled is
+         * the one at queued, hence it may only be started once there
+         * are less than n_slots batches that have not been written. */
+	OutputBatch *slots;
+	unsigned n_slots;
+	uint64_t next;
+	uint64_t queued;
+	uint64_t written;
+	bool done;
+
+	bool ellipsized;
+	int error;
+};
+
+static void
+output_batch_format(OutputPipeline *p, OutputBatch *b)
+{
+	FILE *f;
+	size_t i;
+	int r;
+
+	b->buf = mfree(b->buf);
+	b->size = 0;
+	b->ellipsized = false;
+	b->error = 0;
+
+	f = open_memstream(&b->buf, &b->size);
+	if (!f) {
+		b->error = -ENOMEM;
+		return;
+	}
+
+	for (i = 0; i < b->n_entries; i++) {
+		r = output_funcs[p->mode](f, b->entries + i, p->mode,
+			p->n_columns, p->flags);
+		if (r < 0) {
+			b->error = r;
+			break;
+		}
+		if (r > 0)
+			b->ellipsized = true;
+	}
+
+	/* Closing the stream makes the buffer final */
+	if (fclose(f) != 0 && b->error == 0)
+		b->error = -ENOMEM;
+}
+
+static void *
+output_pipeline_worker(void *userdata)
+{
+	OutputPipeline *p = userdata;
+
+	for (;;) {
+		OutputBatch *b;
+
+		pthread_mutex_lock(&p->mutex);
+
+		while (!p->done && p->next >= p->queued)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		if (p->next >= p->queued) {
+			pthread_mutex_unlock(&p->mutex);
+			return NULL;
+		}
+
+		b = p->slots + p->next++ % p->n_slots;
+		pthread_mutex_unlock(&p->mutex);
+
+		output_batch_format(p, b);
+
+		pthread_mutex_lock(&p->mutex);
+		b->ready = true;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+
+static void
+output_pipeline_submit(OutputPipeline *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	p->queued++;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+/* Writes out the oldest batch that was handed to the workers */
+static int
+output_pipeline_write(OutputPipeline *p)
+{
+	OutputBatch *b;
+
+	assert(p->written < p->queued);
+
+	b = p->slots + p->written % p->n_slots;
+
+	pthread_mutex_lock(&p->mutex);
+	while (!b->ready)
+		pthread_cond_wait(&p->cond, &p->mutex);
+	pthread_mutex_unlock(&p->mutex);
+
+	/* Everything up to the first error was formatted, as it would
+         * have been without threads */
+	if (p->error == 0) {
+		fwrite(b->buf, 1, b->size, p->f);
+
+		if (b->ellipsized)
+			p->ellipsized = true;
+
+		if (b->error < 0)
+			p->error = b->error;
+		else if (ferror(p->f))
+			p->error = -EIO;
+	}
+
+	b->n_entries = 0;
+	b->ready = false;
+	p->written++;
+
+	return p->error;
+}
+
+int
+output_pipeline_new(OutputPipeline **ret, FILE *f, unsigned n_threads,
+	OutputMode mode, unsigned n_columns, OutputFlags flags)
+{
+	OutputPipeline *p;
+	int r = 0;
+
+	assert(ret);
+	assert(f);
+	assert(mode >= 0);
+	assert(mode < _OUTPUT_MODE_MAX);
+	assert(n_threads > 0);
+
+	/* Also keeps the number of slots below from overflowing */
+	n_threads = MIN(n_threads, OUTPUT_THREADS_MAX);
+
+	p = new0(OutputPipeline, 1);
+	if (!p)
+		return -ENOMEM;
+
+	p->f = f;
+	p->mode = mode;
+	p->flags = flags;
+	/* columns() is not safe to call from the workers */
+	p->n_columns = n_columns > 0 ? n_columns : columns();
+	p->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+	p->cond = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
+
+	/* Enough batches for every thread to work on one while the next
+         * is filled */
+	p->n_slots = n_threads * 2;
+	p->slots = new0(OutputBatch, p->n_slots);
+	p->threads = new (pthread_t, n_threads);
+	if (!p->slots || !p->threads) {
+		output_pipeline_free(p);
+		return -ENOMEM;
+	}
+
+	for (; p->n_threads < n_threads; p->n_threads++) {
+		r = pthread_create(&p->threads[p->n_threads], NULL,
+			output_pipeline_worker, p);
+		if (r != 0)
+			break;
+	}
+
+	/* With fewer threads than asked for we just get slower */
+	if (p->n_threads == 0) {
+		output_pipeline_free(p);
+		return -r;
+	}
+
+	*ret = p;
+	return 0;
+}
+
+int
+output_pipeline_add(OutputPipeline *p, sd_journal *j)
+{
+	OutputBatch *b;
+	int r;
+
+	assert(p);
+	assert(j);
+
+	if (p->error < 0)
+		return p->error;
+
+	/* All slots are taken, make room for a new batch */
+	if (p->queued - p->written >= p->n_slots) {
+		r = output_pipeline_write(p);
+		if (r < 0)
+			return r;
+	}
+
+	b = p->slots + p->queued % p->n_slots;
+
+	sd_journal_set_data_threshold(j,
+		output_data_threshold(p->mode, p->flags));
+
+	r = output_entry_load(b->entries + b->n_entries, j, p->flags);
+	if (r < 0)
+		return r;
+
+	if (++b->n_entries >= OUTPUT_BATCH_SIZE)
+		output_pipeline_submit(p);
+
+	return 0;
+}
+
+int
+output_pipeline_flush(OutputPipeline *p, bool *ellipsized)
+{
+	int r = 0;
+
+	assert(p);
+
+	if (p->slots[p->queued % p->n_slots].n_entries > 0)
+		output_pipeline_submit(p);
+
+	while (p->written < p->queued) {
+		r = output_pipeline_write(p);
+		if (r < 0)
+			break;
+	}
+
+	fflush(p->f);
+
+	if (ellipsized && p->ellipsized)
+		*ellipsized = true;
+
+	return r;
+}
+
+OutputPipeline *
+output_pipeline_free(OutputPipeline *p)
+{
+	unsigned i;
+	size_t k;
+
+	if (!p)
+		return NULL;
+
+	pthread_mutex_lock(&p->mutex);
+	p->done = true;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+
+	for (i = 0; i < p->n_threads; i++)
+		pthread_join(p->threads[i], NULL);
+
+	if (p->slots)
+		for (i = 0; i < p->n_slots; i++) {
+			for (k = 0; k < OUTPUT_BATCH_SIZE; k++)
+				output_entry_done(p->slots[i].entries + k);
+			free(p->slots[i].buf);
+		}
+
+	free(p->slots);
+	free(p->threads);
+	free(p);
+
+	return NULL;
+}
+
 static int
 maybe_print_begin_newline(FILE *f, OutputFlags *flags)
 {
@@ -31,6 +31,23 @@
 int output_journal(FILE *f, sd_journal *j, OutputMode mode, unsigned n_columns,
 	OutputFlags flags, bool *ellipsized);
 
+/* Formats entries on a number of threads and writes them out in order.
+ * Entries are copied out of the journal when they are added, and only
+ * written once a batch of them is complete, or on flush. */
+typedef struct OutputPipeline OutputPipeline;
+
+/* Each thread comes with two batches of entries, so keep it sane */
+#define OUTPUT_THREADS_MAX 64U
+
+int output_pipeline_new(OutputPipeline **ret, FILE *f, unsigned n_threads,
+	OutputMode mode, unsigned n_columns, OutputFlags flags);
+int output_pipeline_add(OutputPipeline *p, sd_journal *j);
+int output_pipeline_flush(OutputPipeline *p, bool *ellipsized);
+OutputPipeline *output_pipeline_free(OutputPipeline *p);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(OutputPipeline *, output_pipeline_free);
+#define _cleanup_output_pipeline_free_ _cleanup_(output_pipeline_freep)
+
 int add_match_this_boot(sd_journal *j, const char *machine);
 
 int add_matches_for_unit(sd_journal *j, const char *unit);
@@ -0,0 +1,137 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <linux/auto_fs4.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "automount.h"
+#include "macro.h"
+#include "set.h"
+#include "util.h"
+
+#define N_MOUNT_POINTS 64
+#define N_REQUESTS 512
+#define N_TOKENS 8
+
+static void
+write_packet(int fd, int type, unsigned token, pid_t pid)
+{
+	union autofs_v5_packet_union packet;
+
+	zero(packet);
+	packet.hdr.proto_version = 5;
+	packet.hdr.type = type;
+	packet.v5_packet.wait_queue_token = token;
+	packet.v5_packet.pid = pid;
+
+	assert_se(write(fd, &packet, sizeof(packet)) == sizeof(packet));
+}
+
+/* Simulates a burst of accesses to many automount points at once: each
+ * pipe stands for the kernel end of one mount point, and gets many
+ * requests that only use a handful of distinct wait queue tokens. */
+static void
+test_read_requests_stress(void)
+{
+	unsigned chunk = 4096 / sizeof(union autofs_v5_packet_union);
+	unsigned i;
+
+	for (i = 0; i < N_MOUNT_POINTS; i++) {
+		_cleanup_close_pair_ int p[2] = { -1, -1 };
+		Set *tokens = NULL, *expire_tokens = NULL;
+		unsigned n_missing_total = 0, n_expire_total = 0, sent = 0;
+		unsigned n_missing, n_expire;
+		pid_t pid;
+
+		assert_se(pipe2(p, O_NONBLOCK | O_CLOEXEC) >= 0);
+
+		while (sent < N_REQUESTS) {
+			unsigned k, first;
+
+			/* Stay below the pipe capacity */
+			for (k = 0; k < chunk && sent < N_REQUESTS; k++, sent++)
+				write_packet(p[1],
+					sent % 4 == 3 ?
+						autofs_ptype_expire_direct :
+						autofs_ptype_missing_direct,
+					i * N_TOKENS + sent % N_TOKENS,
+					100 + sent);
+
+			assert_se(automount_read_requests(p[0], &tokens,
+					  &expire_tokens, &n_missing, &n_expire,
+					  &pid) == (int)k);
+
+			/* The first requester of each batch is reported */
+			first = sent - k;
+			if (first % 4 == 3)
+				first++;
+			assert_se(pid == (pid_t)(100 + first));
+
+			n_missing_total += n_missing;
+			n_expire_total += n_expire;
+		}
+
+		assert_se(n_missing_total == N_REQUESTS / 4 * 3);
+		assert_se(n_expire_total == N_REQUESTS / 4);
+
+		/* Tokens 3 and 7 are only ever used for expiry */
+		assert_se(set_size(tokens) == N_TOKENS - 2);
+		assert_se(set_size(expire_tokens) == 2);
+		assert_se(set_contains(expire_tokens,
+			UINT_TO_PTR(i * N_TOKENS + 3)));
+		assert_se(!set_contains(tokens,
+			UINT_TO_PTR(i * N_TOKENS + 7)));
+
+		/* Nothing left on the pipe */
+		assert_se(automount_read_requests(p[0], &tokens,
+				  &expire_tokens, NULL, NULL, NULL) == 0);
+
+		set_free(tokens);
+		set_free(expire_tokens);
+	}
+}
+
+static void
+test_read_requests_short(void)
+{
+	_cleanup_close_pair_ int p[2] = { -1, -1 };
+	Set *tokens = NULL, *expire_tokens = NULL;
+	char garbage[3] = {};
+
+	assert_se(pipe2(p, O_NONBLOCK | O_CLOEXEC) >= 0);
+
+	write_packet(p[1], autofs_ptype_missing_direct, 1, 1);
+	assert_se(write(p[1], garbage, sizeof(garbage)) == sizeof(garbage));
+
+	assert_se(automount_read_requests(p[0], &tokens, &expire_tokens, NULL,
+			  NULL, NULL) == -EIO);
+	assert_se(set_size(tokens) == 1);
+
+	set_free(tokens);
+	set_free(expire_tokens);
+}
+
+int
+main(int argc, char *argv[])
+{
+	test_read_requests_stress();
+	test_read_requests_short();
+
+	return 0;
+}
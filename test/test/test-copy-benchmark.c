@@ -0,0 +1,177 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "copy.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+/* Measures how long it takes to copy a sparse raw disk image, the way
+ * it is done when cloning a machine image: a large file with a 1M
+ * extent of data every 64M and holes in between. The plain read/write
+ * loop stands for how such images used to be copied. */
+
+#define DEFAULT_SIZE_MB 1024
+#define EXTENT_SIZE (1024 * 1024)
+#define EXTENT_STRIDE (64 * 1024 * 1024)
+
+static int
+make_image(const char *path, off_t size)
+{
+	_cleanup_close_ int fd = -1;
+	_cleanup_free_ char *buf = NULL;
+	off_t offset;
+	int r;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	buf = malloc(EXTENT_SIZE);
+	if (!buf)
+		return -ENOMEM;
+
+	for (offset = 0; offset < size; offset += EXTENT_STRIDE) {
+		random_bytes(buf, EXTENT_SIZE);
+
+		if (lseek(fd, offset, SEEK_SET) < 0)
+			return -errno;
+
+		r = loop_write(fd, buf, MIN(size - offset, EXTENT_SIZE), false);
+		if (r < 0)
+			return r;
+	}
+
+	if (ftruncate(fd, size) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static int
+copy_read_write(int fdf, int fdt)
+{
+	char buf[64 * 1024];
+
+	for (;;) {
+		ssize_t n;
+		int r;
+
+		n = read(fdf, buf, sizeof(buf));
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			return 0;
+
+		r = loop_write(fdt, buf, n, false);
+		if (r < 0)
+			return r;
+	}
+}
+
+static int
+run(const char *label, const char *from, const char *to, int mode)
+{
+	_cleanup_close_ int fdf = -1, fdt = -1;
+	struct stat st;
+	usec_t n;
+	int r;
+
+	fdf = open(from, O_RDONLY | O_CLOEXEC);
+	if (fdf < 0)
+		return log_error_errno(errno, "Failed to open %s: %m", from);
+
+	fdt = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fdt < 0)
+		return log_error_errno(errno, "Failed to open %s: %m", to);
+
+	n = now(CLOCK_MONOTONIC);
+
+	if (mode < 0)
+		r = copy_read_write(fdf, fdt);
+	else
+		r = copy_bytes(fdf, fdt, (off_t)-1, mode > 0);
+	if (r >= 0 && fsync(fdt) < 0)
+		r = -errno;
+	if (r < 0)
+		return log_error_errno(r, "Failed to copy %s: %m", from);
+
+	n = now(CLOCK_MONOTONIC) - n;
+
+	if (fstat(fdt, &st) < 0)
+		return log_error_errno(errno, "Failed to stat %s: %m", to);
+
+	log_info("%s: %.1fms, %" PRIu64 "M of %" PRIu64 "M allocated", label,
+		(double)n / USEC_PER_MSEC,
+		(uint64_t)st.st_blocks * 512 / (1024 * 1024),
+		(uint64_t)st.st_size / (1024 * 1024));
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char from[] = "/var/tmp/test-copy-benchmark-XXXXXX";
+	char to[] = "/var/tmp/test-copy-benchmark-XXXXXX";
+	unsigned size = DEFAULT_SIZE_MB;
+	int fd, r;
+
+	log_set_max_level(LOG_INFO);
+	log_parse_environment();
+	log_open();
+
+	if (argc > 1 && (safe_atou(argv[1], &size) < 0 || size == 0)) {
+		log_error("Invalid image size in megabytes: %s", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	fd = mkostemp_safe(from, O_CLOEXEC);
+	if (fd < 0) {
+		log_info_errno(fd, "Cannot create image, skipping: %m");
+		return EXIT_TEST_SKIP;
+	}
+	safe_close(fd);
+
+	fd = mkostemp_safe(to, O_CLOEXEC);
+	if (fd < 0) {
+		unlink(from);
+		log_info_errno(fd, "Cannot create copy, skipping: %m");
+		return EXIT_TEST_SKIP;
+	}
+	safe_close(fd);
+
+	r = make_image(from, (off_t)size * 1024 * 1024);
+	if (r < 0)
+		log_error_errno(r, "Failed to create image: %m");
+
+	if (r >= 0)
+		r = run("read/write", from, to, -1);
+	if (r >= 0)
+		r = run("copy_bytes", from, to, 0);
+	if (r >= 0)
+		r = run("copy_bytes with reflink", from, to, 1);
+
+	unlink(from);
+	unlink(to);
+
+	return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
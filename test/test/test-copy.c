@@ -17,6 +17,8 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/stat.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "copy.h"
@@ -83,6 +85,95 @@ test_copy_file_fd(void)
 	unlink(out_fn);
 }
 
+static void
+test_copy_bytes_sparse(void)
+{
+	char in_fn[] = "/tmp/test-copy-bytes-sparse-XXXXXX";
+	char out_fn[] = "/tmp/test-copy-bytes-sparse-XXXXXX";
+	_cleanup_close_ int in_fd = -1, out_fd = -1;
+	_cleanup_free_ char *a = NULL, *b = NULL;
+	size_t sz = 1024 * 1024;
+	struct stat st;
+
+	in_fd = mkostemp_safe(in_fn, 0);
+	assert_se(in_fd >= 0);
+	out_fd = mkostemp_safe(out_fn, 0);
+	assert_se(out_fd >= 0);
+
+	/* Data at both ends, zeroes in between */
+	a = malloc0(sz);
+	assert_se(a);
+	memset(a, 'x', 4096);
+	memset(a + sz - 100, 'y', 100);
+	assert_se(loop_write(in_fd, a, sz, false) == 0);
+	assert_se(lseek(in_fd, 0, SEEK_SET) == 0);
+
+	assert_se(copy_bytes_sparse(in_fd, out_fd, sz - 1) == -EFBIG);
+
+	assert_se(lseek(in_fd, 0, SEEK_SET) == 0);
+	assert_se(ftruncate(out_fd, 0) == 0);
+	assert_se(lseek(out_fd, 0, SEEK_SET) == 0);
+	assert_se(copy_bytes_sparse(in_fd, out_fd, -1) == 0);
+
+	assert_se(fstat(out_fd, &st) == 0);
+	assert_se(st.st_size == (off_t)sz);
+	assert_se(st.st_blocks * 512 < (blkcnt_t)sz);
+
+	b = malloc(sz);
+	assert_se(b);
+	assert_se(pread(out_fd, b, sz, 0) == (ssize_t)sz);
+	assert_se(memcmp(a, b, sz) == 0);
+
+	unlink(in_fn);
+	unlink(out_fn);
+}
+
+static void
+test_copy_bytes_holes(void)
+{
+	char in_fn[] = "/tmp/test-copy-bytes-holes-XXXXXX";
+	char out_fn[] = "/tmp/test-copy-bytes-holes-XXXXXX";
+	_cleanup_close_ int in_fd = -1, out_fd = -1;
+	_cleanup_free_ char *a = NULL, *b = NULL;
+	off_t sz = 16 * 1024 * 1024;
+	struct stat st;
+
+	in_fd = mkostemp_safe(in_fn, 0);
+	assert_se(in_fd >= 0);
+	out_fd = mkostemp_safe(out_fn, 0);
+	assert_se(out_fd >= 0);
+
+	/* Data in the middle, holes around it and at the end */
+	assert_se(ftruncate(in_fd, sz) == 0);
+	assert_se(pwrite(in_fd, "data", 4, sz / 2) == 4);
+
+	assert_se(copy_bytes(in_fd, out_fd, (off_t)-1, false) == 0);
+	assert_se(lseek(in_fd, 0, SEEK_CUR) == sz);
+	assert_se(lseek(out_fd, 0, SEEK_CUR) == sz);
+
+	assert_se(fstat(out_fd, &st) == 0);
+	assert_se(st.st_size == sz);
+	assert_se(st.st_blocks * 512 < sz / 2);
+
+	a = malloc(sz);
+	b = malloc(sz);
+	assert_se(a && b);
+	assert_se(pread(in_fd, a, sz, 0) == sz);
+	assert_se(pread(out_fd, b, sz, 0) == sz);
+	assert_se(memcmp(a, b, sz) == 0);
+
+	/* A limit is still honoured */
+	assert_se(lseek(in_fd, 0, SEEK_SET) == 0);
+	assert_se(ftruncate(out_fd, 0) == 0);
+	assert_se(lseek(out_fd, 0, SEEK_SET) == 0);
+	assert_se(copy_bytes(in_fd, out_fd, 4096, false) == -EFBIG);
+	assert_se(fstat(out_fd, &st) == 0);
+	assert_se(st.st_size == 4096);
+
+	unlink(in_fn);
+	unlink(out_fn);
+}
+
 static void
 test_copy_tree(void)
 {
@@ -140,12 +231,52 @@ test_copy_tree(void)
 	rm_rf_dangerous(original_dir, false, true, false);
 }
 
+static void
+test_copy_tree_many(void)
+{
+	char original_dir[] = "/tmp/test-copy_tree_many/";
+	char copy_dir[] = "/tmp/test-copy_tree_many-copy/";
+	unsigned i;
+
+	rm_rf_dangerous(copy_dir, false, true, false);
+	rm_rf_dangerous(original_dir, false, true, false);
+
+	/* More files than the copy threads may have queued at once */
+	for (i = 0; i < 200; i++) {
+		char name[DECIMAL_STR_MAX(unsigned) * 2 + 16];
+
+		xsprintf(name, "dir%u/file%u", i % 7, i);
+		assert_se(mkdir_parents(strjoina(original_dir, name), 0755) >=
+			0);
+		assert_se(write_string_file(strjoina(original_dir, name),
+				  name) == 0);
+	}
+
+	assert_se(copy_tree(original_dir, copy_dir, false) == 0);
+
+	for (i = 0; i < 200; i++) {
+		_cleanup_free_ char *buf = NULL;
+		char name[DECIMAL_STR_MAX(unsigned) * 2 + 16];
+
+		xsprintf(name, "dir%u/file%u", i % 7, i);
+		assert_se(read_full_file(strjoina(copy_dir, name), &buf,
+				  NULL) == 0);
+		assert_se(streq(strstrip(buf), name));
+	}
+
+	rm_rf_dangerous(copy_dir, false, true, false);
+	rm_rf_dangerous(original_dir, false, true, false);
+}
+
 int
 main(int argc, char *argv[])
 {
 	test_copy_file();
 	test_copy_file_fd();
+	test_copy_bytes_sparse();
+	test_copy_bytes_holes();
 	test_copy_tree();
+	test_copy_tree_many();
 
 	return 0;
 }
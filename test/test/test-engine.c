@@ -31,7 +31,9 @@ main(int argc, char *argv[])
 	_cleanup_bus_error_free_ sd_bus_error err = SD_BUS_ERROR_NULL;
 	Manager *m = NULL;
 	Unit *a = NULL, *b = NULL, *c = NULL, *d = NULL, *e = NULL, *g = NULL,
-	     *h = NULL;
+	     *h = NULL, *i = NULL;
+	sd_bus_error errors[2] = { SD_BUS_ERROR_NULL, SD_BUS_ERROR_NULL };
+	Unit *units[2];
 	FILE *serial = NULL;
 	FDSet *fdset = NULL;
 	Job *j;
@@ -117,6 +119,47 @@ main(int argc, char *argv[])
 		0);
 	manager_dump_jobs(m, stdout, "\t");
 
+	printf("Load5:\n");
+	manager_clear_jobs(m);
+	assert_se(manager_load_unit(m, "requires-missing.service", NULL, NULL,
+			  &i) >= 0);
+	manager_dump_units(m, stdout, "\t");
+
+	printf("Test11: (Several units, failing anchor)\n");
+	units[0] = i;
+	units[1] = c;
+	assert_se(manager_add_jobs(m, JOB_START, units, 2, JOB_REPLACE, false,
+			  errors, NULL) == 0);
+	assert_se(sd_bus_error_is_set(&errors[0]));
+	assert_se(!sd_bus_error_is_set(&errors[1]));
+	assert_se(!i->job);
+	assert_se(c->job && a->job && b->job);
+	manager_dump_jobs(m, stdout, "\t");
+	sd_bus_error_free(&errors[0]);
+
+	printf("Test12: (Several units, failing unit pulled in by anchor)\n");
+	manager_clear_jobs(m);
+	units[0] = c;
+	units[1] = i;
+	assert_se(manager_add_jobs(m, JOB_START, units, 2, JOB_REPLACE, false,
+			  errors, NULL) == 0);
+	assert_se(!sd_bus_error_is_set(&errors[0]));
+	assert_se(sd_bus_error_is_set(&errors[1]));
+	/* Its job must not stay around without the required dependency */
+	assert_se(!i->job);
+	assert_se(c->job && a->job && b->job);
+	manager_dump_jobs(m, stdout, "\t");
+	sd_bus_error_free(&errors[1]);
+
+	printf("Test13: (Several units, all failing)\n");
+	manager_clear_jobs(m);
+	units[0] = i;
+	assert_se(manager_add_jobs(m, JOB_START, units, 1, JOB_REPLACE, false,
+			  errors, NULL) < 0);
+	assert_se(sd_bus_error_is_set(&errors[0]));
+	assert_se(!i->job && !a->job);
+	sd_bus_error_free(&errors[0]);
+
 	manager_free(m);
 
 	return 0;
@@ -0,0 +1,491 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Measures how fast the login manager registers sessions when many
+ * logins arrive at once.
+ *
+ *   test-login-storm SESSIOND [N_SESSIONS] [DELAY_MSEC] [SLOW_MSEC]
+ *
+ * A private dbus-daemon is started, and the login manager at SESSIOND
+ * is connected to it as its system bus. The service manager on that bus
+ * is a stub that acknowledges every job after DELAY_MSEC, except for the
+ * scopes of sessions of the "nobody" user, which take SLOW_MSEC. Half of
+ * the logins are for root and half for nobody; the latency of the root
+ * logins shows whether a slow scope holds up the others. Needs root.
+ *
+ * All of this runs in a mount namespace of its own, with a fresh tmpfs
+ * over the runtime state directories, so that the login manager under
+ * test does not touch the sessions, runtime directories and snapshot
+ * of the running system. */
+
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bus-util.h"
+#include "event-util.h"
+#include "log.h"
+#include "macro.h"
+#include "path-util.h"
+#include "sd-bus.h"
+#include "sd-event.h"
+#include "svc-config.h"
+#include "time-util.h"
+#include "util.h"
+
+static unsigned arg_n_sessions = 500;
+static usec_t arg_delay_usec = 2 * USEC_PER_MSEC;
+static usec_t arg_slow_usec = 500 * USEC_PER_MSEC;
+
+typedef struct StubJob {
+	sd_bus_message *call;
+	char *unit;
+	uint32_t id;
+} StubJob;
+
+typedef struct Login {
+	usec_t started;
+	usec_t finished;
+	pid_t leader;
+	bool slow;
+	int error;
+} Login;
+
+static uint32_t stub_job_id = 0;
+static unsigned n_pending = 0;
+
+static int
+stub_job_finish(sd_event_source *s, uint64_t usec, void *userdata)
+{
+	_cleanup_free_ char *path = NULL;
+	StubJob *j = userdata;
+	sd_bus *bus;
+
+	bus = sd_bus_message_get_bus(j->call);
+
+	assert_se(asprintf(&path, "/org/freedesktop/systemd1/job/%" PRIu32,
+			  j->id) >= 0);
+
+	/* The reply goes out before the job finishes, just like with
+         * the real service manager */
+	assert_se(sd_bus_reply_method_return(j->call, "o", path) >= 0);
+	assert_se(sd_bus_emit_signal(bus, "/org/freedesktop/systemd1",
+			  SVC_DBUS_INTERFACE ".Manager", "JobRemoved", "uoss",
+			  j->id, path, j->unit, "done") >= 0);
+
+	sd_bus_message_unref(j->call);
+	free(j->unit);
+	free(j);
+
+	sd_event_source_unref(s);
+	return 0;
+}
+
+static bool
+stub_is_slow(sd_bus_message *m)
+{
+	const char *name, *slice = NULL;
+
+	/* Look for Slice= in the properties of StartTransientUnit() */
+	assert_se(sd_bus_message_enter_container(m, 'a', "(sv)") >= 0);
+	while (sd_bus_message_enter_container(m, 'r', "sv") > 0) {
+		assert_se(sd_bus_message_read(m, "s", &name) >= 0);
+
+		if (streq(name, "Slice"))
+			assert_se(sd_bus_message_read(m, "v", "s", &slice) >= 0);
+		else
+			assert_se(sd_bus_message_skip(m, "v") >= 0);
+
+		assert_se(sd_bus_message_exit_container(m) >= 0);
+	}
+
+	return streq_ptr(slice, "user-65534.slice");
+}
+
+static int
+stub_method(sd_bus_message *m, void *userdata, sd_bus_error *error)
+{
+	sd_event *event = userdata;
+	const char *member, *unit, *mode;
+	sd_event_source *s;
+	usec_t delay;
+	StubJob *j;
+
+	member = sd_bus_message_get_member(m);
+
+	if (streq(member, "Get"))
+		/* Every unit is active, every job is gone */
+		return sd_bus_reply_method_return(m, "v", "s", "active");
+
+	if (!STR_IN_SET(member, "StartTransientUnit", "StartUnit", "StopUnit"))
+		return sd_bus_reply_method_return(m, NULL);
+
+	assert_se(sd_bus_message_read(m, "ss", &unit, &mode) >= 0);
+
+	delay = arg_delay_usec;
+	if (streq(member, "StartTransientUnit") && stub_is_slow(m))
+		delay = arg_slow_usec;
+
+	j = new0(StubJob, 1);
+	assert_se(j);
+	j->call = sd_bus_message_ref(m);
+	j->unit = strdup(unit);
+	assert_se(j->unit);
+	j->id = ++stub_job_id;
+
+	assert_se(sd_event_add_time(event, &s, CLOCK_MONOTONIC,
+			  now(CLOCK_MONOTONIC) + delay, 0, stub_job_finish,
+			  j) >= 0);
+
+	return 1;
+}
+
+static int
+stub_filter(sd_bus *bus, sd_bus_message *m, void *userdata,
+	sd_bus_error *error)
+{
+	if (!sd_bus_message_is_method_call(m, NULL, NULL) ||
+		!streq_ptr(sd_bus_message_get_destination(m), SVC_DBUS_BUSNAME))
+		return 0;
+
+	return stub_method(m, userdata, error);
+}
+
+static void
+stub_scheduler(const char *address)
+{
+	_cleanup_event_unref_ sd_event *event = NULL;
+	_cleanup_bus_close_unref_ sd_bus *bus = NULL;
+
+	assert_se(sd_event_default(&event) >= 0);
+
+	assert_se(sd_bus_new(&bus) >= 0);
+	assert_se(sd_bus_set_address(bus, address) >= 0);
+	assert_se(sd_bus_set_bus_client(bus, true) >= 0);
+	assert_se(sd_bus_start(bus) >= 0);
+
+	assert_se(sd_bus_add_filter(bus, NULL, stub_filter, event) >= 0);
+	assert_se(sd_bus_request_name(bus, SVC_DBUS_BUSNAME, 0) >= 0);
+	assert_se(sd_bus_attach_event(bus, event, 0) >= 0);
+
+	assert_se(sd_event_loop(event) >= 0);
+}
+
+static int
+login_reply(sd_bus *bus, sd_bus_message *m, void *userdata,
+	sd_bus_error *error)
+{
+	Login *l = userdata;
+
+	l->finished = now(CLOCK_MONOTONIC);
+	if (sd_bus_message_is_method_error(m, NULL))
+		l->error = sd_bus_error_get_errno(sd_bus_message_get_error(m));
+
+	n_pending--;
+	return 0;
+}
+
+static void
+login_storm(sd_bus *bus, Login *logins)
+{
+	unsigned i;
+
+	for (i = 0; i < arg_n_sessions; i++) {
+		_cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+		Login *l = logins + i;
+
+		l->slow = i % 2;
+
+		assert_se(sd_bus_message_new_method_call(bus, &m,
+				  SVC_SESSIOND_DBUS_BUSNAME,
+				  "/org/freedesktop/login1",
+				  SVC_SESSIOND_DBUS_INTERFACE ".Manager",
+				  "CreateSession") >= 0);
+		assert_se(sd_bus_message_append(m, "uusssssussbss",
+				  l->slow ? 65534 : 0, (uint32_t)l->leader,
+				  "sshd", "tty", "user", "", "", 0, "", "",
+				  true, "", "localhost") >= 0);
+		assert_se(sd_bus_message_append(m, "a(sv)", 0) >= 0);
+
+		l->started = now(CLOCK_MONOTONIC);
+		assert_se(sd_bus_call_async(bus, NULL, m, login_reply, l,
+				  30 * USEC_PER_SEC) >= 0);
+		n_pending++;
+	}
+
+	while (n_pending > 0) {
+		int r;
+
+		r = sd_bus_process(bus, NULL);
+		assert_se(r >= 0);
+		if (r == 0)
+			assert_se(sd_bus_wait(bus, USEC_INFINITY) >= 0);
+	}
+}
+
+static int
+usec_compare(const void *a, const void *b)
+{
+	const usec_t *x = a, *y = b;
+
+	return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+static void
+print_latency(const char *what, Login *logins, bool slow)
+{
+	_cleanup_free_ usec_t *t = NULL;
+	unsigned i, n = 0, n_failed = 0;
+
+	t = new (usec_t, arg_n_sessions);
+	assert_se(t);
+
+	for (i = 0; i < arg_n_sessions; i++) {
+		if (logins[i].slow != slow)
+			continue;
+		if (logins[i].error != 0) {
+			n_failed++;
+			continue;
+		}
+
+		t[n++] = logins[i].finished - logins[i].started;
+	}
+
+	if (n == 0) {
+		printf("%s: all %u failed\n", what, n_failed);
+		return;
+	}
+
+	qsort(t, n, sizeof(usec_t), usec_compare);
+
+	printf("%s: %u ok, %u failed, p50 %s, p99 %s, max %s\n", what, n,
+		n_failed, format_timespan(alloca(FORMAT_TIMESPAN_MAX),
+				  FORMAT_TIMESPAN_MAX, t[n / 2], USEC_PER_MSEC),
+		format_timespan(alloca(FORMAT_TIMESPAN_MAX),
+			FORMAT_TIMESPAN_MAX, t[n * 99 / 100], USEC_PER_MSEC),
+		format_timespan(alloca(FORMAT_TIMESPAN_MAX),
+			FORMAT_TIMESPAN_MAX, t[n - 1], USEC_PER_MSEC));
+}
+
+static pid_t
+spawn_leader(void)
+{
+	pid_t pid;
+
+	pid = fork();
+	assert_se(pid >= 0);
+
+	if (pid == 0) {
+		(void)prctl(PR_SET_PDEATHSIG, SIGTERM);
+		pause();
+		_exit(EXIT_SUCCESS);
+	}
+
+	return pid;
+}
+
+static pid_t
+spawn_bus(char **address)
+{
+	char buf[LINE_MAX], fd[DECIMAL_STR_MAX(int)];
+	_cleanup_fclose_ FILE *f = NULL;
+	int p[2];
+	pid_t pid;
+
+	assert_se(pipe2(p, O_CLOEXEC) >= 0);
+
+	pid = fork();
+	assert_se(pid >= 0);
+
+	if (pid == 0) {
+		assert_se(fd_cloexec(p[1], false) >= 0);
+		xsprintf(fd, "%i", p[1]);
+
+		execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork",
+			"--nopidfile", strjoina("--print-address=", fd), NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	safe_close(p[1]);
+	f = fdopen(p[0], "r");
+	assert_se(f);
+
+	if (!fgets(buf, sizeof(buf), f))
+		return -1;
+
+	*address = strdup(strstrip(buf));
+	assert_se(*address);
+
+	return pid;
+}
+
+static pid_t
+spawn_child(const char *address, const char *sessiond)
+{
+	pid_t pid;
+
+	pid = fork();
+	assert_se(pid >= 0);
+
+	if (pid == 0) {
+		(void)prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+		if (!sessiond) {
+			stub_scheduler(address);
+			_exit(EXIT_SUCCESS);
+		}
+
+		assert_se(setenv("DBUS_SYSTEM_BUS_ADDRESS", address, 1) >= 0);
+		execl(sessiond, sessiond, NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	return pid;
+}
+
+static int
+setup_private_runtime(void)
+{
+	if (unshare(CLONE_NEWNS) < 0)
+		return -errno;
+
+	/* Don't let our mounts propagate back to the host */
+	if (mount(NULL, "/", NULL, MS_SLAVE | MS_REC, NULL) < 0)
+		return -errno;
+
+	if (mount("tmpfs", SVC_RUNSTATEDIR, "tmpfs", MS_NOSUID | MS_NODEV,
+		    "mode=755") < 0)
+		return -errno;
+
+	if (!path_startswith(SVC_USERRUNSTATEDIR, SVC_RUNSTATEDIR) &&
+		mount("tmpfs", SVC_USERRUNSTATEDIR, "tmpfs",
+			MS_NOSUID | MS_NODEV, "mode=755") < 0)
+		return -errno;
+
+	return 0;
+}
+
+static void
+wait_for_name(sd_bus *bus, const char *name)
+{
+	for (;;) {
+		_cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+		int b;
+
+		assert_se(sd_bus_call_method(bus, "org.freedesktop.DBus",
+				  "/org/freedesktop/DBus",
+				  "org.freedesktop.DBus", "NameHasOwner", NULL,
+				  &reply, "s", name) >= 0);
+		assert_se(sd_bus_message_read(reply, "b", &b) >= 0);
+		if (b)
+			return;
+
+		usleep(10 * USEC_PER_MSEC);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	_cleanup_bus_close_unref_ sd_bus *bus = NULL;
+	_cleanup_free_ char *address = NULL;
+	_cleanup_free_ Login *logins = NULL;
+	pid_t bus_pid, stub_pid, sessiond_pid;
+	usec_t started, elapsed;
+	unsigned i;
+	int r;
+
+	log_set_max_level(LOG_DEBUG);
+	log_parse_environment();
+
+	if (argc < 2) {
+		log_error(
+			"Usage: %s SESSIOND [N_SESSIONS] [DELAY_MSEC] [SLOW_MSEC]",
+			program_invocation_short_name);
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 2)
+		assert_se(safe_atou(argv[2], &arg_n_sessions) >= 0);
+	if (argc > 3)
+		assert_se(parse_sec(strjoina(argv[3], "ms"),
+				  &arg_delay_usec) >= 0);
+	if (argc > 4)
+		assert_se(parse_sec(strjoina(argv[4], "ms"),
+				  &arg_slow_usec) >= 0);
+
+	if (getuid() != 0 || !getpwuid(65534)) {
+		log_info("Skipping test: need root and a nobody user.");
+		return EXIT_TEST_SKIP;
+	}
+
+	r = setup_private_runtime();
+	if (r < 0) {
+		log_info_errno(r,
+			"Skipping test: failed to set up a private runtime directory: %m");
+		return EXIT_TEST_SKIP;
+	}
+
+	bus_pid = spawn_bus(&address);
+	if (bus_pid < 0) {
+		log_info("Skipping test: failed to start dbus-daemon.");
+		return EXIT_TEST_SKIP;
+	}
+
+	assert_se(sd_bus_new(&bus) >= 0);
+	assert_se(sd_bus_set_address(bus, address) >= 0);
+	assert_se(sd_bus_set_bus_client(bus, true) >= 0);
+	assert_se(sd_bus_start(bus) >= 0);
+
+	stub_pid = spawn_child(address, NULL);
+	wait_for_name(bus, SVC_DBUS_BUSNAME);
+	sessiond_pid = spawn_child(address, argv[1]);
+	wait_for_name(bus, SVC_SESSIOND_DBUS_BUSNAME);
+
+	logins = new0(Login, arg_n_sessions);
+	assert_se(logins);
+	for (i = 0; i < arg_n_sessions; i++)
+		logins[i].leader = spawn_leader();
+
+	started = now(CLOCK_MONOTONIC);
+	login_storm(bus, logins);
+	elapsed = now(CLOCK_MONOTONIC) - started;
+
+	printf("%u logins in %s, %llu/s\n", arg_n_sessions,
+		format_timespan(alloca(FORMAT_TIMESPAN_MAX),
+			FORMAT_TIMESPAN_MAX, elapsed, USEC_PER_MSEC),
+		(unsigned long long)(arg_n_sessions * USEC_PER_SEC /
+			MAX(elapsed, 1U)));
+	print_latency("fast user", logins, false);
+	print_latency("slow user", logins, true);
+
+	for (i = 0; i < arg_n_sessions; i++)
+		kill(logins[i].leader, SIGTERM);
+	kill(sessiond_pid, SIGTERM);
+	kill(stub_pid, SIGTERM);
+	kill(bus_pid, SIGTERM);
+
+	while (wait(NULL) > 0)
+		;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "namespace.h"
+#include "strv.h"
+#include "util.h"
+
+/* Measures how long it takes from fork() until a child has entered its
+ * sandbox and exited, for the sandbox of a typical hardened service:
+ *
+ *     ProtectSystem=full
+ *     ProtectHome=yes
+ *     PrivateDevices=yes
+ *     ReadOnlyDirectories=/var
+ *
+ * once with every child setting up its own mount namespace, and once
+ * with all of them joining the namespace left behind by the first. */
+
+#define DEFAULT_ITERATIONS 200
+
+static int
+usec_compare(const void *a, const void *b)
+{
+	const usec_t *x = a, *y = b;
+
+	return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+static int
+spawn_one(NamespaceTemplate *t, usec_t *ret)
+{
+	siginfo_t si;
+	usec_t n;
+	pid_t pid;
+	int r;
+
+	n = now(CLOCK_MONOTONIC);
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+
+	if (pid == 0) {
+		if (t)
+			r = setup_namespace_template(t, NULL, NULL,
+				STRV_MAKE("/var"), NULL, true,
+				PROTECT_HOME_YES, PROTECT_SYSTEM_FULL, 0);
+		else
+			r = setup_namespace(NULL, NULL, STRV_MAKE("/var"), NULL,
+				NULL, NULL, NULL, true, PROTECT_HOME_YES,
+				PROTECT_SYSTEM_FULL, 0);
+
+		_exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	r = wait_for_terminate(pid, &si);
+	if (r < 0)
+		return r;
+
+	if (si.si_code != CLD_EXITED || si.si_status != EXIT_SUCCESS)
+		return -EPROTO;
+
+	*ret = now(CLOCK_MONOTONIC) - n;
+	return 0;
+}
+
+static int
+run(const char *label, NamespaceTemplate *t, unsigned iterations)
+{
+	_cleanup_free_ usec_t *latency = NULL;
+	usec_t total = 0;
+	unsigned i;
+	int r;
+
+	latency = new (usec_t, iterations);
+	if (!latency)
+		return log_oom();
+
+	for (i = 0; i < iterations; i++) {
+		r = spawn_one(t, &latency[i]);
+		if (r < 0)
+			return log_error_errno(r,
+				"Failed to set up sandbox: %m");
+
+		total += latency[i];
+	}
+
+	qsort(latency, iterations, sizeof(usec_t), usec_compare);
+
+	log_info("%s: %u starts, mean %.1fms, p50 %.1fms, p99 %.1fms, "
+		 "max %.1fms",
+		label, iterations, (double)total / iterations / USEC_PER_MSEC,
+		(double)latency[iterations / 2] / USEC_PER_MSEC,
+		(double)latency[iterations * 99 / 100] / USEC_PER_MSEC,
+		(double)latency[iterations - 1] / USEC_PER_MSEC);
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	NamespaceTemplate *t = NULL;
+	unsigned iterations = DEFAULT_ITERATIONS;
+	int r;
+
+	log_set_max_level(LOG_INFO);
+	log_parse_environment();
+	log_open();
+
+	if (argc > 1 && (safe_atou(argv[1], &iterations) < 0 ||
+				iterations == 0)) {
+		log_error("Invalid number of iterations: %s", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	if (geteuid() != 0) {
+		log_info("Not running as root, skipping.");
+		return EXIT_TEST_SKIP;
+	}
+
+	/* Bail out early if we are not allowed to create namespaces */
+	r = run("probe", NULL, 1);
+	if (r < 0)
+		return EXIT_TEST_SKIP;
+
+	r = run("setup_namespace", NULL, iterations);
+	if (r < 0)
+		return EXIT_FAILURE;
+
+	r = namespace_template_new("benchmark", &t);
+	if (r < 0) {
+		log_error_errno(r, "Failed to allocate template: %m");
+		return EXIT_FAILURE;
+	}
+
+	r = run("setup_namespace_template", t, iterations);
+	namespace_template_free(t);
+
+	return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -20,6 +20,7 @@
 #include <sys/socket.h>
 
 #include "namespace.h"
+#include "strv.h"
 #include "util.h"
 
 static void
@@ -119,6 +120,98 @@ test_netns(void)
 	assert_se(n == 1);
 }
 
+static void
+test_namespace_template_key(void)
+{
+	_cleanup_free_ char *a = NULL, *b = NULL, *c = NULL, *d = NULL;
+
+	assert_se(namespace_template_key(NULL, NULL, STRV_MAKE("/usr"), NULL,
+			  true, PROTECT_HOME_NO, PROTECT_SYSTEM_NO, 0,
+			  &a) >= 0);
+	assert_se(namespace_template_key(NULL, NULL, STRV_MAKE("/usr"), NULL,
+			  true, PROTECT_HOME_NO, PROTECT_SYSTEM_NO, 0,
+			  &b) >= 0);
+	assert_se(streq(a, b));
+
+	/* Same path, but in another list */
+	assert_se(namespace_template_key(NULL, STRV_MAKE("/usr"), NULL, NULL,
+			  true, PROTECT_HOME_NO, PROTECT_SYSTEM_NO, 0,
+			  &c) >= 0);
+	assert_se(!streq(a, c));
+
+	assert_se(namespace_template_key("/srv", NULL, STRV_MAKE("/usr"),
+			  NULL, true, PROTECT_HOME_NO, PROTECT_SYSTEM_NO, 0,
+			  &d) >= 0);
+	assert_se(!streq(a, d));
+}
+
+static void
+test_namespace_template(void)
+{
+	NamespaceTemplate *t = NULL;
+	_cleanup_close_pair_ int p[2] = { -1, -1 };
+	struct stat st;
+	ino_t ino = 0;
+	unsigned i;
+	int n = 0;
+
+	if (geteuid() > 0)
+		return;
+
+	assert_se(namespace_template_new("test", &t) >= 0);
+	assert_se(pipe2(p, O_CLOEXEC) >= 0);
+
+	for (i = 0; i < 3; i++) {
+		pid_t pid;
+		siginfo_t si;
+
+		pid = fork();
+		assert_se(pid >= 0);
+
+		if (pid == 0) {
+			int r;
+
+			r = setup_namespace_template(t, NULL, NULL,
+				STRV_MAKE("/usr"), NULL, false,
+				PROTECT_HOME_NO, PROTECT_SYSTEM_NO, 0);
+			if (r == -EPERM || r == -EACCES)
+				_exit(EXIT_TEST_SKIP);
+			assert_se(r >= 0);
+
+			assert_se(stat("/proc/self/ns/mnt", &st) >= 0);
+			assert_se(write(p[1], &st.st_ino, sizeof(st.st_ino)) ==
+				sizeof(st.st_ino));
+			_exit(r);
+		}
+
+		assert_se(wait_for_terminate(pid, &si) >= 0);
+		assert_se(si.si_code == CLD_EXITED);
+		if (si.si_status == EXIT_TEST_SKIP) {
+			log_info("Cannot create mount namespaces, skipping.");
+			namespace_template_free(t);
+			return;
+		}
+
+		n += si.si_status;
+	}
+
+	/* Only the first one set it up, and everybody ended up in the
+         * same namespace, which is not ours */
+	assert_se(n == 1);
+
+	assert_se(stat("/proc/self/ns/mnt", &st) >= 0);
+	for (i = 0; i < 3; i++) {
+		ino_t x;
+
+		assert_se(read(p[0], &x, sizeof(x)) == sizeof(x));
+		assert_se(x != st.st_ino);
+		assert_se(ino == 0 || ino == x);
+		ino = x;
+	}
+
+	namespace_template_free(t);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -150,6 +243,8 @@ main(int argc, char *argv[])
 		z, zz);
 
 	test_netns();
+	test_namespace_template_key();
+	test_namespace_template();
 
 	return 0;
 }
@@ -659,6 +659,49 @@ test_get_process_comm(void)
 	log_info("pid1 $PATH: '%s'", strna(i));
 }
 
+static void
+test_get_process_info(void)
+{
+	_cleanup_free_ char *comm = NULL, *cmdline = NULL, *capeff = NULL;
+	ProcessInfo info;
+	pid_t me = getpid();
+
+	assert_se(get_process_info(me,
+			  PROCESS_INFO_COMM | PROCESS_INFO_EXE |
+				  PROCESS_INFO_CMDLINE | PROCESS_INFO_UID |
+				  PROCESS_INFO_GID | PROCESS_INFO_CAPEFF |
+				  PROCESS_INFO_PPID,
+			  &info) == 0);
+
+	assert_se(get_process_comm(me, &comm) >= 0);
+	assert_se(info.mask & PROCESS_INFO_COMM);
+	assert_se(streq(info.comm, comm));
+
+	assert_se(get_process_cmdline(me, 0, false, &cmdline) >= 0);
+	assert_se(info.mask & PROCESS_INFO_CMDLINE);
+	assert_se(streq(info.cmdline, cmdline));
+
+	assert_se(get_process_capeff(me, &capeff) >= 0);
+	assert_se(info.mask & PROCESS_INFO_CAPEFF);
+	assert_se(streq(info.capeff, capeff));
+
+	assert_se(info.mask & PROCESS_INFO_UID);
+	assert_se(info.uid == getuid() && info.euid == geteuid());
+	assert_se(info.mask & PROCESS_INFO_GID);
+	assert_se(info.gid == getgid() && info.egid == getegid());
+	assert_se(info.mask & PROCESS_INFO_PPID);
+	assert_se(info.ppid == getppid());
+
+	log_info("self exe: '%s'", strna(info.exe));
+	process_info_done(&info);
+
+	/* Only what was asked for */
+	assert_se(get_process_info(me, PROCESS_INFO_UID, &info) == 0);
+	assert_se(info.mask == PROCESS_INFO_UID);
+	assert_se(!info.comm && !info.exe && !info.cmdline && !info.capeff);
+	process_info_done(&info);
+}
+
 static void
 test_protect_errno(void)
 {
@@ -2432,6 +2475,7 @@ main(int argc, char *argv[])
 	test_hostname_is_valid();
 	test_u64log2();
 	test_get_process_comm();
+	test_get_process_info();
 	test_protect_errno();
 	test_parse_size();
 	test_parse_range();
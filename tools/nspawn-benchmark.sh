@@ -0,0 +1,76 @@
+#!/bin/sh
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+# Launches N short-lived containers from a local directory tree, up to J
+# of them at the same time, and reports how long each one took until it
+# was ready to run its payload, as measured by nspawn --timing, as well
+# as the overall throughput. Further options are passed on to nspawn.
+#
+#   nspawn-benchmark.sh DIRECTORY [N] [J] [NSPAWN-OPTIONS...]
+#
+# Set NSPAWN to the nspawn binary to use. Needs to run as root.
+
+set -eu
+
+directory=${1:?Usage: $0 DIRECTORY [N] [J] [NSPAWN-OPTIONS...]}
+count=${2:-100}
+jobs=${3:-1}
+shift $(($# < 3 ? $# : 3))
+
+nspawn=${NSPAWN:-systemd-nspawn}
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+run() {
+	i=$1
+	while [ "$i" -le "$count" ]; do
+		"$nspawn" -q --read-only --timing -D "$directory" \
+			-M "nspawn-bench-$i" "$@" /bin/true \
+			2>"$out/$i.log" >/dev/null ||
+			echo "container $i failed, see below" >&2
+		i=$((i + jobs))
+	done
+}
+
+start=$(date +%s%N)
+
+j=1
+while [ "$j" -le "$jobs" ]; do
+	run "$j" "$@" &
+	j=$((j + 1))
+done
+wait
+
+end=$(date +%s%N)
+
+cat "$out"/*.log | grep -v '^Container ready after' | grep -v '^ *[0-9.]*ms ' |
+	grep -v '^ *START ' >&2 || :
+
+sed -n 's/^Container ready after \([0-9.]*\)ms\.$/\1/p' "$out"/*.log |
+	sort -n | awk -v total="$(((end - start) / 1000000))" '
+	{ t[NR] = $1; sum += $1 }
+	END {
+		if (NR == 0) {
+			print "No container came up."
+			exit 1
+		}
+		printf "%d containers in %dms, %.1f per second\n",
+			NR, total, NR * 1000 / (total > 0 ? total : 1)
+		printf "ready after: mean %.1fms, p50 %.1fms, p99 %.1fms, max %.1fms\n",
+			sum / NR, t[int((NR + 1) / 2)], t[int((NR * 99 + 99) / 100)],
+			t[NR]
+	}'
+
+# Average time of each setup phase, for the parent and the child
+cat "$out"/*.log | awk '
+	$1 ~ /ms$/ && $2 ~ /ms$/ {
+		key = $3 " " $4
+		if (!(key in sum))
+			order[++n] = key
+		sum[key] += $2 + 0
+		cnt[key]++
+	}
+	END {
+		for (i = 1; i <= n; i++)
+			printf "%10.1fms  %s\n", sum[order[i]] / cnt[order[i]], order[i]
+	}'